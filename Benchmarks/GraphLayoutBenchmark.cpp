@@ -0,0 +1,294 @@
+// GraphLayoutBenchmark.cpp
+//
+// Compares the memory layout of the currency graph of the Strategy with the nested vectors it replaced: an
+// exchangeRatesMatrix of std::vector rows, an adjacency list g searched linearly for the edge to update, and a list
+// of third currencies per pair. Both replay the same best bid and ask updates the way the Strategy does: store the
+// rates of the updated pair, evaluate its triangles and read price and size of the legs of the profitable ones.
+// Between two updates a buffer larger than the caches is walked, as the other threads on the socket would, so that
+// every update starts cold. Cache misses come from the hardware counters when perf_event_open is available.
+//
+// Usage: ./bench_graph_layout [number of updates] [eviction buffer size in KiB]
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <linux/perf_event.h>
+#include <random>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+#include "../StrategyComponent/CurrencyGraph.hpp"
+#include "SyntheticCurrencyGraph.hpp"
+
+#define DEFAULT_NUMBER_OF_UPDATES 20000
+#define DEFAULT_EVICTION_BUFFER_SIZE_IN_KIB 8192
+
+using namespace std::chrono;
+
+struct BestBidAndAskUpdate {
+    int currencyPairIdx;
+    int baseCurrencyIndex;
+    int quoteCurrencyIndex;
+    double bestBuyPrice;
+    double bestSellPriceReciprocal;
+};
+
+struct LayoutResult {
+    std::vector<double> latencies;
+    long long l1dMisses;
+    long long llcMisses;
+    size_t opportunities;
+};
+
+// The layout the flat edge array replaced
+struct NestedExchangeRate {
+    double bestPrice;
+    double bestPriceSize;
+};
+
+struct NestedCurrencyGraph {
+    size_t V;
+    std::vector<std::vector<NestedExchangeRate>> exchangeRatesMatrix;
+    std::vector<std::vector<std::pair<int, double>>> g;
+    std::vector<std::vector<int>> thirdCurrenciesOfPair;
+};
+
+static void createNestedCurrencyGraph(const CurrencyGraph& graph, NestedCurrencyGraph& nestedGraph) {
+    size_t V = nestedGraph.V = graph.V;
+    nestedGraph.exchangeRatesMatrix = std::vector<std::vector<NestedExchangeRate>>(V, std::vector<NestedExchangeRate>(V, {0.0, 0.0}));
+    nestedGraph.g.resize(V);
+    nestedGraph.thirdCurrenciesOfPair.resize(V * V);
+    for (const Edge& edge : graph.edges) {
+        nestedGraph.g[edge.sourceCurrency].emplace_back(edge.targetCurrency, std::numeric_limits<double>::infinity());
+        for (size_t w = 0; w < V; ++w)
+            if ((int)w != edge.sourceCurrency && (int)w != edge.targetCurrency && graph.edgeIdOfPair[edge.sourceCurrency * V + w] >= 0 &&
+                graph.edgeIdOfPair[edge.targetCurrency * V + w] >= 0)
+                nestedGraph.thirdCurrenciesOfPair[edge.sourceCurrency * V + edge.targetCurrency].push_back(w);
+    }
+}
+
+static double& findEdgeWeight(NestedCurrencyGraph& nestedGraph, int u, int v) {
+    for (auto& edge : nestedGraph.g[u])
+        if (edge.first == v)
+            return edge.second;
+    return nestedGraph.g[u].emplace_back(v, std::numeric_limits<double>::infinity()).second;
+}
+
+static void setNestedExchangeRate(NestedCurrencyGraph& nestedGraph, int u, int v, double price, double size) {
+    nestedGraph.exchangeRatesMatrix[u][v] = {price, size};
+    double weight = -log(price * AFTER_FEE_RATE);
+    findEdgeWeight(nestedGraph, u, v) = std::isfinite(weight) ? weight : std::numeric_limits<double>::infinity();
+}
+
+static size_t runNestedUpdate(NestedCurrencyGraph& nestedGraph, const BestBidAndAskUpdate& update, double& checksum) {
+    int u = update.baseCurrencyIndex;
+    int v = update.quoteCurrencyIndex;
+    setNestedExchangeRate(nestedGraph, u, v, update.bestBuyPrice, 1.0);
+    setNestedExchangeRate(nestedGraph, v, u, update.bestSellPriceReciprocal, 1.0);
+
+    size_t opportunities = 0;
+    for (int w : nestedGraph.thirdCurrenciesOfPair[u * nestedGraph.V + v]) {
+        int cycles[2][NUMBER_OF_ORDERS_FOR_TRIANGULAR_ARBITRAGE + 1] = {{u, v, w, u}, {u, w, v, u}};
+        for (const int* currencySequence : cycles) {
+            double weight = 0;
+            for (int i = 0; i < NUMBER_OF_ORDERS_FOR_TRIANGULAR_ARBITRAGE; i++)
+                weight += findEdgeWeight(nestedGraph, currencySequence[i], currencySequence[i + 1]);
+            if (!(weight < -CYCLE_LOG_RATE_THRESHOLD))
+                continue;
+            for (int i = 0; i < NUMBER_OF_ORDERS_FOR_TRIANGULAR_ARBITRAGE; i++) {
+                const NestedExchangeRate& exchangeRate = nestedGraph.exchangeRatesMatrix[currencySequence[i]][currencySequence[i + 1]];
+                checksum += exchangeRate.bestPrice * exchangeRate.bestPriceSize;
+            }
+            opportunities++;
+        }
+    }
+    return opportunities;
+}
+
+static size_t runFlatUpdate(CurrencyGraph& graph, const BestBidAndAskUpdate& update, std::vector<TriangularArbitrageCycle>& cycles, double& checksum) {
+    setExchangeRate(graph, graph.sellEdgeIdOfPair[update.currencyPairIdx], update.bestBuyPrice, 1.0);
+    setExchangeRate(graph, graph.buyEdgeIdOfPair[update.currencyPairIdx], update.bestSellPriceReciprocal, 1.0);
+
+    cycles.clear();
+    size_t opportunities = findTriangularArbitrages(graph, update.currencyPairIdx, cycles);
+    for (const TriangularArbitrageCycle& cycle : cycles) {
+        for (int i = 0; i < NUMBER_OF_ORDERS_FOR_TRIANGULAR_ARBITRAGE; i++) {
+            const Edge& edge = graph.edges[cycle.edgeIds[i]];
+            checksum += edge.bestPrice * edge.bestPriceSize;
+        }
+    }
+    return opportunities;
+}
+
+static size_t getCacheLines(size_t bytes) {
+    return (bytes + CACHELINE_SIZE - 1) / CACHELINE_SIZE;
+}
+
+// Every allocation starts on its own cache line
+static size_t getWorkingSetInCacheLines(const NestedCurrencyGraph& nestedGraph) {
+    size_t cacheLines = getCacheLines(nestedGraph.exchangeRatesMatrix.size() * sizeof(std::vector<NestedExchangeRate>)) +
+                        getCacheLines(nestedGraph.g.size() * sizeof(std::vector<std::pair<int, double>>)) +
+                        getCacheLines(nestedGraph.thirdCurrenciesOfPair.size() * sizeof(std::vector<int>));
+    for (const auto& row : nestedGraph.exchangeRatesMatrix)
+        cacheLines += getCacheLines(row.size() * sizeof(NestedExchangeRate));
+    for (const auto& edges : nestedGraph.g)
+        cacheLines += getCacheLines(edges.size() * sizeof(std::pair<int, double>));
+    for (const auto& thirdCurrencies : nestedGraph.thirdCurrenciesOfPair)
+        cacheLines += getCacheLines(thirdCurrencies.size() * sizeof(int));
+    return cacheLines;
+}
+
+// The tables of the flat graph are laid out back to back in the portfolio
+template <typename Tables>
+static size_t getWorkingSetInCacheLines(const CurrencyGraph& graph, const Tables& portfolio) {
+    return getCacheLines(graph.edges.size() * sizeof(Edge)) + getCacheLines(sizeof(portfolio.edgeIdOfPair) + sizeof(portfolio.sellEdgeIdOfPair) +
+           sizeof(portfolio.buyEdgeIdOfPair) + 3 * sizeof(portfolio.cycleFirstEdgeIds) + sizeof(portfolio.cycleOffsetOfPair));
+}
+
+static int openCacheMissCounter(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static long long readCounter(int fd) {
+    long long value = 0;
+    if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value))
+        return 0;
+    return value;
+}
+
+static void evictCaches(std::vector<char>& evictionBuffer) {
+    for (size_t i = 0; i < evictionBuffer.size(); i += CACHELINE_SIZE)
+        evictionBuffer[i]++;
+}
+
+template <typename Tables>
+static std::vector<BestBidAndAskUpdate> generateUpdates(const Tables& portfolio, const CurrencyGraph& graph, size_t numberOfUpdates) {
+    std::vector<std::pair<int, int>> pairs;
+    for (size_t pairIdx = 0; pairIdx < portfolio.numberOfPairs; pairIdx++)
+        pairs.emplace_back(portfolio.baseCurrencyIndexOfPair[pairIdx], portfolio.quoteCurrencyIndexOfPair[pairIdx]);
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> valueDistribution(-3, 3);
+    std::normal_distribution<double> moveDistribution(0, MID_PRICE_VOLATILITY);
+    std::uniform_int_distribution<size_t> pairDistribution(0, pairs.size() - 1);
+    std::vector<double> currencyValues(graph.V);
+    for (double& currencyValue : currencyValues)
+        currencyValue = exp(valueDistribution(rng));
+    std::vector<double> midPrices(pairs.size());
+    for (size_t i = 0; i < pairs.size(); i++)
+        midPrices[i] = currencyValues[pairs[i].first] / currencyValues[pairs[i].second];
+
+    // Every pair gets a first update before the measured ones
+    std::vector<BestBidAndAskUpdate> updates;
+    for (size_t update = 0; update < pairs.size() + numberOfUpdates; update++) {
+        size_t pairIdx = update < pairs.size() ? update : pairDistribution(rng);
+        double consistentMidPrice = currencyValues[pairs[pairIdx].first] / currencyValues[pairs[pairIdx].second];
+        midPrices[pairIdx] *= exp(moveDistribution(rng) - 0.1 * log(midPrices[pairIdx] / consistentMidPrice));
+        updates.push_back({(int)pairIdx, pairs[pairIdx].first, pairs[pairIdx].second, midPrices[pairIdx] * (1 - HALF_SPREAD),
+                           1.0 / (midPrices[pairIdx] * (1 + HALF_SPREAD))});
+    }
+    return updates;
+}
+
+template <typename RunUpdate>
+static LayoutResult runLayout(const std::vector<BestBidAndAskUpdate>& updates, size_t numberOfWarmUpUpdates, std::vector<char>& evictionBuffer,
+                              int l1dMissesFd, int llcMissesFd, RunUpdate runUpdate) {
+    LayoutResult result = {std::vector<double>(), 0, 0, 0};
+    result.latencies.reserve(updates.size());
+    for (size_t update = 0; update < updates.size(); update++) {
+        if (update < numberOfWarmUpUpdates) {
+            runUpdate(updates[update]);
+            continue;
+        }
+        evictCaches(evictionBuffer);
+        long long l1dMissesBefore = readCounter(l1dMissesFd);
+        long long llcMissesBefore = readCounter(llcMissesFd);
+        steady_clock::time_point startTimestamp = steady_clock::now();
+        result.opportunities += runUpdate(updates[update]);
+        steady_clock::time_point completionTimestamp = steady_clock::now();
+        result.l1dMisses += readCounter(l1dMissesFd) - l1dMissesBefore;
+        result.llcMisses += readCounter(llcMissesFd) - llcMissesBefore;
+        result.latencies.push_back(duration<double, std::nano>(completionTimestamp - startTimestamp).count());
+    }
+    return result;
+}
+
+static void printResult(const char* portfolioName, const char* layout, size_t workingSetInCacheLines, LayoutResult& result, bool countersAvailable) {
+    std::sort(result.latencies.begin(), result.latencies.end());
+    double mean = 0;
+    for (double latency : result.latencies)
+        mean += latency / result.latencies.size();
+    printf("%-10s %-8s %12zu %10.0f %10.0f %10.0f", portfolioName, layout, workingSetInCacheLines, result.latencies[result.latencies.size() / 2],
+           result.latencies[std::min(result.latencies.size() - 1, result.latencies.size() * 99 / 100)], mean);
+    if (countersAvailable)
+        printf(" %14.2f %14.2f", (double)result.l1dMisses / result.latencies.size(), (double)result.llcMisses / result.latencies.size());
+    else
+        printf(" %14s %14s", "n/a", "n/a");
+    printf(" %14zu\n", result.opportunities);
+}
+
+template <typename Tables>
+static void runPortfolio(const char* portfolioName, const Tables& portfolio, size_t numberOfUpdates, std::vector<char>& evictionBuffer, int l1dMissesFd,
+                         int llcMissesFd, bool countersAvailable, double& checksum) {
+    CurrencyGraph graph;
+    createCurrencyGraph(portfolio, graph);
+    // The layouts are compared, not the SIMD kernels
+    graph.cycleEvaluationKernel = CycleEvaluationKernel::Scalar;
+    NestedCurrencyGraph nestedGraph;
+    createNestedCurrencyGraph(graph, nestedGraph);
+    std::vector<BestBidAndAskUpdate> updates = generateUpdates(portfolio, graph, numberOfUpdates);
+    size_t numberOfWarmUpUpdates = updates.size() - numberOfUpdates;
+
+    LayoutResult nestedResult = runLayout(updates, numberOfWarmUpUpdates, evictionBuffer, l1dMissesFd, llcMissesFd,
+                                          [&](const BestBidAndAskUpdate& update) { return runNestedUpdate(nestedGraph, update, checksum); });
+    std::vector<TriangularArbitrageCycle> cycles;
+    LayoutResult flatResult = runLayout(updates, numberOfWarmUpUpdates, evictionBuffer, l1dMissesFd, llcMissesFd,
+                                        [&](const BestBidAndAskUpdate& update) { return runFlatUpdate(graph, update, cycles, checksum); });
+
+    printResult(portfolioName, "nested", getWorkingSetInCacheLines(nestedGraph), nestedResult, countersAvailable);
+    printResult(portfolioName, "flat", getWorkingSetInCacheLines(graph, portfolio), flatResult, countersAvailable);
+}
+
+int main(int argc, char *argv[]) {
+    size_t numberOfUpdates = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_NUMBER_OF_UPDATES;
+    size_t evictionBufferSizeInKib = argc > 2 ? strtoul(argv[2], NULL, 10) : DEFAULT_EVICTION_BUFFER_SIZE_IN_KIB;
+    if (numberOfUpdates == 0) {
+        fprintf(stderr, "Usage: %s [number of updates] [eviction buffer size in KiB]\n", argv[0]);
+        return 1;
+    }
+
+    int l1dMissesFd = openCacheMissCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                                               (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    int llcMissesFd = openCacheMissCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    bool countersAvailable = l1dMissesFd >= 0 && llcMissesFd >= 0;
+    if (!countersAvailable)
+        fprintf(stderr, "Warning: hardware cache counters unavailable (%s), only latencies are reported\n", strerror(errno));
+
+    std::vector<char> evictionBuffer(evictionBufferSizeInKib * 1024);
+    printf("%zu best bid and ask updates per portfolio, caches evicted with %zu KiB between updates, latency in ns\n\n", numberOfUpdates,
+           evictionBufferSizeInKib);
+    printf("%-10s %-8s %12s %10s %10s %10s %14s %14s %14s\n", "portfolio", "layout", "cache lines", "p50", "p99", "mean", "L1D misses/upd",
+           "LLC misses/upd", "opportunities");
+    double checksum = 0;
+    runPortfolio("kraken-3", krakenPortfolio3, numberOfUpdates, evictionBuffer, l1dMissesFd, llcMissesFd, countersAvailable, checksum);
+    runPortfolio("kraken-50", krakenPortfolio50, numberOfUpdates, evictionBuffer, l1dMissesFd, llcMissesFd, countersAvailable, checksum);
+    runPortfolio("kraken-92", krakenPortfolio92, numberOfUpdates, evictionBuffer, l1dMissesFd, llcMissesFd, countersAvailable, checksum);
+    runPortfolio("kraken-122", krakenPortfolio122, numberOfUpdates, evictionBuffer, l1dMissesFd, llcMissesFd, countersAvailable, checksum);
+    // Keeps the reads of the legs from being optimised away
+    if (checksum == 42)
+        printf("\n");
+    return 0;
+}
@@ -0,0 +1,164 @@
+// NegativeCycleBenchmark.cpp
+//
+// Replays random best bid and ask updates through currency graphs of about 122, 300 and 1000 pairs and reports, per
+// update, the time to detect a profitable cycle of any length with the Bellman-Ford pass over the whole graph, with
+// the incremental detector that only searches from the edges of the updated pair, and with the full pass of the
+// detector split across the given worker cores. The 122 pair graph is the Kraken portfolio, the larger ones are
+// synthetic: every pair between a few hub currencies, and every other currency quoted in a few random hubs, as on the
+// exchanges.
+// Every pair follows its own random walk around a consistent set of currency values, so that short-lived arbitrages
+// appear as they do between books that are updated independently.
+//
+// Usage: ./bench_negative_cycle [number of updates] [worker cores c0,c1,...]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../StrategyComponent/CurrencyGraph.hpp"
+#include "../StrategyComponent/NegativeCycleDetector.hpp"
+#include "../Utils/Utils.hpp"
+#include "SyntheticCurrencyGraph.hpp"
+
+#define DEFAULT_NUMBER_OF_UPDATES 20000
+#define QUOTE_CURRENCIES_PER_CURRENCY 4
+
+using namespace std::chrono;
+
+struct DetectionResult {
+    std::vector<double> latencies;
+    size_t updatesWithArbitrage;
+};
+
+static void setBestBidAndAsk(CurrencyGraph& graph, int currencyPairIdx, double midPrice) {
+    double bestBuyPrice = midPrice * (1 - HALF_SPREAD);
+    double bestSellPriceReciprocal = 1.0 / (midPrice * (1 + HALF_SPREAD));
+    setExchangeRate(graph, graph.sellEdgeIdOfPair[currencyPairIdx], bestBuyPrice, 1.0);
+    setExchangeRate(graph, graph.buyEdgeIdOfPair[currencyPairIdx], bestSellPriceReciprocal, 1.0);
+}
+
+static void printResult(const char* graphName, size_t numberOfPairs, size_t numberOfCurrencies, const char* algorithm, DetectionResult& result) {
+    std::sort(result.latencies.begin(), result.latencies.end());
+    printf("%-10s %6zu %6zu %-22s %10.0f %10.0f %10.0f %10.0f %12zu\n", graphName, numberOfPairs, numberOfCurrencies, algorithm,
+           getPercentile(result.latencies, 50), getPercentile(result.latencies, 99), result.latencies.back(), getMean(result.latencies),
+           result.updatesWithArbitrage);
+}
+
+static void runGraph(const char* graphName, CurrencyGraph& graph, const std::vector<std::pair<int, int>>& pairs, size_t numberOfUpdates,
+                     const std::vector<int>& workerCores) {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> valueDistribution(-3, 3);
+    std::normal_distribution<double> moveDistribution(0, MID_PRICE_VOLATILITY);
+    std::uniform_int_distribution<size_t> pairDistribution(0, pairs.size() - 1);
+    std::vector<double> currencyValues(graph.V);
+    for (double& currencyValue : currencyValues)
+        currencyValue = exp(valueDistribution(rng));
+    std::vector<double> midPrices(pairs.size());
+    for (size_t i = 0; i < pairs.size(); i++) {
+        midPrices[i] = currencyValues[pairs[i].first] / currencyValues[pairs[i].second];
+        setBestBidAndAsk(graph, i, midPrices[i]);
+    }
+
+    // The full pass on the calling thread alone, and split with the workers when there are any
+    NegativeCycleDetector incrementalDetector;
+    createNegativeCycleDetector(incrementalDetector, graph, {});
+    std::vector<std::vector<int>> workerCoresOfFullPasses = {{}};
+    if (!workerCores.empty())
+        workerCoresOfFullPasses.push_back(workerCores);
+    std::vector<NegativeCycleDetector> fullPassDetectors(workerCoresOfFullPasses.size());
+    for (size_t i = 0; i < fullPassDetectors.size(); i++)
+        createNegativeCycleDetector(fullPassDetectors[i], graph, workerCoresOfFullPasses[i]);
+
+    DetectionResult bellmanFordResult = {std::vector<double>(), 0};
+    DetectionResult incrementalResult = {std::vector<double>(), 0};
+    std::vector<DetectionResult> fullPassResults(fullPassDetectors.size(), {std::vector<double>(), 0});
+    bellmanFordResult.latencies.reserve(numberOfUpdates);
+    incrementalResult.latencies.reserve(numberOfUpdates);
+    for (DetectionResult& fullPassResult : fullPassResults)
+        fullPassResult.latencies.reserve(numberOfUpdates);
+    NegativeCycle cycle;
+    cycle.edgeIds.reserve(graph.V);
+    size_t numberOfDisagreements = 0;
+    for (size_t update = 0; update < numberOfUpdates; update++) {
+        size_t pairIdx = pairDistribution(rng);
+        // Pulled back towards the consistent price so that the walks of the pairs do not drift apart for good
+        double consistentMidPrice = currencyValues[pairs[pairIdx].first] / currencyValues[pairs[pairIdx].second];
+        midPrices[pairIdx] *= exp(moveDistribution(rng) - 0.1 * log(midPrices[pairIdx] / consistentMidPrice));
+        setBestBidAndAsk(graph, pairIdx, midPrices[pairIdx]);
+        int updatedEdgeIds[2] = {graph.sellEdgeIdOfPair[pairIdx], graph.buyEdgeIdOfPair[pairIdx]};
+
+        steady_clock::time_point startTimestamp = steady_clock::now();
+        std::pair<std::vector<int>, system_clock::time_point> findTriangularArbitrageResult = findTriangularArbitrage(graph);
+        steady_clock::time_point completionTimestamp = steady_clock::now();
+        bellmanFordResult.latencies.push_back(duration<double, std::nano>(completionTimestamp - startTimestamp).count());
+        // The Bellman-Ford pass only reports 3-cycles, and zeroed currencies when it found none
+        if (findTriangularArbitrageResult.first.size() > NUMBER_OF_ORDERS_FOR_TRIANGULAR_ARBITRAGE)
+            bellmanFordResult.updatesWithArbitrage++;
+
+        startTimestamp = steady_clock::now();
+        bool isCycleFound = detectNegativeCycle(incrementalDetector, updatedEdgeIds, 2, cycle);
+        completionTimestamp = steady_clock::now();
+        incrementalResult.latencies.push_back(duration<double, std::nano>(completionTimestamp - startTimestamp).count());
+        if (isCycleFound)
+            incrementalResult.updatesWithArbitrage++;
+
+        for (size_t i = 0; i < fullPassDetectors.size(); i++) {
+            startTimestamp = steady_clock::now();
+            bool isFullPassCycleFound = detectNegativeCycleFromScratch(fullPassDetectors[i], cycle);
+            completionTimestamp = steady_clock::now();
+            fullPassResults[i].latencies.push_back(duration<double, std::nano>(completionTimestamp - startTimestamp).count());
+            if (isFullPassCycleFound)
+                fullPassResults[i].updatesWithArbitrage++;
+            if (isFullPassCycleFound != isCycleFound)
+                numberOfDisagreements++;
+        }
+    }
+
+    printResult(graphName, pairs.size(), graph.V, "bellman-ford-3-cycles", bellmanFordResult);
+    printResult(graphName, pairs.size(), graph.V, "incremental-spfa", incrementalResult);
+    for (size_t i = 0; i < fullPassDetectors.size(); i++)
+        printResult(graphName, pairs.size(), graph.V, ("full-pass-" + std::to_string(workerCoresOfFullPasses[i].size() + 1) + "-threads").c_str(), fullPassResults[i]);
+    printf("%-10s incremental detector: %zu incremental searches, %zu repeated cycles, %zu full passes after a cycle, %.1f relaxations per update\n",
+           graphName, incrementalDetector.stats.incrementalDetections, incrementalDetector.stats.repeatedCycles, incrementalDetector.stats.fullPasses,
+           (double)incrementalDetector.stats.relaxations / numberOfUpdates);
+    if (numberOfDisagreements > 0)
+        fprintf(stderr, "Warning: the incremental detector and a full pass disagreed on %zu updates\n", numberOfDisagreements);
+
+    stopNegativeCycleDetector(incrementalDetector);
+    for (NegativeCycleDetector& fullPassDetector : fullPassDetectors)
+        stopNegativeCycleDetector(fullPassDetector);
+}
+
+int main(int argc, char *argv[]) {
+    size_t numberOfUpdates = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_NUMBER_OF_UPDATES;
+    std::vector<int> workerCores;
+    if (numberOfUpdates == 0 || (argc > 2 && !parseCoreList(argv[2], workerCores))) {
+        fprintf(stderr, "Usage: %s [number of updates] [worker cores c0,c1,...]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%zu best bid and ask updates per graph, detection latency in ns\n\n", numberOfUpdates);
+    printf("%-10s %6s %6s %-22s %10s %10s %10s %10s %12s\n", "graph", "pairs", "ccys", "algorithm", "p50", "p99", "max", "mean", "updates hit");
+
+    CurrencyGraph krakenGraph;
+    createCurrencyGraph(krakenPortfolio122, krakenGraph);
+    std::vector<std::pair<int, int>> krakenPairs;
+    for (size_t pairIdx = 0; pairIdx < krakenPortfolio122.numberOfPairs; pairIdx++)
+        krakenPairs.emplace_back(krakenPortfolio122.baseCurrencyIndexOfPair[pairIdx], krakenPortfolio122.quoteCurrencyIndexOfPair[pairIdx]);
+    runGraph("kraken-122", krakenGraph, krakenPairs, numberOfUpdates, workerCores);
+
+    for (size_t numberOfPairs : {300, 1000}) {
+        std::mt19937 rng(numberOfPairs);
+        SyntheticPortfolio portfolio;
+        CurrencyGraph graph;
+        createSyntheticGraph(numberOfPairs, QUOTE_CURRENCIES_PER_CURRENCY, rng, portfolio, graph);
+        runGraph(("synth-" + std::to_string(numberOfPairs)).c_str(), graph, portfolio.pairs, numberOfUpdates, workerCores);
+    }
+    return 0;
+}
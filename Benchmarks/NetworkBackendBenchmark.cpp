@@ -0,0 +1,395 @@
+// NetworkBackendBenchmark.cpp
+//
+// Streams timestamped TLS records over a loopback connection and receives them the way the Book Builder Gateway does:
+// the TLS session is taken over with a memory BIO after the handshake, the ciphertext is read through the network
+// backend and decrypted with SSL_read. Every backend waits for readiness with epoll, as libev does in the gateway,
+// except busy_poll which spins on the socket. For each backend the benchmark reports the distribution of the latency
+// from SSL_write on the sending thread to the end of SSL_read on the receiving one, and the CPU time the receiving side
+// spent per message (the receiving thread and any SQPOLL kernel thread, the sending thread excluded). It then sends
+// batches of order-sized records the way the Order Manager does and reports the cost of each sendBatch() call.
+//
+// Usage: ./bench_network_backend [number of messages] [message interval in microseconds] [backend,backend,...]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <csignal>
+#include <cstring>
+#include <string>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "../NetworkIO/NetworkBackend.hpp"
+#include "../Utils/Utils.hpp"
+#include "SyntheticCurrencyGraph.hpp"
+
+#define DEFAULT_NUMBER_OF_MESSAGES 100000
+#define DEFAULT_MESSAGE_INTERVAL_IN_MICROSECONDS 20
+#define NUMBER_OF_WARMUP_MESSAGES 1000
+#define MARKET_DATA_MESSAGE_SIZE 256 // Around the size of a Kraken book update
+#define ORDER_MESSAGE_SIZE 384       // Around the size of a signed order request
+#define ORDER_BATCH_SIZE 3           // One order per leg of a triangle
+#define NUMBER_OF_ORDER_BATCHES 10000
+#define RECEIVE_BUFFER_SIZE 16384
+// Same placement as the first gateway shard, the sender takes the core after it
+#define CPU_CORE_INDEX_FOR_RECEIVER_THREAD 1
+#define CPU_CORE_INDEX_FOR_SENDER_THREAD 2
+#define CPU_CORE_INDEX_FOR_SQ_POLL_THREAD 0
+
+using namespace std::chrono;
+
+struct ReceiveResult {
+    std::vector<double> latencyNanoseconds;
+    double cpuNanosecondsPerMessage;
+};
+
+struct SendResult {
+    std::vector<double> batchNanoseconds;
+    double cpuNanosecondsPerBatch;
+};
+
+static long long getCpuTimeInNanoseconds(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Signs a throwaway P-256 certificate for the loopback server
+static bool useSelfSignedCertificate(SSL_CTX* ctx) {
+    EVP_PKEY* pkey = NULL;
+    EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+    if (!pctx || EVP_PKEY_keygen_init(pctx) <= 0 || EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx, NID_X9_62_prime256v1) <= 0 ||
+        EVP_PKEY_keygen(pctx, &pkey) <= 0) {
+        EVP_PKEY_CTX_free(pctx);
+        return false;
+    }
+    EVP_PKEY_CTX_free(pctx);
+
+    X509* cert = X509_new();
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 3600);
+    X509_set_pubkey(cert, pkey);
+    X509_NAME* name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*)"localhost", -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+
+    bool ok = X509_sign(cert, pkey, EVP_sha256()) > 0 && SSL_CTX_use_certificate(ctx, cert) == 1 && SSL_CTX_use_PrivateKey(ctx, pkey) == 1;
+    X509_free(cert);
+    EVP_PKEY_free(pkey);
+    return ok;
+}
+
+static int createListeningSocket(int& port) {
+    int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t addressLen = sizeof(address);
+    if (listenFd < 0 || bind(listenFd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(listenFd, 1) < 0 ||
+        getsockname(listenFd, (struct sockaddr*)&address, &addressLen) < 0) {
+        perror("Loopback listening socket setup failed");
+        if (listenFd >= 0)
+            close(listenFd);
+        return -1;
+    }
+    port = ntohs(address.sin_port);
+    return listenFd;
+}
+
+// Exchange side: streams the market data records at a fixed pace, then drains the order batches of the client until it
+// hangs up. The orders are not decrypted: writes of one io_uring batch to the same socket may land in any order.
+static void runServer(int listenFd, SSL_CTX* ctx, size_t numberOfMessages, int messageIntervalInMicroseconds, std::atomic<long long>* serverCpuNanoseconds, bool pinThreads) {
+    if (pinThreads)
+        setThreadAffinity(pthread_self(), CPU_CORE_INDEX_FOR_SENDER_THREAD);
+    int fd = accept(listenFd, NULL, NULL);
+    if (fd < 0) {
+        perror("accept failed");
+        return;
+    }
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    SSL* ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, fd);
+    if (SSL_accept(ssl) <= 0) {
+        ERR_print_errors_fp(stderr);
+        SSL_free(ssl);
+        close(fd);
+        return;
+    }
+
+    char message[MARKET_DATA_MESSAGE_SIZE];
+    memset(message, 'x', sizeof(message));
+    long long cpuStart = getCpuTimeInNanoseconds(CLOCK_THREAD_CPUTIME_ID);
+    steady_clock::time_point nextSendTimestamp = steady_clock::now();
+    for (size_t i = 0; i < numberOfMessages + NUMBER_OF_WARMUP_MESSAGES; i++) {
+        // Spinning rather than sleeping keeps the pace regular at microsecond intervals
+        while (steady_clock::now() < nextSendTimestamp);
+        nextSendTimestamp += microseconds(messageIntervalInMicroseconds);
+
+        long long sendTimestamp = duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+        memcpy(message, &sendTimestamp, sizeof(sendTimestamp));
+        if (SSL_write(ssl, message, sizeof(message)) <= 0) {
+            ERR_print_errors_fp(stderr);
+            break;
+        }
+    }
+    serverCpuNanoseconds->store(std::max(getCpuTimeInNanoseconds(CLOCK_THREAD_CPUTIME_ID) - cpuStart, 1LL));
+
+    char orders[RECEIVE_BUFFER_SIZE];
+    while (read(fd, orders, sizeof(orders)) > 0);
+
+    SSL_free(ssl);
+    close(fd);
+}
+
+// Client side of one backend run, the socket is registered in slot 0. Compiled for each backend, like the loops of the
+// gateway and the Order Manager.
+template <typename Backend>
+static bool runClient(int fd, SSL* ssl, BIO* rbio, BIO* wbio, Backend& networkBackend, size_t numberOfMessages, const std::atomic<long long>* serverCpuNanoseconds,
+                      ReceiveResult& receiveResult, SendResult& sendResult) {
+    int epollFd = epoll_create1(0);
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epollFd < 0 || epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        perror("epoll setup failed");
+        return false;
+    }
+
+    unsigned char undecryptedReadBuffer[RECEIVE_BUFFER_SIZE];
+    char decryptedReadBuffer[RECEIVE_BUFFER_SIZE];
+    struct iovec iov;
+    iov.iov_base = undecryptedReadBuffer;
+    iov.iov_len = sizeof(undecryptedReadBuffer);
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    receiveResult.latencyNanoseconds.reserve(numberOfMessages);
+    size_t numberOfMessagesReceived = 0;
+    long long cpuStart = 0;
+    while (numberOfMessagesReceived < numberOfMessages + NUMBER_OF_WARMUP_MESSAGES) {
+        if (!Backend::busyPolling && epoll_wait(epollFd, &event, 1, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait failed");
+            return false;
+        }
+
+        ssize_t undecryptedBytesRead = networkBackend.receiveMessage(0, &msg);
+        if (undecryptedBytesRead == -EAGAIN || undecryptedBytesRead == -EINTR)
+            continue;
+        if (undecryptedBytesRead <= 0) {
+            fprintf(stderr, "Receive error: %s\n", undecryptedBytesRead < 0 ? strerror(-undecryptedBytesRead) : "connection closed");
+            return false;
+        }
+        BIO_write(rbio, undecryptedReadBuffer, undecryptedBytesRead);
+
+        // A read can bring several records, each one is a message
+        int decryptedBytesRead;
+        while ((decryptedBytesRead = SSL_read(ssl, decryptedReadBuffer, sizeof(decryptedReadBuffer))) > 0) {
+            long long receiveTimestamp = duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+            long long sendTimestamp;
+            memcpy(&sendTimestamp, decryptedReadBuffer, sizeof(sendTimestamp));
+            if (++numberOfMessagesReceived == NUMBER_OF_WARMUP_MESSAGES)
+                cpuStart = getCpuTimeInNanoseconds(CLOCK_PROCESS_CPUTIME_ID);
+            else if (numberOfMessagesReceived > NUMBER_OF_WARMUP_MESSAGES)
+                receiveResult.latencyNanoseconds.push_back(receiveTimestamp - sendTimestamp);
+        }
+        if (SSL_get_error(ssl, decryptedBytesRead) != SSL_ERROR_WANT_READ) {
+            ERR_print_errors_fp(stderr);
+            return false;
+        }
+    }
+    long long processCpuNanoseconds = getCpuTimeInNanoseconds(CLOCK_PROCESS_CPUTIME_ID) - cpuStart;
+    close(epollFd);
+
+    // The sender's CPU time covers its warmup messages too, so only its share of the measured messages is removed
+    while (serverCpuNanoseconds->load() == 0)
+        std::this_thread::yield();
+    double serverCpuNanosecondsPerMessage = (double)serverCpuNanoseconds->load() / (numberOfMessages + NUMBER_OF_WARMUP_MESSAGES);
+    receiveResult.cpuNanosecondsPerMessage = (double)processCpuNanoseconds / numberOfMessages - serverCpuNanosecondsPerMessage;
+
+    // Send path: the records are encrypted up front, only the writes are timed, as in the Order Manager
+    char order[ORDER_MESSAGE_SIZE];
+    memset(order, 'o', sizeof(order));
+    std::vector<std::vector<char>> encryptedOrders(ORDER_BATCH_SIZE);
+    int slots[ORDER_BATCH_SIZE];
+    struct iovec buffers[ORDER_BATCH_SIZE];
+    int results[ORDER_BATCH_SIZE];
+    sendResult.batchNanoseconds.reserve(NUMBER_OF_ORDER_BATCHES);
+    long long sendCpuNanoseconds = 0;
+    for (int batch = 0; batch < NUMBER_OF_ORDER_BATCHES; batch++) {
+        for (int i = 0; i < ORDER_BATCH_SIZE; i++) {
+            SSL_write(ssl, order, sizeof(order));
+            encryptedOrders[i].resize(BIO_ctrl_pending(wbio));
+            BIO_read(wbio, encryptedOrders[i].data(), encryptedOrders[i].size());
+            // Every order goes to its own connection in the Order Manager, here they all share slot 0
+            slots[i] = 0;
+            buffers[i].iov_base = encryptedOrders[i].data();
+            buffers[i].iov_len = encryptedOrders[i].size();
+        }
+
+        long long cpuBatchStart = getCpuTimeInNanoseconds(CLOCK_PROCESS_CPUTIME_ID);
+        steady_clock::time_point sendStart = steady_clock::now();
+        int ret = networkBackend.sendBatch(slots, buffers, results, ORDER_BATCH_SIZE);
+        steady_clock::time_point sendEnd = steady_clock::now();
+        sendCpuNanoseconds += getCpuTimeInNanoseconds(CLOCK_PROCESS_CPUTIME_ID) - cpuBatchStart;
+        if (ret < 0) {
+            fprintf(stderr, "sendBatch failed: %s\n", strerror(-ret));
+            return false;
+        }
+        for (int i = 0; i < ORDER_BATCH_SIZE; i++) {
+            if (results[i] != (int)buffers[i].iov_len) {
+                fprintf(stderr, "Short or failed order write: %d\n", results[i]);
+                return false;
+            }
+        }
+        sendResult.batchNanoseconds.push_back(duration_cast<nanoseconds>(sendEnd - sendStart).count());
+    }
+    // The exchange side keeps draining while the batches are sent, so its CPU time is part of this figure
+    sendResult.cpuNanosecondsPerBatch = (double)sendCpuNanoseconds / NUMBER_OF_ORDER_BATCHES;
+    return true;
+}
+
+static bool runBackend(NetworkBackendType networkBackendType, size_t numberOfMessages, int messageIntervalInMicroseconds, bool pinThreads, ReceiveResult& receiveResult, SendResult& sendResult) {
+    NetworkBackendOptions networkBackendOptions;
+    networkBackendOptions.type = networkBackendType;
+    if (pinThreads)
+        networkBackendOptions.sqPollCpuCore = CPU_CORE_INDEX_FOR_SQ_POLL_THREAD;
+    NetworkBackend* networkBackend = createNetworkBackend(networkBackendOptions);
+    if (!networkBackend) {
+        fprintf(stderr, "%s backend unavailable: %s\n", getNetworkBackendTypeName(networkBackendType), strerror(errno));
+        return false;
+    }
+
+    SSL_CTX* serverCtx = SSL_CTX_new(TLS_server_method());
+    SSL_CTX* clientCtx = SSL_CTX_new(TLS_client_method());
+    if (!serverCtx || !clientCtx || !useSelfSignedCertificate(serverCtx)) {
+        ERR_print_errors_fp(stderr);
+        delete networkBackend;
+        return false;
+    }
+    SSL_CTX_set_verify(clientCtx, SSL_VERIFY_NONE, NULL);
+
+    int port;
+    int listenFd = createListeningSocket(port);
+    if (listenFd < 0) {
+        delete networkBackend;
+        return false;
+    }
+
+    std::atomic<long long> serverCpuNanoseconds{0};
+    std::thread serverThread(runServer, listenFd, serverCtx, numberOfMessages, messageIntervalInMicroseconds, &serverCpuNanoseconds, pinThreads);
+
+    bool ok = false;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    int noDelay = 1;
+    SSL* ssl = SSL_new(clientCtx);
+    if (fd >= 0 && connect(fd, (struct sockaddr*)&address, sizeof(address)) == 0 && setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay)) == 0 &&
+        SSL_set_fd(ssl, fd) == 1 && SSL_connect(ssl) == 1) {
+        // Same takeover as the gateway: the socket is only read through the backend from now on
+        BIO* rbio = BIO_new(BIO_s_mem());
+        BIO* wbio = BIO_new(BIO_s_mem());
+        SSL_set_bio(ssl, rbio, wbio);
+        if (networkBackend->registerSockets(&fd, 1) < 0)
+            perror("Socket registration failed");
+        else
+            dispatchNetworkBackend(*networkBackend, [&](auto& backend) {
+                ok = runClient(fd, ssl, rbio, wbio, backend, numberOfMessages, &serverCpuNanoseconds, receiveResult, sendResult);
+            });
+    } else {
+        perror("Loopback TLS connection failed");
+        ERR_print_errors_fp(stderr);
+    }
+
+    // Hanging up ends the drain of the server, or unblocks it if the client gave up early
+    SSL_free(ssl);
+    if (fd >= 0) {
+        shutdown(fd, SHUT_RDWR);
+        close(fd);
+    }
+    serverThread.join();
+    close(listenFd);
+    SSL_CTX_free(serverCtx);
+    SSL_CTX_free(clientCtx);
+    delete networkBackend;
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    size_t numberOfMessages = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_NUMBER_OF_MESSAGES;
+    int messageIntervalInMicroseconds = argc > 2 ? atoi(argv[2]) : DEFAULT_MESSAGE_INTERVAL_IN_MICROSECONDS;
+    std::vector<NetworkBackendType> networkBackendTypes = {NetworkBackendType::IoUringSqPoll, NetworkBackendType::IoUring, NetworkBackendType::Epoll, NetworkBackendType::BusyPoll};
+    if (argc > 3) {
+        networkBackendTypes.clear();
+        std::stringstream ss(argv[3]);
+        std::string name;
+        NetworkBackendType networkBackendType;
+        while (std::getline(ss, name, ',')) {
+            if (!parseNetworkBackendType(name.c_str(), networkBackendType)) {
+                networkBackendTypes.clear();
+                break;
+            }
+            networkBackendTypes.push_back(networkBackendType);
+        }
+    }
+    if (numberOfMessages == 0 || messageIntervalInMicroseconds < 0 || networkBackendTypes.empty() || argc > 4) {
+        fprintf(stderr, "Usage: %s [number of messages] [message interval in microseconds] [backend,backend,...]\n", argv[0]);
+        fprintf(stderr, "       with backend one of io_uring_sqpoll, io_uring, epoll, busy_poll\n");
+        return 1;
+    }
+
+    // A client giving up early must not kill the benchmark through the writes of the server
+    signal(SIGPIPE, SIG_IGN);
+
+    // The sender and the receiver both spin, sharing a core would measure the scheduler rather than the backends
+    bool pinThreads = std::thread::hardware_concurrency() > CPU_CORE_INDEX_FOR_SENDER_THREAD;
+    if (pinThreads)
+        setThreadAffinity(pthread_self(), CPU_CORE_INDEX_FOR_RECEIVER_THREAD);
+    else
+        fprintf(stderr, "Warning: fewer than %d cores, the sender and the receiver are not pinned\n", CPU_CORE_INDEX_FOR_SENDER_THREAD + 1);
+
+    printf("%zu TLS records of %d bytes over loopback, one every %d us\n\n", numberOfMessages, MARKET_DATA_MESSAGE_SIZE, messageIntervalInMicroseconds);
+    printf("%-16s %10s %10s %10s %10s %10s %12s %14s %14s\n", "backend", "p50 ns", "p90 ns", "p99 ns", "p99.9 ns", "max ns", "cpu ns/msg",
+           "send p50 ns", "send cpu ns");
+    for (NetworkBackendType networkBackendType : networkBackendTypes) {
+        ReceiveResult receiveResult;
+        SendResult sendResult;
+        if (!runBackend(networkBackendType, numberOfMessages, messageIntervalInMicroseconds, pinThreads, receiveResult, sendResult)) {
+            printf("%-16s %10s\n", getNetworkBackendTypeName(networkBackendType), "failed");
+            continue;
+        }
+
+        std::vector<double>& latencies = receiveResult.latencyNanoseconds;
+        std::sort(latencies.begin(), latencies.end());
+        std::sort(sendResult.batchNanoseconds.begin(), sendResult.batchNanoseconds.end());
+        printf("%-16s %10.0f %10.0f %10.0f %10.0f %10.0f %12.0f %14.0f %14.0f\n", getNetworkBackendTypeName(networkBackendType),
+               getPercentile(latencies, 50), getPercentile(latencies, 90), getPercentile(latencies, 99), getPercentile(latencies, 99.9), latencies.back(),
+               receiveResult.cpuNanosecondsPerMessage, getPercentile(sendResult.batchNanoseconds, 50), sendResult.cpuNanosecondsPerBatch);
+    }
+
+    return 0;
+}
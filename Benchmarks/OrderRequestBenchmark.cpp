@@ -0,0 +1,274 @@
+// OrderRequestBenchmark.cpp
+//
+// Builds the signed HTTP request of an order for every edge of the traded portfolio and reports the build time per
+// leg of the three ways the Order Manager has prepared them: formatted and signed on the spot with sprintf and one-shot
+// HMACs over the whole message, as it did before the request templates, copied from the template of
+// the edge and patched with the expiry or nonce, the volume and the signature, and completed from a request staged
+// ahead of time, where only the volume and the end of the signature are left. Before timing anything, the request of
+// every edge built from its template and from a staged request is checked against the formatted one with the same
+// expiry or nonce. Each traded exchange is run on its own, over the edges of its pairs. Nothing goes to the network, and
+// the exit status is not 0 when the requests differ.
+//
+// Usage: ./bench_order_request [number of orders]
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <string>
+#include <vector>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include "../Exchanges/ExchangePolicies.hpp"
+#include "../OrderManager/OrderPrestaging.hpp"
+#include "../OrderManager/OrderRequestTemplates.hpp"
+#include "../OrderManager/OrderTemplates.hpp"
+#include "SyntheticCurrencyGraph.hpp"
+
+#define DEFAULT_NUMBER_OF_ORDERS 100000
+#define NUMBER_OF_WARMUP_ORDERS 1000
+#define MAX_VOLUME_IN_LOTS 100000000
+
+using namespace std::chrono;
+
+enum class BuildPath {
+    Formatted,
+    Template,
+    Prestaged
+};
+
+static const char* buildPathNames[] = {"formatted", "template", "prestaged"};
+
+static std::array<OrderTemplate, tradedPortfolio.numberOfEdges> orderTemplates;
+static std::array<OrderRequestTemplate, tradedPortfolio.numberOfEdges> orderRequestTemplates;
+// The edges of the pairs of the exchange being run
+static std::vector<int> exchangeEdgeIds;
+static PrestagedOrderRequest prestagedOrderRequest;
+static OrderPrestagingStats orderPrestagingStats;
+
+static std::string getMicrosecondsSinceEpoch() {
+    return std::to_string(duration_cast<microseconds>(high_resolution_clock::now().time_since_epoch()).count());
+}
+
+// The HMAC of the whole message in one call, as the formatted requests were signed
+static std::string getHmac(const EVP_MD* digest, const unsigned char* key, size_t keyLength, const std::string& message) {
+    unsigned char hmac[EVP_MAX_MD_SIZE];
+    unsigned int hmacLength = 0;
+    HMAC(digest, key, keyLength, (const unsigned char*)message.data(), message.size(), hmac, &hmacLength);
+    return std::string((const char*)hmac, hmacLength);
+}
+
+template <typename ExchangePolicy>
+static std::string getBitmexSignature(const std::string& message) {
+    std::string hmac = getHmac(EVP_sha256(), (const unsigned char*)ExchangePolicy::apiSecret, strlen(ExchangePolicy::apiSecret), message);
+    std::string signature;
+    char hexDigits[3];
+    for (unsigned char byte : hmac) {
+        snprintf(hexDigits, sizeof(hexDigits), "%02x", byte);
+        signature += hexDigits;
+    }
+    return signature;
+}
+
+// HMAC-SHA512 with the base64-decoded secret of the URI and the SHA-256 of the nonce and post data, in base64
+template <typename ExchangePolicy>
+static std::string getKrakenSignature(const std::string& nonce, const std::string& postData) {
+    unsigned char postDataHash[EVP_MAX_MD_SIZE];
+    unsigned int postDataHashLength = 0;
+    std::string noncePostData = nonce + postData;
+    EVP_Digest(noncePostData.data(), noncePostData.size(), postDataHash, &postDataHashLength, EVP_sha256(), NULL);
+
+    size_t secretLength = strlen(ExchangePolicy::apiSecret);
+    std::vector<unsigned char> decodedSecret(secretLength);
+    int decodedSecretLength = EVP_DecodeBlock(decodedSecret.data(), (const unsigned char*)ExchangePolicy::apiSecret, secretLength);
+    for (size_t i = secretLength; i > 0 && ExchangePolicy::apiSecret[i - 1] == '='; i--)
+        decodedSecretLength--;
+
+    std::string hmac = getHmac(EVP_sha512(), decodedSecret.data(), decodedSecretLength,
+                               ExchangePolicy::addOrderUri + std::string((const char*)postDataHash, postDataHashLength));
+    std::vector<unsigned char> signature(4 * ((hmac.size() + 2) / 3) + 1);
+    int signatureLength = EVP_EncodeBlock(signature.data(), (const unsigned char*)hmac.data(), hmac.size());
+    return std::string((const char*)signature.data(), signatureLength);
+}
+
+// The request the Order Manager formatted for each order before the templates. The expiry or nonce is taken on the
+// spot unless one is given, which is how the other requests are checked against it.
+template <typename ExchangePolicy>
+static int buildFormattedOrderRequest(char* request, const OrderTemplate& orderTemplate, int64_t volumeInLots, int lotDecimals, const char* timestamp) {
+    char orderData[MAX_ORDER_BODY_LENGTH];
+    memcpy(orderData, orderTemplate.body, orderTemplate.length + 1);
+    writeOrderVolume(orderData + orderTemplate.volumeOffset, volumeInLots, lotDecimals);
+
+    if constexpr (ExchangePolicy::api == ExchangeApi::Bitmex) {
+        char expires[32];
+        char unencryptedSignature[256];
+        if (timestamp) {
+            snprintf(expires, sizeof(expires), "%s", timestamp);
+        } else {
+            time_t tenSecondsLater = time(NULL) + BITMEX_REQUEST_EXPIRY_IN_SECONDS;
+            strftime(expires, sizeof(expires), "%s", localtime(&tenSecondsLater));
+        }
+        snprintf(unencryptedSignature, sizeof(unencryptedSignature), "%s%s%s%s", ExchangePolicy::addOrderUri, "POST", expires, orderData);
+        std::string signature = getBitmexSignature<ExchangePolicy>(unencryptedSignature);
+        int length = snprintf(request, MAX_ORDER_REQUEST_LENGTH,
+                              "POST %s HTTP/1.1\r\n"
+                              "Host: %s\r\n"
+                              "api-key: %s\r\n"
+                              "api-expires: %s\r\n"
+                              "api-signature: %s\r\n"
+                              "Content-Type: application/x-www-form-urlencoded\r\n"
+                              "Content-Length: %zu\r\n"
+                              "Connection: keep-alive\r\n"
+                              "\r\n"
+                              "%s", ExchangePolicy::addOrderUri, ExchangePolicy::restApiHostName, ExchangePolicy::apiKey, expires, signature.c_str(),
+                              strlen(orderData), orderData);
+        return length;
+    } else {
+        std::string nonce = timestamp ? std::string(timestamp) : getMicrosecondsSinceEpoch();
+        std::string postData = "nonce=" + nonce + "&" + orderData;
+        std::string apiSignature = getKrakenSignature<ExchangePolicy>(nonce, postData);
+        std::string unencryptedRequest = "POST " + std::string(ExchangePolicy::addOrderUri) + " HTTP/1.1\r\n"
+                                         "Host: " + std::string(ExchangePolicy::restApiHostName) + "\r\n"
+                                         "API-Key: " + std::string(ExchangePolicy::apiKey) + "\r\n"
+                                         "API-Sign: " + apiSignature + "\r\n"
+                                         "Content-Type: application/x-www-form-urlencoded; charset=utf-8\r\n"
+                                         "Content-Length: " + std::to_string(postData.size()) + "\r\n"
+                                         "Connection: keep-alive\r\n"
+                                         "\r\n" + postData;
+        memcpy(request, unencryptedRequest.c_str(), unencryptedRequest.size());
+        return unencryptedRequest.size();
+    }
+}
+
+template <typename ExchangePolicy>
+static int buildRequest(BuildPath path, char* request, int edgeId, int64_t volumeInLots, int lotDecimals) {
+    switch (path) {
+        case BuildPath::Formatted:
+            return buildFormattedOrderRequest<ExchangePolicy>(request, orderTemplates[edgeId], volumeInLots, lotDecimals, NULL);
+        case BuildPath::Template:
+            return buildOrderRequest<ExchangePolicy>(request, orderRequestTemplates[edgeId], volumeInLots, lotDecimals);
+        case BuildPath::Prestaged: {
+            // Always staged ahead of the timed section
+            int length = completePrestagedOrderRequest<ExchangePolicy>(prestagedOrderRequest, orderRequestTemplates[edgeId], volumeInLots, lotDecimals);
+            memcpy(request, prestagedOrderRequest.request, length);
+            return length;
+        }
+    }
+    return 0;
+}
+
+// Compares a request with the formatted one of the same order, expiry or nonce
+template <typename ExchangePolicy>
+static bool isSameAsFormattedRequest(const char* request, int length, int edgeId, int64_t volumeInLots, int lotDecimals) {
+    const OrderRequestTemplate& orderRequestTemplate = orderRequestTemplates[edgeId];
+    int timestampLength = ExchangePolicy::api == ExchangeApi::Bitmex ? BITMEX_EXPIRES_LENGTH : KRAKEN_NONCE_LENGTH;
+    std::string timestamp(request + orderRequestTemplate.timestampOffset, timestampLength);
+    char formattedRequest[MAX_ORDER_REQUEST_LENGTH];
+    int formattedLength = buildFormattedOrderRequest<ExchangePolicy>(formattedRequest, orderTemplates[edgeId], volumeInLots, lotDecimals, timestamp.c_str());
+    return formattedLength == length && memcmp(formattedRequest, request, length) == 0;
+}
+
+template <typename ExchangePolicy>
+static bool checkRequests(std::mt19937& rng) {
+    std::uniform_int_distribution<int64_t> volumeDistribution(1, MAX_VOLUME_IN_LOTS);
+    char request[MAX_ORDER_REQUEST_LENGTH];
+    for (int edgeId : exchangeEdgeIds) {
+        int64_t volumeInLots = volumeDistribution(rng);
+        int length = buildRequest<ExchangePolicy>(BuildPath::Template, request, edgeId, volumeInLots, DEFAULT_LOT_DECIMALS);
+        if (!isSameAsFormattedRequest<ExchangePolicy>(request, length, edgeId, volumeInLots, DEFAULT_LOT_DECIMALS)) {
+            fprintf(stderr, "Error: the %s request of edge %d built from its template differs from the formatted one:\n%.*s\n", ExchangePolicy::name, edgeId, length, request);
+            return false;
+        }
+        stageOrderRequest<ExchangePolicy>(prestagedOrderRequest, orderRequestTemplates[edgeId], orderPrestagingStats);
+        length = buildRequest<ExchangePolicy>(BuildPath::Prestaged, request, edgeId, volumeInLots, DEFAULT_LOT_DECIMALS);
+        if (!isSameAsFormattedRequest<ExchangePolicy>(request, length, edgeId, volumeInLots, DEFAULT_LOT_DECIMALS)) {
+            fprintf(stderr, "Error: the staged %s request of edge %d differs from the formatted one:\n%.*s\n", ExchangePolicy::name, edgeId, length, request);
+            return false;
+        }
+    }
+    return true;
+}
+
+// One order per edge in turn, as the legs of the cycles are spread over the edges
+template <typename ExchangePolicy>
+static std::vector<double> runPath(BuildPath path, size_t numberOfOrders, std::mt19937& rng) {
+    std::uniform_int_distribution<int64_t> volumeDistribution(1, MAX_VOLUME_IN_LOTS);
+    std::vector<double> buildNanoseconds;
+    buildNanoseconds.reserve(numberOfOrders);
+    char request[MAX_ORDER_REQUEST_LENGTH];
+    size_t totalLength = 0;
+
+    for (size_t i = 0; i < NUMBER_OF_WARMUP_ORDERS + numberOfOrders; i++) {
+        int edgeId = exchangeEdgeIds[i % exchangeEdgeIds.size()];
+        int64_t volumeInLots = volumeDistribution(rng);
+        if (path == BuildPath::Prestaged)
+            stageOrderRequest<ExchangePolicy>(prestagedOrderRequest, orderRequestTemplates[edgeId], orderPrestagingStats);
+
+        steady_clock::time_point startTimestamp = steady_clock::now();
+        int length = buildRequest<ExchangePolicy>(path, request, edgeId, volumeInLots, DEFAULT_LOT_DECIMALS);
+        steady_clock::time_point endTimestamp = steady_clock::now();
+
+        // Keeps the request alive
+        totalLength += length + request[length - 1];
+        if (i >= NUMBER_OF_WARMUP_ORDERS)
+            buildNanoseconds.push_back(duration_cast<nanoseconds>(endTimestamp - startTimestamp).count());
+    }
+    if (totalLength == 0)
+        printf("No request was built\n");
+    return buildNanoseconds;
+}
+
+// Builds the requests of the edges of one traded exchange and times the three paths over them
+template <typename ExchangePolicy>
+static bool runExchange(size_t numberOfOrders, std::mt19937& rng) {
+    constexpr int exchangeIdx = getTradedExchangeIdx<ExchangePolicy>();
+    exchangeEdgeIds.clear();
+    for (size_t edgeId = 0; edgeId < tradedPortfolio.numberOfEdges; edgeId++) {
+        size_t currencyPairIdx = tradedPortfolio.currencyPairIdxOfEdge[edgeId];
+        if (tradedPortfolio.exchangeIdxOfPair[currencyPairIdx] != exchangeIdx)
+            continue;
+        if (!createOrderTemplate<ExchangePolicy>(orderTemplates[edgeId], tradedPortfolio.currencyPairSymbols[currencyPairIdx].data(), tradedPortfolio.orderSideOfEdge[edgeId]) ||
+            !createOrderRequestTemplate<ExchangePolicy>(orderRequestTemplates[edgeId], orderTemplates[edgeId]))
+            return false;
+        exchangeEdgeIds.push_back(edgeId);
+    }
+    if (!initializeOrderRequestSigning<ExchangePolicy>())
+        return false;
+
+    if (!checkRequests<ExchangePolicy>(rng))
+        return false;
+
+    printf("%zu orders over the %zu %s edges of the traded portfolio, build time per leg in ns\n\n", numberOfOrders, exchangeEdgeIds.size(), ExchangePolicy::name);
+    printf("%-10s %10s %10s %10s %10s %10s %10s\n", "path", "p50", "p99", "p99.9", "max", "mean", "speedup");
+    double formattedMean = 0.0;
+    for (BuildPath path : {BuildPath::Formatted, BuildPath::Template, BuildPath::Prestaged}) {
+        std::vector<double> buildNanoseconds = runPath<ExchangePolicy>(path, numberOfOrders, rng);
+        double mean = getMean(buildNanoseconds);
+        if (path == BuildPath::Formatted)
+            formattedMean = mean;
+        std::sort(buildNanoseconds.begin(), buildNanoseconds.end());
+        printf("%-10s %10.0f %10.0f %10.0f %10.0f %10.0f %9.1fx\n", buildPathNames[(int)path], getPercentile(buildNanoseconds, 50),
+               getPercentile(buildNanoseconds, 99), getPercentile(buildNanoseconds, 99.9), buildNanoseconds.back(), mean, formattedMean / mean);
+    }
+    printf("\n");
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    size_t numberOfOrders = DEFAULT_NUMBER_OF_ORDERS;
+    if (argc > 2 || (argc == 2 && (numberOfOrders = strtoull(argv[1], NULL, 10)) == 0)) {
+        fprintf(stderr, "Usage: %s [number of orders]\n", argv[0]);
+        return 1;
+    }
+
+    std::mt19937 rng(42);
+    bool areAllExchangesRun = true;
+    forEachTradedExchange([&](auto exchangePolicy) {
+        areAllExchangesRun = areAllExchangesRun && runExchange<decltype(exchangePolicy)>(numberOfOrders, rng);
+    });
+    return areAllExchangesRun ? 0 : 1;
+}
@@ -0,0 +1,234 @@
+// PermessageDeflateBenchmark.cpp
+//
+// Replays synthetic Kraken v2 book updates through the receive path of the Book Builder Gateway with and without
+// permessage-deflate and reports, per message, the bytes on the wire and the cost of the TLS record decryption, the
+// websocket decoding/inflation and the JSON parsing. The exchange side compresses with context takeover and
+// Z_SYNC_FLUSH exactly as a permessage-deflate server does, and every message travels in its own AES-128-GCM record.
+//
+// Usage: ./bench_permessage_deflate [number of messages] [max number of levels per update]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <openssl/evp.h>
+#include <rapidjson/document.h>
+#include <zlib.h>
+#include "../BookBuilder/WebSocketInflater.hpp"
+
+#define DEFAULT_NUMBER_OF_MESSAGES 100000
+#define DEFAULT_MAX_NUMBER_OF_LEVELS_PER_UPDATE 3
+#define TLS_RECORD_OVERHEAD 22 // TLS 1.3 record header, inner content type and AEAD tag
+#define AES_GCM_IV_SIZE 12
+#define AES_GCM_TAG_SIZE 16
+
+using namespace std::chrono;
+
+struct EncryptedRecord {
+    std::vector<unsigned char> ciphertext;
+    unsigned char iv[AES_GCM_IV_SIZE];
+    unsigned char tag[AES_GCM_TAG_SIZE];
+};
+
+struct ScenarioResult {
+    double wireBytes;
+    double decryptionNanoseconds;
+    double inflationNanoseconds;
+    double parsingNanoseconds;
+    size_t parsedMessages;
+};
+
+static const unsigned char tlsKey[16] = {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c};
+
+static std::vector<std::string> generateKrakenBookUpdates(size_t numberOfMessages, int maxNumberOfLevels) {
+    const std::vector<std::string> symbols = {"BTC/USD", "ETH/USD", "ETH/BTC", "SOL/USD", "SOL/USDT", "USDT/USD", "LTC/EUR", "XRP/GBP"};
+    std::vector<double> midPrices = {64321.5, 3120.25, 0.04851, 142.37, 142.41, 1.0001, 78.12, 0.4123};
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> levelsDistribution(1, maxNumberOfLevels);
+    std::uniform_real_distribution<double> moveDistribution(-0.0005, 0.0005);
+    std::uniform_real_distribution<double> qtyDistribution(0.0, 25.0);
+
+    std::vector<std::string> messages;
+    messages.reserve(numberOfMessages);
+    char level[96];
+    char timestamp[64];
+    for (size_t i = 0; i < numberOfMessages; i++) {
+        size_t symbolIdx = rng() % symbols.size();
+        midPrices[symbolIdx] *= 1 + moveDistribution(rng);
+
+        std::string bids, asks;
+        int numberOfLevels = levelsDistribution(rng);
+        for (int l = 0; l < numberOfLevels; l++) {
+            bool isBid = rng() & 1;
+            double price = midPrices[symbolIdx] * (isBid ? 1 - 0.0001 * l : 1 + 0.0001 * l);
+            double qty = (rng() % 4 == 0) ? 0.0 : qtyDistribution(rng);
+            snprintf(level, sizeof(level), "{\"price\":%.5f,\"qty\":%.8f}", price, qty);
+            std::string& side = isBid ? bids : asks;
+            if (!side.empty())
+                side += ",";
+            side += level;
+        }
+
+        snprintf(timestamp, sizeof(timestamp), "2024-05-01T12:%02zu:%02zu.%06zuZ", (i / 60000) % 60, (i / 1000) % 60, (i * 137) % 1000000);
+        messages.push_back("{\"channel\":\"book\",\"type\":\"update\",\"data\":[{\"symbol\":\"" + symbols[symbolIdx] + "\",\"bids\":[" + bids +
+                           "],\"asks\":[" + asks + "],\"checksum\":" + std::to_string(rng()) + ",\"timestamp\":\"" + timestamp + "\"}]}");
+    }
+    return messages;
+}
+
+static void appendWebSocketFrame(std::string& frame, const char* payload, size_t payloadLength, bool compressed) {
+    frame.push_back((char)(0x81 | (compressed ? 0x40 : 0x00)));
+    if (payloadLength < 126) {
+        frame.push_back((char)payloadLength);
+    } else if (payloadLength < 65536) {
+        frame.push_back((char)126);
+        frame.push_back((char)(payloadLength >> 8));
+        frame.push_back((char)(payloadLength & 0xFF));
+    } else {
+        frame.push_back((char)127);
+        for (int i = 7; i >= 0; i--)
+            frame.push_back((char)((payloadLength >> (8 * i)) & 0xFF));
+    }
+    frame.append(payload, payloadLength);
+}
+
+// Frames every message the way the exchange would send it, compressing with a single deflate stream when asked to
+static std::vector<std::string> frameMessages(const std::vector<std::string>& messages, bool compressed) {
+    std::vector<std::string> frames;
+    frames.reserve(messages.size());
+
+    z_stream deflateStream;
+    memset(&deflateStream, 0, sizeof(deflateStream));
+    deflateInit2(&deflateStream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    std::vector<unsigned char> compressedBuffer;
+
+    for (const std::string& message : messages) {
+        std::string frame;
+        if (compressed) {
+            compressedBuffer.resize(deflateBound(&deflateStream, message.size()) + 16);
+            deflateStream.next_in = (Bytef*)message.data();
+            deflateStream.avail_in = message.size();
+            deflateStream.next_out = compressedBuffer.data();
+            deflateStream.avail_out = compressedBuffer.size();
+            deflate(&deflateStream, Z_SYNC_FLUSH);
+            // The trailing 00 00 ff ff of the sync flush is not sent
+            size_t compressedLength = compressedBuffer.size() - deflateStream.avail_out - 4;
+            appendWebSocketFrame(frame, (const char*)compressedBuffer.data(), compressedLength, true);
+        } else {
+            appendWebSocketFrame(frame, message.data(), message.size(), false);
+        }
+        frames.push_back(frame);
+    }
+
+    deflateEnd(&deflateStream);
+    return frames;
+}
+
+static std::vector<EncryptedRecord> encryptFrames(const std::vector<std::string>& frames) {
+    std::vector<EncryptedRecord> records(frames.size());
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    for (size_t i = 0; i < frames.size(); i++) {
+        EncryptedRecord& record = records[i];
+        memset(record.iv, 0, sizeof(record.iv));
+        memcpy(record.iv, &i, sizeof(i));
+        record.ciphertext.resize(frames[i].size());
+        int len;
+        EVP_EncryptInit_ex(ctx, EVP_aes_128_gcm(), NULL, tlsKey, record.iv);
+        EVP_EncryptUpdate(ctx, record.ciphertext.data(), &len, (const unsigned char*)frames[i].data(), frames[i].size());
+        EVP_EncryptFinal_ex(ctx, record.ciphertext.data() + len, &len);
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, AES_GCM_TAG_SIZE, record.tag);
+    }
+    EVP_CIPHER_CTX_free(ctx);
+    return records;
+}
+
+static ScenarioResult runScenario(const std::vector<EncryptedRecord>& records, bool compressed) {
+    ScenarioResult result = {};
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    EVP_DecryptInit_ex(ctx, EVP_aes_128_gcm(), NULL, NULL, NULL);
+    WebSocketInflater inflater;
+    inflater.reset(false);
+    std::vector<unsigned char> decrypted(1 << 20);
+    std::vector<char> payload(1 << 20);
+    nanoseconds decryptionTime(0), inflationTime(0), parsingTime(0);
+
+    for (const EncryptedRecord& record : records) {
+        result.wireBytes += record.ciphertext.size() + TLS_RECORD_OVERHEAD;
+
+        auto decryptionStartTimestamp = high_resolution_clock::now();
+        int len, finalLen;
+        EVP_DecryptInit_ex(ctx, NULL, NULL, tlsKey, record.iv);
+        EVP_DecryptUpdate(ctx, decrypted.data(), &len, record.ciphertext.data(), record.ciphertext.size());
+        EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, AES_GCM_TAG_SIZE, (void*)record.tag);
+        if (EVP_DecryptFinal_ex(ctx, decrypted.data() + len, &finalLen) <= 0) {
+            fprintf(stderr, "TLS record authentication failed\n");
+            exit(1);
+        }
+        auto decryptionCompletionTimestamp = high_resolution_clock::now();
+
+        const char* json;
+        size_t jsonLength;
+        if (compressed) {
+            inflater.setInput((const char*)decrypted.data(), len + finalLen);
+            int inflatedBytes;
+            jsonLength = 0;
+            while ((inflatedBytes = inflater.decode(payload.data() + jsonLength, payload.size() - jsonLength)) > 0 || inflater.isMessageComplete())
+                jsonLength += inflatedBytes;
+            json = payload.data();
+        } else {
+            // Without compression the gateway hands the raw frames over, the component skips the header
+            size_t headerLength = decrypted[1] == 126 ? 4 : (decrypted[1] == 127 ? 10 : 2);
+            json = (const char*)decrypted.data() + headerLength;
+            jsonLength = len + finalLen - headerLength;
+        }
+        auto inflationCompletionTimestamp = high_resolution_clock::now();
+
+        rapidjson::Document doc;
+        doc.Parse(json, jsonLength);
+        auto parsingCompletionTimestamp = high_resolution_clock::now();
+        if (!doc.HasParseError())
+            result.parsedMessages++;
+
+        decryptionTime += decryptionCompletionTimestamp - decryptionStartTimestamp;
+        inflationTime += inflationCompletionTimestamp - decryptionCompletionTimestamp;
+        parsingTime += parsingCompletionTimestamp - inflationCompletionTimestamp;
+    }
+
+    EVP_CIPHER_CTX_free(ctx);
+    result.wireBytes /= records.size();
+    result.decryptionNanoseconds = (double)decryptionTime.count() / records.size();
+    result.inflationNanoseconds = (double)inflationTime.count() / records.size();
+    result.parsingNanoseconds = (double)parsingTime.count() / records.size();
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    size_t numberOfMessages = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_NUMBER_OF_MESSAGES;
+    int maxNumberOfLevels = argc > 2 ? atoi(argv[2]) : DEFAULT_MAX_NUMBER_OF_LEVELS_PER_UPDATE;
+    if (numberOfMessages == 0 || maxNumberOfLevels <= 0) {
+        fprintf(stderr, "Usage: %s [number of messages] [max number of levels per update]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<std::string> messages = generateKrakenBookUpdates(numberOfMessages, maxNumberOfLevels);
+    double jsonBytes = 0;
+    for (const std::string& message : messages)
+        jsonBytes += message.size();
+
+    printf("%zu Kraken book updates, %.1f JSON bytes per message on average\n\n", numberOfMessages, jsonBytes / numberOfMessages);
+    printf("%-24s %12s %14s %14s %12s %12s\n", "permessage-deflate", "bytes/msg", "decrypt ns", "inflate ns", "parse ns", "total ns");
+    for (bool compressed : {false, true}) {
+        std::vector<EncryptedRecord> records = encryptFrames(frameMessages(messages, compressed));
+        ScenarioResult result = runScenario(records, compressed);
+        if (result.parsedMessages != numberOfMessages)
+            fprintf(stderr, "Only %zu of %zu messages parsed\n", result.parsedMessages, numberOfMessages);
+        printf("%-24s %12.1f %14.1f %14.1f %12.1f %12.1f\n", compressed ? "on" : "off", result.wireBytes, result.decryptionNanoseconds,
+               result.inflationNanoseconds, result.parsingNanoseconds,
+               result.decryptionNanoseconds + result.inflationNanoseconds + result.parsingNanoseconds);
+    }
+
+    return 0;
+}
@@ -0,0 +1,358 @@
+// StrategyBenchmark.cpp
+//
+// Replays best bid and ask updates through the currency graph of the Strategy, for every portfolio it can trade and
+// for synthetic graphs of the given sizes and densities, and reports, per update, the detection latency of the
+// Bellman-Ford pass over the whole graph and of the evaluation of the triangles through the updated pair only, with
+// every cycle evaluation kernel the CPU supports, along with the updates each of them found an arbitrage in, the
+// profitable cycles found and the heap allocations made per update.
+// By default every pair follows its own random walk around a consistent set of currency values, so that short-lived
+// triangular arbitrages appear as they do between books that are updated independently. A recording replaces the
+// random walks of the portfolios: one captured message of a BBO channel per line, Kraken ticker or BitMEX quote, as
+// the exchanges and the Mock Exchange send them. Its records are matched to the pairs of each portfolio by symbol.
+// Nothing goes to the network and the random walks are seeded, so runs are reproducible. The exit status is not 0
+// when the kernels disagree on the cycles found.
+//
+// Usage: ./bench_strategy [number of updates] [--synthetic pairs:quotes per currency,...] [--replay recorded BBO file]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "../Exchanges/ExchangePolicies.hpp"
+#include "../StrategyComponent/CurrencyGraph.hpp"
+#include "SyntheticCurrencyGraph.hpp"
+
+#define DEFAULT_NUMBER_OF_UPDATES 100000
+#define DEFAULT_SYNTHETIC_GRAPHS "300:4,1000:8"
+#define RECORD_SYMBOL_KEY "\"symbol\":\""
+#define RECORD_DATA_ARRAY_KEY "\"data\":["
+
+using namespace std::chrono;
+
+// Every allocation of the process goes through here, the detections are single-threaded
+static size_t numberOfAllocations = 0;
+
+void* operator new(size_t size) {
+    numberOfAllocations++;
+    if (void* p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    numberOfAllocations++;
+    // aligned_alloc takes sizes that are a multiple of the alignment only
+    size_t alignedSize = (size + (size_t)alignment - 1) / (size_t)alignment * (size_t)alignment;
+    if (void* p = aligned_alloc((size_t)alignment, alignedSize ? alignedSize : (size_t)alignment))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { free(p); }
+
+struct BboUpdate {
+    int currencyPairIdx;
+    double bidPrice;
+    double bidSize;
+    double askPrice;
+    double askSize;
+};
+
+struct RecordedBboUpdate {
+    std::string symbol;
+    double bidPrice;
+    double bidSize;
+    double askPrice;
+    double askSize;
+};
+
+struct SyntheticGraphSpec {
+    size_t numberOfPairs;
+    int quoteCurrenciesPerCurrency;
+};
+
+struct DetectionResult {
+    std::vector<double> latencies;
+    size_t updatesWithArbitrage;
+    size_t opportunities; // Profitable cycles found, the Bellman-Ford pass stops at the first one
+    size_t allocations;
+};
+
+static const char* findRecordField(const char* record, const char* recordEnd, const char* key) {
+    size_t keyLength = strlen(key);
+    const char* field = std::search(record, recordEnd, key, key + keyLength);
+    return field == recordEnd ? NULL : field + keyLength;
+}
+
+// Picks the price and size of both sides out of a flat record of either BBO channel
+template <typename ExchangePolicy>
+static bool parseTopOfBookRecord(const char* record, const char* recordEnd, RecordedBboUpdate& recordedUpdate) {
+    const char* field;
+    return (field = findRecordField(record, recordEnd, ExchangePolicy::topOfBookBidPriceKey)) && (recordedUpdate.bidPrice = strtod(field, NULL)) > 0 &&
+           (field = findRecordField(record, recordEnd, ExchangePolicy::topOfBookBidSizeKey)) && (recordedUpdate.bidSize = strtod(field, NULL)) >= 0 &&
+           (field = findRecordField(record, recordEnd, ExchangePolicy::topOfBookAskPriceKey)) && (recordedUpdate.askPrice = strtod(field, NULL)) > 0 &&
+           (field = findRecordField(record, recordEnd, ExchangePolicy::topOfBookAskSizeKey)) && (recordedUpdate.askSize = strtod(field, NULL)) >= 0;
+}
+
+static bool readRecordedUpdates(const char* path, std::vector<RecordedBboUpdate>& recordedUpdates) {
+    std::ifstream file(path);
+    if (!file) {
+        perror(path);
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        const char* lineEnd = line.c_str() + line.size();
+        const char* record = strstr(line.c_str(), RECORD_DATA_ARRAY_KEY);
+        if (!record)
+            continue;
+        const char* recordEnd;
+        for (record += strlen(RECORD_DATA_ARRAY_KEY); (record = (const char*)memchr(record, '{', lineEnd - record)) != NULL; record = recordEnd) {
+            recordEnd = (const char*)memchr(record, '}', lineEnd - record);
+            if (!recordEnd)
+                break;
+            const char* symbol = findRecordField(record, recordEnd, RECORD_SYMBOL_KEY);
+            const char* symbolEnd = symbol ? (const char*)memchr(symbol, '"', recordEnd - symbol) : NULL;
+            RecordedBboUpdate recordedUpdate;
+            if (!symbolEnd || !(parseTopOfBookRecord<KrakenExchangePolicy>(record, recordEnd, recordedUpdate) ||
+                                parseTopOfBookRecord<BitmexExchangePolicy>(record, recordEnd, recordedUpdate)))
+                continue;
+            recordedUpdate.symbol.assign(symbol, symbolEnd);
+            recordedUpdates.push_back(recordedUpdate);
+        }
+    }
+    return true;
+}
+
+static bool parseSyntheticGraphSpecs(const char* list, std::vector<SyntheticGraphSpec>& specs) {
+    std::string remaining(list);
+    while (!remaining.empty()) {
+        size_t commaPosition = remaining.find(',');
+        std::string spec = remaining.substr(0, commaPosition);
+        char* end;
+        long numberOfPairs = strtol(spec.c_str(), &end, 10);
+        if (*end != ':' || numberOfPairs <= 0)
+            return false;
+        long quoteCurrenciesPerCurrency = strtol(end + 1, &end, 10);
+        if (*end != '\0' || quoteCurrenciesPerCurrency < 2 || quoteCurrenciesPerCurrency > 64)
+            return false;
+        specs.push_back({(size_t)numberOfPairs, (int)quoteCurrenciesPerCurrency});
+        remaining = commaPosition == std::string::npos ? "" : remaining.substr(commaPosition + 1);
+    }
+    return true;
+}
+
+static BboUpdate makeBboUpdate(int currencyPairIdx, double midPrice) {
+    return {currencyPairIdx, midPrice * (1 - HALF_SPREAD), 1.0, midPrice * (1 + HALF_SPREAD), 1.0};
+}
+
+// Applied the way the Strategy applies the best levels of a book
+static void applyBboUpdate(CurrencyGraph& graph, const BboUpdate& update) {
+    setExchangeRate(graph, graph.sellEdgeIdOfPair[update.currencyPairIdx], update.bidPrice, update.bidSize);
+    setExchangeRate(graph, graph.buyEdgeIdOfPair[update.currencyPairIdx], 1.0 / update.askPrice, update.askSize);
+}
+
+// Sets every pair once at a consistent price, then moves one random pair per update
+static void generateRandomUpdates(const std::vector<std::pair<int, int>>& pairs, size_t V, size_t numberOfUpdates, std::vector<BboUpdate>& initialUpdates,
+                                  std::vector<BboUpdate>& updates) {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> valueDistribution(-3, 3);
+    std::normal_distribution<double> moveDistribution(0, MID_PRICE_VOLATILITY);
+    std::uniform_int_distribution<size_t> pairDistribution(0, pairs.size() - 1);
+    std::vector<double> currencyValues(V);
+    for (double& currencyValue : currencyValues)
+        currencyValue = exp(valueDistribution(rng));
+    std::vector<double> midPrices(pairs.size());
+    for (size_t i = 0; i < pairs.size(); i++) {
+        midPrices[i] = currencyValues[pairs[i].first] / currencyValues[pairs[i].second];
+        initialUpdates.push_back(makeBboUpdate(i, midPrices[i]));
+    }
+
+    updates.reserve(numberOfUpdates);
+    for (size_t update = 0; update < numberOfUpdates; update++) {
+        size_t pairIdx = pairDistribution(rng);
+        // Pulled back towards the consistent price so that the walks of the pairs do not drift apart for good
+        double consistentMidPrice = currencyValues[pairs[pairIdx].first] / currencyValues[pairs[pairIdx].second];
+        midPrices[pairIdx] *= exp(moveDistribution(rng) - 0.1 * log(midPrices[pairIdx] / consistentMidPrice));
+        updates.push_back(makeBboUpdate(pairIdx, midPrices[pairIdx]));
+    }
+}
+
+static void printResult(const char* graphName, size_t numberOfPairs, double cyclesPerPair, const char* algorithm, DetectionResult& result) {
+    size_t numberOfUpdates = result.latencies.size();
+    std::sort(result.latencies.begin(), result.latencies.end());
+    printf("%-12s %6zu %12.1f %-17s %10.0f %10.0f %10.0f %10.0f %10.0f %12zu %13zu %13.2f\n", graphName, numberOfPairs, cyclesPerPair, algorithm,
+           getPercentile(result.latencies, 50), getPercentile(result.latencies, 99), getPercentile(result.latencies, 99.9), result.latencies.back(),
+           getMean(result.latencies), result.updatesWithArbitrage, result.opportunities, (double)result.allocations / numberOfUpdates);
+}
+
+// Returns false when the kernels disagreed on the cycles found
+static bool runGraph(const char* graphName, CurrencyGraph& graph, double cyclesPerPair, const std::vector<BboUpdate>& initialUpdates,
+                     const std::vector<BboUpdate>& updates) {
+    std::vector<CycleEvaluationKernel> kernels;
+    for (CycleEvaluationKernel kernel : {CycleEvaluationKernel::Scalar, CycleEvaluationKernel::Sse42, CycleEvaluationKernel::Avx2, CycleEvaluationKernel::Avx512})
+        if (isCycleEvaluationKernelSupported(kernel))
+            kernels.push_back(kernel);
+
+    for (const BboUpdate& update : initialUpdates)
+        applyBboUpdate(graph, update);
+
+    DetectionResult bellmanFordResult = {std::vector<double>(), 0, 0, 0};
+    std::vector<DetectionResult> kernelResults(kernels.size(), {std::vector<double>(), 0, 0, 0});
+    bellmanFordResult.latencies.reserve(updates.size());
+    for (DetectionResult& kernelResult : kernelResults)
+        kernelResult.latencies.reserve(updates.size());
+    // Kept across updates like in the Strategy and reserved up front, so that only the allocations of the detections
+    // themselves are counted
+    std::vector<TriangularArbitrageCycle> triangularArbitrageCycles;
+    triangularArbitrageCycles.reserve(graph.cycleOffsetOfPair[graph.numberOfPairs]);
+    size_t numberOfDisagreements = 0;
+    for (const BboUpdate& update : updates) {
+        applyBboUpdate(graph, update);
+
+        size_t allocationsBefore = numberOfAllocations;
+        steady_clock::time_point startTimestamp = steady_clock::now();
+        std::pair<std::vector<int>, system_clock::time_point> findTriangularArbitrageResult = findTriangularArbitrage(graph);
+        steady_clock::time_point completionTimestamp = steady_clock::now();
+        bellmanFordResult.latencies.push_back(duration<double, std::nano>(completionTimestamp - startTimestamp).count());
+        bellmanFordResult.allocations += numberOfAllocations - allocationsBefore;
+        // A Bellman-Ford pass that found no 3-cycle returns zeroed currencies
+        if (findTriangularArbitrageResult.first.size() > NUMBER_OF_ORDERS_FOR_TRIANGULAR_ARBITRAGE) {
+            bellmanFordResult.updatesWithArbitrage++;
+            bellmanFordResult.opportunities++;
+        }
+
+        size_t expectedNumberOfTriangularArbitrages = 0;
+        for (size_t kernelIdx = 0; kernelIdx < kernels.size(); kernelIdx++) {
+            graph.cycleEvaluationKernel = kernels[kernelIdx];
+            triangularArbitrageCycles.clear();
+            allocationsBefore = numberOfAllocations;
+            startTimestamp = steady_clock::now();
+            size_t numberOfTriangularArbitrages = findTriangularArbitrages(graph, update.currencyPairIdx, triangularArbitrageCycles);
+            completionTimestamp = steady_clock::now();
+            kernelResults[kernelIdx].latencies.push_back(duration<double, std::nano>(completionTimestamp - startTimestamp).count());
+            kernelResults[kernelIdx].allocations += numberOfAllocations - allocationsBefore;
+            kernelResults[kernelIdx].opportunities += numberOfTriangularArbitrages;
+            if (numberOfTriangularArbitrages > 0)
+                kernelResults[kernelIdx].updatesWithArbitrage++;
+
+            if (kernelIdx == 0)
+                expectedNumberOfTriangularArbitrages = numberOfTriangularArbitrages;
+            else if (numberOfTriangularArbitrages != expectedNumberOfTriangularArbitrages)
+                numberOfDisagreements++;
+        }
+    }
+
+    printResult(graphName, graph.numberOfPairs, cyclesPerPair, "bellman-ford", bellmanFordResult);
+    for (size_t kernelIdx = 0; kernelIdx < kernels.size(); kernelIdx++)
+        printResult(graphName, graph.numberOfPairs, cyclesPerPair, (std::string("triangles-") + getCycleEvaluationKernelName(kernels[kernelIdx])).c_str(),
+                    kernelResults[kernelIdx]);
+    if (numberOfDisagreements > 0)
+        fprintf(stderr, "Warning: the kernels disagreed with the scalar one on the cycles found %zu times on %s\n", numberOfDisagreements, graphName);
+    return numberOfDisagreements == 0;
+}
+
+// Replays the recorded updates of the pairs of the portfolio when there is a recording, random walks otherwise
+template <typename Tables>
+static bool runPortfolio(const char* portfolioName, const Tables& portfolio, size_t numberOfUpdates, const std::vector<RecordedBboUpdate>* recordedUpdates) {
+    CurrencyGraph graph;
+    createCurrencyGraph(portfolio, graph);
+    double cyclesPerPair = (double)portfolio.numberOfCycles / portfolio.numberOfPairs;
+
+    std::vector<BboUpdate> initialUpdates, updates;
+    if (recordedUpdates) {
+        std::unordered_map<std::string, int> currencyPairIdxOfSymbol;
+        for (size_t pairIdx = 0; pairIdx < portfolio.numberOfPairs; pairIdx++) {
+            const auto& symbol = portfolio.currencyPairSymbols[pairIdx];
+            currencyPairIdxOfSymbol[std::string(symbol.begin(), std::find(symbol.begin(), symbol.end(), '\0'))] = pairIdx;
+        }
+        for (const RecordedBboUpdate& recordedUpdate : *recordedUpdates) {
+            auto it = currencyPairIdxOfSymbol.find(recordedUpdate.symbol);
+            if (it == currencyPairIdxOfSymbol.end())
+                continue;
+            updates.push_back({it->second, recordedUpdate.bidPrice, recordedUpdate.bidSize, recordedUpdate.askPrice, recordedUpdate.askSize});
+            if (updates.size() == numberOfUpdates)
+                break;
+        }
+        if (updates.empty()) {
+            printf("%-12s no recorded update of its pairs\n", portfolioName);
+            return true;
+        }
+    } else {
+        std::vector<std::pair<int, int>> pairs;
+        for (size_t pairIdx = 0; pairIdx < portfolio.numberOfPairs; pairIdx++)
+            pairs.emplace_back(portfolio.baseCurrencyIndexOfPair[pairIdx], portfolio.quoteCurrencyIndexOfPair[pairIdx]);
+        generateRandomUpdates(pairs, graph.V, numberOfUpdates, initialUpdates, updates);
+    }
+    return runGraph(portfolioName, graph, cyclesPerPair, initialUpdates, updates);
+}
+
+static bool runSyntheticGraph(const SyntheticGraphSpec& spec, size_t numberOfUpdates) {
+    std::mt19937 rng(spec.numberOfPairs);
+    SyntheticPortfolio portfolio;
+    CurrencyGraph graph;
+    createSyntheticGraph(spec.numberOfPairs, spec.quoteCurrenciesPerCurrency, rng, portfolio, graph);
+    double cyclesPerPair = (double)portfolio.cycleFirstEdgeIds.size() / portfolio.pairs.size();
+
+    std::vector<BboUpdate> initialUpdates, updates;
+    generateRandomUpdates(portfolio.pairs, graph.V, numberOfUpdates, initialUpdates, updates);
+    std::string graphName = "synth-" + std::to_string(spec.numberOfPairs) + ":" + std::to_string(spec.quoteCurrenciesPerCurrency);
+    return runGraph(graphName.c_str(), graph, cyclesPerPair, initialUpdates, updates);
+}
+
+int main(int argc, char *argv[]) {
+    size_t numberOfUpdates = DEFAULT_NUMBER_OF_UPDATES;
+    const char* syntheticGraphList = DEFAULT_SYNTHETIC_GRAPHS;
+    const char* replayPath = NULL;
+    bool isUsageValid = true;
+    for (int i = 1; i < argc && isUsageValid; i++) {
+        if (strcmp(argv[i], "--synthetic") == 0 && i + 1 < argc)
+            syntheticGraphList = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+            replayPath = argv[++i];
+        else if (i == 1)
+            isUsageValid = (numberOfUpdates = strtoul(argv[i], NULL, 10)) > 0;
+        else
+            isUsageValid = false;
+    }
+    std::vector<SyntheticGraphSpec> syntheticGraphSpecs;
+    if (!isUsageValid || !parseSyntheticGraphSpecs(syntheticGraphList, syntheticGraphSpecs)) {
+        fprintf(stderr, "Usage: %s [number of updates] [--synthetic pairs:quotes per currency,...] [--replay recorded BBO file]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<RecordedBboUpdate> recordedUpdates;
+    if (replayPath && !readRecordedUpdates(replayPath, recordedUpdates))
+        return 1;
+    const std::vector<RecordedBboUpdate>* portfolioUpdates = replayPath ? &recordedUpdates : NULL;
+
+    if (replayPath)
+        printf("Up to %zu of the %zu recorded best bid and ask updates per portfolio, %zu random ones per synthetic graph, detection latency in ns\n\n",
+               numberOfUpdates, recordedUpdates.size(), numberOfUpdates);
+    else
+        printf("%zu best bid and ask updates per graph, detection latency in ns\n\n", numberOfUpdates);
+    printf("%-12s %6s %12s %-17s %10s %10s %10s %10s %10s %12s %13s %13s\n", "graph", "pairs", "cycles/pair", "algorithm", "p50", "p99", "p99.9", "max",
+           "mean", "updates hit", "opportunities", "allocs/update");
+    bool areKernelsConsistent = true;
+    areKernelsConsistent &= runPortfolio("bitmex-3", bitmexPortfolio, numberOfUpdates, portfolioUpdates);
+    areKernelsConsistent &= runPortfolio("kraken-3", krakenPortfolio3, numberOfUpdates, portfolioUpdates);
+    areKernelsConsistent &= runPortfolio("kraken-50", krakenPortfolio50, numberOfUpdates, portfolioUpdates);
+    areKernelsConsistent &= runPortfolio("kraken-92", krakenPortfolio92, numberOfUpdates, portfolioUpdates);
+    areKernelsConsistent &= runPortfolio("kraken-122", krakenPortfolio122, numberOfUpdates, portfolioUpdates);
+    for (const SyntheticGraphSpec& spec : syntheticGraphSpecs)
+        areKernelsConsistent &= runSyntheticGraph(spec, numberOfUpdates);
+    return areKernelsConsistent ? 0 : 1;
+}
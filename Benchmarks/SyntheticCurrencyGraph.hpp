@@ -0,0 +1,131 @@
+// SyntheticCurrencyGraph.hpp
+#ifndef SYNTHETIC_CURRENCY_GRAPH_HPP
+#define SYNTHETIC_CURRENCY_GRAPH_HPP
+
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../StrategyComponent/CurrencyGraph.hpp"
+
+#define NUMBER_OF_HUB_CURRENCIES 8
+// Random walks of the mid prices of the pairs, whose best bid and ask are this far from the mid
+#define HALF_SPREAD 0.0005
+#define MID_PRICE_VOLATILITY 0.0003
+
+// Latency statistics shared by the benchmarks
+inline double getPercentile(std::vector<double>& sortedValues, double percentile) {
+    size_t idx = std::min(sortedValues.size() - 1, (size_t)(percentile / 100.0 * sortedValues.size()));
+    return sortedValues[idx];
+}
+
+inline double getMean(const std::vector<double>& values) {
+    double sum = 0.0;
+    for (double value : values)
+        sum += value;
+    return values.empty() ? 0.0 : sum / values.size();
+}
+
+// The runtime counterpart of the tables of a portfolio (see makePortfolioTables), for the graphs no portfolio lists:
+// every pair between a few hub currencies, and every other currency quoted in a few random hubs, as on the exchanges.
+// The more hubs a currency is quoted in, the more triangles each pair is part of.
+struct SyntheticPortfolio {
+    std::vector<std::pair<int, int>> pairs; // Base and quote currency of each pair
+    std::vector<std::string> currencyNames;
+    std::vector<const char*> currencies;
+    std::vector<int> sellEdgeIdOfPair;
+    std::vector<int> buyEdgeIdOfPair;
+    std::vector<int> edgeIdOfPair;
+    std::vector<int> edgeOffsetOfCurrency;
+    std::vector<int> sourceCurrencyOfEdge;
+    std::vector<int> targetCurrencyOfEdge;
+    std::vector<int> cycleFirstEdgeIds;
+    std::vector<int> cycleSecondEdgeIds;
+    std::vector<int> cycleThirdEdgeIds;
+    std::vector<int> cycleOffsetOfPair;
+};
+
+// The graph points into the portfolio, which must outlive it
+inline void createSyntheticGraph(size_t numberOfPairs, int quoteCurrenciesPerCurrency, std::mt19937& rng, SyntheticPortfolio& portfolio, CurrencyGraph& graph) {
+    int numberOfHubs = std::max(NUMBER_OF_HUB_CURRENCIES, quoteCurrenciesPerCurrency);
+    for (int firstHub = 0; firstHub < numberOfHubs; firstHub++)
+        for (int secondHub = firstHub + 1; secondHub < numberOfHubs; secondHub++)
+            portfolio.pairs.emplace_back(secondHub, firstHub);
+    int V = numberOfHubs;
+    std::vector<int> hubs(numberOfHubs);
+    for (int hub = 0; hub < numberOfHubs; hub++)
+        hubs[hub] = hub;
+    while (portfolio.pairs.size() < numberOfPairs) {
+        std::shuffle(hubs.begin(), hubs.end(), rng);
+        for (int i = 0; i < quoteCurrenciesPerCurrency && portfolio.pairs.size() < numberOfPairs; i++)
+            portfolio.pairs.emplace_back(V, hubs[i]);
+        V++;
+    }
+
+    for (int currency = 0; currency < V; currency++)
+        portfolio.currencyNames.push_back("C" + std::to_string(currency));
+    for (const std::string& currencyName : portfolio.currencyNames)
+        portfolio.currencies.push_back(currencyName.c_str());
+
+    // Edges sorted by source currency, selling the base for the quote and buying it back
+    std::vector<std::pair<int, int>> edges; // Source currency and pair, negated for the buy side
+    for (size_t pairIdx = 0; pairIdx < portfolio.pairs.size(); pairIdx++) {
+        edges.emplace_back(portfolio.pairs[pairIdx].first, pairIdx + 1);
+        edges.emplace_back(portfolio.pairs[pairIdx].second, -(int)(pairIdx + 1));
+    }
+    std::stable_sort(edges.begin(), edges.end(), [](const std::pair<int, int>& a, const std::pair<int, int>& b) { return a.first < b.first; });
+
+    portfolio.sellEdgeIdOfPair.assign(portfolio.pairs.size(), -1);
+    portfolio.buyEdgeIdOfPair.assign(portfolio.pairs.size(), -1);
+    portfolio.edgeIdOfPair.assign(V * V, -1);
+    portfolio.edgeOffsetOfCurrency.assign(V + 1, 0);
+    for (size_t edgeId = 0; edgeId < edges.size(); edgeId++) {
+        bool isSellEdge = edges[edgeId].second > 0;
+        int pairIdx = std::abs(edges[edgeId].second) - 1;
+        int sourceCurrency = isSellEdge ? portfolio.pairs[pairIdx].first : portfolio.pairs[pairIdx].second;
+        int targetCurrency = isSellEdge ? portfolio.pairs[pairIdx].second : portfolio.pairs[pairIdx].first;
+        (isSellEdge ? portfolio.sellEdgeIdOfPair : portfolio.buyEdgeIdOfPair)[pairIdx] = edgeId;
+        portfolio.edgeIdOfPair[sourceCurrency * V + targetCurrency] = edgeId;
+        portfolio.sourceCurrencyOfEdge.push_back(sourceCurrency);
+        portfolio.targetCurrencyOfEdge.push_back(targetCurrency);
+        portfolio.edgeOffsetOfCurrency[sourceCurrency + 1]++;
+    }
+    for (int currency = 0; currency < V; currency++)
+        portfolio.edgeOffsetOfCurrency[currency + 1] += portfolio.edgeOffsetOfCurrency[currency];
+
+    // Both directions of every triangle through each pair, in the order of makePortfolioTables
+    const std::vector<int>& edgeIdOfPair = portfolio.edgeIdOfPair;
+    for (size_t pairIdx = 0; pairIdx < portfolio.pairs.size(); pairIdx++) {
+        int u = portfolio.pairs[pairIdx].first;
+        int v = portfolio.pairs[pairIdx].second;
+        portfolio.cycleOffsetOfPair.push_back(portfolio.cycleFirstEdgeIds.size());
+        for (int w = 0; w < V; w++) {
+            if (edgeIdOfPair[u * V + w] < 0 || edgeIdOfPair[v * V + w] < 0) continue;
+            // u -> v -> w -> u and u -> w -> v -> u
+            portfolio.cycleFirstEdgeIds.push_back(edgeIdOfPair[u * V + v]);
+            portfolio.cycleSecondEdgeIds.push_back(edgeIdOfPair[v * V + w]);
+            portfolio.cycleThirdEdgeIds.push_back(edgeIdOfPair[w * V + u]);
+            portfolio.cycleFirstEdgeIds.push_back(edgeIdOfPair[u * V + w]);
+            portfolio.cycleSecondEdgeIds.push_back(edgeIdOfPair[w * V + v]);
+            portfolio.cycleThirdEdgeIds.push_back(edgeIdOfPair[v * V + u]);
+        }
+    }
+    portfolio.cycleOffsetOfPair.push_back(portfolio.cycleFirstEdgeIds.size());
+
+    graph.V = V;
+    graph.numberOfPairs = portfolio.pairs.size();
+    graph.currencies = portfolio.currencies.data();
+    graph.edgeOffsetOfCurrency = portfolio.edgeOffsetOfCurrency.data();
+    graph.edgeIdOfPair = portfolio.edgeIdOfPair.data();
+    graph.sellEdgeIdOfPair = portfolio.sellEdgeIdOfPair.data();
+    graph.buyEdgeIdOfPair = portfolio.buyEdgeIdOfPair.data();
+    graph.cycleFirstEdgeIds = portfolio.cycleFirstEdgeIds.data();
+    graph.cycleSecondEdgeIds = portfolio.cycleSecondEdgeIds.data();
+    graph.cycleThirdEdgeIds = portfolio.cycleThirdEdgeIds.data();
+    graph.cycleOffsetOfPair = portfolio.cycleOffsetOfPair.data();
+    initializeEdges(graph, portfolio.sourceCurrencyOfEdge.data(), portfolio.targetCurrencyOfEdge.data());
+}
+
+#endif // SYNTHETIC_CURRENCY_GRAPH_HPP
@@ -11,82 +11,247 @@
 #include "../OrderBook/OrderBook.hpp"
 #include "../SPSCQueue/SPSCQueue.hpp"
 #include "../Utils/Utils.hpp"
+#include "../Exchanges/ExchangePolicies.hpp"
+#include "../StrategyComponent/Portfolios.hpp"
 
 #define CPU_CORE_INDEX_FOR_BOOK_BUILDER_COMPONENT_THREAD 2
 
-#if defined(USE_BITMEX_EXCHANGE) || defined(USE_BITMEX_MOCK_EXCHANGE) || defined(USE_BITMEX_TESTNET_EXCHANGE)
-    #define JSON_START_PATTERN "{\"table\""
-#elif defined(USE_KRAKEN_EXCHANGE) || defined(USE_KRAKEN_MOCK_EXCHANGE)
-    #define JSON_START_PATTERN "{\"channel\":\"book\""
-#endif
+#define TRADE_SIDE_KEY "\"side\":\""
+#define TRADE_PRICE_KEY "\"price\":"
+#define RECORD_TIMESTAMP_KEY "\"timestamp\":\""
+#define JSON_DATA_ARRAY_KEY "\"data\":["
 
 #define JSON_END_PATTERN "}]}"
 
 using namespace rapidjson;
 using namespace std::chrono;
 
-static std::unordered_map<std::string, OrderBook> orderBookMap;
+// The Book Builder of each traded exchange keeps the books of its own pairs
+template <typename ExchangePolicy>
+static std::unordered_map<std::string, OrderBook<ExchangePolicy>> orderBookMapOfExchange;
+template <typename ExchangePolicy>
+static std::unordered_map<std::string, int> currencyPairConnectionIndicesOfExchange;
+template <typename ExchangePolicy>
+static std::unordered_map<std::string, std::ofstream> historicalDataFilesOfExchange;
+
+static std::ofstream latencyDataFile;
+
+// Hands the emptied book to the Strategy so that the pair's rates are not used until a new snapshot lands
+template <typename ExchangePolicy>
+static void invalidateOrderBook(const std::string& currencyPair, SPSCQueue<OrderBook<ExchangePolicy>>& bookBuilderToStrategyQueue, system_clock::time_point updateSocketRxTimestamp) {
+    OrderBook<ExchangePolicy>& orderBook = orderBookMapOfExchange<ExchangePolicy>[currencyPair];
+    if (!orderBook.isValid())
+        return;
+    orderBook.invalidate(updateSocketRxTimestamp);
+    while (!bookBuilderToStrategyQueue.push(orderBook));
+}
+
+// Drops a desynced book and asks the gateway to resubscribe the connection of that single currency pair
+template <typename ExchangePolicy>
+static void requestResync(const std::string& currencyPair, SPSCQueue<OrderBook<ExchangePolicy>>& bookBuilderToStrategyQueue, std::vector<SPSCQueue<int>*>& bookBuilderComponentToGatewayResyncQueues, system_clock::time_point updateSocketRxTimestamp) {
+    if (!orderBookMapOfExchange<ExchangePolicy>[currencyPair].isValid())
+        return;
+    std::cerr << ExchangePolicy::name << " order book for " << currencyPair << " is out of sync, requesting a resubscription" << std::endl;
+    invalidateOrderBook(currencyPair, bookBuilderToStrategyQueue, updateSocketRxTimestamp);
+    int connectionIdx = currencyPairConnectionIndicesOfExchange<ExchangePolicy>[currencyPair];
+    bookBuilderComponentToGatewayResyncQueues[getGatewayShardIdx(connectionIdx, bookBuilderComponentToGatewayResyncQueues.size())]->push(connectionIdx);
+}
+
+// Returns where the value of the given key starts within [begin, end), or NULL when the record does not have the key
+static const char* findRecordField(const char* begin, const char* end, const char* key) {
+    size_t keyLength = strlen(key);
+    const char* field = std::search(begin, end, key, key + keyLength);
+    return field == end ? NULL : field + keyLength;
+}
+
+// Minimal parser for the BBO channels (Kraken ticker, BitMEX quote). Their records are flat objects holding the best
+// level of both sides, so the fields are picked out of each record of the data array without building a DOM. A
+// connection carries a single pair, so the symbol is known from the connection index and not parsed either.
+template <typename ExchangePolicy>
+static void applyTopOfBookUpdates(const BookBuilderGatewayToComponentQueueEntry& queueEntry, const std::string& currencyPair, SPSCQueue<OrderBook<ExchangePolicy>>& bookBuilderToStrategyQueue, std::vector<SPSCQueue<int>*>& bookBuilderComponentToGatewayResyncQueues) {
+    const char* currentPos = queueEntry.decryptedReadBuffer;
+    const char *messageEnd, *record, *recordEnd, *field;
+    double bidPrice, bidSize, askPrice, askSize;
+    long marketUpdateExchangeTimestamp;
+    OrderBook<ExchangePolicy>& orderBook = orderBookMapOfExchange<ExchangePolicy>[currencyPair];
+
+    while ((currentPos = strstr(currentPos, ExchangePolicy::topOfBookJsonStartPattern)) != NULL) {
+        messageEnd = strstr(currentPos, JSON_END_PATTERN);
+        if (!messageEnd)
+            break;
+        record = strstr(currentPos, JSON_DATA_ARRAY_KEY);
+        currentPos = messageEnd + strlen(JSON_END_PATTERN);
+        if (!record || record > messageEnd)
+            continue;
+
+        for (record += strlen(JSON_DATA_ARRAY_KEY); (record = (const char*)memchr(record, '{', messageEnd - record)) != NULL; record = recordEnd) {
+            recordEnd = (const char*)memchr(record, '}', messageEnd + 1 - record);
+            if (!recordEnd)
+                break;
+            if (!(field = findRecordField(record, recordEnd, ExchangePolicy::topOfBookBidPriceKey)) || (bidPrice = strtod(field, NULL)) <= 0 ||
+                !(field = findRecordField(record, recordEnd, ExchangePolicy::topOfBookBidSizeKey)) || (bidSize = strtod(field, NULL)) < 0 ||
+                !(field = findRecordField(record, recordEnd, ExchangePolicy::topOfBookAskPriceKey)) || (askPrice = strtod(field, NULL)) <= 0 ||
+                !(field = findRecordField(record, recordEnd, ExchangePolicy::topOfBookAskSizeKey)) || (askSize = strtod(field, NULL)) < 0)
+                continue;
+
+            // Kraken's ticker may come without an exchange timestamp, the socket receive time stands in for it then
+            const char* exchangeTimestamp = findRecordField(record, recordEnd, RECORD_TIMESTAMP_KEY);
+            const char* exchangeTimestampEnd = exchangeTimestamp ? (const char*)memchr(exchangeTimestamp, '"', recordEnd - exchangeTimestamp) : NULL;
+            if (exchangeTimestampEnd)
+                marketUpdateExchangeTimestamp = timePointToMicroseconds(convertTimestampToTimePoint(std::string(exchangeTimestamp, exchangeTimestampEnd)));
+            else
+                marketUpdateExchangeTimestamp = timePointToMicroseconds(queueEntry.marketUpdateSocketRxTimestamp);
+
+            // Every BBO update is a snapshot of the top of the book, so the first one after a reset makes it valid again
+            orderBook.setTopOfBook(bidPrice, bidSize, askPrice, askSize, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
+            orderBook.markValid();
+            if (orderBook.isCrossed()) {
+                requestResync(currencyPair, bookBuilderToStrategyQueue, bookBuilderComponentToGatewayResyncQueues, queueEntry.marketUpdateSocketRxTimestamp);
+                return;
+            }
+            while (!bookBuilderToStrategyQueue.push(orderBook));
+#ifdef VERBOSE_BOOK_BUILDER
+            orderBook.printOrderBook();
+#endif
+        }
+    }
+}
+
+// Minimal parser for the trade channels (Kraken trade, BitMEX trade), picked apart like the BBO channels. A trade
+// usually reaches us before the book update that removes the liquidity it took, so it is applied to the book right
+// away, marked as inferred, and the pair's triangles are re-evaluated on it. The next book update of the pair then
+// overwrites the inferred levels. Snapshots only replay past trades and are skipped.
+template <typename ExchangePolicy>
+static void applyTradeUpdates(const BookBuilderGatewayToComponentQueueEntry& queueEntry, const std::string& currencyPair, SPSCQueue<OrderBook<ExchangePolicy>>& bookBuilderToStrategyQueue) {
+    const char* currentPos = queueEntry.decryptedReadBuffer;
+    const char *messageEnd, *record, *recordEnd, *field;
+    double price, size;
+    long marketUpdateExchangeTimestamp;
+    OrderBook<ExchangePolicy>& orderBook = orderBookMapOfExchange<ExchangePolicy>[currencyPair];
+
+    while ((currentPos = strstr(currentPos, ExchangePolicy::tradeJsonStartPattern)) != NULL) {
+        messageEnd = strstr(currentPos, JSON_END_PATTERN);
+        if (!messageEnd)
+            break;
+        record = strstr(currentPos, JSON_DATA_ARRAY_KEY);
+        bool isSnapshot = findRecordField(currentPos, record ? record : messageEnd, ExchangePolicy::tradeSnapshotPattern) != NULL;
+        currentPos = messageEnd + strlen(JSON_END_PATTERN);
+        if (!record || record > messageEnd || isSnapshot || !orderBook.isValid())
+            continue;
+
+        bool isBookChanged = false;
+        for (record += strlen(JSON_DATA_ARRAY_KEY); (record = (const char*)memchr(record, '{', messageEnd - record)) != NULL; record = recordEnd) {
+            recordEnd = (const char*)memchr(record, '}', messageEnd + 1 - record);
+            if (!recordEnd)
+                break;
+            const char* side = findRecordField(record, recordEnd, TRADE_SIDE_KEY);
+            if (!side || !(field = findRecordField(record, recordEnd, TRADE_PRICE_KEY)) || (price = strtod(field, NULL)) <= 0 ||
+                !(field = findRecordField(record, recordEnd, ExchangePolicy::tradeSizeKey)) || (size = strtod(field, NULL)) <= 0)
+                continue;
 
-#if defined(USE_KRAKEN_EXCHANGE) 
-static std::unordered_map<std::string, std::ofstream> historicalDataFiles;
+            const char* exchangeTimestamp = findRecordField(record, recordEnd, RECORD_TIMESTAMP_KEY);
+            const char* exchangeTimestampEnd = exchangeTimestamp ? (const char*)memchr(exchangeTimestamp, '"', recordEnd - exchangeTimestamp) : NULL;
+            if (exchangeTimestampEnd)
+                marketUpdateExchangeTimestamp = timePointToMicroseconds(convertTimestampToTimePoint(std::string(exchangeTimestamp, exchangeTimestampEnd)));
+            else
+                marketUpdateExchangeTimestamp = timePointToMicroseconds(queueEntry.marketUpdateSocketRxTimestamp);
+
+            // The side is the taker's: "buy"/"Buy" lifted the asks, "sell"/"Sell" hit the bids
+            OrderBookSide takerSide = (side[0] == 'b' || side[0] == 'B') ? OrderBookSide::Buy : OrderBookSide::Sell;
+            isBookChanged |= orderBook.applyTrade(takerSide, price, size, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
+        }
+
+        // Every trade of a message comes from the same match, the book is only handed over once they are all applied
+        if (isBookChanged) {
+            while (!bookBuilderToStrategyQueue.push(orderBook));
+#ifdef VERBOSE_BOOK_BUILDER
+            orderBook.printOrderBook();
 #endif
+        }
+    }
+}
 
-static std::ofstream latencyDataFile;
+// Takes the next entry from any gateway shard, a currency pair only ever arrives through the shard of its connection
+static bool popFromGatewayShards(std::vector<SPSCQueue<BookBuilderGatewayToComponentQueueEntry>*>& bookBuilderGatewayToComponentQueues, size_t& nextShardIdx, BookBuilderGatewayToComponentQueueEntry& queueEntry) {
+    for (size_t i = 0; i < bookBuilderGatewayToComponentQueues.size(); i++) {
+        SPSCQueue<BookBuilderGatewayToComponentQueueEntry>* queue = bookBuilderGatewayToComponentQueues[nextShardIdx];
+        nextShardIdx = nextShardIdx + 1 == bookBuilderGatewayToComponentQueues.size() ? 0 : nextShardIdx + 1;
+        if (queue->pop(queueEntry))
+            return true;
+    }
+    return false;
+}
 
-void bookBuilderComponent(SPSCQueue<BookBuilderGatewayToComponentQueueEntry>& bookBuilderGatewayToComponentQueue, SPSCQueue<OrderBook>& bookBuilderToStrategyQueue, std::vector<std::string> currencyPairs) {
+// Builds the books of the pairs of one traded exchange, given in the order of the portfolio, on the cores of its pipeline
+template <typename ExchangePolicy>
+void bookBuilderComponent(std::vector<SPSCQueue<BookBuilderGatewayToComponentQueueEntry>*> bookBuilderGatewayToComponentQueues, SPSCQueue<OrderBook<ExchangePolicy>>& bookBuilderToStrategyQueue, std::vector<SPSCQueue<int>*> bookBuilderComponentToGatewayResyncQueues, std::vector<std::string> currencyPairs, std::vector<FeedMode> feedModes, std::vector<bool> tradeFeeds) {
+    constexpr int exchangeIdx = getTradedExchangeIdx<ExchangePolicy>();
+    std::unordered_map<std::string, OrderBook<ExchangePolicy>>& orderBookMap = orderBookMapOfExchange<ExchangePolicy>;
     int numCores = std::thread::hardware_concurrency();
+    int cpuCoreNumberForBookBuilderThread = CPU_CORE_INDEX_FOR_BOOK_BUILDER_COMPONENT_THREAD + exchangeIdx * CPU_CORE_STRIDE_OF_TRADED_EXCHANGES;
     
     if (numCores == 0) {
         std::cerr << "Error: Unable to determine the number of CPU cores." << std::endl;
         return;
-    } else if (numCores < CPU_CORE_INDEX_FOR_BOOK_BUILDER_COMPONENT_THREAD) {
+    } else if (numCores < cpuCoreNumberForBookBuilderThread) {
         std::cerr << "Error: Not enough cores to run the system." << std::endl;
         return;
     }
 
-    int cpuCoreNumberForBookBuilderThread = CPU_CORE_INDEX_FOR_BOOK_BUILDER_COMPONENT_THREAD;
     setThreadAffinity(pthread_self(), cpuCoreNumberForBookBuilderThread);
 
-    for (std::string currencyPair : currencyPairs) { 
-        orderBookMap[currencyPair] = OrderBook(currencyPair);
+    // The Strategy looks the edges of a book up by the index of its pair in the whole portfolio
+    for (size_t connectionIdx = 0; connectionIdx < currencyPairs.size(); connectionIdx++) { 
+        orderBookMap[currencyPairs[connectionIdx]] = OrderBook<ExchangePolicy>(currencyPairs[connectionIdx], tradedPortfolio.pairOffsetOfExchange[exchangeIdx] + connectionIdx);
+        currencyPairConnectionIndicesOfExchange<ExchangePolicy>[currencyPairs[connectionIdx]] = connectionIdx;
     }
 
+    size_t nextShardIdx = 0;
     const char *currentPos, *startPos, *endPos;
     char jsonStr[WEBSOCKET_CLIENT_RX_BUFFER_SIZE];
     size_t jsonLen;
     system_clock::time_point marketUpdateJsonParsingCompletionTimestamp, marketUpdateBookBuildingCompletionTimestamp;
     long marketUpdateExchangeTimestamp;
     GenericValue<rapidjson::UTF8<>>::MemberIterator data;
-#if defined(USE_BITMEX_EXCHANGE) || defined(USE_BITMEX_MOCK_EXCHANGE) || defined(USE_BITMEX_TESTNET_EXCHANGE)
-    const char *action, *symbol, *side, *exchangeTimestamp;
-    uint64_t id;
-    double size, price;
-#elif defined(USE_KRAKEN_EXCHANGE) || defined(USE_KRAKEN_MOCK_EXCHANGE)
-    const char *type, *symbol, *exchangeTimestamp;
+    const char *symbol = NULL, *exchangeTimestamp;
     double price, size;
-    uint64_t checksum;
+    // Kraken only, carried from one book message to the next
     uint64_t prevChecksum = 0;
-    GenericValue<rapidjson::UTF8<>>::ConstMemberIterator asks;
-    GenericValue<rapidjson::UTF8<>>::ConstMemberIterator bids;
-#endif
 
     while (true) {
         struct BookBuilderGatewayToComponentQueueEntry queueEntry;
-        while (!bookBuilderGatewayToComponentQueue.pop(queueEntry)) {};
+        while (!popFromGatewayShards(bookBuilderGatewayToComponentQueues, nextShardIdx, queueEntry)) {};
+
+        if (queueEntry.connectionReset) {
+            invalidateOrderBook(currencyPairs[queueEntry.connectionIdx], bookBuilderToStrategyQueue, queueEntry.marketUpdateSocketRxTimestamp);
+            continue;
+        }
 
         removeIncorrectNullCharacters(queueEntry.decryptedReadBuffer, queueEntry.decryptedBytesRead);
 #ifdef VERBOSE_BOOK_BUILDER
         std::cout << queueEntry.decryptedReadBuffer << std::endl;
 #endif
+        // Trades go first, they are the earliest sign of a move of the top of the book
+        if (tradeFeeds[queueEntry.connectionIdx])
+            applyTradeUpdates(queueEntry, currencyPairs[queueEntry.connectionIdx], bookBuilderToStrategyQueue);
+        if (feedModes[queueEntry.connectionIdx] == FeedMode::TopOfBook) {
+            applyTopOfBookUpdates(queueEntry, currencyPairs[queueEntry.connectionIdx], bookBuilderToStrategyQueue, bookBuilderComponentToGatewayResyncQueues);
+            continue;
+        }
         currentPos = queueEntry.decryptedReadBuffer;
         size_t jsonNo, stop = 0;
         while (currentPos < queueEntry.decryptedReadBuffer + strlen(queueEntry.decryptedReadBuffer)) {
-            startPos = strstr(currentPos, JSON_START_PATTERN);
+            startPos = strstr(currentPos, ExchangePolicy::jsonStartPattern);
             if (!startPos) 
                 break;
             endPos = strstr(startPos, JSON_END_PATTERN);
             if (!endPos) 
                 break;
+            // BitMEX trades start like its book messages and were already applied
+            if (tradeFeeds[queueEntry.connectionIdx] && strncmp(startPos, ExchangePolicy::tradeJsonStartPattern, strlen(ExchangePolicy::tradeJsonStartPattern)) == 0) {
+                currentPos = endPos + 1;
+                continue;
+            }
             
             // Extract the substring containing the JSON object
             jsonLen = endPos - startPos + strlen(JSON_END_PATTERN);
@@ -107,129 +272,177 @@ void bookBuilderComponent(SPSCQueue<BookBuilderGatewayToComponentQueueEntry>& bo
             jsonNo++;
             marketUpdateJsonParsingCompletionTimestamp = high_resolution_clock::now();
             data = doc.FindMember("data");
-#if defined(USE_BITMEX_EXCHANGE) || defined(USE_BITMEX_MOCK_EXCHANGE) || defined(USE_BITMEX_TESTNET_EXCHANGE)
-            action = doc["action"].GetString();
-
-            for (SizeType i = 0; i < doc["data"].Size(); i++) {
-                const Value& data_i = data->value[i];
-                symbol = data_i["symbol"].GetString();
-                id = data_i["id"].GetInt64();
-                side = data_i["side"].GetString();
-                if (data->value[i].HasMember("size")) 
-                    size = data_i["size"].GetInt64();
-                price = data_i["price"].GetDouble();
-                exchangeTimestamp = data_i["timestamp"].GetString();
-                marketUpdateExchangeTimestamp = timePointToMicroseconds(convertTimestampToTimePoint(exchangeTimestamp));
-                if (side[0] == 'B') {
-                    switch (action[0]) {
-                        case 'p':
-                        case 'i':
-                            orderBookMap[symbol].insertBuy(id, price, size, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
-                            break;
-                        case 'u':
-                            orderBookMap[symbol].updateBuy(id, size, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
-                            break;
-                        case 'd':
-                            orderBookMap[symbol].removeBuy(id, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
-                            break;
-                        default:
+            if constexpr (ExchangePolicy::api == ExchangeApi::Bitmex) {
+                const char* action = doc["action"].GetString();
+                const char* side;
+                uint64_t id;
+                bool desynced = false;
+
+                for (SizeType i = 0; i < doc["data"].Size(); i++) {
+                    const Value& data_i = data->value[i];
+                    symbol = data_i["symbol"].GetString();
+                    // A partial replaces the whole book, anything else is dropped while waiting for it
+                    if (action[0] == 'p' && i == 0)
+                        orderBookMap[symbol].invalidate(queueEntry.marketUpdateSocketRxTimestamp);
+                    else if (!orderBookMap[symbol].isValid())
+                        break;
+                    id = data_i["id"].GetInt64();
+                    side = data_i["side"].GetString();
+                    if (data->value[i].HasMember("size")) 
+                        size = data_i["size"].GetInt64();
+                    price = data_i["price"].GetDouble();
+                    exchangeTimestamp = data_i["timestamp"].GetString();
+                    marketUpdateExchangeTimestamp = timePointToMicroseconds(convertTimestampToTimePoint(exchangeTimestamp));
+                    if ((action[0] == 'u' || action[0] == 'd') && !(side[0] == 'B' ? orderBookMap[symbol].checkBuySidePriceLevel(id) : orderBookMap[symbol].checkSellSidePriceLevel(id))) {
+                        // Levels a trade already took out are confirmed by their delete, or come back with their update
+                        if (!orderBookMap[symbol].isInferred()) {
+                            desynced = true;
                             break;
-                    }
-                } else if (side[0] == 'S') {
-                    switch (action[0]) {
-                        case 'p':
-                        case 'i':
+                        }
+                        if (action[0] == 'd')
+                            continue;
+                        if (side[0] == 'B')
+                            orderBookMap[symbol].insertBuy(id, price, size, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
+                        else
                             orderBookMap[symbol].insertSell(id, price, size, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
-                            break;
-                        case 'u':
-                            orderBookMap[symbol].updateSell(id, size, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
-                            break;
-                        case 'd':
-                            orderBookMap[symbol].removeSell(id, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
-                            break;
-                        default:
-                            break;
+                        continue;
                     }
-                }
-            }
-            marketUpdateBookBuildingCompletionTimestamp = high_resolution_clock::now(); 
-            while (!bookBuilderToStrategyQueue.push(orderBookMap[symbol]));   
-#elif defined(USE_KRAKEN_EXCHANGE) || defined (USE_KRAKEN_MOCK_EXCHANGE)
-            type = doc["type"].GetString();
-
-            for (SizeType i = 0; i < doc["data"].Size(); i++) {
-                const Value& data_i = data->value[i];
-                asks = data_i.FindMember("asks");
-                bids = data_i.FindMember("bids");
-                symbol = data_i["symbol"].GetString();    
-                checksum = data_i["checksum"].GetInt64();
-                if (prevChecksum != 0) {
-                    if (checksum == prevChecksum) {
-                        stop++;
-                        break;
+                    if (side[0] == 'B') {
+                        switch (action[0]) {
+                            case 'p':
+                            case 'i':
+                                orderBookMap[symbol].insertBuy(id, price, size, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
+                                break;
+                            case 'u':
+                                orderBookMap[symbol].updateBuy(id, size, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
+                                break;
+                            case 'd':
+                                orderBookMap[symbol].removeBuy(id, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
+                                break;
+                            default:
+                                break;
+                        }
+                    } else if (side[0] == 'S') {
+                        switch (action[0]) {
+                            case 'p':
+                            case 'i':
+                                orderBookMap[symbol].insertSell(id, price, size, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
+                                break;
+                            case 'u':
+                                orderBookMap[symbol].updateSell(id, size, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
+                                break;
+                            case 'd':
+                                orderBookMap[symbol].removeSell(id, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
+                                break;
+                            default:
+                                break;
+                        }
                     }
                 }
-                prevChecksum = checksum;
-                if (type[0] == 's') {
-                    for (SizeType i = 0; i < data_i["asks"].Size(); i++) {
-                        const Value& ask_i = asks->value[i];
-                        price = ask_i["price"].GetDouble();
-                        size = ask_i["qty"].GetDouble();
-                        orderBookMap[symbol].insertSell(price, price, size, 0, queueEntry.marketUpdateSocketRxTimestamp);
-                    }
-                    for (SizeType i = 0; i < data_i["bids"].Size(); i++) {
-                        const Value& bid_i = bids->value[i];
-                        price = bid_i["price"].GetDouble();
-                        size = bid_i["qty"].GetDouble();
-                        orderBookMap[symbol].insertBuy(price, price, size, 0, queueEntry.marketUpdateSocketRxTimestamp);
-                    }
-                } else if (type[0] == 'u') {
-                    exchangeTimestamp = data_i["timestamp"].GetString();
-                    marketUpdateExchangeTimestamp = timePointToMicroseconds(convertTimestampToTimePoint(exchangeTimestamp));
+                if (action[0] == 'p')
+                    orderBookMap[symbol].markValid();
+                orderBookMap[symbol].markConfirmed();
+                marketUpdateBookBuildingCompletionTimestamp = high_resolution_clock::now(); 
+                if (desynced || orderBookMap[symbol].isCrossed())
+                    requestResync(symbol, bookBuilderToStrategyQueue, bookBuilderComponentToGatewayResyncQueues, queueEntry.marketUpdateSocketRxTimestamp);
+                else if (orderBookMap[symbol].isValid())
+                    while (!bookBuilderToStrategyQueue.push(orderBookMap[symbol]));   
+            } else {
+                const char* type = doc["type"].GetString();
+                uint64_t checksum;
+                GenericValue<rapidjson::UTF8<>>::ConstMemberIterator asks;
+                GenericValue<rapidjson::UTF8<>>::ConstMemberIterator bids;
+
+                for (SizeType i = 0; i < doc["data"].Size(); i++) {
+                    const Value& data_i = data->value[i];
                     asks = data_i.FindMember("asks");
                     bids = data_i.FindMember("bids");
                     symbol = data_i["symbol"].GetString();    
                     checksum = data_i["checksum"].GetInt64();
-                    for (SizeType i = 0; i < data_i["asks"].Size(); i++) {
-                        const Value& ask_i = asks->value[i]; 
-                        price = ask_i["price"].GetDouble();
-                        size = ask_i["qty"].GetDouble();
-                        if (size == 0)
-                            orderBookMap[symbol].removeSell(price, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
-                        else if (orderBookMap[symbol].checkSellSidePriceLevel(price))
-                            orderBookMap[symbol].updateSell(price, size, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
-                        else 
-                            orderBookMap[symbol].insertSell(price, price, size, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
+                    if (prevChecksum != 0) {
+                        if (checksum == prevChecksum) {
+                            stop++;
+                            break;
+                        }
                     }
-                    for (SizeType i = 0; i < data_i["bids"].Size(); i++) {
-                        const Value& bid_i = bids->value[i]; 
-                        price = bid_i["price"].GetDouble();
-                        size = bid_i["qty"].GetDouble();
-                        if (size == 0)
-                            orderBookMap[symbol].removeBuy(price, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
-                        else if (orderBookMap[symbol].checkBuySidePriceLevel(price))
-                            orderBookMap[symbol].updateBuy(price, size, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
-                        else 
-                            orderBookMap[symbol].insertBuy(price, price, size, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
+                    prevChecksum = checksum;
+                    if (type[0] == 's') {
+                        // A snapshot replaces whatever was left of the book, including after a resubscription
+                        orderBookMap[symbol].invalidate(queueEntry.marketUpdateSocketRxTimestamp);
+                        for (SizeType i = 0; i < data_i["asks"].Size(); i++) {
+                            const Value& ask_i = asks->value[i];
+                            price = ask_i["price"].GetDouble();
+                            size = ask_i["qty"].GetDouble();
+                            orderBookMap[symbol].insertSell(price, price, size, 0, queueEntry.marketUpdateSocketRxTimestamp);
+                        }
+                        for (SizeType i = 0; i < data_i["bids"].Size(); i++) {
+                            const Value& bid_i = bids->value[i];
+                            price = bid_i["price"].GetDouble();
+                            size = bid_i["qty"].GetDouble();
+                            orderBookMap[symbol].insertBuy(price, price, size, 0, queueEntry.marketUpdateSocketRxTimestamp);
+                        }
+                        orderBookMap[symbol].markValid();
+                    } else if (type[0] == 'u') {
+                        if (!orderBookMap[symbol].isValid())
+                            continue;
+                        exchangeTimestamp = data_i["timestamp"].GetString();
+                        marketUpdateExchangeTimestamp = timePointToMicroseconds(convertTimestampToTimePoint(exchangeTimestamp));
+                        asks = data_i.FindMember("asks");
+                        bids = data_i.FindMember("bids");
+                        symbol = data_i["symbol"].GetString();    
+                        checksum = data_i["checksum"].GetInt64();
+                        for (SizeType i = 0; i < data_i["asks"].Size(); i++) {
+                            const Value& ask_i = asks->value[i]; 
+                            price = ask_i["price"].GetDouble();
+                            size = ask_i["qty"].GetDouble();
+                            // Levels trimmed locally beyond the subscribed depth may still be deleted by the exchange
+                            if (size == 0) {
+                                if (orderBookMap[symbol].checkSellSidePriceLevel(price))
+                                    orderBookMap[symbol].removeSell(price, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
+                            }
+                            else if (orderBookMap[symbol].checkSellSidePriceLevel(price))
+                                orderBookMap[symbol].updateSell(price, size, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
+                            else 
+                                orderBookMap[symbol].insertSell(price, price, size, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
+                        }
+                        for (SizeType i = 0; i < data_i["bids"].Size(); i++) {
+                            const Value& bid_i = bids->value[i]; 
+                            price = bid_i["price"].GetDouble();
+                            size = bid_i["qty"].GetDouble();
+                            if (size == 0) {
+                                if (orderBookMap[symbol].checkBuySidePriceLevel(price))
+                                    orderBookMap[symbol].removeBuy(price, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
+                            }
+                            else if (orderBookMap[symbol].checkBuySidePriceLevel(price))
+                                orderBookMap[symbol].updateBuy(price, size, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
+                            else 
+                                orderBookMap[symbol].insertBuy(price, price, size, marketUpdateExchangeTimestamp, queueEntry.marketUpdateSocketRxTimestamp);
+                        }
                     }
-                }
 
-                while (!bookBuilderToStrategyQueue.push(orderBookMap[symbol]));
-                marketUpdateBookBuildingCompletionTimestamp = high_resolution_clock::now();    
+                    orderBookMap[symbol].markConfirmed();
+                    if (orderBookMap[symbol].isCrossed()) {
+                        requestResync(symbol, bookBuilderToStrategyQueue, bookBuilderComponentToGatewayResyncQueues, queueEntry.marketUpdateSocketRxTimestamp);
+                        continue;
+                    }
+
+                    while (!bookBuilderToStrategyQueue.push(orderBookMap[symbol]));
+                    marketUpdateBookBuildingCompletionTimestamp = high_resolution_clock::now();    
 #ifdef VERBOSE_BOOK_BUILDER
-                orderBookMap[symbol].printOrderBook();
+                    orderBookMap[symbol].printOrderBook();
 #endif
+                }
             }
-#endif          
             if (stop == 1) {
                 stop = 0;
                 break;
             }
 
-#if defined(USE_KRAKEN_EXCHANGE)
-            if (symbol)
-                historicalDataFiles[symbol] << jsonStr << std::endl;
-#endif 
+            if constexpr (ExchangePolicy::api == ExchangeApi::Kraken && !ExchangePolicy::isMock) {
+                // After the receive time, which Kraken tickers and book snapshots do not carry, for the portfolio optimiser
+                if (symbol)
+                    historicalDataFilesOfExchange<ExchangePolicy>[symbol] << timePointToMicroseconds(queueEntry.marketUpdateSocketRxTimestamp) << ' ' << jsonStr << std::endl;
+            }
 
             memset(jsonStr, 0, WEBSOCKET_CLIENT_RX_BUFFER_SIZE);
 
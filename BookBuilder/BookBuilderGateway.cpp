@@ -4,47 +4,56 @@
 #include <signal.h>
 #include <chrono>
 #include <ev.h>
-#include <liburing.h>
 #include <fstream>
 #include <sys/socket.h>
+#include <algorithm>
+#include <atomic>
 #include "../OrderBook/OrderBook.hpp"
 #include "../SPSCQueue/SPSCQueue.hpp"
 #include "../Utils/Utils.hpp"
+#include "../NetworkIO/NetworkBackend.hpp"
+#include "../StrategyComponent/Portfolios.hpp"
+#include "../Exchanges/ExchangePolicies.hpp"
+#ifdef USE_PERMESSAGE_DEFLATE
+#include "WebSocketInflater.hpp"
+#endif
 
 #define CPU_CORE_INDEX_FOR_BOOK_BUILDER_GATEWAY_THREAD 1
 #define CPU_CORE_INDEX_FOR_SQ_POLL_THREAD 0
-#define NUMBER_OF_IO_URING_SQ_ENTRIES 256
+#define CPU_CORE_INDEX_FOR_FIRST_EXTRA_GATEWAY_SHARD_THREAD 5
 #define WEBSOCKET_CLIENT_RX_BUFFER_SIZE 16378
+#define RECONNECT_INITIAL_BACKOFF_IN_MILLISECONDS 100
+#define RECONNECT_MAX_BACKOFF_IN_MILLISECONDS 5000
+#define CONNECT_TIMEOUT_IN_MILLISECONDS 10000
 
 using namespace std::chrono;
 
-#if defined(USE_BITMEX_EXCHANGE) || defined(USE_BITMEX_MOCK_EXCHANGE) || defined(USE_BITMEX_TESTNET_EXCHANGE)
-    #define NUMBER_OF_CONNECTIONS 3
-    static const std::vector<std::string> currencyPairs_ = {"XBTUSDT", "XBTETH", "ETHUSDT"};
-#elif defined(USE_KRAKEN_EXCHANGE) || defined(USE_KRAKEN_MOCK_EXCHANGE)  
-  #if defined(USE_PORTFOLIO_122)
-    #define NUMBER_OF_CONNECTIONS 122
-    static const std::vector<std::string> currencyPairs_ = {"KSM/EUR","KSM/BTC","KSM/DOT","KSM/GBP","KSM/ETH","KSM/USD","GBP/USD","BTC/CAD","BTC/EUR","BTC/AUD","BTC/JPY","BTC/GBP","BTC/CHF","BTC/USDT","BTC/USD","BTC/USDC","LTC/EUR","LTC/BTC","LTC/AUD","LTC/JPY","LTC/GBP","LTC/ETH","LTC/USDT","LTC/USD","SOL/EUR","SOL/BTC","SOL/GBP","SOL/ETH","SOL/USDT","SOL/USD","DOT/EUR","DOT/BTC","DOT/JPY","DOT/GBP","DOT/ETH","DOT/USDT","DOT/USD","ETH/CAD","ETH/EUR","ETH/BTC","ETH/AUD","ETH/JPY","ETH/GBP","ETH/CHF","ETH/USDT","ETH/USD","ETH/USDC","LINK/EUR","LINK/BTC","LINK/AUD","LINK/JPY","LINK/GBP","LINK/ETH","LINK/USDT","LINK/USD","USDC/CAD","USDC/EUR","USDC/AUD","USDC/GBP","USDC/CHF","USDC/USDT","USDC/USD","ADA/EUR","ADA/BTC","ADA/AUD","ADA/GBP","ADA/ETH","ADA/USDT","ADA/USD","ATOM/EUR","ATOM/BTC","ATOM/GBP","ATOM/ETH","ATOM/USDT","ATOM/USD","USDT/EUR","USDT/AUD","USDT/JPY","USDT/GBP","USDT/CHF","USDT/USD","USDT/CAD","AUD/JPY","AUD/USD","XRP/CAD","XRP/EUR","XRP/BTC","XRP/AUD","XRP/GBP","XRP/ETH","XRP/USDT","XRP/USD","EUR/CAD","EUR/AUD","EUR/JPY","EUR/GBP","EUR/CHF","EUR/USD","BCH/EUR","BCH/BTC","BCH/AUD","BCH/JPY","BCH/GBP","BCH/ETH","BCH/USDT","BCH/USD","USD/CHF","USD/JPY","USD/CAD","ALGO/EUR","ALGO/BTC","ALGO/GBP","ALGO/ETH","ALGO/USDT","ALGO/USD", };
-  #elif defined(USE_PORTFOLIO_92)
-    #define NUMBER_OF_CONNECTIONS 92
-    static const std::vector<std::string> currencyPairs_ = {"BCH/USD","BCH/BTC","BCH/EUR","BCH/AUD","BCH/GBP","BCH/ETH","BCH/USDT","BCH/JPY","BTC/USD","BTC/EUR","BTC/USDC","BTC/AUD","BTC/GBP","BTC/CAD","BTC/USDT","BTC/JPY","USD/CAD","USD/JPY","XRP/USD","XRP/BTC","XRP/EUR","XRP/AUD","XRP/GBP","XRP/ETH","XRP/CAD","XRP/USDT","EUR/USD","EUR/AUD","EUR/GBP","EUR/CAD","EUR/JPY","LTC/USD","LTC/EUR","LTC/BTC","LTC/AUD","LTC/GBP","LTC/ETH","LTC/USDT","LTC/JPY","ETH/USD","ETH/EUR","ETH/BTC","ETH/USDC","ETH/AUD","ETH/GBP","ETH/CAD","ETH/USDT","ETH/JPY","LINK/USD","LINK/BTC","LINK/EUR","LINK/AUD","LINK/GBP","LINK/ETH","LINK/USDT","LINK/JPY","ADA/USD","ADA/BTC","ADA/EUR","ADA/AUD","ADA/GBP","ADA/ETH","ADA/USDT","USDC/USD","USDC/EUR","USDC/AUD","USDC/GBP","USDC/CAD","USDC/USDT","GBP/USD","DOT/USD","DOT/BTC","DOT/EUR","DOT/GBP","DOT/ETH","DOT/USDT","DOT/JPY","USDT/USD","USDT/EUR","USDT/AUD","USDT/GBP","USDT/CAD","USDT/JPY","AUD/USD","AUD/JPY", };
-  #elif defined(USE_PORTFOLIO_50)
-    #define NUMBER_OF_CONNECTIONS 50
-    static const std::vector<std::string> currencyPairs_ = {"BCH/JPY","BCH/ETH","BCH/GBP","BCH/AUD","BCH/BTC","BCH/USDT","BCH/EUR","BCH/USD","USDT/JPY","USDT/GBP","USDT/AUD","USDT/EUR","USDT/USD","BTC/JPY","BTC/GBP","BTC/AUD","BTC/USDT","BTC/EUR","BTC/USD","EUR/GBP","EUR/JPY","EUR/AUD","EUR/USD","ETH/JPY","ETH/EUR","ETH/AUD","ETH/BTC","ETH/USDT","ETH/GBP","ETH/USD","USD/JPY","LINK/JPY","LINK/ETH","LINK/EUR","LINK/AUD","LINK/BTC","LINK/USDT","LINK/GBP","LINK/USD","LTC/JPY","LTC/ETH","LTC/GBP","LTC/AUD","LTC/BTC","LTC/USDT","LTC/EUR","LTC/USD","GBP/USD","AUD/JPY","AUD/USD", };
-  #elif defined(USE_PORTFOLIO_3)
-    #define NUMBER_OF_CONNECTIONS 3
-    static const std::vector<std::string> currencyPairs_ = {"USDT/USD", "SOL/USDT", "SOL/USD"};
-  #endif
-#endif
+#define NUMBER_OF_CONNECTIONS tradedPortfolio.numberOfPairs
 
-static SPSCQueue<BookBuilderGatewayToComponentQueueEntry>* bookBuilderGatewayToComponentQueue;
+// Every gateway shard runs on its own thread with its own network backend, libev loop and lws context, so the connection
+// state below is per thread. A shard owns the connections shardIdx, shardIdx + numberOfShards, ... of the portfolio
+// and indexes them locally from 0, the Book Builder Component only ever sees the portfolio-wide index.
+static thread_local int shardIdx;
+static thread_local int numberOfShards = 1;
+static thread_local int numberOfShardConnections;
+static thread_local std::vector<std::string> shardCurrencyPairs;
+static thread_local std::vector<FeedMode> shardFeedModes;
+static thread_local std::vector<bool> shardTradeFeeds;
+// Shards without an SQPOLL core of their own attach to the SQPOLL thread of the first shard of their exchange
+template <typename ExchangePolicy>
+static std::atomic<int> firstShardRingFd{-1};
+
+static thread_local SPSCQueue<BookBuilderGatewayToComponentQueueEntry>* bookBuilderGatewayToComponentQueue;
+static thread_local SPSCQueue<int>* bookBuilderComponentToGatewayResyncQueue;
 
 static int rxSeen, test;
-static int interrupted[NUMBER_OF_CONNECTIONS];
-static struct lws *clientWsis[NUMBER_OF_CONNECTIONS];
+static thread_local int interrupted[NUMBER_OF_CONNECTIONS];
+// Set between the subscription to the book of a pair and the one to its trades, as lws allows one write per callback
+static thread_local bool isTradeSubscriptionPending[NUMBER_OF_CONNECTIONS];
+static thread_local struct lws *clientWsis[NUMBER_OF_CONNECTIONS];
 
-static struct ev_loop *loopEv; 
-static ev_timer timeoutWatcher;
+static thread_local struct ev_loop *loopEv; 
+static thread_local ev_timer timeoutWatcher;
 
 struct WebSocketClientEvContext
 {
@@ -60,34 +69,110 @@ struct WebSocketClientEvContext
   struct timeval tv;
   char ctrlBuf[CMSG_SPACE(sizeof(tv))];
   struct cmsghdr* cmsg;
+#ifdef USE_PERMESSAGE_DEFLATE
+  WebSocketInflater inflater;
+  // The inflated payloads wait here until their message is complete, as the Book Builder Component parses the
+  // messages of each entry on their own
+  char inflatedBuffer[WEBSOCKET_CLIENT_RX_BUFFER_SIZE];
+  int inflatedLength;
+  int completeMessagesLength;
+  bool discardingMessage;  // The rest of a message that does not fit in an entry is dropped
+#endif
 };
 
-static struct WebSocketClientEvContext *wsClientsEvContexts[NUMBER_OF_CONNECTIONS];
+static thread_local struct WebSocketClientEvContext *wsClientsEvContexts[NUMBER_OF_CONNECTIONS];
 
 struct WebSocketSubscriptionData {
     std::vector<std::string> currencyPairs;
     int connectionIdx;
 };
 
-static SSL *ssls[NUMBER_OF_CONNECTIONS];
-static BIO *rbios[NUMBER_OF_CONNECTIONS];
-static int sockfds[NUMBER_OF_CONNECTIONS];
-
-static struct io_uring ring;
-static struct io_uring_sqe *sqe;
-static struct io_uring_cqe *cqe;
-
-// static const struct lws_extension extensions[] = {
-//         {
-//                 "permessage-deflate",
-//                 lws_extension_callback_pm_deflate,
-//                       "permessage-deflate"
-//                       "; client_no_context_takeover"
-//                       "; client_max_window_bits"
-//         },
-//         { NULL, NULL, NULL /* terminator */ }
-// };
+static thread_local SSL *ssls[NUMBER_OF_CONNECTIONS];
+static thread_local BIO *rbios[NUMBER_OF_CONNECTIONS];
+static thread_local int sockfds[NUMBER_OF_CONNECTIONS];
+
+static thread_local NetworkBackend* networkBackend;
+static thread_local bool areSocketsRegistered;
+
+static thread_local struct lws_context *context;
+static thread_local struct lws_client_connect_info clientConnectInfo;
+// Kept alive for the strings clientConnectInfo points into
+static thread_local ExchangeEndpoint marketDataEndpoint;
+
+enum class ConnectionState {
+    Connecting,
+    Connected,
+    Disconnected
+};
+
+static thread_local ConnectionState connectionStates[NUMBER_OF_CONNECTIONS];
+static thread_local int reconnectAttempts[NUMBER_OF_CONNECTIONS];
+// Earliest time of the next attempt while disconnected, deadline of the handshake while connecting
+static thread_local steady_clock::time_point connectionStateDeadlines[NUMBER_OF_CONNECTIONS];
+static thread_local int numberOfUnhealthyConnections;
+
+#ifdef USE_PERMESSAGE_DEFLATE
+static const struct lws_extension extensions[] = {
+        {
+                "permessage-deflate",
+                lws_extension_callback_pm_deflate,
+                      "permessage-deflate"
+                      "; client_no_context_takeover"
+                      "; client_max_window_bits"
+        },
+        { NULL, NULL, NULL /* terminator */ }
+};
+
+// Whether the exchange resets its compressor after every message, read from the handshake response
+static thread_local bool serverNoContextTakeover[NUMBER_OF_CONNECTIONS];
+#endif
+
+static inline int toPortfolioConnectionIdx(int connectionIdx) {
+    return shardIdx + connectionIdx * numberOfShards;
+}
+
+// Tears down a single dead or desynced connection without touching the others: its watcher is stopped, its fixed
+// file slot is emptied so that the old socket is released, and the Book Builder Component is told to drop the book
+// until the snapshot of the resubscription lands. The reconnection itself happens in serviceConnections().
+static void scheduleReconnect(int connectionIdx) {
+    if (connectionStates[connectionIdx] == ConnectionState::Disconnected)
+        return;
 
+    if (connectionStates[connectionIdx] == ConnectionState::Connected)
+        numberOfUnhealthyConnections++;
+
+    if (wsClientsEvContexts[connectionIdx])
+        ev_io_stop(loopEv, &wsClientsEvContexts[connectionIdx]->socketWatcher);
+
+    if (areSocketsRegistered) {
+        int ret = networkBackend->updateSocket(connectionIdx, -1);
+        if (ret < 0)
+            fprintf(stderr, "Emptying the socket slot of connection %d failed: %s\n", toPortfolioConnectionIdx(connectionIdx), strerror(-ret));
+    }
+
+    struct lws *wsi = clientWsis[connectionIdx];
+    clientWsis[connectionIdx] = NULL;
+    if (wsi)
+        lws_set_timeout(wsi, PENDING_TIMEOUT_USER_OK, LWS_TO_KILL_ASYNC);
+
+    sockfds[connectionIdx] = -1;
+    interrupted[connectionIdx] = 0;
+
+    int backoffInMilliseconds = std::min(RECONNECT_INITIAL_BACKOFF_IN_MILLISECONDS << std::min(reconnectAttempts[connectionIdx], 10), RECONNECT_MAX_BACKOFF_IN_MILLISECONDS);
+    connectionStateDeadlines[connectionIdx] = steady_clock::now() + milliseconds(backoffInMilliseconds);
+    reconnectAttempts[connectionIdx]++;
+    connectionStates[connectionIdx] = ConnectionState::Disconnected;
+    printf("Connection %d lost, reconnecting in %d ms\n", toPortfolioConnectionIdx(connectionIdx), backoffInMilliseconds);
+
+    struct BookBuilderGatewayToComponentQueueEntry queueEntry;
+    queueEntry.decryptedBytesRead = 0;
+    queueEntry.connectionIdx = toPortfolioConnectionIdx(connectionIdx);
+    queueEntry.connectionReset = true;
+    queueEntry.marketUpdateSocketRxTimestamp = high_resolution_clock::now();
+    while (!bookBuilderGatewayToComponentQueue->push(queueEntry));
+}
+
+template <typename ExchangePolicy>
 static int
 bookBuilderLwsCallback(struct lws *wsi, enum lws_callback_reasons reason,
 	      void *user, void *in, size_t len)
@@ -98,32 +183,25 @@ bookBuilderLwsCallback(struct lws *wsi, enum lws_callback_reasons reason,
         case LWS_CALLBACK_CLIENT_CONNECTION_ERROR:
             lwsl_err("CLIENT_CONNECTION_ERROR: %s\n",
                 in ? (char *)in : "(null)");
-            clientWsis[connectionIdx] = NULL;
+            // Events of a connection that was already replaced are ignored
+            if (clientWsis[connectionIdx] == wsi || clientWsis[connectionIdx] == NULL) {
+                clientWsis[connectionIdx] = NULL;
+                scheduleReconnect(connectionIdx);
+            }
             break;
 
         case LWS_CALLBACK_CLIENT_ESTABLISHED: {
-            printf("LWS_CALLBACK_CLIENT_ESTABLISHED for %d\n", connectionIdx);
+            printf("LWS_CALLBACK_CLIENT_ESTABLISHED for %d\n", toPortfolioConnectionIdx(connectionIdx));
             lwsl_user("%s: established\n", __func__);
-#ifndef USE_KRAKEN_MOCK_EXCHANGE
-#ifndef USE_BITMEX_MOCK_EXCHANGE
-    #if defined(USE_BITMEX_EXCHANGE) || defined(USE_BITMEX_TESTNET_EXCHANGE)
-            std::string currencyPair = currencyPairs_[connectionIdx];
-            std::string subscriptionMessage = "{\"op\":\"subscribe\",\"args\":[\"orderBookL2_25:" + currencyPair + "\"]}";
-    #elif defined(USE_KRAKEN_EXCHANGE)
-            std::string subscriptionMessage = R"({
-                                                "method": "subscribe",
-                                                "params": {
-                                                    "channel": "book",
-                                                    "depth": 10,
-                                                    "snapshot": true,
-                                                    "symbol": [)";
-            subscriptionMessage += "\"" + currencyPairs_[connectionIdx] + "\"";
-            subscriptionMessage += R"(]
-                                        },
-                                        "req_id": 1234567890
-                                        }
-                                    )";
-    #endif
+#ifdef USE_PERMESSAGE_DEFLATE
+            char negotiatedExtensions[256];
+            serverNoContextTakeover[connectionIdx] = lws_hdr_copy(wsi, negotiatedExtensions, sizeof(negotiatedExtensions), WSI_TOKEN_EXTENSIONS) > 0 &&
+                                                     strstr(negotiatedExtensions, "server_no_context_takeover") != NULL;
+#endif
+            // The subscription to the book or BBO channel of the pair, and to its trades when the exchange takes a message of its own for them
+            std::string subscriptionMessage = ExchangePolicy::getSubscriptionMessage(shardCurrencyPairs[connectionIdx], shardFeedModes[connectionIdx] == FeedMode::TopOfBook,
+                                                                                      shardTradeFeeds[connectionIdx]);
+            std::string tradeSubscriptionMessage = ExchangePolicy::getTradeSubscriptionMessage(shardCurrencyPairs[connectionIdx], shardTradeFeeds[connectionIdx]);
             // Allocate buffer with LWS_PRE bytes before the data
             unsigned char buf[LWS_PRE + subscriptionMessage.size()];
 
@@ -132,15 +210,33 @@ bookBuilderLwsCallback(struct lws *wsi, enum lws_callback_reasons reason,
                     
             // Send data using lws_write
             lws_write(wsi, &buf[LWS_PRE], subscriptionMessage.size(), LWS_WRITE_TEXT);
-            
-#endif
-#endif
-			interrupted[connectionIdx] = 1;
+
+            // The connection is only taken over once lws has flushed every subscription
+            isTradeSubscriptionPending[connectionIdx] = !tradeSubscriptionMessage.empty();
+            lws_callback_on_writable(wsi);
             break;
         }
 
+        case LWS_CALLBACK_CLIENT_WRITEABLE:
+            if (clientWsis[connectionIdx] != wsi || interrupted[connectionIdx])
+                break;
+            if (isTradeSubscriptionPending[connectionIdx]) {
+                std::string tradeSubscriptionMessage = ExchangePolicy::getTradeSubscriptionMessage(shardCurrencyPairs[connectionIdx], shardTradeFeeds[connectionIdx]);
+                unsigned char tradeBuf[LWS_PRE + tradeSubscriptionMessage.size()];
+                memcpy(&tradeBuf[LWS_PRE], tradeSubscriptionMessage.c_str(), tradeSubscriptionMessage.size());
+                lws_write(wsi, &tradeBuf[LWS_PRE], tradeSubscriptionMessage.size(), LWS_WRITE_TEXT);
+                isTradeSubscriptionPending[connectionIdx] = false;
+                lws_callback_on_writable(wsi);
+                break;
+            }
+			interrupted[connectionIdx] = 1;
+            break;
+
         case LWS_CALLBACK_CLIENT_CLOSED:
-            clientWsis[connectionIdx] = NULL;
+            if (clientWsis[connectionIdx] == wsi || clientWsis[connectionIdx] == NULL) {
+                clientWsis[connectionIdx] = NULL;
+                scheduleReconnect(connectionIdx);
+            }
             break;
 
         default:
@@ -150,85 +246,227 @@ bookBuilderLwsCallback(struct lws *wsi, enum lws_callback_reasons reason,
 	return lws_callback_http_dummy(wsi, reason, user, in, len);
 }
 
+template <typename ExchangePolicy>
 static const struct lws_protocols protocols[] = {
-        { "book-builder-lws-client", bookBuilderLwsCallback, 0, 0, 0, NULL, 0 },
+        { "book-builder-lws-client", bookBuilderLwsCallback<ExchangePolicy>, 0, 0, 0, NULL, 0 },
         LWS_PROTOCOL_LIST_TERM
 };
 
-void handleSocketEvent (EV_P_ ev_io *w_, int revents) {
-    // Cast the ev_io watcher pointer to our custom WebSocketClientEvContext structure
-    struct WebSocketClientEvContext *w = (struct WebSocketClientEvContext *) w_;
-    // Now we can access the custom data fields for the corresponding WebSocket client 
-    uint connectionIdx = w->connectionIdx;
+#ifdef USE_PERMESSAGE_DEFLATE
+// Forgets the compression context and the incomplete message of a connection
+static void resetInflation(struct WebSocketClientEvContext *w, int connectionIdx) {
+    w->inflater.reset(serverNoContextTakeover[connectionIdx]);
+    w->inflatedLength = 0;
+    w->completeMessagesLength = 0;
+    w->discardingMessage = false;
+}
 
-  	if (revents & EV_READ) {
-        system_clock::time_point marketUpdatePollTimestamp = high_resolution_clock::now();
-        // printf("SOCKET ready for reading for connection %d\n", connectionIdx);
-        sqe = io_uring_get_sqe(&ring);
+// Hands the complete messages inflated so far over in one entry and moves the start of the next one to the front
+static void pushCompleteMessages(struct WebSocketClientEvContext *w, struct BookBuilderGatewayToComponentQueueEntry& queueEntry) {
+    if (w->completeMessagesLength == 0)
+        return;
+    memcpy(queueEntry.decryptedReadBuffer, w->inflatedBuffer, w->completeMessagesLength);
+    queueEntry.decryptedReadBuffer[w->completeMessagesLength] = '\0';
+    queueEntry.decryptedBytesRead = w->completeMessagesLength;
+    while (!bookBuilderGatewayToComponentQueue->push(queueEntry));
+
+    w->inflatedLength -= w->completeMessagesLength;
+    memmove(w->inflatedBuffer, w->inflatedBuffer + w->completeMessagesLength, w->inflatedLength);
+    w->completeMessagesLength = 0;
+}
+#endif
 
-        if (!sqe) {
-            perror("io_uring_get_sqe failed");
-            io_uring_queue_exit(&ring);
-            return;
-        }
+// Reads whatever the socket of a connection holds, decrypts it and hands it over to the Book Builder Component. An
+// empty socket is not an error, so the busy polling loop can call this on every connection without readiness events.
+template <typename Backend>
+static void readConnection(Backend& backend, int connectionIdx, system_clock::time_point marketUpdatePollTimestamp) {
+    struct WebSocketClientEvContext *w = wsClientsEvContexts[connectionIdx];
 
-        // printf("Reading for sockfd %d\n", w->sockfd);
-        io_uring_prep_recvmsg(sqe, connectionIdx, &w->msg, 0);  
-        sqe->flags |= IOSQE_FIXED_FILE;
+    ssize_t undecryptedBytesRead = backend.receiveMessage(connectionIdx, &w->msg);
+    system_clock::time_point marketUpdateReadCompletionTimestamp = high_resolution_clock::now();
 
-        if (io_uring_submit(&ring) < 0) {
-            perror("io_uring_submit failed");
-            io_uring_queue_exit(&ring);
+    if (undecryptedBytesRead <= 0) {
+        if (undecryptedBytesRead == -EAGAIN || undecryptedBytesRead == -EINTR)
             return;
-        }
+        fprintf(stderr, "recvmsg operation error for connection %d: %zd\n", toPortfolioConnectionIdx(connectionIdx), undecryptedBytesRead);
+        scheduleReconnect(connectionIdx);
+        return;
+    }
 
-        int ret = io_uring_wait_cqe(&ring, &cqe);
-        system_clock::time_point marketUpdateReadCompletionTimestamp = high_resolution_clock::now();
-        
-        if (ret < 0) {
-            perror("Error waiting for completion: %s\n");
+    int bytesBioWritten = BIO_write(rbios[connectionIdx], w->undecryptedReadBuffer, undecryptedBytesRead);
+    int decryptedBytesRead = SSL_read(ssls[connectionIdx], w->decryptedReadBuffer, w->decryptedReadBufferSize);
+
+    system_clock::time_point marketUpdateDecryptionCompletionTimestamp = high_resolution_clock::now();
+    
+    // printf("BYTES READ from ssl: %d\n", decryptedBytesRead);
+    if (decryptedBytesRead <= 0) {
+        // An incomplete TLS record is completed by the next read, anything else means the session is gone
+        if (SSL_get_error(ssls[connectionIdx], decryptedBytesRead) == SSL_ERROR_WANT_READ)
             return;
-        }
+        fprintf(stderr, "SSL_read error for connection %d\n", toPortfolioConnectionIdx(connectionIdx));
+        scheduleReconnect(connectionIdx);
+        return;
+    }
 
-        if (cqe->res < 0) {
-            perror("recvmsg operation error");
+    system_clock::time_point marketUpdateSocketRxTimestamp;
+    w->msg.msg_control = w->ctrlBuf;
+    w->msg.msg_controllen = sizeof(w->ctrlBuf);
+    w->cmsg = CMSG_FIRSTHDR(&w->msg);
+
+    if (w->cmsg->cmsg_level == SOL_SOCKET && w->cmsg->cmsg_type == SCM_TIMESTAMP) {
+        memcpy(&w->tv, CMSG_DATA(w->cmsg), sizeof(w->tv));
+        // std::cout << "Received packet at timestamp: " << w->tv.tv_sec << " seconds and " << w->tv.tv_usec << " microseconds" << std::endl;
+        marketUpdateSocketRxTimestamp = std::chrono::system_clock::from_time_t((long)w->tv.tv_sec);
+        marketUpdateSocketRxTimestamp += std::chrono::microseconds((long)w->tv.tv_usec);
+    }
+
+    struct BookBuilderGatewayToComponentQueueEntry queueEntry;
+    queueEntry.connectionIdx = toPortfolioConnectionIdx(connectionIdx);
+    queueEntry.marketUpdateSocketRxTimestamp = marketUpdateSocketRxTimestamp;
+    queueEntry.marketUpdatePollTimestamp = marketUpdatePollTimestamp;
+    queueEntry.marketUpdateReadCompletionTimestamp = marketUpdateReadCompletionTimestamp;
+    queueEntry.marketUpdateDecryptionCompletionTimestamp = marketUpdateDecryptionCompletionTimestamp;
+#ifdef USE_PERMESSAGE_DEFLATE
+    // The decrypted bytes are websocket frames: only their (inflated) payloads are handed over, in entries of whole
+    // messages NUL-terminated for the JSON extraction of the Book Builder Component. The start of a message that ends
+    // in a later read is carried over to the entry of that read.
+    int inflatedBufferCapacity = sizeof(w->inflatedBuffer) - 1;
+    w->inflater.setInput(w->decryptedReadBuffer, decryptedBytesRead);
+    while (true) {
+        int inflatedBytes = w->inflater.decode(w->inflatedBuffer + w->inflatedLength, inflatedBufferCapacity - w->inflatedLength);
+        if (inflatedBytes < 0) {
+            fprintf(stderr, "Websocket close frame or corrupt compressed data on connection %d\n", toPortfolioConnectionIdx(connectionIdx));
+            scheduleReconnect(connectionIdx);
             return;
-        } 
-
-        int undecryptedBytesRead = cqe->res;				
-        int bytesBioWritten = BIO_write(rbios[connectionIdx], w->undecryptedReadBuffer, undecryptedBytesRead);
-        int decryptedBytesRead = SSL_read(ssls[connectionIdx], w->decryptedReadBuffer, w->decryptedReadBufferSize);
-
-        system_clock::time_point marketUpdateDecryptionCompletionTimestamp = high_resolution_clock::now();
-        
-        // printf("BYTES READ from ssl: %d\n", decryptedBytesRead);
-        io_uring_cqe_seen(&ring, cqe);
-
-        system_clock::time_point marketUpdateSocketRxTimestamp;
-        w->msg.msg_control = w->ctrlBuf;
-        w->msg.msg_controllen = sizeof(w->ctrlBuf);
-        w->cmsg = CMSG_FIRSTHDR(&w->msg);
-
-        if (w->cmsg->cmsg_level == SOL_SOCKET && w->cmsg->cmsg_type == SCM_TIMESTAMP) {
-            memcpy(&w->tv, CMSG_DATA(w->cmsg), sizeof(w->tv));
-            // std::cout << "Received packet at timestamp: " << w->tv.tv_sec << " seconds and " << w->tv.tv_usec << " microseconds" << std::endl;
-            marketUpdateSocketRxTimestamp = std::chrono::system_clock::from_time_t((long)w->tv.tv_sec);
-            marketUpdateSocketRxTimestamp += std::chrono::microseconds((long)w->tv.tv_usec);
         }
+        w->inflatedLength += inflatedBytes;
+
+        if (w->inflater.isMessageComplete()) {
+            if (w->discardingMessage) {
+                w->discardingMessage = false;
+                w->inflatedLength = w->completeMessagesLength;
+            } else {
+                w->completeMessagesLength = w->inflatedLength;
+            }
+            continue;
+        }
+        // The input is exhausted
+        if (w->inflatedLength < inflatedBufferCapacity)
+            break;
 
-        struct BookBuilderGatewayToComponentQueueEntry queueEntry;
-        memcpy(queueEntry.decryptedReadBuffer, w->decryptedReadBuffer, w->decryptedReadBufferSize);
-        queueEntry.decryptedBytesRead = decryptedBytesRead;
-        queueEntry.marketUpdateSocketRxTimestamp = marketUpdateSocketRxTimestamp;
-        queueEntry.marketUpdatePollTimestamp = marketUpdatePollTimestamp;
-        queueEntry.marketUpdateReadCompletionTimestamp = marketUpdateReadCompletionTimestamp;
-        queueEntry.marketUpdateDecryptionCompletionTimestamp = marketUpdateDecryptionCompletionTimestamp;
+        // The buffer is full in the middle of a message
+        if (w->discardingMessage) {
+            w->inflatedLength = w->completeMessagesLength;
+        } else if (w->completeMessagesLength > 0) {
+            pushCompleteMessages(w, queueEntry);
+        } else {
+            fprintf(stderr, "Dropping a message of more than %d bytes on connection %d\n", inflatedBufferCapacity, toPortfolioConnectionIdx(connectionIdx));
+            w->discardingMessage = true;
+            w->inflatedLength = 0;
+        }
+    }
+    pushCompleteMessages(w, queueEntry);
+#else
+    memcpy(queueEntry.decryptedReadBuffer, w->decryptedReadBuffer, w->decryptedReadBufferSize);
+    queueEntry.decryptedBytesRead = decryptedBytesRead;
 
-        while (!bookBuilderGatewayToComponentQueue->push(queueEntry));  
+    while (!bookBuilderGatewayToComponentQueue->push(queueEntry));  
+#endif
     
-        memset(w->undecryptedReadBuffer, 0, w->undecryptedReadBufferSize);
-        memset(w->decryptedReadBuffer, 0, w->decryptedReadBufferSize);
-        // memset(w->ctrlBuf, 0, sizeof(w->ctrlBuf));     
+    memset(w->undecryptedReadBuffer, 0, w->undecryptedReadBufferSize);
+    memset(w->decryptedReadBuffer, 0, w->decryptedReadBufferSize);
+    // memset(w->ctrlBuf, 0, sizeof(w->ctrlBuf));     
+}
+
+// Instantiated for the backend of the shard, which is known to be of that type
+template <typename Backend>
+static void handleSocketEvent (EV_P_ ev_io *w_, int revents) {
+    // Cast the ev_io watcher pointer to our custom WebSocketClientEvContext structure
+    struct WebSocketClientEvContext *w = (struct WebSocketClientEvContext *) w_;
+
+  	if (revents & EV_READ)
+        readConnection(static_cast<Backend&>(*networkBackend), w->connectionIdx, high_resolution_clock::now());
+}
+
+// Takes over the TLS session of an established lws connection so that its market data is read through the network
+// backend
+static int attachConnection(int connectionIdx) {
+    ssls[connectionIdx] = lws_get_ssl(clientWsis[connectionIdx]);
+    rbios[connectionIdx] = BIO_new(BIO_s_mem());
+    SSL_set_bio(ssls[connectionIdx], rbios[connectionIdx], NULL);
+    sockfds[connectionIdx] = lws_get_socket_fd(clientWsis[connectionIdx]);
+    int timestamp_option = 1;
+    if (setsockopt(sockfds[connectionIdx], SOL_SOCKET, SO_TIMESTAMP, &timestamp_option, sizeof(timestamp_option)) < 0) {
+        perror("setsockopt SO_TIMESTAMP failed");
+        return -1;
+    }
+    return 0;
+}
+
+static void startConnection(int connectionIdx) {
+    interrupted[connectionIdx] = 0;
+    isTradeSubscriptionPending[connectionIdx] = false;
+    connectionStates[connectionIdx] = ConnectionState::Connecting;
+    connectionStateDeadlines[connectionIdx] = steady_clock::now() + milliseconds(CONNECT_TIMEOUT_IN_MILLISECONDS);
+    clientConnectInfo.pwsi = &clientWsis[connectionIdx];
+    clientConnectInfo.opaque_user_data = (void *)(intptr_t) connectionIdx;
+    if (!lws_client_connect_via_info(&clientConnectInfo))
+        scheduleReconnect(connectionIdx);
+}
+
+// Puts a reconnected socket into the socket slot of the connection it replaces and resumes reading from it
+static void completeReconnect(int connectionIdx) {
+    if (attachConnection(connectionIdx) < 0 || networkBackend->updateSocket(connectionIdx, sockfds[connectionIdx]) < 0) {
+        scheduleReconnect(connectionIdx);
+        return;
+    }
+
+    struct WebSocketClientEvContext *w = wsClientsEvContexts[connectionIdx];
+    w->sockfd = sockfds[connectionIdx];
+#ifdef USE_PERMESSAGE_DEFLATE
+    resetInflation(w, connectionIdx);
+#endif
+    ev_io_set(&w->socketWatcher, sockfds[connectionIdx], EV_READ);
+    if (!networkBackend->isBusyPolling())
+        ev_io_start(loopEv, &w->socketWatcher);
+
+    connectionStates[connectionIdx] = ConnectionState::Connected;
+    reconnectAttempts[connectionIdx] = 0;
+    numberOfUnhealthyConnections--;
+    printf("Connection %d reestablished\n", toPortfolioConnectionIdx(connectionIdx));
+}
+
+// Drives the reconnection state machine of the unhealthy connections. Only the resync queue is checked while every
+// connection is healthy, so the healthy connections keep flowing at full speed.
+static void serviceConnections() {
+    int portfolioConnectionIdx, connectionIdx;
+    while (bookBuilderComponentToGatewayResyncQueue->pop(portfolioConnectionIdx)) {
+        connectionIdx = portfolioConnectionIdx / numberOfShards;
+        if (connectionStates[connectionIdx] == ConnectionState::Connected) {
+            printf("Resubscribing connection %d to resynchronise its order book\n", portfolioConnectionIdx);
+            scheduleReconnect(connectionIdx);
+        }
+    }
+
+    if (numberOfUnhealthyConnections == 0)
+        return;
+
+    steady_clock::time_point now = steady_clock::now();
+    for (connectionIdx = 0; connectionIdx < numberOfShardConnections; connectionIdx++) {
+        switch (connectionStates[connectionIdx]) {
+            case ConnectionState::Disconnected:
+                if (now >= connectionStateDeadlines[connectionIdx])
+                    startConnection(connectionIdx);
+                break;
+            case ConnectionState::Connecting:
+                if (interrupted[connectionIdx] && clientWsis[connectionIdx])
+                    completeReconnect(connectionIdx);
+                else if (now >= connectionStateDeadlines[connectionIdx])
+                    scheduleReconnect(connectionIdx);
+                break;
+            default:
+                break;
+        }
     }
 }
 
@@ -241,54 +479,111 @@ timeout_cb (EV_P_ ev_timer *w, int revents)
   ev_break (EV_A_ EVBREAK_ONE);
 }
 
-void bookBuilderGateway(SPSCQueue<BookBuilderGatewayToComponentQueueEntry>& bookBuilderGatewayToComponentQueue_, std::vector<std::string> currencyPairs_, int orderManagerPipeEnd) {
+// Reads the market data of the shard until the process exits, compiled for the backend of the shard
+template <typename Backend>
+static void runGatewayLoop(Backend& backend) {
+    for (int connectionIdx = 0; connectionIdx < numberOfShardConnections; connectionIdx++) {
+        ev_io_init(&wsClientsEvContexts[connectionIdx]->socketWatcher, handleSocketEvent<Backend>, sockfds[connectionIdx], EV_READ);
+        if (connectionStates[connectionIdx] == ConnectionState::Connected && !Backend::busyPolling)
+            ev_io_start(loopEv, &wsClientsEvContexts[connectionIdx]->socketWatcher);
+    }
+
+    // initialise a timer watcher, then start it
+    // simple non-repeating 5.5 second timeout
+    ev_timer_init(&timeoutWatcher, timeout_cb, 600, 0.);
+    ev_timer_start(loopEv, &timeoutWatcher); 
+
+    while (true) {
+        // Busy polling skips the readiness notifications and tries every connected socket on each iteration
+        if constexpr (Backend::busyPolling) {
+            for (int connectionIdx = 0; connectionIdx < numberOfShardConnections; connectionIdx++)
+                if (connectionStates[connectionIdx] == ConnectionState::Connected)
+                    readConnection(backend, connectionIdx, high_resolution_clock::now());
+        }
+        ev_run(loopEv, EVRUN_NOWAIT);
+        serviceConnections();
+    }
+}
+
+// The first shard keeps the original placement, the others take the cores after the Order Manager's and share the
+// SQPOLL thread of the first shard. The pipelines of the other traded exchanges are laid out the same way further up.
+std::vector<BookBuilderGatewayShardPlacement> getDefaultGatewayShardPlacements(int numberOfShards, int exchangeIdx) {
+    std::vector<BookBuilderGatewayShardPlacement> placements;
+    int firstCpuCore = exchangeIdx * CPU_CORE_STRIDE_OF_TRADED_EXCHANGES;
+    placements.push_back({firstCpuCore + CPU_CORE_INDEX_FOR_BOOK_BUILDER_GATEWAY_THREAD, firstCpuCore + CPU_CORE_INDEX_FOR_SQ_POLL_THREAD});
+    for (int i = 1; i < numberOfShards; i++)
+        placements.push_back({firstCpuCore + CPU_CORE_INDEX_FOR_FIRST_EXTRA_GATEWAY_SHARD_THREAD + i - 1, -1});
+    return placements;
+}
+
+template <typename ExchangePolicy>
+void bookBuilderGateway(int shardIdx_, int numberOfShards_, BookBuilderGatewayShardPlacement placement, NetworkBackendType networkBackendType, SPSCQueue<BookBuilderGatewayToComponentQueueEntry>& bookBuilderGatewayToComponentQueue_, SPSCQueue<int>& bookBuilderComponentToGatewayResyncQueue_, std::vector<std::string> currencyPairs_, std::vector<FeedMode> feedModes_, std::vector<bool> tradeFeeds_, ExchangeEndpoint marketDataEndpoint_, int orderManagerPipeEnd) {
     int numCores = std::thread::hardware_concurrency();
     
     if (numCores == 0) {
         std::cerr << "Error: Unable to determine the number of CPU cores." << std::endl;
         return;
-    } else if (numCores < CPU_CORE_INDEX_FOR_BOOK_BUILDER_GATEWAY_THREAD) {
+    } else if (numCores < placement.gatewayCpuCore) {
         std::cerr << "Error: Not enough cores to run the system." << std::endl;
         return;
     }
 
-    int cpuCoreNumberForBookBuilderThread = CPU_CORE_INDEX_FOR_BOOK_BUILDER_GATEWAY_THREAD;
-    setThreadAffinity(pthread_self(), cpuCoreNumberForBookBuilderThread);
+    setThreadAffinity(pthread_self(), placement.gatewayCpuCore);
+
+    shardIdx = shardIdx_;
+    numberOfShards = numberOfShards_;
+    for (size_t portfolioConnectionIdx = shardIdx; portfolioConnectionIdx < currencyPairs_.size() && portfolioConnectionIdx < NUMBER_OF_CONNECTIONS; portfolioConnectionIdx += numberOfShards)
+    {
+        shardCurrencyPairs.push_back(currencyPairs_[portfolioConnectionIdx]);
+        shardFeedModes.push_back(feedModes_[portfolioConnectionIdx]);
+        shardTradeFeeds.push_back(tradeFeeds_[portfolioConnectionIdx]);
+    }
+    numberOfShardConnections = shardCurrencyPairs.size();
+    numberOfUnhealthyConnections = numberOfShardConnections;
+    printf("%s gateway shard %d handles %d connections on core %d\n", ExchangePolicy::name, shardIdx, numberOfShardConnections, placement.gatewayCpuCore);
 
     bookBuilderGatewayToComponentQueue = &bookBuilderGatewayToComponentQueue_;
+    bookBuilderComponentToGatewayResyncQueue = &bookBuilderComponentToGatewayResyncQueue_;
+
+    NetworkBackendOptions networkBackendOptions;
+    networkBackendOptions.type = networkBackendType;
+    if (networkBackendType == NetworkBackendType::IoUringSqPoll) {
+        if (placement.sqPollCpuCore >= 0) {
+            printf("Running %s gateway shard %d with submission queue polling on core %d\n", ExchangePolicy::name, shardIdx, placement.sqPollCpuCore);
+            networkBackendOptions.sqPollCpuCore = placement.sqPollCpuCore;
+        } else if (shardIdx != 0) {
+            int attachRingFd;
+            while ((attachRingFd = firstShardRingFd<ExchangePolicy>.load()) == -1)
+                std::this_thread::yield();
+            if (attachRingFd < 0) {
+                std::cerr << ExchangePolicy::name << " gateway shard " << shardIdx << " has no SQPOLL thread to attach to" << std::endl;
+                return;
+            }
+            printf("Running %s gateway shard %d with the submission queue polling thread of shard 0\n", ExchangePolicy::name, shardIdx);
+            networkBackendOptions.attachRingFd = attachRingFd;
+        }
+    }
 
-    struct io_uring_params params;
+    networkBackend = createNetworkBackend(networkBackendOptions);
+    if (!networkBackend) {
+        perror("Gateway network backend initialization failed");
+        if (shardIdx == 0)
+            firstShardRingFd<ExchangePolicy>.store(-2);
+        return;
+    }
+    printf("Running %s gateway shard %d with the %s network backend\n", ExchangePolicy::name, shardIdx, getNetworkBackendTypeName(networkBackendType));
 
-    // Initialize io_uring
-    // Use submission queue polling if user has root privileges
-    if (geteuid()) {
-        printf("You need root privileges to run the Order Manager with submission queue polling\n");
-        int ret = io_uring_queue_init(NUMBER_OF_IO_URING_SQ_ENTRIES, &ring, 0);
-        if (ret) {
-            perror("io_uring_queue_init");
-            return;
-        }
-    } else {
-        printf("Running the Order Manager with submission queue polling\n");
-        memset(&params, 0, sizeof(params));
-        params.flags |= IORING_SETUP_SQPOLL;
-        params.flags |= IORING_SETUP_SQ_AFF;
-        params.sq_thread_idle = 200000;
-        params.sq_thread_cpu = CPU_CORE_INDEX_FOR_SQ_POLL_THREAD;
-        int ret = io_uring_queue_init_params(NUMBER_OF_IO_URING_SQ_ENTRIES, &ring, &params);
-        
-        if (ret) {
-            perror("io_uring_queue_init");
-            return;
-        }
-    
-        int bookBuilderRingFd = ring.ring_fd;
+    if (shardIdx == 0) {
+        int bookBuilderRingFd = networkBackend->getSqPollRingFd();
+        firstShardRingFd<ExchangePolicy>.store(bookBuilderRingFd >= 0 ? bookBuilderRingFd : -2);
+        // The Order Manager waits for this before setting up its own backend, even when there is no ring to share
         if (write(orderManagerPipeEnd, &bookBuilderRingFd, sizeof(bookBuilderRingFd)) != sizeof(bookBuilderRingFd)) {
             perror("Pipe write error in Book Builder");
             return;
         }
 
-        printf("WEB SOCKET CLIENT RING FD: %d\n", bookBuilderRingFd);
+        if (bookBuilderRingFd >= 0)
+            printf("WEB SOCKET CLIENT RING FD: %d\n", bookBuilderRingFd);
     }
 	
 	const char *p;
@@ -297,7 +592,8 @@ void bookBuilderGateway(SPSCQueue<BookBuilderGatewayToComponentQueueEntry>& book
 	lws_set_log_level(logs, NULL);
 	lwsl_user("LWS Book Builder ws client rx [-d <logs>] [--h2] [-t (test)]\n");
 
-    loopEv = ev_default_loop(EVBACKEND_EPOLL);
+    // libev has a single default loop, it goes to the first shard of the first exchange
+    loopEv = shardIdx == 0 && getTradedExchangeIdx<ExchangePolicy>() == 0 ? ev_default_loop(EVBACKEND_EPOLL) : ev_loop_new(EVBACKEND_EPOLL);
     void *foreignLoops[1];
     foreignLoops[0] = loopEv;
 
@@ -306,67 +602,86 @@ void bookBuilderGateway(SPSCQueue<BookBuilderGatewayToComponentQueueEntry>& book
     info.foreign_loops = foreignLoops;
     info.options = LWS_SERVER_OPTION_DO_SSL_GLOBAL_INIT | LWS_WITH_LIBEV;
     info.port = CONTEXT_PORT_NO_LISTEN; 
-    info.fd_limit_per_thread = 1 + NUMBER_OF_CONNECTIONS;
-    info.protocols = protocols;
+    info.fd_limit_per_thread = 1 + numberOfShardConnections;
+    info.protocols = protocols<ExchangePolicy>;
+#ifdef USE_PERMESSAGE_DEFLATE
+    info.extensions = extensions;
+#endif
 
-    struct lws_context *context;
     context = lws_create_context(&info);
 	if (!context) {
 		lwsl_err("lws init failed\n");
 		return;
 	}
 
-    struct lws_client_connect_info i;
+    struct lws_client_connect_info &i = clientConnectInfo;
 	memset(&i, 0, sizeof i);
 	i.context = context;
-#if defined(USE_KRAKEN_MOCK_EXCHANGE) || defined(USE_BITMEX_MOCK_EXCHANGE)
-    i.port = 7681;
-    i.address = "146.169.41.107";
-    i.ssl_connection = LCCSCF_ALLOW_SELFSIGNED | LCCSCF_SKIP_SERVER_CERT_HOSTNAME_CHECK | LCCSCF_ALLOW_INSECURE | LWS_SERVER_OPTION_IGNORE_MISSING_CERT | LWS_SERVER_OPTION_PEER_CERT_NOT_REQUIRED;
-#elif defined(USE_KRAKEN_EXCHANGE)
-    i.port = 443;
-	i.address = "ws.kraken.com";
-    i.path = "/v2";
-#elif defined(USE_BITMEX_EXCHANGE)
-    i.port = 443;
-	i.address = "ws.bitmex.com";
-    i.path = "/realtime";
-#elif defined(USE_BITMEX_TESTNET_EXCHANGE)
-    i.port = 443;
-	i.address = "testnet.bitmex.com";
-    i.path = "/realtime";
-#endif
+    marketDataEndpoint = marketDataEndpoint_;
+    i.port = marketDataEndpoint.port;
+    i.address = marketDataEndpoint.address.c_str();
+    i.path = marketDataEndpoint.path.c_str();
+    if (ExchangePolicy::isMock)
+        i.ssl_connection = LCCSCF_ALLOW_SELFSIGNED | LCCSCF_SKIP_SERVER_CERT_HOSTNAME_CHECK | LCCSCF_ALLOW_INSECURE | LWS_SERVER_OPTION_IGNORE_MISSING_CERT | LWS_SERVER_OPTION_PEER_CERT_NOT_REQUIRED;
     i.ssl_connection = i.ssl_connection | LCCSCF_USE_SSL | LCCSCF_PRIORITIZE_READS;
 	i.host = i.address;
 	i.origin = i.address;
 	i.protocol = NULL; 
     
-    for (int m = 0; m < NUMBER_OF_CONNECTIONS; m++) {
-        i.pwsi = &clientWsis[m];
-        i.opaque_user_data = (void *)(intptr_t) m;
-        lws_client_connect_via_info(&i);
-
-        while (n >= 0 && clientWsis[m] && !interrupted[m]) {
-            n = lws_service(context, 0);
-        }
-        ssls[m] = lws_get_ssl(clientWsis[m]);
-        rbios[m] = BIO_new(BIO_s_mem());
-	    SSL_set_bio(ssls[m], rbios[m], NULL);
-        sockfds[m] = lws_get_socket_fd(clientWsis[m]);
-        int timestamp_option = 1;
-        if (setsockopt(sockfds[m], SOL_SOCKET, SO_TIMESTAMP, &timestamp_option, sizeof(timestamp_option)) < 0) {
-            perror("setsockopt SO_TIMESTAMP failed");
-            return;
+    // Every handshake is in flight at once and each connection is taken over as soon as its subscription is sent, so
+    // the shard is ready after roughly one round trip and one handshake instead of one per connection
+    steady_clock::time_point startupTimestamp = steady_clock::now();
+    std::vector<double> readyMilliseconds;
+    std::vector<bool> isStartupPending(numberOfShardConnections, true);
+    int numberOfStartupPendingConnections = numberOfShardConnections;
+    for (int m = 0; m < numberOfShardConnections; m++)
+        startConnection(m);
+
+    while (n >= 0 && numberOfStartupPendingConnections > 0) {
+        n = lws_service(context, 0);
+        steady_clock::time_point now = steady_clock::now();
+
+        for (int m = 0; m < numberOfShardConnections; m++) {
+            if (!isStartupPending[m])
+                continue;
+
+            // Connections that fail at startup are retried in the background like any other dead connection
+            if (connectionStates[m] != ConnectionState::Connecting) {
+                isStartupPending[m] = false;
+            } else if (interrupted[m] && clientWsis[m]) {
+                isStartupPending[m] = false;
+                if (attachConnection(m) < 0) {
+                    scheduleReconnect(m);
+                } else {
+                    connectionStates[m] = ConnectionState::Connected;
+                    numberOfUnhealthyConnections--;
+                    readyMilliseconds.push_back(duration_cast<microseconds>(now - startupTimestamp).count() / 1000.0);
+                }
+            } else if (now >= connectionStateDeadlines[m]) {
+                isStartupPending[m] = false;
+                scheduleReconnect(m);
+            }
+
+            if (!isStartupPending[m])
+                numberOfStartupPendingConnections--;
         }
     }
 
-    if (io_uring_register_files(&ring, sockfds, NUMBER_OF_CONNECTIONS) < 0) {
-        perror("io_uring_register_files failed");
+    std::sort(readyMilliseconds.begin(), readyMilliseconds.end());
+    printf("%s gateway shard %d startup: %zu of %d connections ready in %.3f ms", ExchangePolicy::name, shardIdx, readyMilliseconds.size(), numberOfShardConnections,
+           duration_cast<microseconds>(steady_clock::now() - startupTimestamp).count() / 1000.0);
+    if (!readyMilliseconds.empty())
+        printf(" (first %.3f ms, median %.3f ms, last %.3f ms)", readyMilliseconds.front(), readyMilliseconds[readyMilliseconds.size() / 2], readyMilliseconds.back());
+    printf("\n");
+
+    if (networkBackend->registerSockets(sockfds, numberOfShardConnections) < 0) {
+        perror("Gateway socket registration failed");
         return;
     }
+    areSocketsRegistered = true;
 
 	
-    for (int connectionIdx = 0; connectionIdx < NUMBER_OF_CONNECTIONS; connectionIdx++) {
+    for (int connectionIdx = 0; connectionIdx < numberOfShardConnections; connectionIdx++) {
         wsClientsEvContexts[connectionIdx] = new WebSocketClientEvContext();
         wsClientsEvContexts[connectionIdx]->sockfd = sockfds[connectionIdx];
         wsClientsEvContexts[connectionIdx]->connectionIdx = connectionIdx;
@@ -378,21 +693,14 @@ void bookBuilderGateway(SPSCQueue<BookBuilderGatewayToComponentQueueEntry>& book
         wsClientsEvContexts[connectionIdx]->msg.msg_controllen = sizeof(wsClientsEvContexts[connectionIdx]->ctrlBuf);
         wsClientsEvContexts[connectionIdx]->msg.msg_iov = wsClientsEvContexts[connectionIdx]->iov;
         wsClientsEvContexts[connectionIdx]->msg.msg_iovlen = 1;
-
-        ev_io_init(&wsClientsEvContexts[connectionIdx]->socketWatcher, handleSocketEvent, sockfds[connectionIdx], EV_READ);
-
-        ev_io_start(loopEv, &wsClientsEvContexts[connectionIdx]->socketWatcher);
+#ifdef USE_PERMESSAGE_DEFLATE
+        resetInflation(wsClientsEvContexts[connectionIdx], connectionIdx);
+#endif
     }
-    
-    // initialise a timer watcher, then start it
-    // simple non-repeating 5.5 second timeout
-    ev_timer_init(&timeoutWatcher, timeout_cb, 600, 0.);
-    ev_timer_start(loopEv, &timeoutWatcher); 
 
-    while (true) {
-        ev_run(loopEv, EVRUN_NOWAIT);
-    }
+    dispatchNetworkBackend(*networkBackend, [](auto& backend) { runGatewayLoop(backend); });
 
 	lws_context_destroy(context);
-    close(orderManagerPipeEnd);    
+    if (shardIdx == 0)
+        close(orderManagerPipeEnd);    
 }
\ No newline at end of file
@@ -0,0 +1,176 @@
+// WebSocketInflater.cpp
+
+#include <algorithm>
+#include <cstring>
+#include "WebSocketInflater.hpp"
+
+// permessage-deflate strips the empty stored block that ends every flushed message, it has to be fed back in
+static const unsigned char DEFLATE_MESSAGE_TRAILER[4] = {0x00, 0x00, 0xff, 0xff};
+
+WebSocketInflater::WebSocketInflater() {
+    memset(&stream, 0, sizeof(stream));
+    inflateInit2(&stream, -MAX_WBITS);
+    reset(false);
+}
+
+WebSocketInflater::~WebSocketInflater() {
+    inflateEnd(&stream);
+}
+
+void WebSocketInflater::reset(bool noContextTakeover) {
+    inflateReset(&stream);
+    stream.next_in = nullptr;
+    stream.avail_in = 0;
+    this->noContextTakeover = noContextTakeover;
+    inflateOutputPending = false;
+    trailerPending = false;
+    messageEndPending = false;
+    messageComplete = false;
+    frameHeaderLength = 0;
+    frameHeaderComplete = false;
+    framePayloadRemaining = 0;
+    frameOpcode = 0;
+    frameFinal = false;
+    messageCompressed = false;
+    input = nullptr;
+    inputLength = 0;
+}
+
+void WebSocketInflater::setInput(const char* buffer, size_t length) {
+    input = reinterpret_cast<const unsigned char*>(buffer);
+    inputLength = length;
+}
+
+size_t WebSocketInflater::requiredFrameHeaderLength() const {
+    if (frameHeaderLength < 2)
+        return 2;
+
+    size_t length = 2;
+    uint8_t shortPayloadLength = frameHeader[1] & 0x7F;
+    if (shortPayloadLength == 126)
+        length += 2;
+    else if (shortPayloadLength == 127)
+        length += 8;
+    if (frameHeader[1] & 0x80)
+        length += 4;
+    return length;
+}
+
+int WebSocketInflater::parseFrameHeader() {
+    // Servers never mask their frames
+    if (frameHeader[1] & 0x80)
+        return -1;
+
+    frameFinal = frameHeader[0] & 0x80;
+    frameOpcode = frameHeader[0] & 0x0F;
+    // RSV1 is only meaningful on the first frame of a data message
+    if (frameOpcode != WEBSOCKET_OPCODE_CONTINUATION && frameOpcode < WEBSOCKET_OPCODE_CLOSE)
+        messageCompressed = frameHeader[0] & 0x40;
+
+    uint64_t payloadLength = frameHeader[1] & 0x7F;
+    if (payloadLength == 126) {
+        payloadLength = ((uint64_t)frameHeader[2] << 8) | frameHeader[3];
+    } else if (payloadLength == 127) {
+        payloadLength = 0;
+        for (int i = 2; i < 10; i++)
+            payloadLength = (payloadLength << 8) | frameHeader[i];
+    }
+
+    framePayloadRemaining = payloadLength;
+    frameHeaderComplete = true;
+    return 0;
+}
+
+int WebSocketInflater::completeFrame() {
+    frameHeaderComplete = false;
+    frameHeaderLength = 0;
+
+    if (frameOpcode == WEBSOCKET_OPCODE_CLOSE)
+        return -1;
+
+    // A compressed message only ends once its trailer is inflated
+    if (frameOpcode < WEBSOCKET_OPCODE_CLOSE && frameFinal) {
+        if (messageCompressed)
+            trailerPending = true;
+        else
+            messageEndPending = true;
+    }
+    return 0;
+}
+
+int WebSocketInflater::decode(char* output, size_t outputCapacity) {
+    size_t outputLength = 0;
+    messageComplete = false;
+
+    while (outputLength < outputCapacity) {
+        // Whatever was handed to zlib is inflated before the next frame is looked at
+        if (stream.avail_in > 0 || inflateOutputPending) {
+            stream.next_out = reinterpret_cast<Bytef*>(output + outputLength);
+            stream.avail_out = outputCapacity - outputLength;
+            int ret = inflate(&stream, Z_SYNC_FLUSH);
+            if (ret != Z_OK && ret != Z_BUF_ERROR && ret != Z_STREAM_END)
+                return -1;
+            if (ret == Z_STREAM_END)
+                inflateReset(&stream);
+            outputLength = outputCapacity - stream.avail_out;
+            inflateOutputPending = stream.avail_out == 0;
+            continue;
+        }
+
+        if (trailerPending) {
+            trailerPending = false;
+            messageEndPending = true;
+            stream.next_in = const_cast<Bytef*>(DEFLATE_MESSAGE_TRAILER);
+            stream.avail_in = sizeof(DEFLATE_MESSAGE_TRAILER);
+            continue;
+        }
+
+        if (messageEndPending) {
+            messageEndPending = false;
+            if (noContextTakeover && messageCompressed)
+                inflateReset(&stream);
+            messageComplete = true;
+            break;
+        }
+
+        if (!frameHeaderComplete) {
+            if (inputLength == 0)
+                break;
+            // The header length is only known once its first two bytes are in
+            while (inputLength > 0 && frameHeaderLength < requiredFrameHeaderLength()) {
+                frameHeader[frameHeaderLength++] = *input++;
+                inputLength--;
+            }
+            if (frameHeaderLength < requiredFrameHeaderLength())
+                break;
+            if (parseFrameHeader() < 0)
+                return -1;
+            if (framePayloadRemaining == 0 && completeFrame() < 0)
+                return -1;
+            continue;
+        }
+
+        if (inputLength == 0)
+            break;
+
+        size_t payloadChunkLength = std::min<uint64_t>(framePayloadRemaining, inputLength);
+        if (frameOpcode >= WEBSOCKET_OPCODE_CLOSE) {
+            // Control frame payloads (ping, pong, close reason) are not market data
+        } else if (messageCompressed) {
+            stream.next_in = const_cast<Bytef*>(input);
+            stream.avail_in = payloadChunkLength;
+        } else {
+            payloadChunkLength = std::min(payloadChunkLength, outputCapacity - outputLength);
+            memcpy(output + outputLength, input, payloadChunkLength);
+            outputLength += payloadChunkLength;
+        }
+        input += payloadChunkLength;
+        inputLength -= payloadChunkLength;
+        framePayloadRemaining -= payloadChunkLength;
+
+        if (framePayloadRemaining == 0 && completeFrame() < 0)
+            return -1;
+    }
+
+    return outputLength;
+}
@@ -0,0 +1,64 @@
+// WebSocketInflater.hpp
+
+#ifndef WEBSOCKET_INFLATER_HPP
+#define WEBSOCKET_INFLATER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <zlib.h>
+
+#define WEBSOCKET_MAX_FRAME_HEADER_SIZE 14
+#define WEBSOCKET_OPCODE_CONTINUATION 0x0
+#define WEBSOCKET_OPCODE_CLOSE 0x8
+
+// Decodes the websocket frames read from a hijacked connection into the payloads of its data frames. Messages
+// compressed with permessage-deflate (RSV1 set on their first frame) are inflated on the fly with a raw deflate
+// stream that is kept across messages unless the server negotiated server_no_context_takeover. Frames and deflate
+// blocks may be split arbitrarily across reads.
+class WebSocketInflater {
+private:
+    z_stream stream;
+    bool noContextTakeover;
+    bool inflateOutputPending;
+    bool trailerPending;
+    bool messageEndPending;
+    bool messageComplete;
+
+    unsigned char frameHeader[WEBSOCKET_MAX_FRAME_HEADER_SIZE];
+    size_t frameHeaderLength;
+    bool frameHeaderComplete;
+    uint64_t framePayloadRemaining;
+    uint8_t frameOpcode;
+    bool frameFinal;
+    bool messageCompressed;
+
+    const unsigned char* input;
+    size_t inputLength;
+
+    size_t requiredFrameHeaderLength() const;
+    int parseFrameHeader();
+    int completeFrame();
+
+public:
+    WebSocketInflater();
+    ~WebSocketInflater();
+    WebSocketInflater(const WebSocketInflater&) = delete;
+    WebSocketInflater& operator=(const WebSocketInflater&) = delete;
+
+    // Forgets any partial frame and the compression context, e.g. after a reconnection
+    void reset(bool noContextTakeover);
+
+    // The buffer must stay untouched until decode() has returned 0 for it
+    void setInput(const char* buffer, size_t length);
+
+    // Writes the payloads of the data frames found in the input, inflated when compressed, to the output buffer.
+    // Returns the number of bytes written, 0 once the input is exhausted, or -1 on a close frame, a protocol error
+    // or corrupt deflate data. It stops at the end of every data message, so that the caller knows where messages
+    // end in its output. Call it again while it returns a full buffer or a complete message.
+    int decode(char* output, size_t outputCapacity);
+
+    // Whether the last call to decode() stopped at the end of a data message, all of it written out
+    bool isMessageComplete() const { return messageComplete; }
+};
+
+#endif // WEBSOCKET_INFLATER_HPP
@@ -0,0 +1,230 @@
+// ExchangePolicies.hpp
+#ifndef EXCHANGE_POLICIES_HPP
+#define EXCHANGE_POLICIES_HPP
+
+#include <cstddef>
+#include <string>
+#include <tuple>
+#include <type_traits>
+
+// What differs from one venue to the next lives in a policy, a struct of compile-time constants and static functions.
+// Components take what they need from the policy of the traded exchange, so that everything is resolved at compile
+// time and a new venue is one more policy rather than one more branch in each component.
+
+// Wire protocol of the exchange, for the code paths whose shape differs and not only their constants
+enum class ExchangeApi {
+    Kraken,
+    Bitmex
+};
+
+constexpr bool areSymbolsEqual(const char* lhs, const char* rhs) {
+    while (*lhs && *lhs == *rhs) {
+        lhs++;
+        rhs++;
+    }
+    return *lhs == *rhs;
+}
+
+struct KrakenExchangePolicy {
+    static constexpr ExchangeApi api = ExchangeApi::Kraken;
+    static constexpr const char* name = "Kraken";
+    static constexpr bool isMock = false;
+
+    // Symbols of the pairs, "BTC/USD"
+    static constexpr char symbolSeparator = '/';
+    static constexpr const char* getCanonicalCurrency(const char* currency) {
+        return currency;
+    }
+
+    // Market data
+    static constexpr const char* marketDataAddress = "ws.kraken.com";
+    static constexpr int marketDataPort = 443;
+    static constexpr const char* marketDataPath = "/v2";
+    static constexpr const char* marketDataServerName = "ws.kraken.com";
+    static constexpr const char* jsonStartPattern = "{\"channel\":\"book\"";
+    static constexpr const char* topOfBookJsonStartPattern = "{\"channel\":\"ticker\"";
+    static constexpr const char* topOfBookBidPriceKey = "\"bid\":";
+    static constexpr const char* topOfBookBidSizeKey = "\"bid_qty\":";
+    static constexpr const char* topOfBookAskPriceKey = "\"ask\":";
+    static constexpr const char* topOfBookAskSizeKey = "\"ask_qty\":";
+    static constexpr const char* tradeJsonStartPattern = "{\"channel\":\"trade\"";
+    static constexpr const char* tradeSnapshotPattern = "\"type\":\"snapshot\"";
+    static constexpr const char* tradeSizeKey = "\"qty\":";
+    // Price levels kept on each side of a book, the depth of the subscription as updates do not remove the levels
+    // that fall out of it
+    static constexpr size_t maxBookDepth = 10;
+
+    // Order entry
+    static constexpr const char* orderEntryAddress = "104.17.186.205";
+    static constexpr int orderEntryPort = 443;
+    static constexpr const char* orderEntryServerName = "api.kraken.com";
+    static constexpr const char* restApiHostName = "api.kraken.com";
+    static constexpr const char* addOrderUri = "/0/private/AddOrder";
+    static constexpr const char* apiKey = "lKfIwMQfaY32k3Wk90+Ia2CRgvw3IjsFQIUPIJmRU+wShkZc0BqAZuCW";
+    static constexpr const char* apiSecret = "DC9Na40OX2gf8a1bwbSvCwTKnadc1XcuBnWIkwLBRqbD5xMGEDNQTqoOrAwCAotFqppDQuedI6+/cI3S+5FJdg==";
+    static constexpr const char* buyOrder = "buy";
+    static constexpr const char* sellOrder = "sell";
+    static constexpr const char* orderBodyPrefixFormat = "pair=%s&type=%s&volume=";
+    static constexpr const char* orderBodySuffix = "&ordertype=market";
+
+    // Top-of-book connections subscribe to the BBO channel of the exchange instead of the depth book
+    static std::string getSubscriptionMessage(const std::string& currencyPair, bool topOfBook, bool trades) {
+        if (topOfBook)
+            return "{\"method\":\"subscribe\",\"params\":{\"channel\":\"ticker\",\"event_trigger\":\"bbo\",\"snapshot\":true,\"symbol\":[\"" +
+                   currencyPair + "\"]},\"req_id\":1234567890}";
+        return "{\"method\":\"subscribe\",\"params\":{\"channel\":\"book\",\"depth\":" + std::to_string(maxBookDepth) +
+               ",\"snapshot\":true,\"symbol\":[\"" + currencyPair + "\"]},\"req_id\":1234567890}";
+    }
+
+    // The trade channel needs a subscription of its own, empty when trades are not followed
+    static std::string getTradeSubscriptionMessage(const std::string& currencyPair, bool trades) {
+        if (!trades)
+            return "";
+        return "{\"method\":\"subscribe\",\"params\":{\"channel\":\"trade\",\"snapshot\":false,\"symbol\":[\"" +
+               currencyPair + "\"]},\"req_id\":1234567891}";
+    }
+};
+
+struct BitmexExchangePolicy {
+    static constexpr ExchangeApi api = ExchangeApi::Bitmex;
+    static constexpr const char* name = "BitMEX";
+    static constexpr bool isMock = false;
+
+    // Symbols of the pairs, "XBTUSDT", with bitcoin named XBT where the other exchanges name it BTC
+    static constexpr char symbolSeparator = '\0';
+    static constexpr const char* getCanonicalCurrency(const char* currency) {
+        return areSymbolsEqual(currency, "XBT") ? "BTC" : currency;
+    }
+
+    // Market data
+    static constexpr const char* marketDataAddress = "ws.bitmex.com";
+    static constexpr int marketDataPort = 443;
+    static constexpr const char* marketDataPath = "/realtime";
+    static constexpr const char* marketDataServerName = "ws.bitmex.com";
+    static constexpr const char* jsonStartPattern = "{\"table\"";
+    static constexpr const char* topOfBookJsonStartPattern = "{\"table\":\"quote\"";
+    static constexpr const char* topOfBookBidPriceKey = "\"bidPrice\":";
+    static constexpr const char* topOfBookBidSizeKey = "\"bidSize\":";
+    static constexpr const char* topOfBookAskPriceKey = "\"askPrice\":";
+    static constexpr const char* topOfBookAskSizeKey = "\"askSize\":";
+    static constexpr const char* tradeJsonStartPattern = "{\"table\":\"trade\"";
+    static constexpr const char* tradeSnapshotPattern = "\"action\":\"partial\"";
+    static constexpr const char* tradeSizeKey = "\"size\":";
+    // The orderBookL2_25 table deletes the levels that fall out of it, so books are never trimmed
+    static constexpr size_t maxBookDepth = 0;
+
+    // Order entry
+    static constexpr const char* orderEntryAddress = "18.165.242.94";
+    static constexpr int orderEntryPort = 443;
+    static constexpr const char* orderEntryServerName = "bitmex.com";
+    static constexpr const char* restApiHostName = "bitmex.com";
+    static constexpr const char* addOrderUri = "/api/v1/order";
+    static constexpr const char* apiKey = "63ObNQpYqaCVrjTuBbhgFm2p";
+    static constexpr const char* apiSecret = "D2OBzpfW-i6FfgmqGnrhpYqKPrxCvIYnu5KZKsZQW_09XkF-";
+    static constexpr const char* buyOrder = "Buy";
+    static constexpr const char* sellOrder = "Sell";
+    static constexpr const char* orderBodyPrefixFormat = "symbol=%s&side=%s&orderQty=";
+    static constexpr const char* orderBodySuffix = "&ordType=Market";
+
+    // The trade table of the pair, when enabled, is subscribed to in the same message as its book
+    static std::string getSubscriptionMessage(const std::string& currencyPair, bool topOfBook, bool trades) {
+        return "{\"op\":\"subscribe\",\"args\":[\"" + std::string(topOfBook ? "quote:" : "orderBookL2_25:") + currencyPair + "\"" +
+               (trades ? ",\"trade:" + currencyPair + "\"" : "") + "]}";
+    }
+
+    // Trades come with the book subscription
+    static std::string getTradeSubscriptionMessage(const std::string& currencyPair, bool trades) {
+        return "";
+    }
+};
+
+struct BitmexTestnetExchangePolicy : BitmexExchangePolicy {
+    static constexpr const char* name = "BitMEX Testnet";
+    static constexpr const char* marketDataAddress = "testnet.bitmex.com";
+    static constexpr const char* marketDataServerName = "testnet.bitmex.com";
+    static constexpr const char* orderEntryAddress = "104.18.32.75";
+    static constexpr const char* orderEntryServerName = "testnet.bitmex.com";
+    static constexpr const char* restApiHostName = "testnet.bitmex.com";
+};
+
+// The local mock exchange speaks the protocol of the exchange it mimics, over self-signed TLS on the loopback. Each
+// protocol has ports of its own so that a Kraken and a BitMEX mock can run side by side.
+template <typename ExchangePolicy>
+struct MockExchangePolicy : ExchangePolicy {
+    static constexpr bool isMock = true;
+    static constexpr const char* marketDataAddress = "127.0.0.1";
+    static constexpr int marketDataPort = ExchangePolicy::api == ExchangeApi::Kraken ? 7681 : 7682;
+    static constexpr const char* marketDataPath = "/";
+    static constexpr const char* marketDataServerName = "";
+    static constexpr const char* orderEntryAddress = "127.0.0.1";
+    static constexpr int orderEntryPort = ExchangePolicy::api == ExchangeApi::Kraken ? 12345 : 12346;
+    static constexpr const char* orderEntryServerName = "";
+};
+
+// Every policy the components are compiled for, for the explicit instantiations of the translation units
+#define FOR_EACH_EXCHANGE_POLICY(MACRO) \
+    MACRO(KrakenExchangePolicy) \
+    MACRO(BitmexExchangePolicy) \
+    MACRO(BitmexTestnetExchangePolicy) \
+    MACRO(MockExchangePolicy<KrakenExchangePolicy>) \
+    MACRO(MockExchangePolicy<BitmexExchangePolicy>)
+
+#define MAX_NUMBER_OF_TRADED_EXCHANGES 4
+
+// Each traded exchange runs a pipeline of its own (gateways, Book Builder and Order Manager) on the cores of the
+// first exchange shifted by this many per exchange, while the Strategy searches the combined graph of all of them
+#define CPU_CORE_STRIDE_OF_TRADED_EXCHANGES 8
+
+// Index of an exchange in a tuple of policies, which is also the index the portfolio tables give to its pairs, -1 when
+// it is not in the list
+template <typename ExchangePolicy, typename ExchangePolicies, size_t I = 0>
+constexpr int getExchangeIdx() {
+    if constexpr (I == std::tuple_size<ExchangePolicies>::value)
+        return -1;
+    else if constexpr (std::is_same<ExchangePolicy, std::tuple_element_t<I, ExchangePolicies>>::value)
+        return I;
+    else
+        return getExchangeIdx<ExchangePolicy, ExchangePolicies, I + 1>();
+}
+
+// The only place the build options of the exchange are looked at
+#if defined(USE_KRAKEN_AND_BITMEX_MOCK_EXCHANGES)
+    #define HAS_TRADED_EXCHANGE
+    using TradedExchanges = std::tuple<MockExchangePolicy<KrakenExchangePolicy>, MockExchangePolicy<BitmexExchangePolicy>>;
+#elif defined(USE_KRAKEN_AND_BITMEX_EXCHANGES)
+    #define HAS_TRADED_EXCHANGE
+    using TradedExchanges = std::tuple<KrakenExchangePolicy, BitmexExchangePolicy>;
+#elif defined(USE_KRAKEN_MOCK_EXCHANGE)
+    #define HAS_TRADED_EXCHANGE
+    using TradedExchanges = std::tuple<MockExchangePolicy<KrakenExchangePolicy>>;
+#elif defined(USE_BITMEX_MOCK_EXCHANGE)
+    #define HAS_TRADED_EXCHANGE
+    using TradedExchanges = std::tuple<MockExchangePolicy<BitmexExchangePolicy>>;
+#elif defined(USE_KRAKEN_EXCHANGE)
+    #define HAS_TRADED_EXCHANGE
+    using TradedExchanges = std::tuple<KrakenExchangePolicy>;
+#elif defined(USE_BITMEX_EXCHANGE)
+    #define HAS_TRADED_EXCHANGE
+    using TradedExchanges = std::tuple<BitmexExchangePolicy>;
+#elif defined(USE_BITMEX_TESTNET_EXCHANGE)
+    #define HAS_TRADED_EXCHANGE
+    using TradedExchanges = std::tuple<BitmexTestnetExchangePolicy>;
+#endif
+
+#ifdef HAS_TRADED_EXCHANGE
+static constexpr size_t numberOfTradedExchanges = std::tuple_size<TradedExchanges>::value;
+static_assert(numberOfTradedExchanges <= MAX_NUMBER_OF_TRADED_EXCHANGES, "too many traded exchanges");
+
+template <typename ExchangePolicy>
+constexpr int getTradedExchangeIdx() {
+    return getExchangeIdx<ExchangePolicy, TradedExchanges>();
+}
+
+// Calls function(ExchangePolicy{}) for each traded exchange in order, unrolled at compile time
+template <typename Function>
+void forEachTradedExchange(Function&& function) {
+    std::apply([&](auto... exchangePolicies) { (function(exchangePolicies), ...); }, TradedExchanges{});
+}
+#endif
+
+#endif // EXCHANGE_POLICIES_HPP
@@ -0,0 +1,924 @@
+// MockExchange.cpp
+//
+// Local stand-in for Kraken and BitMEX so that the system can run end to end on an isolated box. It serves TLS
+// websockets that stream the book of the pair each connection subscribes to, in the format of the selected exchange
+// (depth book or BBO channel, following the subscription, plus the trade channel when subscribed to as well),
+// either synthesised or replayed from a recording, and a TLS REST API that accepts AddOrder (Kraken) and
+// /api/v1/order (BitMEX) requests and answers them after a configurable latency. Build the system with
+// USE_KRAKEN_MOCK_EXCHANGE or USE_BITMEX_MOCK_EXCHANGE and point it at this process with --market-data-endpoint and
+// --order-entry-endpoint, it connects to 127.0.0.1 on the default ports otherwise. Each exchange has default ports of
+// its own, so that a Kraken and a BitMEX mock can serve a USE_KRAKEN_AND_BITMEX_MOCK_EXCHANGES build side by side.
+//
+// Usage: ./mock_exchange [--exchange kraken|bitmex] [--bind address] [--market-data-port port]
+//                        [--order-entry-port port] [--rate updates per second per pair] [--depth levels]
+//                        [--replay file] [--order-latency-us microseconds] [--cert file --key file]
+//
+// A replay file holds one websocket message per line as captured from the exchange, after the time it was received at
+// when the Book Builder recorded it. Every connection loops over the lines that mention the symbol and the channels it
+// subscribed to, snapshots included.
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/sha.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../Utils/Utils.hpp"
+#include "../Exchanges/ExchangePolicies.hpp"
+
+#define DEFAULT_UPDATES_PER_SECOND 10
+#define DEFAULT_BOOK_DEPTH 10
+#define MOCK_EXCHANGE_RX_BUFFER_SIZE 16384
+#define MAX_HTTP_REQUEST_SIZE 65536
+#define TLS_HANDSHAKE_TIMEOUT_IN_MILLISECONDS 5000
+#define IDLE_POLL_PERIOD_IN_MILLISECONDS 1000
+#define MAX_SPREAD_IN_TICKS 10
+#define WEBSOCKET_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC11B85"
+#define WEBSOCKET_OPCODE_TEXT 0x1
+#define WEBSOCKET_OPCODE_CLOSE 0x8
+#define WEBSOCKET_OPCODE_PING 0x9
+#define WEBSOCKET_OPCODE_PONG 0xA
+
+using namespace std::chrono;
+
+enum class ExchangeFormat { Kraken, Bitmex };
+
+struct MockExchangeConfig {
+    ExchangeFormat format = ExchangeFormat::Kraken;
+    std::string bindAddress = "0.0.0.0";
+    int marketDataPort = 0;  // The port the system connects to for the exchange unless given
+    int orderEntryPort = 0;
+    double updatesPerSecond = DEFAULT_UPDATES_PER_SECOND;
+    int depth = DEFAULT_BOOK_DEPTH;
+    long orderLatencyMicroseconds = 0;
+    std::string replayFile;
+    std::string certFile;
+    std::string keyFile;
+};
+
+struct TlsConnection {
+    int fd;
+    SSL *ssl;
+};
+
+static MockExchangeConfig config;
+static std::vector<std::string> replayMessages;
+static SSL_CTX *sslContext;
+static std::atomic<uint64_t> nextConnectionId{0};
+static std::atomic<uint64_t> nextOrderId{1};
+
+// Rough USD values that keep the synthetic cross rates consistent, so that arbitrage only shows up through the noise
+static const std::map<std::string, double> referenceUsdPrices = {
+    {"USD", 1.0}, {"USDT", 1.0}, {"USDC", 1.0}, {"EUR", 1.08}, {"GBP", 1.27}, {"CHF", 1.12}, {"CAD", 0.73},
+    {"AUD", 0.66}, {"JPY", 0.0064}, {"BTC", 64000.0}, {"XBT", 64000.0}, {"ETH", 3100.0}, {"SOL", 145.0},
+    {"LTC", 80.0}, {"DOT", 7.0}, {"KSM", 30.0}, {"LINK", 14.0}, {"ADA", 0.45}, {"ATOM", 8.0}, {"XRP", 0.5},
+    {"BCH", 450.0}, {"ALGO", 0.18},
+};
+
+static double getReferencePrice(const std::string& symbol) {
+    size_t slashPos = symbol.find('/');
+    if (slashPos != std::string::npos) {
+        auto base = referenceUsdPrices.find(symbol.substr(0, slashPos));
+        auto quote = referenceUsdPrices.find(symbol.substr(slashPos + 1));
+        if (base != referenceUsdPrices.end() && quote != referenceUsdPrices.end())
+            return base->second / quote->second;
+        return 1.0;
+    }
+
+    // BitMEX symbols have no separator, e.g. XBTUSDT
+    for (size_t baseLength = 3; baseLength <= 4 && baseLength < symbol.size(); baseLength++) {
+        auto base = referenceUsdPrices.find(symbol.substr(0, baseLength));
+        auto quote = referenceUsdPrices.find(symbol.substr(baseLength));
+        if (base != referenceUsdPrices.end() && quote != referenceUsdPrices.end())
+            return base->second / quote->second;
+    }
+    return 1.0;
+}
+
+// Keeps a book of config.depth levels per side around a random walk and emits the changes in the exchange's format
+class SyntheticBook {
+private:
+    std::string symbol;
+    int priceDecimals;
+    double tickSize;
+    std::map<long long, double, std::greater<long long>> bids;
+    std::map<long long, double> asks;
+    std::mt19937_64 rng;
+    uint64_t nextTradeId = 1;
+
+    double randomQty() {
+        if (config.format == ExchangeFormat::Bitmex)
+            return (double)(100 * (1 + rng() % 5000));
+        return std::uniform_real_distribution<double>(0.001, 25.0)(rng);
+    }
+
+    void appendLevel(std::string& out, long long tick, double qty, bool isBid, const char* action, const std::string& timestamp) {
+        char level[256];
+        if (config.format == ExchangeFormat::Kraken) {
+            snprintf(level, sizeof(level), "{\"price\":%.*f,\"qty\":%.8f}", priceDecimals, tick * tickSize, qty);
+        } else if (action[0] == 'd') {
+            snprintf(level, sizeof(level), "{\"symbol\":\"%s\",\"id\":%lld,\"side\":\"%s\",\"price\":%.*f,\"timestamp\":\"%s\"}",
+                     symbol.c_str(), (1LL << 40) - tick, isBid ? "Buy" : "Sell", priceDecimals, tick * tickSize, timestamp.c_str());
+        } else {
+            snprintf(level, sizeof(level), "{\"symbol\":\"%s\",\"id\":%lld,\"side\":\"%s\",\"size\":%lld,\"price\":%.*f,\"timestamp\":\"%s\"}",
+                     symbol.c_str(), (1LL << 40) - tick, isBid ? "Buy" : "Sell", (long long)qty, priceDecimals, tick * tickSize, timestamp.c_str());
+        }
+        if (out.back() != '[')
+            out += ",";
+        out += level;
+    }
+
+    std::string formatKrakenMessage(const char* type, const std::vector<std::pair<long long, double>>& bidChanges,
+                                     const std::vector<std::pair<long long, double>>& askChanges, const std::string& timestamp) {
+        std::string message = std::string("{\"channel\":\"book\",\"type\":\"") + type + "\",\"data\":[{\"symbol\":\"" + symbol + "\",\"bids\":[";
+        for (const auto& change : bidChanges)
+            appendLevel(message, change.first, change.second, true, type, timestamp);
+        message += "],\"asks\":[";
+        for (const auto& change : askChanges)
+            appendLevel(message, change.first, change.second, false, type, timestamp);
+        // Only used by the Book Builder to spot repeated messages, not Kraken's CRC32 of the top of the book
+        message += "],\"checksum\":" + std::to_string(rng() & 0xFFFFFFFF);
+        if (type[0] == 'u')
+            message += ",\"timestamp\":\"" + timestamp + "\"";
+        message += "}]}";
+        return message;
+    }
+
+    std::string formatBitmexMessage(const char* action, const std::vector<std::pair<long long, double>>& bidChanges,
+                                     const std::vector<std::pair<long long, double>>& askChanges, const std::string& timestamp) {
+        std::string message = std::string("{\"table\":\"orderBookL2_25\",\"action\":\"") + action + "\"";
+        if (action[0] == 'p')
+            message += ",\"keys\":[\"symbol\",\"id\",\"side\"]";
+        message += ",\"data\":[";
+        for (const auto& change : askChanges)
+            appendLevel(message, change.first, change.second, false, action, timestamp);
+        for (const auto& change : bidChanges)
+            appendLevel(message, change.first, change.second, true, action, timestamp);
+        message += "]}";
+        return message;
+    }
+
+    // BitMEX needs one message per action, Kraken sends all changes of an update at once with a zero qty for removals
+    void emitChanges(std::vector<std::string>& messages, const std::vector<std::pair<long long, double>>& bidChanges,
+                     const std::vector<std::pair<long long, double>>& askChanges, const char* bitmexAction) {
+        std::string timestamp = getCurrentTimestamp();
+        if (config.format == ExchangeFormat::Kraken)
+            messages.push_back(formatKrakenMessage("update", bidChanges, askChanges, timestamp));
+        else
+            messages.push_back(formatBitmexMessage(bitmexAction, bidChanges, askChanges, timestamp));
+    }
+
+public:
+    SyntheticBook(const std::string& symbol, uint64_t seed) : symbol(symbol), rng(seed) {
+        double referencePrice = getReferencePrice(symbol);
+        priceDecimals = std::max(0, std::min(10, (int)std::ceil(4 - std::log10(referencePrice))));
+        tickSize = std::pow(10.0, -priceDecimals);
+
+        long long midTick = std::llround(referencePrice / tickSize * std::uniform_real_distribution<double>(0.999, 1.001)(rng));
+        for (int i = 0; i < config.depth; i++) {
+            bids[midTick - 1 - i] = randomQty();
+            asks[midTick + 1 + i] = randomQty();
+        }
+    }
+
+    std::string snapshot() {
+        std::vector<std::pair<long long, double>> bidLevels(bids.begin(), bids.end());
+        std::vector<std::pair<long long, double>> askLevels(asks.begin(), asks.end());
+        std::string timestamp = getCurrentTimestamp();
+        if (config.format == ExchangeFormat::Kraken)
+            return formatKrakenMessage("snapshot", bidLevels, askLevels, timestamp);
+        return formatBitmexMessage("partial", bidLevels, askLevels, timestamp);
+    }
+
+    // Best level of both sides in the format of the exchange's BBO channel (Kraken ticker, BitMEX quote)
+    std::string topOfBook(bool isSnapshot) {
+        char message[512];
+        std::string timestamp = getCurrentTimestamp();
+        const auto& bestBid = *bids.begin();
+        const auto& bestAsk = *asks.begin();
+        if (config.format == ExchangeFormat::Kraken)
+            snprintf(message, sizeof(message), "{\"channel\":\"ticker\",\"type\":\"%s\",\"data\":[{\"symbol\":\"%s\",\"bid\":%.*f,\"bid_qty\":%.8f,\"ask\":%.*f,\"ask_qty\":%.8f,\"timestamp\":\"%s\"}]}",
+                     isSnapshot ? "snapshot" : "update", symbol.c_str(), priceDecimals, bestBid.first * tickSize, bestBid.second, priceDecimals, bestAsk.first * tickSize, bestAsk.second, timestamp.c_str());
+        else
+            snprintf(message, sizeof(message), "{\"table\":\"quote\",\"action\":\"%s\",\"data\":[{\"timestamp\":\"%s\",\"symbol\":\"%s\",\"bidSize\":%lld,\"bidPrice\":%.*f,\"askPrice\":%.*f,\"askSize\":%lld}]}",
+                     isSnapshot ? "partial" : "insert", timestamp.c_str(), symbol.c_str(), (long long)bestBid.second, priceDecimals, bestBid.first * tickSize, priceDecimals, bestAsk.first * tickSize, (long long)bestAsk.second);
+        return message;
+    }
+
+    // A taker taking out a whole level, in the format of the exchange's trade channel. The seller hits the bid, the
+    // buyer lifts the ask.
+    std::string trade(bool isBuyer, long long tick, double qty) {
+        char message[512];
+        std::string timestamp = getCurrentTimestamp();
+        if (config.format == ExchangeFormat::Kraken)
+            snprintf(message, sizeof(message), "{\"channel\":\"trade\",\"type\":\"update\",\"data\":[{\"symbol\":\"%s\",\"side\":\"%s\",\"price\":%.*f,\"qty\":%.8f,\"ord_type\":\"market\",\"trade_id\":%lu,\"timestamp\":\"%s\"}]}",
+                     symbol.c_str(), isBuyer ? "buy" : "sell", priceDecimals, tick * tickSize, qty, nextTradeId++, timestamp.c_str());
+        else
+            snprintf(message, sizeof(message), "{\"table\":\"trade\",\"action\":\"insert\",\"data\":[{\"timestamp\":\"%s\",\"symbol\":\"%s\",\"side\":\"%s\",\"size\":%lld,\"price\":%.*f,\"tickDirection\":\"%s\",\"trdMatchID\":\"%016lx\"}]}",
+                     timestamp.c_str(), symbol.c_str(), isBuyer ? "Buy" : "Sell", (long long)qty, priceDecimals, tick * tickSize, isBuyer ? "PlusTick" : "MinusTick", nextTradeId++);
+        return message;
+    }
+
+    // Moves the book like nextUpdate() but only publishes the top of the book, and only when it changed
+    void nextTopOfBookUpdate(std::vector<std::string>& messages, bool withTrades) {
+        std::pair<const long long, double> previousBestBid = *bids.begin(), previousBestAsk = *asks.begin();
+        std::vector<std::string> depthMessages;
+        nextUpdate(depthMessages, withTrades);
+        // The trade, if any, is the first message and goes out ahead of the quote as on the exchange
+        if (withTrades && !depthMessages.empty() && depthMessages[0].find("\"trade\"") != std::string::npos)
+            messages.push_back(depthMessages[0]);
+        if (*bids.begin() != previousBestBid || *asks.begin() != previousBestAsk)
+            messages.push_back(topOfBook(false));
+    }
+
+    void nextUpdate(std::vector<std::string>& messages, bool withTrades) {
+        std::vector<std::pair<long long, double>> noChanges, changes, removals;
+        bool isBid = rng() & 1;
+        long long bestBid = bids.begin()->first;
+        long long bestAsk = asks.begin()->first;
+        long long spread = bestAsk - bestBid;
+        int action = rng() % 10;
+
+        if (action < 6) {
+            // Resize a random level
+            if (isBid) {
+                auto level = std::next(bids.begin(), rng() % bids.size());
+                level->second = randomQty();
+                changes.push_back(*level);
+            } else {
+                auto level = std::next(asks.begin(), rng() % asks.size());
+                level->second = randomQty();
+                changes.push_back(*level);
+            }
+            emitChanges(messages, isBid ? changes : noChanges, isBid ? noChanges : changes, "update");
+        } else if ((action < 8 && spread > 1) || spread > MAX_SPREAD_IN_TICKS) {
+            // Improve the touch inside the spread and trim the deepest level
+            long long tick = isBid ? bestBid + 1 : bestAsk - 1;
+            double qty = randomQty();
+            changes.push_back({tick, qty});
+            if (isBid) {
+                bids[tick] = qty;
+                auto deepest = std::prev(bids.end());
+                removals.push_back({deepest->first, 0});
+                bids.erase(deepest);
+            } else {
+                asks[tick] = qty;
+                auto deepest = std::prev(asks.end());
+                removals.push_back({deepest->first, 0});
+                asks.erase(deepest);
+            }
+            if (config.format == ExchangeFormat::Kraken) {
+                changes.insert(changes.end(), removals.begin(), removals.end());
+                emitChanges(messages, isBid ? changes : noChanges, isBid ? noChanges : changes, "update");
+            } else {
+                emitChanges(messages, isBid ? changes : noChanges, isBid ? noChanges : changes, "insert");
+                emitChanges(messages, isBid ? removals : noChanges, isBid ? noChanges : removals, "delete");
+            }
+        } else {
+            // Take out the touch and add a level at the back, through a trade when the trade channel is on
+            if (withTrades)
+                messages.push_back(isBid ? trade(false, bestBid, bids.begin()->second) : trade(true, bestAsk, asks.begin()->second));
+            double qty = randomQty();
+            if (isBid) {
+                removals.push_back({bestBid, 0});
+                bids.erase(bids.begin());
+                long long tick = std::prev(bids.end())->first - 1;
+                bids[tick] = qty;
+                changes.push_back({tick, qty});
+            } else {
+                removals.push_back({bestAsk, 0});
+                asks.erase(asks.begin());
+                long long tick = std::prev(asks.end())->first + 1;
+                asks[tick] = qty;
+                changes.push_back({tick, qty});
+            }
+            if (config.format == ExchangeFormat::Kraken) {
+                removals.insert(removals.end(), changes.begin(), changes.end());
+                emitChanges(messages, isBid ? removals : noChanges, isBid ? noChanges : removals, "update");
+            } else {
+                emitChanges(messages, isBid ? removals : noChanges, isBid ? noChanges : removals, "delete");
+                emitChanges(messages, isBid ? changes : noChanges, isBid ? noChanges : changes, "insert");
+            }
+        }
+    }
+};
+
+static int waitForSocket(int fd, short events, int timeoutMs) {
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+    int ret = poll(&pfd, 1, timeoutMs);
+    if (ret < 0 && errno == EINTR)
+        return 0;
+    return ret;
+}
+
+// Returns the number of bytes read, 0 when nothing arrived before the deadline, or -1 once the connection is gone
+static int tlsRead(TlsConnection& conn, char* buf, size_t len, steady_clock::time_point deadline) {
+    while (true) {
+        int n = SSL_read(conn.ssl, buf, len);
+        if (n > 0)
+            return n;
+
+        int err = SSL_get_error(conn.ssl, n);
+        if (err != SSL_ERROR_WANT_READ && err != SSL_ERROR_WANT_WRITE)
+            return -1;
+
+        int timeoutMs = std::max<long>(0, duration_cast<milliseconds>(deadline - steady_clock::now()).count());
+        int ret = waitForSocket(conn.fd, err == SSL_ERROR_WANT_READ ? POLLIN : POLLOUT, timeoutMs);
+        if (ret < 0)
+            return -1;
+        if (ret == 0)
+            return 0;
+    }
+}
+
+static bool tlsWriteAll(TlsConnection& conn, const char* buf, size_t len) {
+    while (len > 0) {
+        int n = SSL_write(conn.ssl, buf, len);
+        if (n > 0) {
+            buf += n;
+            len -= n;
+            continue;
+        }
+
+        int err = SSL_get_error(conn.ssl, n);
+        if (err != SSL_ERROR_WANT_READ && err != SSL_ERROR_WANT_WRITE)
+            return false;
+        if (waitForSocket(conn.fd, err == SSL_ERROR_WANT_READ ? POLLIN : POLLOUT, -1) < 0)
+            return false;
+    }
+    return true;
+}
+
+static bool tlsAccept(TlsConnection& conn) {
+    int flags = fcntl(conn.fd, F_GETFL, 0);
+    fcntl(conn.fd, F_SETFL, flags | O_NONBLOCK);
+    int one = 1;
+    setsockopt(conn.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    conn.ssl = SSL_new(sslContext);
+    SSL_set_fd(conn.ssl, conn.fd);
+    auto deadline = steady_clock::now() + milliseconds(TLS_HANDSHAKE_TIMEOUT_IN_MILLISECONDS);
+    while (true) {
+        int ret = SSL_accept(conn.ssl);
+        if (ret == 1)
+            return true;
+
+        int err = SSL_get_error(conn.ssl, ret);
+        int timeoutMs = duration_cast<milliseconds>(deadline - steady_clock::now()).count();
+        if ((err != SSL_ERROR_WANT_READ && err != SSL_ERROR_WANT_WRITE) || timeoutMs <= 0 ||
+            waitForSocket(conn.fd, err == SSL_ERROR_WANT_READ ? POLLIN : POLLOUT, timeoutMs) <= 0) {
+            ERR_print_errors_fp(stderr);
+            return false;
+        }
+    }
+}
+
+static void closeConnection(TlsConnection& conn) {
+    if (conn.ssl) {
+        SSL_shutdown(conn.ssl);
+        SSL_free(conn.ssl);
+    }
+    close(conn.fd);
+}
+
+static std::string getHttpHeader(const std::string& request, const char* name) {
+    size_t lineStart = request.find("\r\n");
+    size_t nameLength = strlen(name);
+    while (lineStart != std::string::npos) {
+        lineStart += 2;
+        size_t lineEnd = request.find("\r\n", lineStart);
+        if (lineEnd == std::string::npos || lineEnd == lineStart)
+            break;
+        if (lineEnd - lineStart > nameLength && request[lineStart + nameLength] == ':' &&
+            strncasecmp(request.c_str() + lineStart, name, nameLength) == 0) {
+            size_t valueStart = request.find_first_not_of(' ', lineStart + nameLength + 1);
+            return request.substr(valueStart, lineEnd - valueStart);
+        }
+        lineStart = lineEnd;
+    }
+    return "";
+}
+
+// Reads until a whole request (headers and Content-Length body) is buffered, leaving any pipelined bytes behind
+static bool readHttpRequest(TlsConnection& conn, std::string& rxBuffer, std::string& request, std::string& body, steady_clock::time_point deadline) {
+    char buf[MOCK_EXCHANGE_RX_BUFFER_SIZE];
+    while (true) {
+        size_t headerEnd = rxBuffer.find("\r\n\r\n");
+        if (headerEnd != std::string::npos) {
+            std::string contentLength = getHttpHeader(rxBuffer.substr(0, headerEnd + 2), "Content-Length");
+            size_t bodyLength = contentLength.empty() ? 0 : strtoul(contentLength.c_str(), NULL, 10);
+            if (rxBuffer.size() >= headerEnd + 4 + bodyLength) {
+                request = rxBuffer.substr(0, headerEnd + 2);
+                body = rxBuffer.substr(headerEnd + 4, bodyLength);
+                rxBuffer.erase(0, headerEnd + 4 + bodyLength);
+                return true;
+            }
+        }
+        if (rxBuffer.size() > MAX_HTTP_REQUEST_SIZE)
+            return false;
+
+        int n = tlsRead(conn, buf, sizeof(buf), deadline);
+        if (n <= 0)
+            return false;
+        rxBuffer.append(buf, n);
+    }
+}
+
+static bool sendWebSocketFrame(TlsConnection& conn, int opcode, const std::string& payload) {
+    std::string frame;
+    frame.push_back((char)(0x80 | opcode));
+    if (payload.size() < 126) {
+        frame.push_back((char)payload.size());
+    } else if (payload.size() < 65536) {
+        frame.push_back((char)126);
+        frame.push_back((char)(payload.size() >> 8));
+        frame.push_back((char)(payload.size() & 0xFF));
+    } else {
+        frame.push_back((char)127);
+        for (int i = 7; i >= 0; i--)
+            frame.push_back((char)(((uint64_t)payload.size() >> (8 * i)) & 0xFF));
+    }
+    frame += payload;
+    return tlsWriteAll(conn, frame.data(), frame.size());
+}
+
+// Pops the next complete client frame (always masked) off the buffer, returns false when more bytes are needed
+static bool popWebSocketFrame(std::string& rxBuffer, int& opcode, std::string& payload) {
+    if (rxBuffer.size() < 2)
+        return false;
+
+    const unsigned char* bytes = (const unsigned char*)rxBuffer.data();
+    uint64_t payloadLength = bytes[1] & 0x7F;
+    size_t headerLength = 2;
+    if (payloadLength == 126) {
+        if (rxBuffer.size() < 4)
+            return false;
+        payloadLength = ((uint64_t)bytes[2] << 8) | bytes[3];
+        headerLength = 4;
+    } else if (payloadLength == 127) {
+        if (rxBuffer.size() < 10)
+            return false;
+        payloadLength = 0;
+        for (int i = 2; i < 10; i++)
+            payloadLength = (payloadLength << 8) | bytes[i];
+        headerLength = 10;
+    }
+    bool masked = bytes[1] & 0x80;
+    size_t maskOffset = headerLength;
+    if (masked)
+        headerLength += 4;
+    if (rxBuffer.size() < headerLength + payloadLength)
+        return false;
+
+    opcode = bytes[0] & 0x0F;
+    payload = rxBuffer.substr(headerLength, payloadLength);
+    if (masked)
+        for (size_t i = 0; i < payload.size(); i++)
+            payload[i] ^= bytes[maskOffset + (i % 4)];
+    rxBuffer.erase(0, headerLength + payloadLength);
+    return true;
+}
+
+static std::string computeWebSocketAccept(const std::string& key) {
+    std::string keyWithGuid = key + WEBSOCKET_GUID;
+    unsigned char digest[SHA_DIGEST_LENGTH];
+    SHA1((const unsigned char*)keyWithGuid.data(), keyWithGuid.size(), digest);
+    unsigned char encoded[4 * ((SHA_DIGEST_LENGTH + 2) / 3) + 1];
+    EVP_EncodeBlock(encoded, digest, SHA_DIGEST_LENGTH);
+    return std::string((const char*)encoded);
+}
+
+// Extracts the pair from a Kraken v2 book/ticker/trade or BitMEX orderBookL2_25/quote/trade subscription and acknowledges
+// it like the exchange. Kraken takes the trade channel in a subscription of its own, BitMEX in the same one.
+static std::string handleSubscription(TlsConnection& conn, const std::string& message, bool& isTopOfBook, bool& isTrade) {
+    std::string symbol;
+    if (config.format == ExchangeFormat::Kraken) {
+        isTopOfBook = message.find("\"ticker\"") != std::string::npos;
+        isTrade = message.find("\"trade\"") != std::string::npos;
+        size_t keyPos = message.find("\"symbol\"");
+        size_t listPos = keyPos == std::string::npos ? std::string::npos : message.find('[', keyPos);
+        size_t symbolStart = listPos == std::string::npos ? std::string::npos : message.find('"', listPos);
+        size_t symbolEnd = symbolStart == std::string::npos ? std::string::npos : message.find('"', symbolStart + 1);
+        if (symbolEnd == std::string::npos || message.find("\"subscribe\"") == std::string::npos)
+            return "";
+        symbol = message.substr(symbolStart + 1, symbolEnd - symbolStart - 1);
+        std::string timestamp = getCurrentTimestamp();
+        // The channel is not listed first so that the Book Builder does not take the acknowledgement for book data
+        std::string channel = isTrade ? "\"channel\":\"trade\"" : isTopOfBook ? "\"channel\":\"ticker\",\"event_trigger\":\"bbo\"" : "\"channel\":\"book\",\"depth\":" + std::to_string(config.depth);
+        sendWebSocketFrame(conn, WEBSOCKET_OPCODE_TEXT, "{\"method\":\"subscribe\",\"result\":{\"symbol\":\"" + symbol + "\"," + channel +
+                           ",\"snapshot\":" + (isTrade ? "false" : "true") + "},\"success\":true,\"time_in\":\"" + timestamp + "\",\"time_out\":\"" + timestamp + "\",\"req_id\":" +
+                           (isTrade ? "1234567891" : "1234567890") + "}");
+    } else {
+        size_t topicPos = message.find("orderBookL2_25:");
+        isTopOfBook = topicPos == std::string::npos;
+        if (isTopOfBook)
+            topicPos = message.find("quote:");
+        size_t symbolEnd = topicPos == std::string::npos ? std::string::npos : message.find('"', topicPos);
+        if (symbolEnd == std::string::npos)
+            return "";
+        std::string topic = message.substr(topicPos, symbolEnd - topicPos);
+        symbol = topic.substr(topic.find(':') + 1);
+        isTrade = message.find("\"trade:" + symbol + "\"") != std::string::npos;
+        sendWebSocketFrame(conn, WEBSOCKET_OPCODE_TEXT, "{\"success\":true,\"subscribe\":\"" + topic +
+                           "\",\"request\":{\"op\":\"subscribe\",\"args\":[\"" + topic + "\"]}}");
+        if (isTrade)
+            sendWebSocketFrame(conn, WEBSOCKET_OPCODE_TEXT, "{\"success\":true,\"subscribe\":\"trade:" + symbol +
+                               "\",\"request\":{\"op\":\"subscribe\",\"args\":[\"trade:" + symbol + "\"]}}");
+    }
+    return symbol;
+}
+
+static void serveMarketDataConnection(int fd) {
+    TlsConnection conn = {fd, NULL};
+    uint64_t connectionId = nextConnectionId++;
+    if (!tlsAccept(conn)) {
+        closeConnection(conn);
+        return;
+    }
+
+    std::string rxBuffer, request, body;
+    if (!readHttpRequest(conn, rxBuffer, request, body, steady_clock::now() + milliseconds(TLS_HANDSHAKE_TIMEOUT_IN_MILLISECONDS))) {
+        closeConnection(conn);
+        return;
+    }
+    std::string key = getHttpHeader(request, "Sec-WebSocket-Key");
+    if (key.empty()) {
+        std::string response = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        tlsWriteAll(conn, response.data(), response.size());
+        closeConnection(conn);
+        return;
+    }
+    // No extension is negotiated, the frames are never compressed
+    std::string response = "HTTP/1.1 101 Switching Protocols\r\n"
+                           "Upgrade: websocket\r\n"
+                           "Connection: Upgrade\r\n"
+                           "Sec-WebSocket-Accept: " + computeWebSocketAccept(key) + "\r\n"
+                           "\r\n";
+    if (!tlsWriteAll(conn, response.data(), response.size())) {
+        closeConnection(conn);
+        return;
+    }
+    if (config.format == ExchangeFormat::Bitmex)
+        sendWebSocketFrame(conn, WEBSOCKET_OPCODE_TEXT, "{\"info\":\"Welcome to the BitMEX Realtime API.\",\"version\":\"mock\",\"timestamp\":\"" +
+                           getCurrentTimestamp() + "\",\"limit\":{\"remaining\":39}}");
+
+    std::string symbol;
+    bool isTopOfBook = false;
+    bool withTrades = false;
+    std::string tradeChannelPattern = config.format == ExchangeFormat::Kraken ? "\"channel\":\"trade\"" : "\"table\":\"trade\"";
+    std::unique_ptr<SyntheticBook> syntheticBook;
+    std::vector<const std::string*> symbolReplayMessages;
+    size_t replayPosition = 0;
+    std::vector<std::string> messages;
+    nanoseconds updateInterval = duration_cast<nanoseconds>(duration<double>(1.0 / config.updatesPerSecond));
+    steady_clock::time_point nextUpdateTime = steady_clock::now();
+    char buf[MOCK_EXCHANGE_RX_BUFFER_SIZE];
+    bool open = true;
+
+    while (open) {
+        steady_clock::time_point deadline = symbol.empty() ? steady_clock::now() + milliseconds(IDLE_POLL_PERIOD_IN_MILLISECONDS) : nextUpdateTime;
+        int n = tlsRead(conn, buf, sizeof(buf), deadline);
+        if (n < 0)
+            break;
+        rxBuffer.append(buf, n);
+
+        int opcode;
+        std::string payload;
+        while (open && popWebSocketFrame(rxBuffer, opcode, payload)) {
+            if (opcode == WEBSOCKET_OPCODE_CLOSE) {
+                sendWebSocketFrame(conn, WEBSOCKET_OPCODE_CLOSE, payload.substr(0, 2));
+                open = false;
+            } else if (opcode == WEBSOCKET_OPCODE_PING) {
+                sendWebSocketFrame(conn, WEBSOCKET_OPCODE_PONG, payload);
+            } else if (opcode == WEBSOCKET_OPCODE_TEXT && !symbol.empty()) {
+                // Kraken's trade channel comes in a subscription of its own after the book's
+                bool isTradeTopOfBook, isTrade = false;
+                std::string tradeSymbol = handleSubscription(conn, payload, isTradeTopOfBook, isTrade);
+                if (isTrade && tradeSymbol == symbol && !withTrades) {
+                    withTrades = true;
+                    printf("Connection %lu subscribed to the trades of %s\n", connectionId, symbol.c_str());
+                }
+            } else if (opcode == WEBSOCKET_OPCODE_TEXT) {
+                symbol = handleSubscription(conn, payload, isTopOfBook, withTrades);
+                if (symbol.empty())
+                    continue;
+                printf("Connection %lu subscribed to %s%s%s\n", connectionId, symbol.c_str(), isTopOfBook ? " (top of book)" : "", withTrades ? " and its trades" : "");
+
+                std::string symbolPattern = "\"symbol\":\"" + symbol + "\"";
+                std::string channelPattern;
+                if (config.format == ExchangeFormat::Kraken)
+                    channelPattern = isTopOfBook ? "\"channel\":\"ticker\"" : "\"channel\":\"book\"";
+                else
+                    channelPattern = isTopOfBook ? "\"table\":\"quote\"" : "\"table\":\"orderBookL2_25\"";
+                // Recorded trades keep their place between the book messages, they are only sent once subscribed to
+                for (const std::string& message : replayMessages)
+                    if (message.find(symbolPattern) != std::string::npos &&
+                        (message.find(channelPattern) != std::string::npos || message.find(tradeChannelPattern) != std::string::npos))
+                        symbolReplayMessages.push_back(&message);
+                if (symbolReplayMessages.empty()) {
+                    if (!replayMessages.empty())
+                        std::cerr << "No recorded messages for " << symbol << ", synthesising its book instead" << std::endl;
+                    syntheticBook.reset(new SyntheticBook(symbol, std::hash<std::string>()(symbol) ^ connectionId));
+                    open = sendWebSocketFrame(conn, WEBSOCKET_OPCODE_TEXT, isTopOfBook ? syntheticBook->topOfBook(true) : syntheticBook->snapshot());
+                }
+                nextUpdateTime = steady_clock::now() + updateInterval;
+            }
+        }
+
+        if (symbol.empty())
+            continue;
+
+        // A stream that fell far behind restarts its pacing instead of bursting
+        steady_clock::time_point now = steady_clock::now();
+        if (now - nextUpdateTime > seconds(1))
+            nextUpdateTime = now;
+        while (open && now >= nextUpdateTime) {
+            messages.clear();
+            if (syntheticBook && isTopOfBook) {
+                syntheticBook->nextTopOfBookUpdate(messages, withTrades);
+            } else if (syntheticBook) {
+                syntheticBook->nextUpdate(messages, withTrades);
+            } else {
+                const std::string& message = *symbolReplayMessages[replayPosition];
+                replayPosition = (replayPosition + 1) % symbolReplayMessages.size();
+                if (withTrades || message.find(tradeChannelPattern) == std::string::npos)
+                    messages.push_back(message);
+            }
+            for (const std::string& message : messages)
+                open = open && sendWebSocketFrame(conn, WEBSOCKET_OPCODE_TEXT, message);
+            nextUpdateTime += updateInterval;
+        }
+    }
+
+    if (!symbol.empty())
+        printf("Connection %lu for %s closed\n", connectionId, symbol.c_str());
+    closeConnection(conn);
+}
+
+static std::string getFormField(const std::string& body, const char* name) {
+    std::string prefix = std::string(name) + "=";
+    size_t fieldStart = 0;
+    while (fieldStart < body.size()) {
+        size_t fieldEnd = body.find('&', fieldStart);
+        if (fieldEnd == std::string::npos)
+            fieldEnd = body.size();
+        if (body.compare(fieldStart, prefix.size(), prefix) == 0)
+            return body.substr(fieldStart + prefix.size(), fieldEnd - fieldStart - prefix.size());
+        fieldStart = fieldEnd + 1;
+    }
+    return "";
+}
+
+// Answers like the exchange would for a filled market order, plus the transactTime the Order Manager reads
+static std::string handleRestRequest(const std::string& method, const std::string& uri, const std::string& body, int& status) {
+    std::string timestamp = getCurrentTimestamp();
+    uint64_t orderId = nextOrderId++;
+    char response[1024];
+    status = 200;
+
+    if (method == "POST" && uri == "/api/v1/order") {
+        std::string symbol = getFormField(body, "symbol");
+        std::string side = getFormField(body, "side");
+        double orderQty = strtod(getFormField(body, "orderQty").c_str(), NULL);
+        snprintf(response, sizeof(response), "{\"orderID\":\"00000000-0000-0000-0000-%012lu\",\"symbol\":\"%s\",\"side\":\"%s\",\"orderQty\":%.8g,"
+                 "\"ordType\":\"Market\",\"ordStatus\":\"Filled\",\"cumQty\":%.8g,\"leavesQty\":0,\"transactTime\":\"%s\",\"timestamp\":\"%s\"}",
+                 orderId, symbol.c_str(), side.c_str(), orderQty, orderQty, timestamp.c_str(), timestamp.c_str());
+    } else if (method == "POST" && uri == "/0/private/AddOrder") {
+        std::string pair = getFormField(body, "pair");
+        std::string type = getFormField(body, "type");
+        double volume = strtod(getFormField(body, "volume").c_str(), NULL);
+        snprintf(response, sizeof(response), "{\"error\":[],\"result\":{\"descr\":{\"order\":\"%s %.8f %s @ market\"},\"txid\":[\"OMOCK-%06lu-%06lu\"]},\"transactTime\":\"%s\"}",
+                 type.c_str(), volume, pair.c_str(), orderId / 1000000, orderId % 1000000, timestamp.c_str());
+    } else if (method == "GET" && uri == "/api/v1/address") {
+        snprintf(response, sizeof(response), "{\"address\":\"mock\",\"timestamp\":\"%s\"}", timestamp.c_str());
+    } else if (method == "GET" && uri == "/0/private/Balance") {
+        snprintf(response, sizeof(response), "{\"error\":[],\"result\":{\"ZUSD\":\"100000.0000\"}}");
+    } else {
+        status = 404;
+        snprintf(response, sizeof(response), "{\"error\":[\"EGeneral:Unknown method\"]}");
+    }
+    return response;
+}
+
+static void serveOrderEntryConnection(int fd) {
+    TlsConnection conn = {fd, NULL};
+    if (!tlsAccept(conn)) {
+        closeConnection(conn);
+        return;
+    }
+
+    std::string rxBuffer, request, body;
+    while (readHttpRequest(conn, rxBuffer, request, body, steady_clock::time_point::max())) {
+        size_t methodEnd = request.find(' ');
+        size_t uriEnd = methodEnd == std::string::npos ? std::string::npos : request.find(' ', methodEnd + 1);
+        if (uriEnd == std::string::npos)
+            break;
+        std::string method = request.substr(0, methodEnd);
+        std::string uri = request.substr(methodEnd + 1, uriEnd - methodEnd - 1);
+
+        if (method == "POST" && config.orderLatencyMicroseconds > 0)
+            std::this_thread::sleep_for(microseconds(config.orderLatencyMicroseconds));
+
+        int status;
+        std::string responseBody = handleRestRequest(method, uri, body, status);
+        std::string response = "HTTP/1.1 " + std::to_string(status) + (status == 200 ? " OK" : " Not Found") + "\r\n"
+                               "Content-Type: application/json\r\n"
+                               "Content-Length: " + std::to_string(responseBody.size()) + "\r\n"
+                               "Connection: keep-alive\r\n"
+                               "\r\n" + responseBody;
+        if (!tlsWriteAll(conn, response.data(), response.size()))
+            break;
+        if (method == "POST")
+            printf("%s %s %s\n", method.c_str(), uri.c_str(), body.c_str());
+    }
+
+    closeConnection(conn);
+}
+
+static int listenOn(const std::string& address, int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+        std::cerr << "Invalid bind address: " << address << std::endl;
+        close(fd);
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        perror("bind/listen");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void acceptConnections(int listenFd, void (*serveConnection)(int)) {
+    while (true) {
+        int fd = accept(listenFd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("accept");
+            return;
+        }
+        std::thread(serveConnection, fd).detach();
+    }
+}
+
+// Signs a throwaway P-256 certificate for localhost, the system's mock builds do not verify it
+static bool useSelfSignedCertificate(SSL_CTX* ctx) {
+    EVP_PKEY* pkey = NULL;
+    EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+    if (!pctx || EVP_PKEY_keygen_init(pctx) <= 0 || EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx, NID_X9_62_prime256v1) <= 0 ||
+        EVP_PKEY_keygen(pctx, &pkey) <= 0) {
+        EVP_PKEY_CTX_free(pctx);
+        return false;
+    }
+    EVP_PKEY_CTX_free(pctx);
+
+    X509* cert = X509_new();
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 365L * 24 * 3600);
+    X509_set_pubkey(cert, pkey);
+    X509_NAME* name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*)"localhost", -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+
+    bool ok = X509_sign(cert, pkey, EVP_sha256()) > 0 && SSL_CTX_use_certificate(ctx, cert) == 1 && SSL_CTX_use_PrivateKey(ctx, pkey) == 1;
+    X509_free(cert);
+    EVP_PKEY_free(pkey);
+    return ok;
+}
+
+static void printUsage(const char* programName) {
+    std::cerr << "Usage: " << programName << " [--exchange kraken|bitmex] [--bind address] [--market-data-port port]" << std::endl
+              << "       [--order-entry-port port] [--rate updates per second per pair] [--depth levels]" << std::endl
+              << "       [--replay file] [--order-latency-us microseconds] [--cert file --key file]" << std::endl;
+}
+
+static bool parseArguments(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc)
+            return false;
+        std::string option = argv[i];
+        std::string value = argv[++i];
+        if (option == "--exchange" && (value == "kraken" || value == "bitmex"))
+            config.format = value == "kraken" ? ExchangeFormat::Kraken : ExchangeFormat::Bitmex;
+        else if (option == "--bind")
+            config.bindAddress = value;
+        else if (option == "--market-data-port")
+            config.marketDataPort = atoi(value.c_str());
+        else if (option == "--order-entry-port")
+            config.orderEntryPort = atoi(value.c_str());
+        else if (option == "--rate")
+            config.updatesPerSecond = atof(value.c_str());
+        else if (option == "--depth")
+            config.depth = atoi(value.c_str());
+        else if (option == "--replay")
+            config.replayFile = value;
+        else if (option == "--order-latency-us")
+            config.orderLatencyMicroseconds = atol(value.c_str());
+        else if (option == "--cert")
+            config.certFile = value;
+        else if (option == "--key")
+            config.keyFile = value;
+        else
+            return false;
+    }
+    if (config.marketDataPort == 0)
+        config.marketDataPort = config.format == ExchangeFormat::Kraken ? MockExchangePolicy<KrakenExchangePolicy>::marketDataPort : MockExchangePolicy<BitmexExchangePolicy>::marketDataPort;
+    if (config.orderEntryPort == 0)
+        config.orderEntryPort = config.format == ExchangeFormat::Kraken ? MockExchangePolicy<KrakenExchangePolicy>::orderEntryPort : MockExchangePolicy<BitmexExchangePolicy>::orderEntryPort;
+    return config.marketDataPort > 0 && config.orderEntryPort > 0 && config.updatesPerSecond > 0 && config.depth > 0 && config.orderLatencyMicroseconds >= 0 &&
+           config.certFile.empty() == config.keyFile.empty();
+}
+
+int main(int argc, char *argv[]) {
+    if (!parseArguments(argc, argv)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    if (!config.replayFile.empty()) {
+        std::ifstream replayFile(config.replayFile);
+        if (!replayFile) {
+            perror("replay file");
+            return 1;
+        }
+        std::string line;
+        long long receiveTimestamp;
+        while (std::getline(replayFile, line))
+            if (!line.empty())
+                replayMessages.push_back(skipRecordedReceiveTimestamp(line.c_str(), receiveTimestamp));
+        printf("Loaded %zu recorded messages\n", replayMessages.size());
+    }
+
+    SSL_library_init();
+    SSL_load_error_strings();
+    sslContext = SSL_CTX_new(TLS_server_method());
+    if (!sslContext) {
+        ERR_print_errors_fp(stderr);
+        return 1;
+    }
+    bool certificateLoaded = config.certFile.empty() ? useSelfSignedCertificate(sslContext) :
+                             SSL_CTX_use_certificate_chain_file(sslContext, config.certFile.c_str()) == 1 &&
+                             SSL_CTX_use_PrivateKey_file(sslContext, config.keyFile.c_str(), SSL_FILETYPE_PEM) == 1;
+    if (!certificateLoaded) {
+        ERR_print_errors_fp(stderr);
+        return 1;
+    }
+
+    int marketDataListenFd = listenOn(config.bindAddress, config.marketDataPort);
+    int orderEntryListenFd = listenOn(config.bindAddress, config.orderEntryPort);
+    if (marketDataListenFd < 0 || orderEntryListenFd < 0)
+        return 1;
+
+    printf("Mock %s exchange: market data on wss://%s:%d, order entry on https://%s:%d, %.1f updates/s per pair, %ld us order latency\n",
+           config.format == ExchangeFormat::Kraken ? "Kraken" : "BitMEX", config.bindAddress.c_str(), config.marketDataPort,
+           config.bindAddress.c_str(), config.orderEntryPort, config.updatesPerSecond, config.orderLatencyMicroseconds);
+
+    std::thread orderEntryThread(acceptConnections, orderEntryListenFd, serveOrderEntryConnection);
+    acceptConnections(marketDataListenFd, serveMarketDataConnection);
+    orderEntryThread.join();
+
+    SSL_CTX_free(sslContext);
+    return 0;
+}
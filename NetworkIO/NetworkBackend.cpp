@@ -0,0 +1,100 @@
+// NetworkBackend.cpp
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include "NetworkBackend.hpp"
+
+IoUringNetworkBackend::IoUringNetworkBackend(bool sqPoll) : sqPoll(sqPoll) {}
+
+IoUringNetworkBackend::~IoUringNetworkBackend() {
+    io_uring_queue_exit(&ring);
+}
+
+int IoUringNetworkBackend::init(const NetworkBackendOptions& options) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    if (sqPoll) {
+        params.flags |= IORING_SETUP_SQPOLL;
+        params.sq_thread_idle = options.sqThreadIdleInMilliseconds;
+        if (options.attachRingFd >= 0) {
+            params.flags |= IORING_SETUP_ATTACH_WQ;
+            params.wq_fd = options.attachRingFd;
+        } else if (options.sqPollCpuCore >= 0) {
+            params.flags |= IORING_SETUP_SQ_AFF;
+            params.sq_thread_cpu = options.sqPollCpuCore;
+        }
+    }
+    return io_uring_queue_init_params(NUMBER_OF_IO_URING_SQ_ENTRIES, &ring, &params);
+}
+
+NetworkBackendType IoUringNetworkBackend::getType() const {
+    return sqPoll ? NetworkBackendType::IoUringSqPoll : NetworkBackendType::IoUring;
+}
+
+int IoUringNetworkBackend::registerSockets(const int* sockfds, int numberOfSockets) {
+    return io_uring_register_files(&ring, sockfds, numberOfSockets);
+}
+
+int IoUringNetworkBackend::updateSocket(int slot, int sockfd) {
+    int ret = io_uring_register_files_update(&ring, slot, &sockfd, 1);
+    return ret < 0 ? ret : 0;
+}
+
+int IoUringNetworkBackend::getSqPollRingFd() const {
+    return sqPoll ? ring.ring_fd : -1;
+}
+
+NetworkBackend* createNetworkBackend(const NetworkBackendOptions& options) {
+    switch (options.type) {
+        case NetworkBackendType::IoUringSqPoll:
+        case NetworkBackendType::IoUring: {
+            IoUringNetworkBackend* backend = new IoUringNetworkBackend(options.type == NetworkBackendType::IoUringSqPoll);
+            int ret = backend->init(options);
+            if (ret < 0) {
+                delete backend;
+                errno = -ret;
+                return NULL;
+            }
+            return backend;
+        }
+        case NetworkBackendType::Epoll:
+            return new EpollNetworkBackend(options.busyPollInMicroseconds);
+        case NetworkBackendType::BusyPoll:
+            return new BusyPollNetworkBackend(options.busyPollInMicroseconds);
+    }
+    errno = EINVAL;
+    return NULL;
+}
+
+NetworkBackendType getDefaultNetworkBackendType() {
+    return geteuid() ? NetworkBackendType::IoUring : NetworkBackendType::IoUringSqPoll;
+}
+
+static const struct {
+    NetworkBackendType type;
+    const char* name;
+} networkBackendNames[] = {
+    {NetworkBackendType::IoUringSqPoll, "io_uring_sqpoll"},
+    {NetworkBackendType::IoUring, "io_uring"},
+    {NetworkBackendType::Epoll, "epoll"},
+    {NetworkBackendType::BusyPoll, "busy_poll"},
+};
+
+bool parseNetworkBackendType(const char* name, NetworkBackendType& type) {
+    for (const auto& networkBackendName : networkBackendNames) {
+        if (strcmp(name, networkBackendName.name) == 0) {
+            type = networkBackendName.type;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* getNetworkBackendTypeName(NetworkBackendType type) {
+    for (const auto& networkBackendName : networkBackendNames)
+        if (networkBackendName.type == type)
+            return networkBackendName.name;
+    return "unknown";
+}
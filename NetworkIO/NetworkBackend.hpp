@@ -0,0 +1,208 @@
+// NetworkBackend.hpp
+
+#ifndef NETWORK_BACKEND_HPP
+#define NETWORK_BACKEND_HPP
+
+#include <cerrno>
+#include <liburing.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+#define NUMBER_OF_IO_URING_SQ_ENTRIES 300
+#define DEFAULT_SQ_THREAD_IDLE_IN_MILLISECONDS 200000
+#define DEFAULT_BUSY_POLL_IN_MICROSECONDS 50
+
+enum class NetworkBackendType {
+    IoUringSqPoll, // io_uring with a kernel thread polling the submission queue
+    IoUring,       // io_uring entered with a syscall for every submission
+    Epoll,         // plain non-blocking recvmsg/write once epoll reported the socket ready
+    BusyPoll       // non-blocking recvmsg on SO_BUSY_POLL sockets, spun on instead of waiting for readiness
+};
+
+struct NetworkBackendOptions {
+    NetworkBackendType type;
+    int sqPollCpuCore = -1;  // Core of the SQPOLL thread, unpinned when negative
+    int attachRingFd = -1;   // Ring whose SQPOLL thread is shared instead of starting a new one, none when negative
+    unsigned sqThreadIdleInMilliseconds = DEFAULT_SQ_THREAD_IDLE_IN_MILLISECONDS;
+    int busyPollInMicroseconds = DEFAULT_BUSY_POLL_IN_MICROSECONDS;
+};
+
+// Sockets of a component, addressed by slot, the index they were registered at, so that the io_uring backends can use
+// fixed files. Results follow the io_uring convention: the number of bytes transferred, or -errno.
+// Only the setup and the reconnections go through this interface. The receive and send calls of the hot path are
+// members of the concrete backends below, made from loops that are templates on the backend and entered through
+// dispatchNetworkBackend(), so that they are resolved at compile time.
+class NetworkBackend {
+public:
+    virtual ~NetworkBackend() {}
+
+    virtual NetworkBackendType getType() const = 0;
+    // Registers the sockets of the slots 0..numberOfSockets-1, a slot holding -1 stays empty
+    virtual int registerSockets(const int* sockfds, int numberOfSockets) = 0;
+    // Puts another socket (or -1) into an already registered slot
+    virtual int updateSocket(int slot, int sockfd) = 0;
+    // Ring other io_uring instances can attach their submission queue polling to, -1 when there is none
+    virtual int getSqPollRingFd() const {
+        return -1;
+    }
+
+    // Whether the caller spins on receiveMessage() instead of waiting for readiness notifications
+    bool isBusyPolling() const {
+        return getType() == NetworkBackendType::BusyPoll;
+    }
+};
+
+class IoUringNetworkBackend final : public NetworkBackend {
+private:
+    struct io_uring ring;
+    bool sqPoll;
+
+public:
+    static constexpr bool busyPolling = false;
+
+    explicit IoUringNetworkBackend(bool sqPoll);
+    ~IoUringNetworkBackend();
+
+    int init(const NetworkBackendOptions& options);
+    NetworkBackendType getType() const override;
+    int registerSockets(const int* sockfds, int numberOfSockets) override;
+    int updateSocket(int slot, int sockfd) override;
+    int getSqPollRingFd() const override;
+
+    ssize_t receiveMessage(int slot, struct msghdr* msg) {
+        struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        if (!sqe)
+            return -EBUSY;
+        io_uring_prep_recvmsg(sqe, slot, msg, 0);
+        sqe->flags |= IOSQE_FIXED_FILE;
+
+        int ret = io_uring_submit(&ring);
+        if (ret < 0)
+            return ret;
+
+        struct io_uring_cqe* cqe;
+        ret = io_uring_wait_cqe(&ring, &cqe);
+        if (ret < 0)
+            return ret;
+        ssize_t bytesRead = cqe->res;
+        io_uring_cqe_seen(&ring, cqe);
+        return bytesRead;
+    }
+
+    // Writes every buffer to the socket of its slot at once, results[i] is set for buffers[i]
+    int sendBatch(const int* slots, const struct iovec* buffers, int* results, int count) {
+        for (int i = 0; i < count; i++) {
+            struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+            if (!sqe)
+                return -EBUSY;
+            io_uring_prep_write(sqe, slots[i], buffers[i].iov_base, buffers[i].iov_len, 0);
+            sqe->flags |= IOSQE_FIXED_FILE;
+            // Completions come back in any order
+            io_uring_sqe_set_data64(sqe, i);
+        }
+
+        int ret = io_uring_submit(&ring);
+        if (ret < 0)
+            return ret;
+
+        for (int i = 0; i < count; i++) {
+            struct io_uring_cqe* cqe;
+            ret = io_uring_wait_cqe(&ring, &cqe);
+            if (ret < 0)
+                return ret;
+            results[io_uring_cqe_get_data64(cqe)] = cqe->res;
+            io_uring_cqe_seen(&ring, cqe);
+        }
+        return 0;
+    }
+};
+
+// Epoll and busy polling only differ in how readiness is found: the socket calls are the same
+template <NetworkBackendType backendType>
+class SocketNetworkBackend final : public NetworkBackend {
+private:
+    int busyPollInMicroseconds;
+    std::vector<int> sockfds;
+
+public:
+    static constexpr bool busyPolling = backendType == NetworkBackendType::BusyPoll;
+
+    explicit SocketNetworkBackend(int busyPollInMicroseconds) : busyPollInMicroseconds(busyPollInMicroseconds) {}
+
+    NetworkBackendType getType() const override {
+        return backendType;
+    }
+
+    int registerSockets(const int* sockfds, int numberOfSockets) override {
+        this->sockfds.assign(numberOfSockets, -1);
+        for (int slot = 0; slot < numberOfSockets; slot++) {
+            int ret = updateSocket(slot, sockfds[slot]);
+            if (ret < 0)
+                return ret;
+        }
+        return 0;
+    }
+
+    int updateSocket(int slot, int sockfd) override {
+        if (slot < 0 || slot >= (int)sockfds.size())
+            return -EINVAL;
+        sockfds[slot] = sockfd;
+        // The kernel spins on the device queue for up to busyPollInMicroseconds when a read finds the socket empty
+        if (busyPolling && sockfd >= 0) {
+            if (setsockopt(sockfd, SOL_SOCKET, SO_BUSY_POLL, &busyPollInMicroseconds, sizeof(busyPollInMicroseconds)) < 0)
+                return -errno;
+#ifdef SO_PREFER_BUSY_POLL
+            int preferBusyPoll = 1;
+            setsockopt(sockfd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &preferBusyPoll, sizeof(preferBusyPoll));
+#endif
+        }
+        return 0;
+    }
+
+    ssize_t receiveMessage(int slot, struct msghdr* msg) {
+        if (sockfds[slot] < 0)
+            return -EBADF;
+        ssize_t bytesRead = recvmsg(sockfds[slot], msg, MSG_DONTWAIT);
+        return bytesRead < 0 ? -errno : bytesRead;
+    }
+
+    int sendBatch(const int* slots, const struct iovec* buffers, int* results, int count) {
+        for (int i = 0; i < count; i++) {
+            ssize_t bytesWritten = write(sockfds[slots[i]], buffers[i].iov_base, buffers[i].iov_len);
+            results[i] = bytesWritten < 0 ? -errno : bytesWritten;
+        }
+        return 0;
+    }
+};
+
+using EpollNetworkBackend = SocketNetworkBackend<NetworkBackendType::Epoll>;
+using BusyPollNetworkBackend = SocketNetworkBackend<NetworkBackendType::BusyPoll>;
+
+// Calls function with the backend as its concrete type, the loops of the components are instantiated once per backend
+template <typename Function>
+void dispatchNetworkBackend(NetworkBackend& networkBackend, Function&& function) {
+    switch (networkBackend.getType()) {
+        case NetworkBackendType::IoUringSqPoll:
+        case NetworkBackendType::IoUring:
+            function(static_cast<IoUringNetworkBackend&>(networkBackend));
+            break;
+        case NetworkBackendType::Epoll:
+            function(static_cast<EpollNetworkBackend&>(networkBackend));
+            break;
+        case NetworkBackendType::BusyPoll:
+            function(static_cast<BusyPollNetworkBackend&>(networkBackend));
+            break;
+    }
+}
+
+// Returns NULL (with errno set) when the backend cannot be set up on this host
+NetworkBackend* createNetworkBackend(const NetworkBackendOptions& options);
+// SQPOLL when running as root, a plain ring otherwise, as before the backends were selectable
+NetworkBackendType getDefaultNetworkBackendType();
+bool parseNetworkBackendType(const char* name, NetworkBackendType& type);
+const char* getNetworkBackendTypeName(NetworkBackendType type);
+
+#endif // NETWORK_BACKEND_HPP
@@ -1,20 +1,25 @@
 // order_book.cpp
 
+#include <algorithm>
 #include "OrderBook.hpp"
+#include "../Exchanges/ExchangePolicies.hpp"
 
-std::pair<double, double> OrderBook::getBestBuyLimitPriceAndSize() {
+template <typename ExchangePolicy>
+std::pair<double, double> OrderBook<ExchangePolicy>::getBestBuyLimitPriceAndSize() {
     double highestBuyLimitNodePrice = highestBuyLimitNode != nullptr ? highestBuyLimitNode->price : 0.0;
     double highestBuyLimitNodeSize = highestBuyLimitNode != nullptr ? highestBuyLimitNode->size : 0.0;
     return std::make_pair(highestBuyLimitNodePrice, highestBuyLimitNodeSize); 
 }
 
-std::pair<double, double> OrderBook::getBestSellLimitPriceAndSize() {
+template <typename ExchangePolicy>
+std::pair<double, double> OrderBook<ExchangePolicy>::getBestSellLimitPriceAndSize() {
     double lowestSellLimitNodePrice = lowestSellLimitNode != nullptr ? lowestSellLimitNode->price : 0.0;
     double lowestSellLimitNodeSize = lowestSellLimitNode != nullptr ? lowestSellLimitNode->size : 0.0;
     return std::make_pair(lowestSellLimitNodePrice, lowestSellLimitNodeSize); 
 }
 
-void OrderBook::insertLimitNode(LimitNode* newNode, LimitNode* currentNode, LimitNode* parentNode, ParentRelation parentRelation) {
+template <typename ExchangePolicy>
+void OrderBook<ExchangePolicy>::insertLimitNode(LimitNode* newNode, LimitNode* currentNode, LimitNode* parentNode, ParentRelation parentRelation) {
     if (currentNode == nullptr) {
         (parentRelation == ParentRelation::Left) ? parentNode->leftLimitNode = newNode : parentNode->rightLimitNode = newNode;
         newNode->parentLimitNode = parentNode;
@@ -31,7 +36,8 @@ void OrderBook::insertLimitNode(LimitNode* newNode, LimitNode* currentNode, Limi
     }
 }
 
-LimitNode* OrderBook::minPriceLimitNode(LimitNode* node) {
+template <typename ExchangePolicy>
+LimitNode* OrderBook<ExchangePolicy>::minPriceLimitNode(LimitNode* node) {
     LimitNode* current = node;
 
     while (current->leftLimitNode != nullptr) 
@@ -40,7 +46,8 @@ LimitNode* OrderBook::minPriceLimitNode(LimitNode* node) {
     return current;
 }
 
-LimitNode* OrderBook::maxPriceLimitNode(LimitNode* node) {
+template <typename ExchangePolicy>
+LimitNode* OrderBook<ExchangePolicy>::maxPriceLimitNode(LimitNode* node) {
     LimitNode* current = node;
 
     while (current->rightLimitNode != nullptr) 
@@ -50,7 +57,8 @@ LimitNode* OrderBook::maxPriceLimitNode(LimitNode* node) {
 }
 
 // Transplant function replaces subtree rooted at u with subtree rooted at v
-void OrderBook::transplant(LimitNode* u, LimitNode* v, OrderBookSide orderBookSide) {
+template <typename ExchangePolicy>
+void OrderBook<ExchangePolicy>::transplant(LimitNode* u, LimitNode* v, OrderBookSide orderBookSide) {
     if (u->parentLimitNode == nullptr) {
         (orderBookSide == OrderBookSide::Buy) ? buyRootNode = v : sellRootNode = v;
     } else if (u == u->parentLimitNode->leftLimitNode) {
@@ -64,7 +72,8 @@ void OrderBook::transplant(LimitNode* u, LimitNode* v, OrderBookSide orderBookSi
 }
 
 // Remove function
-void OrderBook::removeLimitNode(LimitNode* node, OrderBookSide orderBookSide) {
+template <typename ExchangePolicy>
+void OrderBook<ExchangePolicy>::removeLimitNode(LimitNode* node, OrderBookSide orderBookSide) {
     if (node->leftLimitNode == nullptr) {
         transplant(node, node->rightLimitNode, orderBookSide);
     } else if (node->rightLimitNode == nullptr) {
@@ -83,7 +92,8 @@ void OrderBook::removeLimitNode(LimitNode* node, OrderBookSide orderBookSide) {
     delete node;
 }
 
-void OrderBook::insertBuy(double id, double price, double size, long updateExchangeTimestamp, system_clock::time_point updateSocketRxTimestamp) {
+template <typename ExchangePolicy>
+void OrderBook<ExchangePolicy>::insertBuy(double id, double price, double size, long updateExchangeTimestamp, system_clock::time_point updateSocketRxTimestamp) {
     LimitNode* newBuyNode = new LimitNode(id, price, size);
     if (buyRootNode == nullptr)
         buyRootNode = newBuyNode;
@@ -94,40 +104,36 @@ void OrderBook::insertBuy(double id, double price, double size, long updateExcha
 
     buyMap[id] = newBuyNode; 
     this->marketUpdateExchangeRxTimestamp = updateExchangeTimestamp;
-#if defined(USE_KRAKEN_EXCHANGE) || defined(USE_KRAKEN_MOCK_EXCHANGE)
     buyNodeCount++;
-#endif
     if (highestBuyLimitNode == nullptr || price > highestBuyLimitNode->price)
         highestBuyLimitNode = newBuyNode;
     
-#if defined(USE_KRAKEN_EXCHANGE) || defined(USE_KRAKEN_MOCK_EXCHANGE)
-    if (buyNodeCount > 10) {
+    if (ExchangePolicy::maxBookDepth > 0 && buyNodeCount > ExchangePolicy::maxBookDepth) {
         LimitNode* nodeToRemove = minPriceLimitNode(buyRootNode);
         this->buyMap.erase(nodeToRemove->price);
         removeLimitNode(nodeToRemove, OrderBookSide::Buy);
         buyNodeCount--;
     }
-#endif
     this->finalUpdateTimestamp = high_resolution_clock::now();
     this->updateSocketRxTimestamp = updateSocketRxTimestamp;
 }
 
-void OrderBook::updateBuy(double id, double size, long updateExchangeTimestamp, system_clock::time_point updateSocketRxTimestamp) {
+template <typename ExchangePolicy>
+void OrderBook<ExchangePolicy>::updateBuy(double id, double size, long updateExchangeTimestamp, system_clock::time_point updateSocketRxTimestamp) {
     this->buyMap[id]->size = size;
     this->marketUpdateExchangeRxTimestamp = updateExchangeTimestamp;
     this->finalUpdateTimestamp = high_resolution_clock::now();
     this->updateSocketRxTimestamp = updateSocketRxTimestamp;
 }
 
-void OrderBook::removeBuy(double id, long updateExchangeTimestamp, system_clock::time_point updateSocketRxTimestamp) {
+template <typename ExchangePolicy>
+void OrderBook<ExchangePolicy>::removeBuy(double id, long updateExchangeTimestamp, system_clock::time_point updateSocketRxTimestamp) {
     LimitNode* nodeToRemove = buyMap[id];
     removeLimitNode(nodeToRemove, OrderBookSide::Buy);
     this->buyMap.erase(id);
     this->marketUpdateExchangeRxTimestamp = updateExchangeTimestamp;
     
-#if defined(USE_KRAKEN_EXCHANGE) || defined(USE_KRAKEN_MOCK_EXCHANGE)
     buyNodeCount--;
-#endif
     
     if (nodeToRemove == highestBuyLimitNode) {
         if (highestBuyLimitNode->parentLimitNode == nullptr) {
@@ -143,7 +149,8 @@ void OrderBook::removeBuy(double id, long updateExchangeTimestamp, system_clock:
     this->updateSocketRxTimestamp = updateSocketRxTimestamp; 
 }
 
-void OrderBook::insertSell(double id, double price, double size, long updateExchangeTimestamp, system_clock::time_point updateSocketRxTimestamp) {
+template <typename ExchangePolicy>
+void OrderBook<ExchangePolicy>::insertSell(double id, double price, double size, long updateExchangeTimestamp, system_clock::time_point updateSocketRxTimestamp) {
     LimitNode* newSellLimitNode = new LimitNode(id, price, size);
     if (sellRootNode == nullptr)
         sellRootNode = newSellLimitNode;
@@ -155,40 +162,36 @@ void OrderBook::insertSell(double id, double price, double size, long updateExch
     sellMap[id] = newSellLimitNode; 
     this->marketUpdateExchangeRxTimestamp = updateExchangeTimestamp;
     
-#if defined(USE_KRAKEN_EXCHANGE) || defined(USE_KRAKEN_MOCK_EXCHANGE)
     sellNodeCount++;
-#endif
 
     if (lowestSellLimitNode == nullptr || price < lowestSellLimitNode->price)
         lowestSellLimitNode = newSellLimitNode;
 
-#if defined(USE_KRAKEN_EXCHANGE) || defined(USE_KRAKEN_MOCK_EXCHANGE)
-    if (sellNodeCount > 10) {
+    if (ExchangePolicy::maxBookDepth > 0 && sellNodeCount > ExchangePolicy::maxBookDepth) {
         LimitNode* nodeToRemove = maxPriceLimitNode(sellRootNode);
         this->sellMap.erase(nodeToRemove->price);
         removeLimitNode(nodeToRemove, OrderBookSide::Sell);
         sellNodeCount--;
     }
-#endif
     this->finalUpdateTimestamp = high_resolution_clock::now();
     this->updateSocketRxTimestamp = updateSocketRxTimestamp; 
 }
 
-void OrderBook::updateSell(double id, double size, long updateExchangeTimestamp, system_clock::time_point updateSocketRxTimestamp) {
+template <typename ExchangePolicy>
+void OrderBook<ExchangePolicy>::updateSell(double id, double size, long updateExchangeTimestamp, system_clock::time_point updateSocketRxTimestamp) {
     this->sellMap[id]->size = size;
     this->marketUpdateExchangeRxTimestamp = updateExchangeTimestamp;
     this->finalUpdateTimestamp = high_resolution_clock::now();
 }
 
-void OrderBook::removeSell(double id, long updateExchangeTimestamp, system_clock::time_point updateSocketRxTimestamp) {
+template <typename ExchangePolicy>
+void OrderBook<ExchangePolicy>::removeSell(double id, long updateExchangeTimestamp, system_clock::time_point updateSocketRxTimestamp) {
     LimitNode* nodeToRemove = sellMap[id];
     removeLimitNode(nodeToRemove, OrderBookSide::Sell);
     this->sellMap.erase(id);
     this->marketUpdateExchangeRxTimestamp = updateExchangeTimestamp;
     
-#if defined(USE_KRAKEN_EXCHANGE) || defined(USE_KRAKEN_MOCK_EXCHANGE)    
     sellNodeCount--;
-#endif
 
     if (nodeToRemove == lowestSellLimitNode) {
         if (lowestSellLimitNode->parentLimitNode == nullptr) {
@@ -204,15 +207,107 @@ void OrderBook::removeSell(double id, long updateExchangeTimestamp, system_clock
     this->updateSocketRxTimestamp = updateSocketRxTimestamp;
 }
 
-bool OrderBook::checkBuySidePriceLevel(double price) {
+template <typename ExchangePolicy>
+bool OrderBook<ExchangePolicy>::checkBuySidePriceLevel(double price) {
     return this->buyMap.count(price) != 0;
 }
 
-bool OrderBook::checkSellSidePriceLevel(double price) {
+template <typename ExchangePolicy>
+bool OrderBook<ExchangePolicy>::checkSellSidePriceLevel(double price) {
     return this->sellMap.count(price) != 0;
 }
 
-void OrderBook::reverseInOrderTraversal(LimitNode* node) {
+template <typename ExchangePolicy>
+bool OrderBook<ExchangePolicy>::isCrossed() {
+    return highestBuyLimitNode != nullptr && lowestSellLimitNode != nullptr && highestBuyLimitNode->price >= lowestSellLimitNode->price;
+}
+
+template <typename ExchangePolicy>
+void OrderBook<ExchangePolicy>::setTopOfBook(double bidPrice, double bidSize, double askPrice, double askSize, long updateExchangeTimestamp, system_clock::time_point updateSocketRxTimestamp) {
+    // The single node of each side is only allocated after the book was created or invalidated
+    if (highestBuyLimitNode == nullptr)
+        highestBuyLimitNode = buyRootNode = new LimitNode(bidPrice, bidPrice, bidSize);
+    if (lowestSellLimitNode == nullptr)
+        lowestSellLimitNode = sellRootNode = new LimitNode(askPrice, askPrice, askSize);
+
+    highestBuyLimitNode->id = highestBuyLimitNode->price = bidPrice;
+    highestBuyLimitNode->size = bidSize;
+    lowestSellLimitNode->id = lowestSellLimitNode->price = askPrice;
+    lowestSellLimitNode->size = askSize;
+    this->inferred = false;
+
+    this->marketUpdateExchangeRxTimestamp = updateExchangeTimestamp;
+    this->finalUpdateTimestamp = high_resolution_clock::now();
+    this->updateSocketRxTimestamp = updateSocketRxTimestamp;
+}
+
+template <typename ExchangePolicy>
+bool OrderBook<ExchangePolicy>::applyTrade(OrderBookSide takerSide, double price, double size, long updateExchangeTimestamp, system_clock::time_point updateSocketRxTimestamp) {
+    // A buyer lifts the asks up to the trade price, a seller hits the bids down to it
+    bool isBuyer = takerSide == OrderBookSide::Buy;
+    LimitNode*& bestNode = isBuyer ? lowestSellLimitNode : highestBuyLimitNode;
+    std::unordered_map<double, LimitNode*>& levels = isBuyer ? sellMap : buyMap;
+    if (bestNode == nullptr || (isBuyer ? price < bestNode->price : price > bestNode->price))
+        return false;
+
+    // The levels the trade went through are gone, the last one is kept so that the side never looks empty
+    while (levels.size() > 1 && (isBuyer ? bestNode->price < price : bestNode->price > price)) {
+        if (isBuyer)
+            removeSell(bestNode->id, updateExchangeTimestamp, updateSocketRxTimestamp);
+        else
+            removeBuy(bestNode->id, updateExchangeTimestamp, updateSocketRxTimestamp);
+    }
+
+    if (bestNode->price != price) {
+        // The trade went past every known level. The single node of a top-of-book feed moves to the trade price, as
+        // a bound of the new best price, while a depth book keeps its last level. Either way its size is unknown.
+        if (levels.empty())
+            bestNode->id = bestNode->price = price;
+        bestNode->size = 0;
+    } else if (bestNode->size > size || levels.size() <= 1) {
+        bestNode->size = std::max(bestNode->size - size, 0.0);
+    } else if (isBuyer) {
+        removeSell(bestNode->id, updateExchangeTimestamp, updateSocketRxTimestamp);
+    } else {
+        removeBuy(bestNode->id, updateExchangeTimestamp, updateSocketRxTimestamp);
+    }
+
+    this->inferred = true;
+    this->marketUpdateExchangeRxTimestamp = updateExchangeTimestamp;
+    this->finalUpdateTimestamp = high_resolution_clock::now();
+    this->updateSocketRxTimestamp = updateSocketRxTimestamp;
+    return true;
+}
+
+template <typename ExchangePolicy>
+void OrderBook<ExchangePolicy>::deleteLimitNodes(LimitNode* node) {
+    if (node != nullptr) {
+        deleteLimitNodes(node->leftLimitNode);
+        deleteLimitNodes(node->rightLimitNode);
+        delete node;
+    }
+}
+
+template <typename ExchangePolicy>
+void OrderBook<ExchangePolicy>::invalidate(system_clock::time_point updateSocketRxTimestamp) {
+    deleteLimitNodes(buyRootNode);
+    deleteLimitNodes(sellRootNode);
+    buyRootNode = nullptr;
+    sellRootNode = nullptr;
+    highestBuyLimitNode = nullptr;
+    lowestSellLimitNode = nullptr;
+    buyMap.clear();
+    sellMap.clear();
+    buyNodeCount = 0;
+    sellNodeCount = 0;
+    this->valid = false;
+    this->inferred = false;
+    this->finalUpdateTimestamp = high_resolution_clock::now();
+    this->updateSocketRxTimestamp = updateSocketRxTimestamp;
+}
+
+template <typename ExchangePolicy>
+void OrderBook<ExchangePolicy>::reverseInOrderTraversal(LimitNode* node) {
     if (node != nullptr) {
         reverseInOrderTraversal(node->rightLimitNode);
         std::cout << "Price: " << node->price << ", Size: " << node->size << "\n";
@@ -220,7 +315,8 @@ void OrderBook::reverseInOrderTraversal(LimitNode* node) {
     }
 }
 
-void OrderBook::printOrderBook() {
+template <typename ExchangePolicy>
+void OrderBook<ExchangePolicy>::printOrderBook() {
     std::cout << currencyPairSymbol << " - Sell Side of the LOB for " << currencyPairSymbol << ":\n";
     reverseInOrderTraversal(sellRootNode);
     std::cout << "------------------------\n";
@@ -229,3 +325,5 @@ void OrderBook::printOrderBook() {
     std::cout << "########################\n";
 }
 
+#define INSTANTIATE_ORDER_BOOK(ExchangePolicy) template class OrderBook<ExchangePolicy>;
+FOR_EACH_EXCHANGE_POLICY(INSTANTIATE_ORDER_BOOK)
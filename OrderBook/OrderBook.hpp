@@ -32,6 +32,8 @@ enum class OrderBookSide {
     Sell
 };
 
+// The policy of the exchange the book is built from decides how deep it is kept
+template <typename ExchangePolicy>
 class OrderBook {
 private:
     LimitNode* buyRootNode;
@@ -42,32 +44,30 @@ private:
     LimitNode* highestBuyLimitNode; // Best buy price
     
     std::string currencyPairSymbol;
+    // Index of the pair in the traded portfolio, which the Strategy looks its edges up by
+    int currencyPairIdx;
     long marketUpdateExchangeRxTimestamp;
     system_clock::time_point finalUpdateTimestamp;
     system_clock::time_point updateSocketRxTimestamp;
+    // False from the moment the feed is known to be dead or desynced until a fresh snapshot has been applied
+    bool valid;
+    // True while the top of the book reflects trades that no book update has confirmed yet
+    bool inferred;
 
-#if defined(USE_KRAKEN_EXCHANGE) || defined(USE_KRAKEN_MOCK_EXCHANGE)
     size_t buyNodeCount;
     size_t sellNodeCount;
-    LimitNode* highestSelllLimitNode;
-    LimitNode* lowestBuyLimitNode;
-#endif
     void transplant(LimitNode* u, LimitNode* v, OrderBookSide orderBookSide);
     void insertLimitNode(LimitNode* newNode, LimitNode* currentNode, LimitNode* parentLimitNodeNode, ParentRelation parentLimitNodeRelation);
     void removeLimitNode(LimitNode* node, OrderBookSide orderBookSide);
     LimitNode* minPriceLimitNode(LimitNode* node);
     LimitNode* maxPriceLimitNode(LimitNode* node);
+    void deleteLimitNodes(LimitNode* node);
     
     void reverseInOrderTraversal(LimitNode* node);
 
 public:
-#if defined(USE_KRAKEN_EXCHANGE) || (USE_KRAKEN_MOCK_EXCHANGE)    
-    OrderBook(std::string currencyPairSymbol) : buyRootNode(nullptr), sellRootNode(nullptr), lowestSellLimitNode(nullptr), highestBuyLimitNode(nullptr), currencyPairSymbol(currencyPairSymbol), buyNodeCount(0), sellNodeCount(0) {}
-    OrderBook() : buyRootNode(nullptr), sellRootNode(nullptr), lowestSellLimitNode(nullptr), highestBuyLimitNode(nullptr), currencyPairSymbol(""), buyNodeCount(0), sellNodeCount(0) {}
-#else
-    OrderBook(std::string currencyPairSymbol) : buyRootNode(nullptr), sellRootNode(nullptr), lowestSellLimitNode(nullptr), highestBuyLimitNode(nullptr), currencyPairSymbol(currencyPairSymbol) {}
-    OrderBook() : buyRootNode(nullptr), sellRootNode(nullptr), lowestSellLimitNode(nullptr), highestBuyLimitNode(nullptr), currencyPairSymbol("") {}
-#endif
+    OrderBook(std::string currencyPairSymbol, int currencyPairIdx) : buyRootNode(nullptr), sellRootNode(nullptr), lowestSellLimitNode(nullptr), highestBuyLimitNode(nullptr), currencyPairSymbol(currencyPairSymbol), currencyPairIdx(currencyPairIdx), valid(true), inferred(false), buyNodeCount(0), sellNodeCount(0) {}
+    OrderBook() : buyRootNode(nullptr), sellRootNode(nullptr), lowestSellLimitNode(nullptr), highestBuyLimitNode(nullptr), currencyPairSymbol(""), currencyPairIdx(-1), valid(true), inferred(false), buyNodeCount(0), sellNodeCount(0) {}
     // Buy side functions
     void insertBuy(double id, double price, double size, long timestamp, system_clock::time_point updateSocketRxTimestamp);
     void updateBuy(double id, double size, long timestamp, system_clock::time_point updateSocketRxTimestamp);
@@ -81,11 +81,39 @@ public:
     std::pair<double, double> getBestSellLimitPriceAndSize(); 
     bool checkBuySidePriceLevel(double price);
     bool checkSellSidePriceLevel(double price);
+    bool isCrossed();
+    // Top-of-book feeds only publish the best level of each side, which is overwritten in place
+    void setTopOfBook(double bidPrice, double bidSize, double askPrice, double askSize, long updateExchangeTimestamp, system_clock::time_point updateSocketRxTimestamp);
+    // Takes the liquidity a trade consumed off the side its taker traded against, ahead of the book update that will
+    // confirm it. Returns false when the trade did not touch the known top of the book.
+    bool applyTrade(OrderBookSide takerSide, double price, double size, long updateExchangeTimestamp, system_clock::time_point updateSocketRxTimestamp);
+
+    // Drops every price level and marks the book invalid until markValid() is called after a new snapshot
+    void invalidate(system_clock::time_point updateSocketRxTimestamp);
+    void markValid() {
+        this->valid = true;
+    }
+
+    bool isValid() const {
+        return this->valid;
+    }
+
+    void markConfirmed() {
+        this->inferred = false;
+    }
+
+    bool isInferred() const {
+        return this->inferred;
+    }
 
     std::string getCurrencyPairSymbol() const {
         return this->currencyPairSymbol;
     }
 
+    int getCurrencyPairIdx() const {
+        return this->currencyPairIdx;
+    }
+
     long getMarketUpdateExchangeTimestamp() {
         return this->marketUpdateExchangeRxTimestamp;
     }
@@ -1,75 +1,78 @@
 #include "OrderManager.hpp"
 #include "OrderManagerUtils.hpp"
+#include "../Exchanges/ExchangePolicies.hpp"
 
-#define TX_DEFAULT_BUF_SIZE 128
 #define CPU_CORE_INDEX_FOR_ORDER_MANAGER_THREAD 4
 #define HEARTBEAT_SENDER_PERIOD_IN_SECONDS 80 
-#define NUMBER_OF_IO_URING_SQ_ENTRIES 300
-#define REST_API_ADD_ORDER_REQUEST_METHOD "POST"
-
-#if defined(USE_BITMEX_EXCHANGE) || defined(USE_BITMEX_MOCK_EXCHANGE)
-    #define EXCHANGE_HOST_NAME "bitmex.com"
-#elif defined(USE_KRAKEN_EXCHANGE) || defined(USE_KRAKEN_MOCK_EXCHANGE)
-    #define EXCHANGE_HOST_NAME "api.kraken.com"
-#elif defined(USE_BITMEX_TESTNET_EXCHANGE)
-    #define EXCHANGE_HOST_NAME "testnet.bitmex.com"
-#endif
-
-#if defined(USE_BITMEX_TESTNET_EXCHANGE) || defined(USE_BITMEX_EXCHANGE) || defined(USE_BITMEX_MOCK_EXCHANGE)
-    #define REST_API_ADD_ORDER_REQUEST_URI "/api/v1/order"
-    #define API_KEY "63ObNQpYqaCVrjTuBbhgFm2p"
-    #define API_SECRET "D2OBzpfW-i6FfgmqGnrhpYqKPrxCvIYnu5KZKsZQW_09XkF-"
-#elif defined(USE_KRAKEN_EXCHANGE) || defined(USE_KRAKEN_MOCK_EXCHANGE)
-    #define REST_API_ADD_ORDER_REQUEST_URI "/0/private/AddOrder"
-    #define API_KEY "lKfIwMQfaY32k3Wk90+Ia2CRgvw3IjsFQIUPIJmRU+wShkZc0BqAZuCW"
-    #define API_SECRET "DC9Na40OX2gf8a1bwbSvCwTKnadc1XcuBnWIkwLBRqbD5xMGEDNQTqoOrAwCAotFqppDQuedI6+/cI3S+5FJdg=="
-#endif
+#define ORDER_MANAGER_STARTUP_TIMEOUT_IN_MILLISECONDS 10000
 
 using namespace std::chrono;
 
-int sockfds[ARBITRAGE_BATCH_SIZE];
-struct OrderManagerClient orderManagerClients[ARBITRAGE_BATCH_SIZE];
+// The Order Manager of each traded exchange has connections, templates and staged requests of its own
+template <typename ExchangePolicy>
+struct OrderManagerState {
+    int sockfds[MAX_ORDER_MANAGER_CONNECTIONS];
+    // Indexed by edge, that is by pair and side, only the edges of the pairs of the exchange are filled in
+    std::array<OrderRequestTemplate, tradedPortfolio.numberOfEdges> orderRequestTemplates;
+    std::array<PrestagedOrderRequest, tradedPortfolio.numberOfEdges> prestagedOrderRequests;
+    // The request of each connection is built here from the template of its edge
+    char orderRequests[MAX_ORDER_MANAGER_CONNECTIONS][MAX_ORDER_REQUEST_LENGTH];
+    OrderPrestagingStats orderPrestagingStats;
+    struct OrderManagerClient orderManagerClients[MAX_ORDER_MANAGER_CONNECTIONS];
+    // One connection per leg of the longest cycle the Strategy sends, for each batch in flight
+    int numberOfConnections = ARBITRAGE_BATCH_SIZE;
+    int numberOfBatchSlots = 1;
+};
+
+template <typename ExchangePolicy>
+static OrderManagerState<ExchangePolicy> orderManagerState;
+
+// The Order Managers share the SSL context, created by whichever starts first
+static std::once_flag sslInitFlag;
 
 static std::ofstream orderManagerDataFile;
 static std::ofstream systemDataFile;
 
 // Sends a heartbeat-kind message for each connection each 80 seconds 
+template <typename ExchangePolicy>
 void sendPeriodicHeartbeat() {
-    for (int i = 0; i < ARBITRAGE_BATCH_SIZE; ++i) { 
-        char unencrypted_signature[ARBITRAGE_BATCH_SIZE][512];
-        char unencrypted_request[ARBITRAGE_BATCH_SIZE][2048];
+    auto& orderManagerClients = orderManagerState<ExchangePolicy>.orderManagerClients;
+    int numberOfConnections = orderManagerState<ExchangePolicy>.numberOfConnections;
+    for (int i = 0; i < numberOfConnections; ++i) { 
+        char unencrypted_signature[MAX_ORDER_MANAGER_CONNECTIONS][512];
+        char unencrypted_request[MAX_ORDER_MANAGER_CONNECTIONS][2048];
     
-#if defined(USE_BITMEX_TESTNET_EXCHANGE) || defined(USE_BITMEX_EXCHANGE) || defined(USE_BITMEX_MOCK_EXCHANGE)
-        char *signature;
-        char expires[ARBITRAGE_BATCH_SIZE][32];
-        time_t now = time(NULL);
-        time_t tenSecondsLater = now + 10;
-        strftime(expires[i], sizeof(expires[i]), "%s", localtime(&tenSecondsLater));
-        snprintf(unencrypted_signature[i], sizeof(unencrypted_signature[i]), "%s%s%s", "GET", "/api/v1/address", expires[i]);
-        signature = generateBitmexApiSignature(API_SECRET, strlen(API_SECRET), unencrypted_signature[i], strlen(unencrypted_signature[i]));
+        if constexpr (ExchangePolicy::api == ExchangeApi::Bitmex) {
+            char *signature;
+            char expires[MAX_ORDER_MANAGER_CONNECTIONS][32];
+            time_t now = time(NULL);
+            time_t tenSecondsLater = now + 10;
+            strftime(expires[i], sizeof(expires[i]), "%s", localtime(&tenSecondsLater));
+            snprintf(unencrypted_signature[i], sizeof(unencrypted_signature[i]), "%s%s%s", "GET", "/api/v1/address", expires[i]);
+            signature = generateBitmexApiSignature(ExchangePolicy::apiSecret, strlen(ExchangePolicy::apiSecret), unencrypted_signature[i], strlen(unencrypted_signature[i]));
         
-        sprintf(unencrypted_request[i], "GET /api/v1/address HTTP/1.1\r\n"
-                                        "Host: %s\r\n"
-                                        "api-key: %s\r\n"
-                                        "api-expires: %s\r\n"
-                                        "api-signature: %s\r\n"
-                                        "Connection: keep-alive\r\n"
-                                        "\r\n",
-                                        EXCHANGE_HOST_NAME, API_KEY, expires[i], signature);
-#elif defined(USE_KRAKEN_EXCHANGE) || defined(USE_KRAKEN_MOCK_EXCHANGE)
-        std::string nonce = generateNonce();
-        std::string apiSignature = generateKrakenApiSignature(REST_API_ADD_ORDER_REQUEST_URI, nonce, "", API_SECRET);
+            sprintf(unencrypted_request[i], "GET /api/v1/address HTTP/1.1\r\n"
+                                            "Host: %s\r\n"
+                                            "api-key: %s\r\n"
+                                            "api-expires: %s\r\n"
+                                            "api-signature: %s\r\n"
+                                            "Connection: keep-alive\r\n"
+                                            "\r\n",
+                                            ExchangePolicy::restApiHostName, ExchangePolicy::apiKey, expires[i], signature);
+        } else {
+            std::string nonce = generateNonce();
+            std::string apiSignature = generateKrakenApiSignature(ExchangePolicy::addOrderUri, nonce, "", ExchangePolicy::apiSecret);
         
-        sprintf(unencrypted_request[i], "GET /0/private/Balance HTTP/1.1\r\n"
-                                        "Host: %s\r\n"
-                                        "API-Key: %s\r\n"
-                                        "API-Sign: %s\r\n"
-                                        "Content-Type: application/x-www-form-urlencoded; charset=utf-8\r\n"
-                                        "Connection: keep-alive\r\n"
-                                        "\r\n"
-                                        "%s",
-                                        EXCHANGE_HOST_NAME, API_KEY, apiSignature.c_str(), nonce.c_str());
-#endif
+            sprintf(unencrypted_request[i], "GET /0/private/Balance HTTP/1.1\r\n"
+                                            "Host: %s\r\n"
+                                            "API-Key: %s\r\n"
+                                            "API-Sign: %s\r\n"
+                                            "Content-Type: application/x-www-form-urlencoded; charset=utf-8\r\n"
+                                            "Connection: keep-alive\r\n"
+                                            "\r\n"
+                                            "%s",
+                                            ExchangePolicy::restApiHostName, ExchangePolicy::apiKey, apiSignature.c_str(), nonce.c_str());
+        }
         send_unencrypted_bytes(&orderManagerClients[i], unencrypted_request[i], strlen(unencrypted_request[i]));
         do_encrypt(&orderManagerClients[i]);
         do_sock_write(&orderManagerClients[i]);
@@ -81,318 +84,385 @@ void sendPeriodicHeartbeat() {
     }
 }
 
-void orderManager(SPSCQueue<StrategyComponentToOrderManagerQueueEntry>& strategyToOrderManagerQueue, int bookBuilderPipeEnd) {
-    int numCores = std::thread::hardware_concurrency();
+// The cycle a group of connections is sending, until the exchange has answered each of its orders
+struct OrderBatchSlot {
+    bool inFlight;
+    int numberOfResponses;
+    StrategyComponentToOrderManagerQueueEntry orderQueueEntry;
+    std::chrono::system_clock::time_point exchangeExecutionTimestamps[MAX_ARBITRAGE_BATCH_SIZE];
+};
+
+// Prepares, signs, encrypts and sends the orders of one cycle, one per connection from the first one of its batch slot
+template <typename ExchangePolicy, typename Backend>
+static bool sendOrderBatch(Backend& networkBackend, int firstConnectionIdx, const StrategyComponentToOrderManagerQueueEntry& orderQueueEntry) {
+    OrderManagerState<ExchangePolicy>& state = orderManagerState<ExchangePolicy>;
+    auto& orderManagerClients = state.orderManagerClients;
+    std::chrono::system_clock::time_point exchangeUpdateTxTimepoints[MAX_ARBITRAGE_BATCH_SIZE];
+    std::chrono::system_clock::time_point orderBookFinalChangeTimestamps[MAX_ARBITRAGE_BATCH_SIZE];
+    std::chrono::system_clock::time_point strategyComponentOrderPushTimstamps[MAX_ARBITRAGE_BATCH_SIZE];
+    std::chrono::system_clock::time_point orderManagerOrderDetectionTimepoints[MAX_ARBITRAGE_BATCH_SIZE];
+    int writeResults[MAX_ARBITRAGE_BATCH_SIZE];
+
+    int numberOfOrdersInBatch = orderQueueEntry.numberOfOrders;
+    std::chrono::system_clock::time_point arbitrageOrdersPopTimestamp = high_resolution_clock::now();
+    std::chrono::system_clock::time_point arbitrageFirstOrderPushTimestamp = nanosecondsToTimePoint(orderQueueEntry.strategyOrderPushTimestamp);
     
+    for (int i = 0; i < numberOfOrdersInBatch; ++i) {    
+        const ArbitrageOrder& order = orderQueueEntry.orders[i];
+        int edgeId = order.side == OrderSide::Sell ? tradedPortfolio.sellEdgeIdOfPair[order.currencyPairIdx] : tradedPortfolio.buyEdgeIdOfPair[order.currencyPairIdx];
+        const OrderRequestTemplate& orderRequestTemplate = state.orderRequestTemplates[edgeId];
+        system_clock::time_point orderDetectionTimepoint = high_resolution_clock::now();
+        orderManagerOrderDetectionTimepoints[i] = orderDetectionTimepoint;
+        exchangeUpdateTxTimepoints[i] = nanosecondsToTimePoint(orderQueueEntry.marketUpdateExchangeTimestamp);
+        orderBookFinalChangeTimestamps[i] = nanosecondsToTimePoint(orderQueueEntry.orderBookFinalChangeTimestamp);
+        strategyComponentOrderPushTimstamps[i] = nanosecondsToTimePoint(orderQueueEntry.strategyOrderPushTimestamp);
+
+        // A staged request of the edge only misses its volume and its signature, otherwise the template of the edge is
+        // copied and patched
+        steady_clock::time_point preparationStartTimestamp = steady_clock::now();
+        PrestagedOrderRequest& prestagedOrderRequest = state.prestagedOrderRequests[edgeId];
+        if (isPrestagedOrderRequestUsable(prestagedOrderRequest, preparationStartTimestamp, state.orderPrestagingStats)) {
+            int requestLength = completePrestagedOrderRequest<ExchangePolicy>(prestagedOrderRequest, orderRequestTemplate, order.volumeInLots, order.lotDecimals);
+            send_unencrypted_bytes(&orderManagerClients[firstConnectionIdx + i], prestagedOrderRequest.request, requestLength);
+            recordOrderPreparation(state.orderPrestagingStats, true, duration_cast<nanoseconds>(steady_clock::now() - preparationStartTimestamp).count());
+            continue;
+        }
+
+        char* orderRequest = state.orderRequests[firstConnectionIdx + i];
+        int requestLength = buildOrderRequest<ExchangePolicy>(orderRequest, orderRequestTemplate, order.volumeInLots, order.lotDecimals);
+        send_unencrypted_bytes(&orderManagerClients[firstConnectionIdx + i], orderRequest, requestLength);
+        recordOrderPreparation(state.orderPrestagingStats, false, duration_cast<nanoseconds>(steady_clock::now() - preparationStartTimestamp).count());
+    }
+    std::chrono::system_clock::time_point requestsPreparationCompletionTimestamp = high_resolution_clock::now();
+
+    for (int i = 0; i < numberOfOrdersInBatch; ++i) {
+        do_encrypt(&orderManagerClients[firstConnectionIdx + i]);
+    }
+    std::chrono::system_clock::time_point requestsEncryptionCompletionTimestamp = high_resolution_clock::now();
+
+    int socketSlots[MAX_ARBITRAGE_BATCH_SIZE];
+    struct iovec writeBuffers[MAX_ARBITRAGE_BATCH_SIZE];
+    for (int i = 0; i < numberOfOrdersInBatch; ++i) {
+        socketSlots[i] = firstConnectionIdx + i;
+        writeBuffers[i].iov_base = orderManagerClients[firstConnectionIdx + i].writeBuffer;
+        writeBuffers[i].iov_len = orderManagerClients[firstConnectionIdx + i].writeLen;
+    }
+
+    int ret = networkBackend.sendBatch(socketSlots, writeBuffers, writeResults, numberOfOrdersInBatch);
+    if (ret < 0) {
+        errno = -ret;
+        perror("Order batch submission failed");
+        return false;
+    }
+
+    system_clock::time_point socketWritesCompletionTimestamp = high_resolution_clock::now();
+
+    for (int i = 0; i < numberOfOrdersInBatch; ++i) {
+        if (writeResults[i] <= 0) {
+            errno = -writeResults[i];
+            perror("Order write error");
+            return false;
+        }
+        
+        // Read response
+        if (writeResults[i] > 0) {
+            if ((size_t)writeResults[i] < orderManagerClients[firstConnectionIdx + i].writeLen)
+                memmove(orderManagerClients[firstConnectionIdx + i].writeBuffer, orderManagerClients[firstConnectionIdx + i].writeBuffer+writeResults[i], orderManagerClients[firstConnectionIdx + i].writeLen - writeResults[i]);
+            orderManagerClients[firstConnectionIdx + i].writeLen -= writeResults[i];
+            orderManagerClients[firstConnectionIdx + i].writeBuffer = (char*)realloc(orderManagerClients[firstConnectionIdx + i].writeBuffer, orderManagerClients[firstConnectionIdx + i].writeLen);
+        }
+        else
+            return false;
+    }
+    return true;
+
+}
+
+// Sends the cycles of the Strategy and reads the responses of the exchange, compiled for the backend of the connections.
+// Returns when an order batch could not be sent.
+template <typename ExchangePolicy, typename Backend>
+static void runOrderManagerLoop(Backend& networkBackend, SPSCQueue<StrategyComponentToOrderManagerQueueEntry>& strategyToOrderManagerQueue,
+                                SPSCQueue<int>& strategyToOrderManagerPrestagingQueue, int maxNumberOfOrdersInBatch, InFlightCycleRegistry& inFlightCycleRegistry,
+                                struct pollfd* fdset) {
+    OrderManagerState<ExchangePolicy>& state = orderManagerState<ExchangePolicy>;
+    auto& orderManagerClients = state.orderManagerClients;
+    int numberOfConnections = state.numberOfConnections;
+    // Each batch slot owns its own connections, so that the cycles the Strategy sends from one batch of books are in
+    // flight at once. The responses are polled without blocking to take the next cycle as soon as a slot is free.
+    OrderBatchSlot orderBatchSlots[MAX_CONCURRENT_ARBITRAGE_BATCHES] = {};
+    bool isResponsePending[MAX_ORDER_MANAGER_CONNECTIONS] = {};
+    int numberOfBatchesInFlight = 0;
+    while (true) {
+        bool isBatchSent = false;
+        for (int slotIdx = 0; slotIdx < state.numberOfBatchSlots; ++slotIdx) {
+            OrderBatchSlot& orderBatchSlot = orderBatchSlots[slotIdx];
+            if (orderBatchSlot.inFlight)
+                continue;
+            // One entry holds every leg of the cycle
+            if (!strategyToOrderManagerQueue.pop(orderBatchSlot.orderQueueEntry))
+                break;
+            int firstConnectionIdx = slotIdx * maxNumberOfOrdersInBatch;
+            if (!sendOrderBatch<ExchangePolicy>(networkBackend, firstConnectionIdx, orderBatchSlot.orderQueueEntry))
+                return;
+            for (int i = 0; i < orderBatchSlot.orderQueueEntry.numberOfOrders; ++i)
+                isResponsePending[firstConnectionIdx + i] = true;
+            orderBatchSlot.inFlight = true;
+            orderBatchSlot.numberOfResponses = 0;
+            numberOfBatchesInFlight++;
+            isBatchSent = true;
+        }
+
+        // The requests of the edges the Strategy expects to trade soon are staged while there is nothing to send, one
+        // at a time so that a cycle arriving meanwhile waits for at most one staging
+        int edgeId;
+        if (!isBatchSent && strategyToOrderManagerPrestagingQueue.pop(edgeId))
+            stageOrderRequest<ExchangePolicy>(state.prestagedOrderRequests[edgeId], state.orderRequestTemplates[edgeId], state.orderPrestagingStats);
+
+        if (numberOfBatchesInFlight == 0)
+            continue;
+
+        int nready = poll(&fdset[0], numberOfConnections, 0);
+        if (nready <= 0)
+            continue; /* no fd ready */
+
+        for (int i = 0; i < numberOfConnections; ++i) {
+            int revents = fdset[i].revents;
+            if (!isResponsePending[i])
+                continue;
+            if (revents & POLLIN) {
+                int bytes_read = do_sock_read(&orderManagerClients[i], false);
+                size_t last_char_index = strlen(orderManagerClients[i].response_buf) - 1;
+                if (orderManagerClients[i].response_buf[last_char_index] == '}') {
+                    OrderBatchSlot& orderBatchSlot = orderBatchSlots[i / maxNumberOfOrdersInBatch];
+                    orderBatchSlot.exchangeExecutionTimestamps[i % maxNumberOfOrdersInBatch] = convertTimestampToTimePoint(extract_json(std::string(orderManagerClients[i].response_buf)).FindMember("transactTime")->value.GetString());
+
+                    // std::cout
+                    // << "\n===========================================================================================\n"
+                    // << "NEW ORDER EXECUTED\n"
+                    // << "\n===========================================================================================\n"
+                    // << std::endl;
+
+                    memset(orderManagerClients[i].response_buf, 0, sizeof(orderManagerClients[i].response_buf));
+                    isResponsePending[i] = false;
+                    if (++orderBatchSlot.numberOfResponses == orderBatchSlot.orderQueueEntry.numberOfOrders) {
+                        // The Strategy may send the same cycle again once the Order Managers of all its legs are done
+                        completeInFlightCycle(inFlightCycleRegistry, orderBatchSlot.orderQueueEntry.inFlightSlotIdx, orderBatchSlot.orderQueueEntry.cycleId,
+                                              getTradedExchangeIdx<ExchangePolicy>());
+                        orderBatchSlot.inFlight = false;
+                        numberOfBatchesInFlight--;
+                    }
+                }
+            }
+        }
+    }
+}
+
+template <typename ExchangePolicy>
+void orderManager(SPSCQueue<StrategyComponentToOrderManagerQueueEntry>& strategyToOrderManagerQueue, SPSCQueue<int>& strategyToOrderManagerPrestagingQueue, ExchangeEndpoint orderEntryEndpoint, NetworkBackendType networkBackendType, int bookBuilderPipeEnd, int maxNumberOfOrdersInBatch,
+                  int numberOfConcurrentBatches, InFlightCycleRegistry& inFlightCycleRegistry) {
+    constexpr int exchangeIdx = getTradedExchangeIdx<ExchangePolicy>();
+    if (exchangeIdx < 0) {
+        std::cerr << "Error: " << ExchangePolicy::name << " is not a traded exchange." << std::endl;
+        return;
+    }
+    OrderManagerState<ExchangePolicy>& state = orderManagerState<ExchangePolicy>;
+    auto& sockfds = state.sockfds;
+    auto& orderManagerClients = state.orderManagerClients;
+
+    int numCores = std::thread::hardware_concurrency();
+    int cpuCoreNumberForOrderManagerThread = CPU_CORE_INDEX_FOR_ORDER_MANAGER_THREAD + exchangeIdx * CPU_CORE_STRIDE_OF_TRADED_EXCHANGES;
+
     if (numCores == 0) {
         std::cerr << "Error: Unable to determine the number of CPU cores." << std::endl;
         return;
-    } else if (numCores < CPU_CORE_INDEX_FOR_ORDER_MANAGER_THREAD) {
+    } else if (numCores < cpuCoreNumberForOrderManagerThread) {
         std::cerr << "Error: Not enough cores to run the system." << std::endl;
         return;
     }
 
-    int cpuCoreNumberForOrderManagerThread = CPU_CORE_INDEX_FOR_ORDER_MANAGER_THREAD;
-
     setThreadAffinity(pthread_self(), cpuCoreNumberForOrderManagerThread);
 
-#if defined(USE_BITMEX_EXCHANGE)
-    int port = 443;
-    const char* host_ip = "18.165.242.94";
-    const char * host_name = "bitmex.com";
-#elif defined(USE_BITMEX_TESTNET_EXCHANGE)
-    int port = 443;
-    const char* host_ip = "104.18.32.75";
-    const char * host_name = "testnet.bitmex.com";
-#elif defined(USE_KRAKEN_EXCHANGE) 
-    int port = 443;
-    const char* host_ip = "104.17.186.205";
-    const char * host_name = "api.kraken.com";
-#elif defined(USE_KRAKEN_MOCK_EXCHANGE) || defined(USE_BITMEX_MOCK_EXCHANGE)
-    int port = 12345;
-    const char* host_ip = "146.169.41.107";
-    const char * host_name;
-#endif
+    if (maxNumberOfOrdersInBatch < ARBITRAGE_BATCH_SIZE || maxNumberOfOrdersInBatch > MAX_ARBITRAGE_BATCH_SIZE) {
+        std::cerr << "Error: the Order Manager sends batches of " << ARBITRAGE_BATCH_SIZE << " to " << MAX_ARBITRAGE_BATCH_SIZE << " orders." << std::endl;
+        return;
+    }
+    if (numberOfConcurrentBatches < 1 || numberOfConcurrentBatches > MAX_CONCURRENT_ARBITRAGE_BATCHES) {
+        std::cerr << "Error: the Order Manager has 1 to " << MAX_CONCURRENT_ARBITRAGE_BATCHES << " batches in flight." << std::endl;
+        return;
+    }
+    state.numberOfBatchSlots = numberOfConcurrentBatches;
+    int numberOfConnections = state.numberOfConnections = maxNumberOfOrdersInBatch * numberOfConcurrentBatches;
+
+    for (size_t edgeId = 0; edgeId < tradedPortfolio.numberOfEdges; edgeId++) {
+        int currencyPairIdx = tradedPortfolio.currencyPairIdxOfEdge[edgeId];
+        if (tradedPortfolio.exchangeIdxOfPair[currencyPairIdx] != exchangeIdx)
+            continue;
+        const char* currencyPairSymbol = tradedPortfolio.currencyPairSymbols[currencyPairIdx].data();
+        OrderTemplate orderTemplate;
+        if (!createOrderTemplate<ExchangePolicy>(orderTemplate, currencyPairSymbol, tradedPortfolio.orderSideOfEdge[edgeId]) ||
+            !createOrderRequestTemplate<ExchangePolicy>(state.orderRequestTemplates[edgeId], orderTemplate))
+            return;
+    }
+    if (!initializeOrderRequestSigning<ExchangePolicy>())
+        return;
+
+    const char* host_name = orderEntryEndpoint.serverName.empty() ? NULL : orderEntryEndpoint.serverName.c_str();
+    struct addrinfo hints, *resolvedAddress;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(orderEntryEndpoint.address.c_str(), std::to_string(orderEntryEndpoint.port).c_str(), &hints, &resolvedAddress) != 0)
+        die("getaddrinfo()");
     int ip_family = AF_INET;
 
-    for (int i = 0; i < ARBITRAGE_BATCH_SIZE; ++i) {
-        sockfds[i] = socket(ip_family, SOCK_STREAM, 0);
+    // The connects and the TLS handshakes of all the sockets are in flight at once, so the Order Manager is ready after
+    // roughly one round trip and one handshake instead of one per socket
+    steady_clock::time_point startupTimestamp = steady_clock::now();
+    for (int i = 0; i < numberOfConnections; ++i) {
+        sockfds[i] = socket(ip_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
 
         if (sockfds[i] < 0)
             die("socket()");
 
-        if (ip_family == AF_INET) {
-            struct sockaddr_in addr;
-            memset(&addr, 0, sizeof(addr));
-            addr.sin_family = ip_family;
-            addr.sin_port = htons(port);
-
-            if (inet_pton(ip_family, host_ip, &(addr.sin_addr)) <= 0)
-                die("inet_pton()");
-
-            if (connect(sockfds[i], (struct sockaddr *) &addr, sizeof(addr)) < 0)
-                die("connect()");
-        }
+        if (connect(sockfds[i], resolvedAddress->ai_addr, resolvedAddress->ai_addrlen) < 0 && errno != EINPROGRESS)
+            die("connect()");
     }
+    freeaddrinfo(resolvedAddress);
 
-    printf("sockets connected\n");
-
-    struct pollfd fdset[ARBITRAGE_BATCH_SIZE];
-    memset(&fdset, 0, sizeof(fdset));
-    for (int i = 0; i < ARBITRAGE_BATCH_SIZE; i++) {
-        fdset[i].fd = sockfds[i];
-        fdset[i].events = POLLERR | POLLHUP | POLLNVAL | POLLIN;
-    }
-
-    ssl_init(0, 0);
-    for (int i = 0; i < ARBITRAGE_BATCH_SIZE; i++) {
+    std::call_once(sslInitFlag, [] { ssl_init(0, 0); });
+    for (int i = 0; i < numberOfConnections; i++) {
         ssl_client_init(&orderManagerClients[i], sockfds[i], SSLMODE_CLIENT);
         if (host_name)
             SSL_set_tlsext_host_name(orderManagerClients[i].ssl, host_name); // TLS SNI
     }
 
-    for (int i = 0; i < ARBITRAGE_BATCH_SIZE; i++) {
-        do_ssl_handshake(&orderManagerClients[i]);
-        printf("Performing SSL handshake\n");
-        while (true) {
-            if (SSL_is_init_finished(orderManagerClients[i].ssl))
-                break;
+    struct pollfd fdset[MAX_ORDER_MANAGER_CONNECTIONS];
+    bool isSocketConnected[MAX_ORDER_MANAGER_CONNECTIONS] = {};
+    double connectMilliseconds[MAX_ORDER_MANAGER_CONNECTIONS], handshakeMilliseconds[MAX_ORDER_MANAGER_CONNECTIONS];
+    int numberOfPendingSockets = numberOfConnections;
+    memset(&fdset, 0, sizeof(fdset));
+    for (int i = 0; i < numberOfConnections; i++)
+        fdset[i].fd = sockfds[i];
 
-            fdset[i].events &= ~POLLOUT;
-            fdset[i].events |= ssl_client_want_write(&orderManagerClients[i]) ? POLLOUT : 0;
+    while (numberOfPendingSockets > 0) {
+        int remainingMilliseconds = ORDER_MANAGER_STARTUP_TIMEOUT_IN_MILLISECONDS - duration_cast<milliseconds>(steady_clock::now() - startupTimestamp).count();
+        if (remainingMilliseconds <= 0)
+            die("Order Manager connection establishment timed out");
 
-            int nready = poll(&fdset[0], ARBITRAGE_BATCH_SIZE, -1);
+        for (int i = 0; i < numberOfConnections; i++) {
+            // A pending connect shows up as writability, an ongoing handshake waits for the peer unless it has bytes to send
+            if (!isSocketConnected[i])
+                fdset[i].events = POLLOUT;
+            else
+                fdset[i].events = POLLIN | (ssl_client_want_write(&orderManagerClients[i]) ? POLLOUT : 0);
+        }
+
+        int nready = poll(&fdset[0], numberOfConnections, remainingMilliseconds);
 
-            if (nready == 0)
-                continue; /* no fd ready */
+        if (nready <= 0)
+            continue; /* no fd ready */
 
+        for (int i = 0; i < numberOfConnections; i++) {
             int revents = fdset[i].revents;
+            if (fdset[i].fd < 0 || revents == 0)
+                continue;
+
+            if (!isSocketConnected[i]) {
+                int socketError = 0;
+                socklen_t socketErrorLength = sizeof(socketError);
+                if (getsockopt(sockfds[i], SOL_SOCKET, SO_ERROR, &socketError, &socketErrorLength) < 0 || socketError != 0) {
+                    errno = socketError;
+                    die("connect()");
+                }
+                isSocketConnected[i] = true;
+                connectMilliseconds[i] = duration_cast<microseconds>(steady_clock::now() - startupTimestamp).count() / 1000.0;
+                if (do_ssl_handshake(&orderManagerClients[i]) == SSLSTATUS_FAIL)
+                    die("SSL handshake");
+                continue;
+            }
+
+            // A read of 0 bytes (peer closed) also fails, errno tells it apart from a spurious wakeup
+            errno = 0;
             if (revents & POLLIN)
-                if (do_sock_read(&orderManagerClients[i], true) == -1)
-                    break;
+                if (do_sock_read(&orderManagerClients[i], true) == -1 && errno != EAGAIN)
+                    die("SSL handshake read");
 
+            errno = 0;
             if (revents & POLLOUT)
-                if (do_sock_write(&orderManagerClients[i]) == -1)
-                    break;
+                if (do_sock_write(&orderManagerClients[i]) == -1 && errno != EAGAIN)
+                    die("SSL handshake write");
 
             if (revents & (POLLERR | POLLHUP | POLLNVAL))
-                break;
+                die("SSL handshake");
 
-            if (orderManagerClients[i].encrypt_len > 0)
-                if (do_encrypt(&orderManagerClients[i]) < 0)
-                    break;
+            if (SSL_is_init_finished(orderManagerClients[i].ssl)) {
+                handshakeMilliseconds[i] = duration_cast<microseconds>(steady_clock::now() - startupTimestamp).count() / 1000.0;
+                // poll ignores negative fds
+                fdset[i].fd = -1;
+                numberOfPendingSockets--;
+            }
         }
     }
 
+    // The Order Manager writes and reads the sockets synchronously from here on
+    for (int i = 0; i < numberOfConnections; i++) {
+        int flags = fcntl(sockfds[i], F_GETFL, 0);
+        if (flags < 0 || fcntl(sockfds[i], F_SETFL, flags & ~O_NONBLOCK) < 0)
+            die("fcntl()");
+        fdset[i].fd = sockfds[i];
+        fdset[i].events = POLLERR | POLLHUP | POLLNVAL | POLLIN;
+    }
+
+    printf("%s Order Manager startup: %d connections ready in %.3f ms\n", ExchangePolicy::name, numberOfConnections,
+           duration_cast<microseconds>(steady_clock::now() - startupTimestamp).count() / 1000.0);
+    for (int i = 0; i < numberOfConnections; i++)
+        printf("    connection %d: TCP connected at %.3f ms, TLS established at %.3f ms\n", i, connectMilliseconds[i], handshakeMilliseconds[i]);
+
     printf("SSL handshake done for all sockets\n");
 
-    struct io_uring ring;
-    struct io_uring_params params;
+    // The Book Builder Gateway always hands over its SQPOLL ring, -1 when it does not run one
+    int bookBuilderRingFd;
+    if (read(bookBuilderPipeEnd, &bookBuilderRingFd, sizeof(bookBuilderRingFd)) != sizeof(bookBuilderRingFd)) {
+        perror("Pipe read error in Order Manager");
+        return;
+    }
 
-    // Initialize io_uring
-    // Use submission queue polling if user has root privileges
-    if (geteuid()) {
-        printf("You need root privileges to run the Order Manager with submission queue polling\n");
-        int ret = io_uring_queue_init(NUMBER_OF_IO_URING_SQ_ENTRIES, &ring, 0);
-        if (ret) {
-            perror("io_uring_queue_init");
-            return;
-        }
-    } else {
-        printf("Running the Order Manager with submission queue polling\n");
-        memset(&params, 0, sizeof(params));
-        params.flags |= IORING_SETUP_SQPOLL;
-
-        int bookBuilderRingFd;
-        if (read(bookBuilderPipeEnd, &bookBuilderRingFd, sizeof(bookBuilderRingFd)) != sizeof(bookBuilderRingFd)) {
-            perror("Pipe read error in Order Manager");
-            return;
-        }
+    NetworkBackendOptions networkBackendOptions;
+    networkBackendOptions.type = networkBackendType;
+    if (networkBackendType == NetworkBackendType::IoUringSqPoll) {
         printf("Book Builder ring fd seen by Order Manager: %d\n", bookBuilderRingFd);
-        params.wq_fd = bookBuilderRingFd;
-
-        params.flags |= IORING_SETUP_ATTACH_WQ;
-        params.sq_thread_idle = 1;
-        int ret = io_uring_queue_init_params(NUMBER_OF_IO_URING_SQ_ENTRIES, &ring, &params);
-        printf("ORDER MANAGER RING WQ_FD: %d\n", ring.ring_fd);
-        if (ret) {
-            perror("io_uring_queue_init");
-            return;
-        }
+        // Share the SQPOLL thread of the Book Builder Gateway instead of starting one more spinning kernel thread
+        networkBackendOptions.attachRingFd = bookBuilderRingFd;
+        networkBackendOptions.sqThreadIdleInMilliseconds = 1;
     }
 
-    if (io_uring_register_files(&ring, sockfds, ARBITRAGE_BATCH_SIZE) < 0) {
-        perror("io_uring_register_files");
+    NetworkBackend* networkBackend = createNetworkBackend(networkBackendOptions);
+    if (!networkBackend) {
+        perror("Order Manager network backend initialization failed");
         return;
     }
+    printf("Running the %s Order Manager with the %s network backend\n", ExchangePolicy::name, getNetworkBackendTypeName(networkBackendType));
 
-    int stop = 0;
-    struct io_uring_sqe *sqe;
-    struct io_uring_cqe *cqe;
-    while (true) {
-        char orderData[ARBITRAGE_BATCH_SIZE][TX_DEFAULT_BUF_SIZE];
-        std::chrono::system_clock::time_point exchangeUpdateTxTimepoints[ARBITRAGE_BATCH_SIZE];
-        std::chrono::system_clock::time_point orderBookFinalChangeTimestamps[ARBITRAGE_BATCH_SIZE];
-        std::chrono::system_clock::time_point strategyComponentOrderPushTimstamps[ARBITRAGE_BATCH_SIZE];
-        std::chrono::system_clock::time_point orderManagerOrderDetectionTimepoints[ARBITRAGE_BATCH_SIZE];
-        char expires[ARBITRAGE_BATCH_SIZE][32];
-        char unencrypted_signature[ARBITRAGE_BATCH_SIZE][256];
-        char unencrypted_request[ARBITRAGE_BATCH_SIZE][1024];
-        const char *signature;
-        StrategyComponentToOrderManagerQueueEntry orderQueueEntries[ARBITRAGE_BATCH_SIZE];
-        int cqeResults[ARBITRAGE_BATCH_SIZE];
-
-        auto lastHeartbeatTransmissionTime = std::chrono::steady_clock::now();
-        for (int i = 0; i < ARBITRAGE_BATCH_SIZE; ++i) {  
-            while (!strategyToOrderManagerQueue.pop(orderQueueEntries[i])) {};
-        }
-        std::chrono::system_clock::time_point arbitrageOrdersPopTimestamp = high_resolution_clock::now();
-        std::chrono::system_clock::time_point arbitrageFirstOrderPushTimestamp = orderQueueEntries[0].strategyOrderPushTimestamp;
-        
-        for (int i = 0; i < ARBITRAGE_BATCH_SIZE; ++i) {    
-            std::string orderData_i = orderQueueEntries[i].order;
-            system_clock::time_point orderDetectionTimepoint = high_resolution_clock::now();
-            strcpy(orderData[i], orderData_i.c_str());
-            orderManagerOrderDetectionTimepoints[i] = orderDetectionTimepoint;
-            exchangeUpdateTxTimepoints[i] = orderQueueEntries[i].marketUpdateExchangeTimestamp;
-            orderBookFinalChangeTimestamps[i] = orderQueueEntries[i].orderBookFinalChangeTimestamp;
-            strategyComponentOrderPushTimstamps[i] = orderQueueEntries[i].strategyOrderPushTimestamp;
-
-            time_t now = time(NULL);
-            time_t tenSecondsLater = now + 10;
-            strftime(expires[i], sizeof(expires[i]), "%s", localtime(&tenSecondsLater));
-
-            snprintf(unencrypted_signature[i], sizeof(unencrypted_signature[i]), "%s%s%s%s", REST_API_ADD_ORDER_REQUEST_URI, REST_API_ADD_ORDER_REQUEST_METHOD, expires[i], orderData[i]);
-
-#if defined(USE_BITMEX_EXCHANGE) || defined(USE_BITMEX_TESTNET_EXCHANGE) || defined(USE_BITMEX_MOCK_EXCHANGE)
-            signature = generateBitmexApiSignature(API_SECRET, strlen(API_SECRET), unencrypted_signature[i], strlen(unencrypted_signature[i]));
-            sprintf(unencrypted_request[i], 
-                                         "POST /api/v1/order HTTP/1.1\r\n"
-                                         "Host: %s\r\n"
-                                         "api-key: %s\r\n"
-                                         "api-expires: %s\r\n"
-                                         "api-signature: %s\r\n"
-                                         "Content-Type: application/x-www-form-urlencoded\r\n"
-                                         "Content-Length: %zu\r\n"
-                                         "Connection: keep-alive\r\n"
-                                         "\r\n"
-                                         "%s", EXCHANGE_HOST_NAME, API_KEY, expires[i], signature, strlen(orderData[i]), orderData[i]);
-            send_unencrypted_bytes(&orderManagerClients[i], unencrypted_request[i], strlen(unencrypted_request[i]));                                            
-#elif defined(USE_KRAKEN_EXCHANGE) || defined(USE_KRAKEN_MOCK_EXCHANGE)
-            std::string nonce = generateNonce();
-            std::string postData = "nonce=" + nonce + "&" + orderData[i];
-            std::string apiSignature = generateKrakenApiSignature(REST_API_ADD_ORDER_REQUEST_URI, nonce, postData, API_SECRET);
-
-            std::string unencrypted_request = "POST /0/private/AddOrder HTTP/1.1\r\n"
-                                            "Host: " + std::string(EXCHANGE_HOST_NAME) + "\r\n"
-                                            "API-Key: " + std::string(API_KEY) + "\r\n"
-                                            "API-Sign: " + apiSignature + "\r\n"
-                                            "Content-Type: application/x-www-form-urlencoded; charset=utf-8\r\n"
-                                            "Content-Length: " + std::to_string(postData.size()) + "\r\n"
-                                            "Connection: keep-alive\r\n"
-                                            "\r\n" + postData;
-            send_unencrypted_bytes(&orderManagerClients[i], unencrypted_request.c_str(), unencrypted_request.size());
-#endif
-            
-        }
-        std::chrono::system_clock::time_point requestsPreparationCompletionTimestamp = high_resolution_clock::now();
-
-        for (int i = 0; i < ARBITRAGE_BATCH_SIZE; ++i) {
-            do_encrypt(&orderManagerClients[i]);
-        }
-        std::chrono::system_clock::time_point requestsEncryptionCompletionTimestamp = high_resolution_clock::now();
-
-        for (int i = 0; i < ARBITRAGE_BATCH_SIZE; ++i) {
-            sqe = io_uring_get_sqe(&ring);
-
-            if (!sqe) {
-                perror("io_uring_get_sqe");
-                io_uring_queue_exit(&ring);
-                return;
-            }
-
-            io_uring_prep_write(sqe, i, orderManagerClients[i].writeBuffer, orderManagerClients[i].writeLen, 0);
-            sqe->flags |= IOSQE_FIXED_FILE;
-        }
-
-        if (io_uring_submit(&ring) < 0) {
-            perror("io_uring_submit");
-            io_uring_queue_exit(&ring);
-            return;
-        }
-        
-        // Wait for completions
-        for (int i = 0; i < ARBITRAGE_BATCH_SIZE; ++i) {
-            int ret = io_uring_wait_cqe(&ring, &cqe);
-            if (ret < 0) {
-                perror("Error waiting for completion: %s\n");
-                return;
-            }
-            cqeResults[i] = cqe->res;
-            io_uring_cqe_seen(&ring, cqe);
-        }
-
-        system_clock::time_point socketWritesCompletionTimestamp = high_resolution_clock::now();
-
-        for (int i = 0; i < ARBITRAGE_BATCH_SIZE; ++i) {
-            if (cqeResults[i] <= 0) {
-                perror("io_uring completion error");
-                return;
-            }
-            
-            // Read response
-            if (cqeResults[i] > 0) {
-                if ((size_t)cqeResults[i] < orderManagerClients[i].writeLen)
-                    memmove(orderManagerClients[i].writeBuffer, orderManagerClients[i].writeBuffer+cqeResults[i], orderManagerClients[i].writeLen - cqeResults[i]);
-                orderManagerClients[i].writeLen -= cqeResults[i];
-                orderManagerClients[i].writeBuffer = (char*)realloc(orderManagerClients[i].writeBuffer, orderManagerClients[i].writeLen);
-            }
-            else
-                return;   
-        }
-
-        std::chrono::system_clock::time_point exchangeExecutionTimestamps[ARBITRAGE_BATCH_SIZE];
-        int break_polling = 0;
-        while (true) {
-            int nready = poll(&fdset[0], ARBITRAGE_BATCH_SIZE, -1);
-            if (nready == 0)
-                continue; /* no fd ready */
-
-            for (int i = 0; i < ARBITRAGE_BATCH_SIZE; ++i) {
-                int revents = fdset[i].revents;
-                if (revents & POLLIN) {
-                    int bytes_read = do_sock_read(&orderManagerClients[i], false);
-                    size_t last_char_index = strlen(orderManagerClients[i].response_buf) - 1;
-                    if (orderManagerClients[i].response_buf[last_char_index] == '}') {
-
-                        exchangeExecutionTimestamps[i] = convertTimestampToTimePoint(extract_json(std::string(orderManagerClients[i].response_buf)).FindMember("transactTime")->value.GetString());
-
-                        // std::cout
-                        // << "\n===========================================================================================\n"
-                        // << "NEW ORDER EXECUTED\n"
-                        // << "\n===========================================================================================\n"
-                        // << std::endl;
-
-                        memset(orderManagerClients[i].response_buf, 0, sizeof(orderManagerClients[i].response_buf));
-                        break_polling++;
-                    }
-                }
-
-                if (revents & (POLLERR | POLLHUP | POLLNVAL))
-                    break;
-
-            }
-
-            if (break_polling >= ARBITRAGE_BATCH_SIZE)
-                break;
-        }
-        std::chrono::system_clock::time_point lastOrderExecutionTimestamp = exchangeExecutionTimestamps[ARBITRAGE_BATCH_SIZE - 1];        
+    if (networkBackend->registerSockets(sockfds, numberOfConnections) < 0) {
+        perror("Order Manager socket registration failed");
+        return;
     }
 
-    for (int i = 0; i < ARBITRAGE_BATCH_SIZE; ++i) {
+    dispatchNetworkBackend(*networkBackend, [&](auto& backend) {
+        runOrderManagerLoop<ExchangePolicy>(backend, strategyToOrderManagerQueue, strategyToOrderManagerPrestagingQueue, maxNumberOfOrdersInBatch, inFlightCycleRegistry, fdset);
+    });
+    // The loop only returns when an order batch could not be sent
+    delete networkBackend;
+
+    for (int i = 0; i < numberOfConnections; ++i) {
         close(fdset[i].fd);
         print_ssl_state(&orderManagerClients[i]);
         print_ssl_error();
         ssl_client_cleanup(&orderManagerClients[i]); 
     }
 }
+
+#define INSTANTIATE_ORDER_MANAGER(ExchangePolicy) \
+    template void orderManager<ExchangePolicy>(SPSCQueue<StrategyComponentToOrderManagerQueueEntry>&, SPSCQueue<int>&, ExchangeEndpoint, NetworkBackendType, int, int, int, \
+                                               InFlightCycleRegistry&);
+FOR_EACH_EXCHANGE_POLICY(INSTANTIATE_ORDER_MANAGER)
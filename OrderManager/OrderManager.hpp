@@ -8,7 +8,6 @@
 #include <iomanip>
 #include <thread>
 #include <mutex>
-#include <liburing.h>
 #include <chrono>
 #include <ctime>
 #include <iomanip>
@@ -17,5 +16,13 @@
 #include <unistd.h>
 #include "../SPSCQueue/SPSCQueue.hpp"
 #include "../Utils/Utils.hpp"
+#include "../NetworkIO/NetworkBackend.hpp"
+#include "OrderTemplates.hpp"
+#include "OrderRequestTemplates.hpp"
+#include "OrderPrestaging.hpp"
+#include "../StrategyComponent/InFlightCycleRegistry.hpp"
 
-void orderManager(SPSCQueue<StrategyComponentToOrderManagerQueueEntry>& strategyToOrderManagerQueue, int bookBuilderPipeEnd);
+// Sends the orders of the pairs of one traded exchange, on the cores of its pipeline
+template <typename ExchangePolicy>
+void orderManager(SPSCQueue<StrategyComponentToOrderManagerQueueEntry>& strategyToOrderManagerQueue, SPSCQueue<int>& strategyToOrderManagerPrestagingQueue, ExchangeEndpoint orderEntryEndpoint, NetworkBackendType networkBackendType, int bookBuilderPipeEnd, int maxNumberOfOrdersInBatch,
+                  int numberOfConcurrentBatches, InFlightCycleRegistry& inFlightCycleRegistry);
@@ -9,6 +9,9 @@
 #include <openssl/evp.h>
 #include <rapidjson/document.h>
 #include <arpa/inet.h>
+#include <netdb.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -0,0 +1,67 @@
+// OrderPrestaging.cpp
+
+#include <cstdio>
+#include "OrderPrestaging.hpp"
+#include "../Exchanges/ExchangePolicies.hpp"
+
+// The expiry or nonce is taken at staging, and so is the hash of everything the signature covers before the volume
+template <typename ExchangePolicy>
+void stageOrderRequest(PrestagedOrderRequest& prestagedOrderRequest, const OrderRequestTemplate& orderRequestTemplate, OrderPrestagingStats& stats) {
+    // A request staged again before it was used or expired
+    discardOrderRequestSignature(prestagedOrderRequest.signatureContext);
+    startOrderRequest<ExchangePolicy>(prestagedOrderRequest.request, orderRequestTemplate);
+    hashOrderRequestPrefix<ExchangePolicy>(prestagedOrderRequest.signatureContext, prestagedOrderRequest.request, orderRequestTemplate);
+    prestagedOrderRequest.stagingTimestamp = steady_clock::now();
+    prestagedOrderRequest.staged = true;
+    stats.staged++;
+}
+
+bool isPrestagedOrderRequestUsable(PrestagedOrderRequest& prestagedOrderRequest, steady_clock::time_point now, OrderPrestagingStats& stats) {
+    if (!prestagedOrderRequest.staged)
+        return false;
+    if (now - prestagedOrderRequest.stagingTimestamp > milliseconds(PRESTAGED_REQUEST_LIFETIME_IN_MILLISECONDS)) {
+        discardOrderRequestSignature(prestagedOrderRequest.signatureContext);
+        prestagedOrderRequest.staged = false;
+        stats.expired++;
+        return false;
+    }
+    return true;
+}
+
+template <typename ExchangePolicy>
+int completePrestagedOrderRequest(PrestagedOrderRequest& prestagedOrderRequest, const OrderRequestTemplate& orderRequestTemplate, int64_t volumeInLots,
+                                  int lotDecimals) {
+    writeOrderVolume(prestagedOrderRequest.request + orderRequestTemplate.volumeOffset, volumeInLots, lotDecimals);
+    signOrderRequest<ExchangePolicy>(prestagedOrderRequest.signatureContext, prestagedOrderRequest.request, orderRequestTemplate);
+    prestagedOrderRequest.staged = false;
+    return orderRequestTemplate.length;
+}
+
+void recordOrderPreparation(OrderPrestagingStats& stats, bool prestaged, double preparationNanoseconds) {
+    if (prestaged) {
+        stats.hits++;
+        stats.hitPreparationNanoseconds += preparationNanoseconds;
+    } else {
+        stats.misses++;
+        stats.missPreparationNanoseconds += preparationNanoseconds;
+    }
+    // Nothing to report when the Strategy does not ask for prestaging
+    if (stats.staged > 0 && (stats.hits + stats.misses) % PRESTAGING_STATS_INTERVAL == 0)
+        printOrderPrestagingStats(stats);
+}
+
+void printOrderPrestagingStats(const OrderPrestagingStats& stats) {
+    size_t numberOfOrders = stats.hits + stats.misses;
+    double hitMicroseconds = stats.hits ? stats.hitPreparationNanoseconds / stats.hits / 1000.0 : 0.0;
+    double missMicroseconds = stats.misses ? stats.missPreparationNanoseconds / stats.misses / 1000.0 : 0.0;
+    printf("Order prestaging: %zu orders, %zu staged, %zu expired, hit rate %.1f%%, preparation %.2f us on a hit and %.2f us on a miss",
+           numberOfOrders, stats.staged, stats.expired, numberOfOrders ? 100.0 * stats.hits / numberOfOrders : 0.0, hitMicroseconds, missMicroseconds);
+    if (stats.hits && stats.misses)
+        printf(", %.2f us saved per hit", missMicroseconds - hitMicroseconds);
+    printf("\n");
+}
+
+#define INSTANTIATE_ORDER_PRESTAGING(ExchangePolicy) \
+    template void stageOrderRequest<ExchangePolicy>(PrestagedOrderRequest&, const OrderRequestTemplate&, OrderPrestagingStats&); \
+    template int completePrestagedOrderRequest<ExchangePolicy>(PrestagedOrderRequest&, const OrderRequestTemplate&, int64_t, int);
+FOR_EACH_EXCHANGE_POLICY(INSTANTIATE_ORDER_PRESTAGING)
@@ -0,0 +1,51 @@
+// OrderPrestaging.hpp
+#ifndef ORDER_PRESTAGING_HPP
+#define ORDER_PRESTAGING_HPP
+
+#include <chrono>
+#include <cstdint>
+
+#include "OrderRequestTemplates.hpp"
+
+// BitMEX requests are staged with an expiry 10 seconds ahead, like the ones built on the spot
+#define PRESTAGED_REQUEST_LIFETIME_IN_MILLISECONDS 5000
+// Kraken rejects a staged nonce once a more recent one was sent, unless it is within the nonce window of the API key,
+// counted in nonces, which are microseconds. Prestaging is refused at startup on a smaller window.
+#define MIN_KRAKEN_NONCE_WINDOW_FOR_PRESTAGING (PRESTAGED_REQUEST_LIFETIME_IN_MILLISECONDS * 1000LL)
+// The Strategy asks for an edge again once its staged request is this old, as it is about to expire
+#define PRESTAGING_REQUEST_INTERVAL_IN_MILLISECONDS 2500
+#define PRESTAGING_STATS_INTERVAL 100
+
+using namespace std::chrono;
+
+// The request of an order of one edge, copied from its template and signed up to the volume, which the signatures of
+// both exchanges cover and which is the only part that is not known before the cycle turns profitable
+struct PrestagedOrderRequest {
+    bool staged;
+    steady_clock::time_point stagingTimestamp;
+    // Everything the signature hashes before the volume: the inner HMAC of BitMEX, the nonce and post data of Kraken
+    OrderRequestSignatureContext signatureContext;
+    char request[MAX_ORDER_REQUEST_LENGTH];
+};
+
+struct OrderPrestagingStats {
+    size_t staged;
+    size_t hits;            // Orders sent from a staged request
+    size_t misses;          // Orders built on the spot
+    size_t expired;         // Staged requests dropped unused
+    double hitPreparationNanoseconds;
+    double missPreparationNanoseconds;
+};
+
+template <typename ExchangePolicy>
+void stageOrderRequest(PrestagedOrderRequest& prestagedOrderRequest, const OrderRequestTemplate& orderRequestTemplate, OrderPrestagingStats& stats);
+// Drops the request and counts it as expired when it is too old to be sent
+bool isPrestagedOrderRequestUsable(PrestagedOrderRequest& prestagedOrderRequest, steady_clock::time_point now, OrderPrestagingStats& stats);
+// Writes the volume and the signature into the staged request, which is used up, and returns its length
+template <typename ExchangePolicy>
+int completePrestagedOrderRequest(PrestagedOrderRequest& prestagedOrderRequest, const OrderRequestTemplate& orderRequestTemplate, int64_t volumeInLots,
+                                  int lotDecimals);
+void recordOrderPreparation(OrderPrestagingStats& stats, bool prestaged, double preparationNanoseconds);
+void printOrderPrestagingStats(const OrderPrestagingStats& stats);
+
+#endif // ORDER_PRESTAGING_HPP
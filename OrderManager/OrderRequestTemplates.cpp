@@ -0,0 +1,226 @@
+// OrderRequestTemplates.cpp
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <openssl/core_names.h>
+#include <openssl/evp.h>
+#include <openssl/params.h>
+#include <openssl/sha.h>
+#include "OrderRequestTemplates.hpp"
+#include "../Exchanges/ExchangePolicies.hpp"
+
+// Hexadecimal HMAC-SHA256 of BitMEX, base64 HMAC-SHA512 of Kraken
+#define BITMEX_SIGNATURE_LENGTH (2 * SHA256_DIGEST_LENGTH)
+#define KRAKEN_SIGNATURE_LENGTH (4 * ((SHA512_DIGEST_LENGTH + 2) / 3))
+#define KRAKEN_NONCE_KEY "nonce="
+
+using namespace std::chrono;
+
+// The HMAC is keyed once and duplicated for each signature: HMAC-SHA256 with the raw secret for BitMEX, which has
+// already hashed the URI and the method of the order, HMAC-SHA512 with the decoded secret for Kraken, which has already
+// hashed the URI of AddOrder
+template <typename ExchangePolicy>
+static EVP_MAC_CTX* keyedHmacContext = NULL;
+// The SHA-256 of the nonce and post data that Kraken signs, fetched once rather than looked up for each order
+template <typename ExchangePolicy>
+static EVP_MD* krakenPostDataDigest = NULL;
+// Kraken rejects a nonce that is not above the last one, even for orders sent within the same microsecond
+template <typename ExchangePolicy>
+static int64_t lastKrakenNonce = 0;
+
+static bool keyHmac(EVP_MAC_CTX*& hmacContext, const char* digestName, const unsigned char* key, size_t keyLength, const char* uri, const char* method) {
+    EVP_MAC* hmac = EVP_MAC_fetch(NULL, OSSL_MAC_NAME_HMAC, NULL);
+    if (hmac == NULL) {
+        std::cerr << "Error: HMAC is not available to sign orders" << std::endl;
+        return false;
+    }
+    hmacContext = EVP_MAC_CTX_new(hmac);
+    EVP_MAC_free(hmac);
+    OSSL_PARAM params[] = {OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char*)digestName, 0), OSSL_PARAM_construct_end()};
+    if (hmacContext == NULL || !EVP_MAC_init(hmacContext, key, keyLength, params) ||
+        !EVP_MAC_update(hmacContext, (const unsigned char*)uri, strlen(uri)) ||
+        !EVP_MAC_update(hmacContext, (const unsigned char*)method, strlen(method))) {
+        std::cerr << "Error: the HMAC of the orders could not be keyed" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+template <typename ExchangePolicy>
+bool initializeOrderRequestSigning() {
+    size_t secretLength = strlen(ExchangePolicy::apiSecret);
+
+    if constexpr (ExchangePolicy::api == ExchangeApi::Bitmex) {
+        return keyHmac(keyedHmacContext<ExchangePolicy>, SN_sha256, (const unsigned char*)ExchangePolicy::apiSecret, secretLength, ExchangePolicy::addOrderUri, "POST");
+    } else {
+        // The decoded secret is 3/4 of its base64 length, less the padding
+        unsigned char decodedSecret[256];
+        if (secretLength > 4 * sizeof(decodedSecret) / 3) {
+            std::cerr << "Error: the API secret is too long to sign orders" << std::endl;
+            return false;
+        }
+        int decodedSecretLength = EVP_DecodeBlock(decodedSecret, (const unsigned char*)ExchangePolicy::apiSecret, secretLength);
+        for (size_t i = secretLength; i > 0 && ExchangePolicy::apiSecret[i - 1] == '='; i--)
+            decodedSecretLength--;
+        if (decodedSecretLength < 0) {
+            std::cerr << "Error: the API secret is not base64" << std::endl;
+            return false;
+        }
+
+        krakenPostDataDigest<ExchangePolicy> = EVP_MD_fetch(NULL, SN_sha256, NULL);
+        if (krakenPostDataDigest<ExchangePolicy> == NULL) {
+            std::cerr << "Error: SHA-256 is not available to sign orders" << std::endl;
+            return false;
+        }
+        return keyHmac(keyedHmacContext<ExchangePolicy>, SN_sha512, decodedSecret, decodedSecretLength, ExchangePolicy::addOrderUri, "");
+    }
+}
+
+// Laid out exactly like the requests the Order Manager formatted for each order, with zeroed placeholders
+template <typename ExchangePolicy>
+bool createOrderRequestTemplate(OrderRequestTemplate& orderRequestTemplate, const OrderTemplate& orderTemplate) {
+    OrderRequestTemplate& requestTemplate = orderRequestTemplate;
+    int headerLength, timestampOffset, signatureOffset;
+
+    if constexpr (ExchangePolicy::api == ExchangeApi::Bitmex) {
+        headerLength = snprintf(requestTemplate.request, sizeof(requestTemplate.request),
+                                "POST %s HTTP/1.1\r\n"
+                                "Host: %s\r\n"
+                                "api-key: %s\r\n"
+                                "api-expires: %n%0*d\r\n"
+                                "api-signature: %n%*s\r\n"
+                                "Content-Type: application/x-www-form-urlencoded\r\n"
+                                "Content-Length: %d\r\n"
+                                "Connection: keep-alive\r\n"
+                                "\r\n",
+                                ExchangePolicy::addOrderUri, ExchangePolicy::restApiHostName, ExchangePolicy::apiKey, &timestampOffset,
+                                BITMEX_EXPIRES_LENGTH, 0, &signatureOffset, BITMEX_SIGNATURE_LENGTH, "", orderTemplate.length);
+    } else {
+        int postDataLength = (int)strlen(KRAKEN_NONCE_KEY) + KRAKEN_NONCE_LENGTH + 1 + orderTemplate.length;
+        headerLength = snprintf(requestTemplate.request, sizeof(requestTemplate.request),
+                                "POST %s HTTP/1.1\r\n"
+                                "Host: %s\r\n"
+                                "API-Key: %s\r\n"
+                                "API-Sign: %n%*s\r\n"
+                                "Content-Type: application/x-www-form-urlencoded; charset=utf-8\r\n"
+                                "Content-Length: %d\r\n"
+                                "Connection: keep-alive\r\n"
+                                "\r\n"
+                                KRAKEN_NONCE_KEY "%n%0*d&",
+                                ExchangePolicy::addOrderUri, ExchangePolicy::restApiHostName, ExchangePolicy::apiKey, &signatureOffset,
+                                KRAKEN_SIGNATURE_LENGTH, "", postDataLength, &timestampOffset, KRAKEN_NONCE_LENGTH, 0);
+    }
+
+    if (headerLength < 0 || headerLength + orderTemplate.length >= (int)sizeof(requestTemplate.request)) {
+        std::cerr << "Error: an order request does not fit in " << MAX_ORDER_REQUEST_LENGTH << " bytes" << std::endl;
+        return false;
+    }
+    memcpy(requestTemplate.request + headerLength, orderTemplate.body, orderTemplate.length + 1);
+    requestTemplate.length = headerLength + orderTemplate.length;
+    requestTemplate.timestampOffset = timestampOffset;
+    requestTemplate.signatureOffset = signatureOffset;
+    requestTemplate.bodyOffset = headerLength;
+    requestTemplate.volumeOffset = headerLength + orderTemplate.volumeOffset;
+    return true;
+}
+
+static void writeDigits(char* slot, int64_t value, int numberOfDigits) {
+    for (int i = numberOfDigits - 1; i >= 0; i--) {
+        slot[i] = '0' + value % 10;
+        value /= 10;
+    }
+}
+
+template <typename ExchangePolicy>
+void startOrderRequest(char* request, const OrderRequestTemplate& orderRequestTemplate) {
+    memcpy(request, orderRequestTemplate.request, orderRequestTemplate.length);
+    if constexpr (ExchangePolicy::api == ExchangeApi::Bitmex) {
+        writeDigits(request + orderRequestTemplate.timestampOffset, time(NULL) + BITMEX_REQUEST_EXPIRY_IN_SECONDS, BITMEX_EXPIRES_LENGTH);
+    } else {
+        int64_t microsecondsSinceEpoch = duration_cast<microseconds>(high_resolution_clock::now().time_since_epoch()).count();
+        lastKrakenNonce<ExchangePolicy> = std::max(microsecondsSinceEpoch, lastKrakenNonce<ExchangePolicy> + 1);
+        writeDigits(request + orderRequestTemplate.timestampOffset, lastKrakenNonce<ExchangePolicy>, KRAKEN_NONCE_LENGTH);
+    }
+}
+
+template <typename ExchangePolicy>
+void hashOrderRequestPrefix(OrderRequestSignatureContext& signatureContext, const char* request, const OrderRequestTemplate& orderRequestTemplate) {
+    const OrderRequestTemplate& requestTemplate = orderRequestTemplate;
+    if constexpr (ExchangePolicy::api == ExchangeApi::Bitmex) {
+        // URI, method, expiry and body
+        signatureContext.hmacContext = EVP_MAC_CTX_dup(keyedHmacContext<ExchangePolicy>);
+        EVP_MAC_update(signatureContext.hmacContext, (const unsigned char*)request + requestTemplate.timestampOffset, BITMEX_EXPIRES_LENGTH);
+        EVP_MAC_update(signatureContext.hmacContext, (const unsigned char*)request + requestTemplate.bodyOffset,
+                       requestTemplate.volumeOffset - requestTemplate.bodyOffset);
+    } else {
+        // The nonce, then the whole post data, which starts with the nonce again
+        signatureContext.digestContext = EVP_MD_CTX_new();
+        EVP_DigestInit_ex(signatureContext.digestContext, krakenPostDataDigest<ExchangePolicy>, NULL);
+        EVP_DigestUpdate(signatureContext.digestContext, request + requestTemplate.timestampOffset, KRAKEN_NONCE_LENGTH);
+        int postDataOffset = requestTemplate.timestampOffset - (int)strlen(KRAKEN_NONCE_KEY);
+        EVP_DigestUpdate(signatureContext.digestContext, request + postDataOffset, requestTemplate.volumeOffset - postDataOffset);
+    }
+}
+
+template <typename ExchangePolicy>
+void signOrderRequest(OrderRequestSignatureContext& signatureContext, char* request, const OrderRequestTemplate& orderRequestTemplate) {
+    char* signature = request + orderRequestTemplate.signatureOffset;
+    const char* suffix = request + orderRequestTemplate.volumeOffset;
+    size_t suffixLength = orderRequestTemplate.length - orderRequestTemplate.volumeOffset;
+
+    // The volume and the suffix of the body end the signed message of both exchanges
+    if constexpr (ExchangePolicy::api == ExchangeApi::Bitmex) {
+        static const char hexDigits[] = "0123456789abcdef";
+        unsigned char hmac[SHA256_DIGEST_LENGTH];
+        size_t hmacLength;
+        EVP_MAC_update(signatureContext.hmacContext, (const unsigned char*)suffix, suffixLength);
+        EVP_MAC_final(signatureContext.hmacContext, hmac, &hmacLength, sizeof(hmac));
+        for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
+            signature[2 * i] = hexDigits[hmac[i] >> 4];
+            signature[2 * i + 1] = hexDigits[hmac[i] & 0xf];
+        }
+    } else {
+        unsigned char postDataHash[SHA256_DIGEST_LENGTH], hmac[SHA512_DIGEST_LENGTH];
+        unsigned char encodedHmac[KRAKEN_SIGNATURE_LENGTH + 1];
+        size_t hmacLength;
+        EVP_DigestUpdate(signatureContext.digestContext, suffix, suffixLength);
+        EVP_DigestFinal_ex(signatureContext.digestContext, postDataHash, NULL);
+        signatureContext.hmacContext = EVP_MAC_CTX_dup(keyedHmacContext<ExchangePolicy>);
+        EVP_MAC_update(signatureContext.hmacContext, postDataHash, sizeof(postDataHash));
+        EVP_MAC_final(signatureContext.hmacContext, hmac, &hmacLength, sizeof(hmac));
+        // EVP_EncodeBlock terminates the string, which would overwrite the end of the header line
+        EVP_EncodeBlock(encodedHmac, hmac, sizeof(hmac));
+        memcpy(signature, encodedHmac, KRAKEN_SIGNATURE_LENGTH);
+    }
+    discardOrderRequestSignature(signatureContext);
+}
+
+void discardOrderRequestSignature(OrderRequestSignatureContext& signatureContext) {
+    EVP_MAC_CTX_free(signatureContext.hmacContext);
+    EVP_MD_CTX_free(signatureContext.digestContext);
+    signatureContext.hmacContext = NULL;
+    signatureContext.digestContext = NULL;
+}
+
+template <typename ExchangePolicy>
+int buildOrderRequest(char* request, const OrderRequestTemplate& orderRequestTemplate, int64_t volumeInLots, int lotDecimals) {
+    OrderRequestSignatureContext signatureContext = {};
+    startOrderRequest<ExchangePolicy>(request, orderRequestTemplate);
+    writeOrderVolume(request + orderRequestTemplate.volumeOffset, volumeInLots, lotDecimals);
+    hashOrderRequestPrefix<ExchangePolicy>(signatureContext, request, orderRequestTemplate);
+    signOrderRequest<ExchangePolicy>(signatureContext, request, orderRequestTemplate);
+    return orderRequestTemplate.length;
+}
+
+#define INSTANTIATE_ORDER_REQUEST_TEMPLATES(ExchangePolicy) \
+    template bool initializeOrderRequestSigning<ExchangePolicy>(); \
+    template bool createOrderRequestTemplate<ExchangePolicy>(OrderRequestTemplate&, const OrderTemplate&); \
+    template void startOrderRequest<ExchangePolicy>(char*, const OrderRequestTemplate&); \
+    template void hashOrderRequestPrefix<ExchangePolicy>(OrderRequestSignatureContext&, const char*, const OrderRequestTemplate&); \
+    template void signOrderRequest<ExchangePolicy>(OrderRequestSignatureContext&, char*, const OrderRequestTemplate&); \
+    template int buildOrderRequest<ExchangePolicy>(char*, const OrderRequestTemplate&, int64_t, int);
+FOR_EACH_EXCHANGE_POLICY(INSTANTIATE_ORDER_REQUEST_TEMPLATES)
@@ -0,0 +1,58 @@
+// OrderRequestTemplates.hpp
+#ifndef ORDER_REQUEST_TEMPLATES_HPP
+#define ORDER_REQUEST_TEMPLATES_HPP
+
+#include <cstdint>
+#include <openssl/evp.h>
+
+#include "OrderTemplates.hpp"
+
+#define MAX_ORDER_REQUEST_LENGTH 1024
+// api-expires of BitMEX in seconds and the nonce of Kraken in microseconds since the epoch, both of this many digits
+// until the year 2286
+#define BITMEX_EXPIRES_LENGTH 10
+#define KRAKEN_NONCE_LENGTH 16
+#define BITMEX_REQUEST_EXPIRY_IN_SECONDS 10
+
+// The whole HTTP request of the orders of one edge, laid out once when the Order Manager starts. The expiry or nonce,
+// the signature and the volume have placeholders of a fixed length, so that the Content-Length is known as well and
+// an order only copies the template into the buffer of its connection and patches those bytes.
+struct OrderRequestTemplate {
+    char request[MAX_ORDER_REQUEST_LENGTH];
+    int length;
+    int timestampOffset; // The api-expires header of BitMEX, the nonce of the post data of Kraken
+    int signatureOffset;
+    int bodyOffset;
+    int volumeOffset;
+};
+
+// What the signature of one request has hashed so far: the HMAC of BitMEX, or the SHA-256 of the nonce and post data
+// that the HMAC of Kraken covers. Allocated by hashOrderRequestPrefix and freed once the request is signed or dropped.
+struct OrderRequestSignatureContext {
+    EVP_MAC_CTX* hmacContext;
+    EVP_MD_CTX* digestContext;
+};
+
+// The requests of an exchange are built and signed by the functions of its policy, each with its own keyed HMAC and
+// nonce, so that the Order Managers of two exchanges share nothing
+
+// Decodes the API secret and keys the HMAC once for all the requests
+template <typename ExchangePolicy>
+bool initializeOrderRequestSigning();
+template <typename ExchangePolicy>
+bool createOrderRequestTemplate(OrderRequestTemplate& orderRequestTemplate, const OrderTemplate& orderTemplate);
+// Copies the template into the buffer and writes the current expiry or the next nonce into it
+template <typename ExchangePolicy>
+void startOrderRequest(char* request, const OrderRequestTemplate& orderRequestTemplate);
+// Hashes everything the signature covers before the volume, which is all that depends on the order
+template <typename ExchangePolicy>
+void hashOrderRequestPrefix(OrderRequestSignatureContext& signatureContext, const char* request, const OrderRequestTemplate& orderRequestTemplate);
+// Hashes the volume and the rest of the body, writes the signature into its placeholder and frees the context
+template <typename ExchangePolicy>
+void signOrderRequest(OrderRequestSignatureContext& signatureContext, char* request, const OrderRequestTemplate& orderRequestTemplate);
+void discardOrderRequestSignature(OrderRequestSignatureContext& signatureContext);
+// Builds the request of an order on the spot and returns its length
+template <typename ExchangePolicy>
+int buildOrderRequest(char* request, const OrderRequestTemplate& orderRequestTemplate, int64_t volumeInLots, int lotDecimals);
+
+#endif // ORDER_REQUEST_TEMPLATES_HPP
@@ -0,0 +1,27 @@
+// OrderTemplates.cpp
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include "OrderTemplates.hpp"
+#include "../Exchanges/ExchangePolicies.hpp"
+
+template <typename ExchangePolicy>
+bool createOrderTemplate(OrderTemplate& orderTemplate, const char* currencyPairSymbol, OrderSide orderSide) {
+    int prefixLength = snprintf(orderTemplate.body, sizeof(orderTemplate.body), ExchangePolicy::orderBodyPrefixFormat, currencyPairSymbol,
+                                orderSide == OrderSide::Buy ? ExchangePolicy::buyOrder : ExchangePolicy::sellOrder);
+    int length = prefixLength + ORDER_VOLUME_SLOT_WIDTH + (int)strlen(ExchangePolicy::orderBodySuffix);
+    if (prefixLength < 0 || length >= (int)sizeof(orderTemplate.body)) {
+        std::cerr << "Error: the order body of " << currencyPairSymbol << " does not fit in " << MAX_ORDER_BODY_LENGTH << " bytes" << std::endl;
+        return false;
+    }
+    memset(orderTemplate.body + prefixLength, '0', ORDER_VOLUME_SLOT_WIDTH);
+    memcpy(orderTemplate.body + prefixLength + ORDER_VOLUME_SLOT_WIDTH, ExchangePolicy::orderBodySuffix, strlen(ExchangePolicy::orderBodySuffix) + 1);
+    orderTemplate.length = length;
+    orderTemplate.volumeOffset = prefixLength;
+    return true;
+}
+
+#define INSTANTIATE_ORDER_TEMPLATES(ExchangePolicy) \
+    template bool createOrderTemplate<ExchangePolicy>(OrderTemplate&, const char*, OrderSide);
+FOR_EACH_EXCHANGE_POLICY(INSTANTIATE_ORDER_TEMPLATES)
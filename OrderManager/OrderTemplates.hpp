@@ -0,0 +1,51 @@
+// OrderTemplates.hpp
+#ifndef ORDER_TEMPLATES_HPP
+#define ORDER_TEMPLATES_HPP
+
+#include <cstdint>
+
+#include "../StrategyComponent/Portfolios.hpp"
+
+#define MAX_ORDER_BODY_LENGTH 96
+// Digits and decimal point of the volume, zero-padded on the left so that the body of an order has a fixed length
+#define ORDER_VOLUME_SLOT_WIDTH 18
+#define MAX_LOT_DECIMALS 10
+// The precision std::to_string printed the volumes with, for the pairs without lot_decimals in min-order-sizes.json
+#define DEFAULT_LOT_DECIMALS 6
+
+// The body of the order of one pair and side with everything but the volume filled in
+struct OrderTemplate {
+    char body[MAX_ORDER_BODY_LENGTH];
+    int length;
+    int volumeOffset;   // Where the ORDER_VOLUME_SLOT_WIDTH characters of the volume start in the body
+};
+
+// In the order body format of the exchange of the policy
+template <typename ExchangePolicy>
+bool createOrderTemplate(OrderTemplate& orderTemplate, const char* currencyPairSymbol, OrderSide orderSide);
+
+static constexpr double powersOfTen[MAX_LOT_DECIMALS + 1] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10};
+
+// Truncates the volume to the lot, so that a leg never asks for more than it was sized on. Returns 0 when it rounds to
+// zero lots or would not fit in the volume slot.
+inline int64_t volumeToLots(double volume, int lotDecimals) {
+    double scaledVolume = volume * powersOfTen[lotDecimals] + 1e-6; // A volume of 0.3 scales to 29.999... lots
+    if (!(scaledVolume >= 1.0 && scaledVolume < 1e17))
+        return 0;
+    return (int64_t)scaledVolume;
+}
+
+// Writes the zero-padded volume into the slot of an order, the lots come from volumeToLots
+inline void writeOrderVolume(char* volumeSlot, int64_t lots, int lotDecimals) {
+    int decimalPointPosition = ORDER_VOLUME_SLOT_WIDTH - 1 - lotDecimals;
+    for (int i = ORDER_VOLUME_SLOT_WIDTH - 1; i >= 0; i--) {
+        if (lotDecimals > 0 && i == decimalPointPosition) {
+            volumeSlot[i] = '.';
+            continue;
+        }
+        volumeSlot[i] = '0' + lots % 10;
+        lots /= 10;
+    }
+}
+
+#endif // ORDER_TEMPLATES_HPP
@@ -0,0 +1,592 @@
+// PortfolioOptimizer.cpp
+//
+// Picks the pairs of a portfolio from recorded market data instead of by hand. It replays a recording, one captured
+// websocket message per line (Kraken ticker and book, BitMEX quote) after the local time it was received at, as the
+// Book Builder records them and the Mock Exchange replays them, keeps the best
+// bid and ask of every pair and reports per pair its update rate, the triangles it is part of and how often those
+// turned profitable after fees. Every time a triangle turns profitable is an opportunity, which lasts until one of
+// its books moves it back below the threshold.
+// An opportunity is captured when the system reacts before it is gone. The reaction latency of a portfolio is modelled
+// as a fixed tick-to-trade latency, plus the detection latency, which grows with the cycles per pair and is fitted
+// on the output of bench_strategy, plus the time the updates of the portfolio wait for each other on the given cores.
+// The pairs are added a triangle at a time, each time the one that adds the most captured opportunities per pair,
+// while the cores keep up and the reaction latency stays within the budget. The selection is printed in the format of
+// the portfolio lists of StrategyComponent/Portfolios.hpp.
+//
+// Usage: ./portfolio_optimizer --recording file [--latency-model bench_strategy output] [--algorithm name]
+//                              [--latency-percentile p50|p99|p99.9|max|mean] [--cores n] [--latency-budget-us us]
+//                              [--base-latency-us us] [--update-cost-ns ns] [--max-pairs n] [--name array name]
+//                              [--output file]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "../StrategyComponent/CurrencyGraph.hpp"
+#include "../Utils/Utils.hpp"
+
+#define DEFAULT_CORES 1
+#define DEFAULT_LATENCY_BUDGET_IN_MICROSECONDS 1000.0
+#define DEFAULT_BASE_LATENCY_IN_MICROSECONDS 500.0
+// Building the book and queueing an update to the Strategy, on top of the detection itself
+#define DEFAULT_UPDATE_COST_IN_NANOSECONDS 2000.0
+// Detection latency in ns per cycle of the updated pair when there is no latency model
+#define DEFAULT_DETECTION_NANOSECONDS_PER_CYCLE 5.0
+// Queueing delays explode as a core gets close to saturation, so no core is planned beyond this
+#define MAX_CORE_UTILISATION 0.7
+#define PAIRS_PER_OUTPUT_LINE 6
+// Lifetimes cannot be measured on a recording where most messages have neither a receive time nor an exchange one
+#define MIN_TIMESTAMPED_UPDATES 2
+#define MAX_UNTIMESTAMPED_UPDATE_SHARE 0.5
+#define RECORD_SYMBOL_KEY "\"symbol\":\""
+#define RECORD_TIMESTAMP_KEY "\"timestamp\":\""
+#define RECORD_DATA_ARRAY_KEY "\"data\":["
+#define KRAKEN_TICKER_PATTERN "{\"channel\":\"ticker\""
+#define KRAKEN_BOOK_PATTERN "{\"channel\":\"book\""
+#define KRAKEN_SNAPSHOT_PATTERN "\"type\":\"snapshot\""
+#define BITMEX_QUOTE_PATTERN "{\"table\":\"quote\""
+
+using namespace std::chrono;
+
+struct PortfolioOptimizerConfig {
+    std::string recordingFile;
+    std::string latencyModelFile;
+    std::string algorithm; // Fastest triangle kernel of each graph when empty
+    std::string latencyPercentile = "p99";
+    int cores = DEFAULT_CORES;
+    double latencyBudgetMicroseconds = DEFAULT_LATENCY_BUDGET_IN_MICROSECONDS;
+    double baseLatencyMicroseconds = DEFAULT_BASE_LATENCY_IN_MICROSECONDS;
+    double updateCostNanoseconds = DEFAULT_UPDATE_COST_IN_NANOSECONDS;
+    size_t maxPairs = 0; // No limit but the currencies of the portfolio tables
+    std::string name = "optimizedPortfolioCurrencyPairs";
+    std::string outputFile;
+};
+
+struct PairStats {
+    std::string symbol;
+    int baseCurrency;
+    int quoteCurrency;
+    size_t updates;
+    double bidPrice;
+    double askPrice;
+    // Depth books of the book channel, only their best levels are used
+    std::map<double, double> bids;
+    std::map<double, double> asks;
+    std::vector<int> triangleIds;
+    size_t opportunities; // Of the triangles it is part of
+};
+
+// The two directions of a triangle are tracked apart, each opening and closing its own opportunities
+struct Triangle {
+    int pairIds[3];
+    int currencies[3];
+    bool isProfitable[2];
+    double openingTimestamp[2];
+    std::vector<double> lifetimes; // Of its opportunities in us, sorted once the recording is replayed
+};
+
+// Detection latency in ns as a function of the cycles per pair of the portfolio
+struct LatencyModel {
+    double intercept;
+    double nanosecondsPerCycle;
+};
+
+struct PortfolioEvaluation {
+    bool isFeasible;
+    double reactionLatencyMicroseconds;
+    double coreUtilisation;
+    size_t capturedOpportunities;
+    size_t numberOfTriangles;
+};
+
+static PortfolioOptimizerConfig config;
+static std::vector<std::string> currencyNames;
+static std::unordered_map<std::string, int> currencyIdxOfName;
+static std::vector<PairStats> pairs;
+static std::unordered_map<std::string, int> pairIdxOfSymbol;
+static std::vector<Triangle> triangles;
+static double firstTimestamp = -1, lastTimestamp = -1; // In us
+
+static int getCurrencyIdx(const std::string& currencyName) {
+    auto it = currencyIdxOfName.find(currencyName);
+    if (it != currencyIdxOfName.end())
+        return it->second;
+    currencyNames.push_back(currencyName);
+    return currencyIdxOfName[currencyName] = currencyNames.size() - 1;
+}
+
+// Kraken separates the currencies with a slash, BitMEX symbols end with the quote currency
+static bool splitSymbol(const std::string& symbol, std::string& baseCurrency, std::string& quoteCurrency) {
+    static const char* bitmexQuoteCurrencies[] = {"USDT", "USDC", "USD", "EUR", "ETH", "XBT"};
+    size_t separatorPosition = symbol.find('/');
+    if (separatorPosition != std::string::npos) {
+        baseCurrency = symbol.substr(0, separatorPosition);
+        quoteCurrency = symbol.substr(separatorPosition + 1);
+        return !baseCurrency.empty() && !quoteCurrency.empty();
+    }
+    for (const char* bitmexQuoteCurrency : bitmexQuoteCurrencies) {
+        size_t length = strlen(bitmexQuoteCurrency);
+        if (symbol.size() > length && symbol.compare(symbol.size() - length, length, bitmexQuoteCurrency) == 0) {
+            baseCurrency = symbol.substr(0, symbol.size() - length);
+            quoteCurrency = bitmexQuoteCurrency;
+            return true;
+        }
+    }
+    return false;
+}
+
+static int getPairIdx(const std::string& symbol) {
+    auto it = pairIdxOfSymbol.find(symbol);
+    if (it != pairIdxOfSymbol.end())
+        return it->second;
+    std::string baseCurrency, quoteCurrency;
+    if (!splitSymbol(symbol, baseCurrency, quoteCurrency))
+        return -1;
+    PairStats pair = {};
+    pair.symbol = symbol;
+    pair.baseCurrency = getCurrencyIdx(baseCurrency);
+    pair.quoteCurrency = getCurrencyIdx(quoteCurrency);
+    pairs.push_back(pair);
+    return pairIdxOfSymbol[symbol] = pairs.size() - 1;
+}
+
+static const char* findField(const char* start, const char* end, const char* key) {
+    size_t keyLength = strlen(key);
+    const char* field = std::search(start, end, key, key + keyLength);
+    return field == end ? NULL : field + keyLength;
+}
+
+static std::string getStringField(const char* start, const char* end, const char* key) {
+    const char* field = findField(start, end, key);
+    const char* fieldEnd = field ? (const char*)memchr(field, '"', end - field) : NULL;
+    return fieldEnd ? std::string(field, fieldEnd) : std::string();
+}
+
+// Applies the levels of a bids or asks array of the Kraken book channel, a quantity of 0 removes the level
+static void applyBookLevels(const char* record, const char* recordEnd, const char* sideKey, std::map<double, double>& levels) {
+    const char* level = findField(record, recordEnd, sideKey);
+    const char* levelsEnd = level ? (const char*)memchr(level, ']', recordEnd - level) : NULL;
+    if (!levelsEnd)
+        return;
+    const char* price;
+    const char* quantity;
+    for (; (level = (const char*)memchr(level, '{', levelsEnd - level)) != NULL; level++) {
+        const char* levelEnd = (const char*)memchr(level, '}', levelsEnd - level);
+        if (!levelEnd || !(price = findField(level, levelEnd, "\"price\":")) || !(quantity = findField(level, levelEnd, "\"qty\":")))
+            break;
+        double qty = strtod(quantity, NULL);
+        if (qty > 0)
+            levels[strtod(price, NULL)] = qty;
+        else
+            levels.erase(strtod(price, NULL));
+    }
+}
+
+static bool isCycleProfitable(const Triangle& triangle, int direction) {
+    double logRate = 0;
+    for (int leg = 0; leg < 3; leg++) {
+        // Forward u -> v -> w -> u, backward u -> w -> v -> u
+        int sourceCurrency = triangle.currencies[direction == 0 ? leg : (3 - leg) % 3];
+        int targetCurrency = triangle.currencies[direction == 0 ? (leg + 1) % 3 : 2 - leg];
+        const PairStats* pair = NULL;
+        for (int pairId : triangle.pairIds)
+            if ((pairs[pairId].baseCurrency == sourceCurrency && pairs[pairId].quoteCurrency == targetCurrency) ||
+                (pairs[pairId].baseCurrency == targetCurrency && pairs[pairId].quoteCurrency == sourceCurrency))
+                pair = &pairs[pairId];
+        double rate = pair->baseCurrency == sourceCurrency ? pair->bidPrice : (pair->askPrice > 0 ? 1.0 / pair->askPrice : 0.0);
+        if (rate <= 0)
+            return false;
+        logRate += log(rate * AFTER_FEE_RATE);
+    }
+    return logRate > CYCLE_LOG_RATE_THRESHOLD;
+}
+
+// Only the triangles through the updated pair can change, as in the Strategy
+static void onPairUpdate(int pairIdx, double timestamp) {
+    for (int triangleId : pairs[pairIdx].triangleIds) {
+        Triangle& triangle = triangles[triangleId];
+        for (int direction = 0; direction < 2; direction++) {
+            bool isProfitable = isCycleProfitable(triangle, direction);
+            if (isProfitable && !triangle.isProfitable[direction]) {
+                triangle.openingTimestamp[direction] = timestamp;
+                for (int pairId : triangle.pairIds)
+                    pairs[pairId].opportunities++;
+            } else if (!isProfitable && triangle.isProfitable[direction]) {
+                triangle.lifetimes.push_back(timestamp - triangle.openingTimestamp[direction]);
+            }
+            triangle.isProfitable[direction] = isProfitable;
+        }
+    }
+}
+
+struct RecordedUpdate {
+    int pairIdx;
+    double timestamp; // In us, -1 when the record has none
+};
+
+// Reads the symbols and prices of the recording, the triangles are only known once every pair was seen
+static bool readRecording(const std::string& path, std::vector<RecordedUpdate>& updates, std::vector<std::pair<double, double>>& prices) {
+    std::ifstream file(path);
+    if (!file) {
+        perror(path.c_str());
+        return false;
+    }
+    std::string line;
+    long long receiveTimestamp;
+    while (std::getline(file, line)) {
+        const char* lineStart = skipRecordedReceiveTimestamp(line.c_str(), receiveTimestamp);
+        const char* lineEnd = line.c_str() + line.size();
+        bool isTicker = strncmp(lineStart, KRAKEN_TICKER_PATTERN, strlen(KRAKEN_TICKER_PATTERN)) == 0;
+        bool isQuote = strncmp(lineStart, BITMEX_QUOTE_PATTERN, strlen(BITMEX_QUOTE_PATTERN)) == 0;
+        bool isBook = strncmp(lineStart, KRAKEN_BOOK_PATTERN, strlen(KRAKEN_BOOK_PATTERN)) == 0;
+        const char* record = strstr(lineStart, RECORD_DATA_ARRAY_KEY);
+        if (!(isTicker || isQuote || isBook) || !record)
+            continue;
+
+        std::string symbol = getStringField(record, lineEnd, RECORD_SYMBOL_KEY);
+        int pairIdx = symbol.empty() ? -1 : getPairIdx(symbol);
+        if (pairIdx < 0)
+            continue;
+        PairStats& pair = pairs[pairIdx];
+        // The receive time goes first so that the whole recording is on one clock, the exchange time is only for bare messages
+        std::string timestamp = getStringField(record, lineEnd, RECORD_TIMESTAMP_KEY);
+        double timestampInMicroseconds = receiveTimestamp >= 0 ? receiveTimestamp : timestamp.empty() ? -1 : timePointToMicroseconds(convertTimestampToTimePoint(timestamp));
+
+        const char* field;
+        if (isBook) {
+            if (strstr(lineStart, KRAKEN_SNAPSHOT_PATTERN)) {
+                pair.bids.clear();
+                pair.asks.clear();
+            }
+            applyBookLevels(record, lineEnd, "\"bids\":[", pair.bids);
+            applyBookLevels(record, lineEnd, "\"asks\":[", pair.asks);
+            pair.bidPrice = pair.bids.empty() ? 0.0 : pair.bids.rbegin()->first;
+            pair.askPrice = pair.asks.empty() ? 0.0 : pair.asks.begin()->first;
+        } else {
+            const char* bidKey = isTicker ? "\"bid\":" : "\"bidPrice\":";
+            const char* askKey = isTicker ? "\"ask\":" : "\"askPrice\":";
+            if (!(field = findField(record, lineEnd, bidKey)))
+                continue;
+            pair.bidPrice = strtod(field, NULL);
+            if (!(field = findField(record, lineEnd, askKey)))
+                continue;
+            pair.askPrice = strtod(field, NULL);
+        }
+        pair.updates++;
+        updates.push_back({pairIdx, timestampInMicroseconds});
+        prices.emplace_back(pair.bidPrice, pair.askPrice);
+    }
+    return true;
+}
+
+static void enumerateTriangles() {
+    std::map<std::pair<int, int>, int> pairIdxOfCurrencies;
+    for (size_t pairIdx = 0; pairIdx < pairs.size(); pairIdx++) {
+        pairIdxOfCurrencies[{pairs[pairIdx].baseCurrency, pairs[pairIdx].quoteCurrency}] = pairIdx;
+        pairIdxOfCurrencies[{pairs[pairIdx].quoteCurrency, pairs[pairIdx].baseCurrency}] = pairIdx;
+    }
+    // Each triangle once, from the pair of its two smallest currencies
+    for (size_t pairIdx = 0; pairIdx < pairs.size(); pairIdx++) {
+        int u = std::min(pairs[pairIdx].baseCurrency, pairs[pairIdx].quoteCurrency);
+        int v = std::max(pairs[pairIdx].baseCurrency, pairs[pairIdx].quoteCurrency);
+        for (int w = v + 1; w < (int)currencyNames.size(); w++) {
+            auto uw = pairIdxOfCurrencies.find({u, w});
+            auto vw = pairIdxOfCurrencies.find({v, w});
+            if (uw == pairIdxOfCurrencies.end() || vw == pairIdxOfCurrencies.end())
+                continue;
+            Triangle triangle = {{(int)pairIdx, vw->second, uw->second}, {u, v, w}, {false, false}, {0, 0}, {}};
+            for (int pairId : triangle.pairIds)
+                pairs[pairId].triangleIds.push_back(triangles.size());
+            triangles.push_back(triangle);
+        }
+    }
+}
+
+static std::vector<std::string> splitWords(const std::string& line) {
+    std::istringstream ss(line);
+    std::vector<std::string> words;
+    std::string word;
+    while (ss >> word)
+        words.push_back(word);
+    return words;
+}
+
+// Least squares fit of the chosen latency column of bench_strategy on the cycles per pair of its graphs
+static bool readLatencyModel(const std::string& path, LatencyModel& latencyModel) {
+    std::ifstream file(path);
+    if (!file) {
+        perror(path.c_str());
+        return false;
+    }
+    std::map<std::string, double> latencyOfGraph, cyclesPerPairOfGraph;
+    int latencyColumn = -1;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::vector<std::string> words = splitWords(line);
+        if (!words.empty() && words[0] == "graph") {
+            for (size_t i = 0; i < words.size(); i++)
+                if (words[i] == config.latencyPercentile)
+                    latencyColumn = i;
+            continue;
+        }
+        if (latencyColumn < 0 || (int)words.size() <= latencyColumn)
+            continue;
+        const std::string& algorithm = words[3];
+        bool isSelected = config.algorithm.empty() ? algorithm.compare(0, strlen("triangles-"), "triangles-") == 0 : algorithm == config.algorithm;
+        if (!isSelected)
+            continue;
+        double latency = atof(words[latencyColumn].c_str());
+        auto it = latencyOfGraph.find(words[0]);
+        if (it == latencyOfGraph.end() || latency < it->second) {
+            latencyOfGraph[words[0]] = latency;
+            cyclesPerPairOfGraph[words[0]] = atof(words[2].c_str());
+        }
+    }
+    if (latencyOfGraph.empty()) {
+        std::cerr << "Error: no " << (config.algorithm.empty() ? "triangles-*" : config.algorithm) << " row with a " << config.latencyPercentile
+                  << " column in " << path << std::endl;
+        return false;
+    }
+
+    double n = latencyOfGraph.size(), sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+    for (const auto& graph : latencyOfGraph) {
+        double x = cyclesPerPairOfGraph[graph.first], y = graph.second;
+        sumX += x;
+        sumY += y;
+        sumXX += x * x;
+        sumXY += x * y;
+    }
+    double variance = n * sumXX - sumX * sumX;
+    latencyModel.nanosecondsPerCycle = variance > 0 ? std::max(0.0, (n * sumXY - sumX * sumY) / variance) : 0.0;
+    latencyModel.intercept = std::max(0.0, (sumY - latencyModel.nanosecondsPerCycle * sumX) / n);
+    return true;
+}
+
+static PortfolioEvaluation evaluatePortfolio(const std::vector<char>& isSelected, size_t numberOfPairs, const LatencyModel& latencyModel,
+                                             double durationInSeconds) {
+    PortfolioEvaluation evaluation = {false, 0, 0, 0, 0};
+    if (numberOfPairs == 0)
+        return evaluation;
+    std::set<int> currencies;
+    double updatesPerSecond = 0;
+    for (size_t pairIdx = 0; pairIdx < pairs.size(); pairIdx++) {
+        if (!isSelected[pairIdx])
+            continue;
+        currencies.insert(pairs[pairIdx].baseCurrency);
+        currencies.insert(pairs[pairIdx].quoteCurrency);
+        updatesPerSecond += pairs[pairIdx].updates / durationInSeconds;
+    }
+    std::vector<const Triangle*> selectedTriangles;
+    for (const Triangle& triangle : triangles)
+        if (isSelected[triangle.pairIds[0]] && isSelected[triangle.pairIds[1]] && isSelected[triangle.pairIds[2]])
+            selectedTriangles.push_back(&triangle);
+    evaluation.numberOfTriangles = selectedTriangles.size();
+
+    // Every triangle is two cycles of each of its three pairs
+    double cyclesPerPair = 6.0 * selectedTriangles.size() / numberOfPairs;
+    double serviceNanoseconds = config.updateCostNanoseconds + latencyModel.intercept + latencyModel.nanosecondsPerCycle * cyclesPerPair;
+    evaluation.coreUtilisation = updatesPerSecond * serviceNanoseconds * 1e-9 / config.cores;
+    // Waiting time of an M/D/1 queue per core
+    double waitNanoseconds = evaluation.coreUtilisation < 1 ? evaluation.coreUtilisation * serviceNanoseconds / (2 * (1 - evaluation.coreUtilisation)) : INFINITY;
+    evaluation.reactionLatencyMicroseconds = config.baseLatencyMicroseconds + (serviceNanoseconds + waitNanoseconds) / 1000.0;
+    evaluation.isFeasible = evaluation.coreUtilisation <= MAX_CORE_UTILISATION && evaluation.reactionLatencyMicroseconds <= config.latencyBudgetMicroseconds &&
+                            currencies.size() <= MAX_NUMBER_OF_CURRENCIES && (config.maxPairs == 0 || numberOfPairs <= config.maxPairs);
+
+    for (const Triangle* triangle : selectedTriangles)
+        evaluation.capturedOpportunities += triangle->lifetimes.end() -
+                                            std::lower_bound(triangle->lifetimes.begin(), triangle->lifetimes.end(), evaluation.reactionLatencyMicroseconds);
+    return evaluation;
+}
+
+// Adds the missing pairs of one triangle at a time, the one with the most captured opportunities gained per pair
+static std::vector<int> selectPairs(const LatencyModel& latencyModel, double durationInSeconds, PortfolioEvaluation& evaluation) {
+    std::vector<char> isSelected(pairs.size(), 0);
+    std::vector<int> selectedPairs;
+    evaluation = evaluatePortfolio(isSelected, 0, latencyModel, durationInSeconds);
+    while (true) {
+        double bestGainPerPair = 0;
+        int bestTriangleId = -1;
+        PortfolioEvaluation bestEvaluation = evaluation;
+        for (size_t triangleId = 0; triangleId < triangles.size(); triangleId++) {
+            const Triangle& triangle = triangles[triangleId];
+            if (triangle.lifetimes.empty())
+                continue;
+            int numberOfAddedPairs = 0;
+            for (int pairId : triangle.pairIds)
+                if (!isSelected[pairId]) {
+                    isSelected[pairId] = 1;
+                    numberOfAddedPairs++;
+                }
+            if (numberOfAddedPairs == 0)
+                continue;
+            PortfolioEvaluation candidateEvaluation = evaluatePortfolio(isSelected, selectedPairs.size() + numberOfAddedPairs, latencyModel, durationInSeconds);
+            double gainPerPair = ((double)candidateEvaluation.capturedOpportunities - evaluation.capturedOpportunities) / numberOfAddedPairs;
+            if (candidateEvaluation.isFeasible && gainPerPair > bestGainPerPair) {
+                bestGainPerPair = gainPerPair;
+                bestTriangleId = triangleId;
+                bestEvaluation = candidateEvaluation;
+            }
+            for (int pairId : triangle.pairIds)
+                isSelected[pairId] = std::find(selectedPairs.begin(), selectedPairs.end(), pairId) != selectedPairs.end();
+        }
+        if (bestTriangleId < 0)
+            break;
+        for (int pairId : triangles[bestTriangleId].pairIds)
+            if (!isSelected[pairId]) {
+                isSelected[pairId] = 1;
+                selectedPairs.push_back(pairId);
+            }
+        evaluation = bestEvaluation;
+    }
+    return selectedPairs;
+}
+
+static void writePortfolio(std::ostream& out, const std::vector<int>& selectedPairs, const PortfolioEvaluation& evaluation, double durationInSeconds) {
+    out << "// " << selectedPairs.size() << " pairs selected by portfolio_optimizer from " << config.recordingFile << ": " << evaluation.numberOfTriangles
+        << " triangles, " << evaluation.capturedOpportunities * 3600.0 / durationInSeconds << " captured opportunities per hour at "
+        << evaluation.reactionLatencyMicroseconds << " us" << std::endl;
+    out << "static constexpr CurrencyPair " << config.name << "[] = {" << std::endl;
+    for (size_t i = 0; i < selectedPairs.size(); i++) {
+        const PairStats& pair = pairs[selectedPairs[i]];
+        out << (i % PAIRS_PER_OUTPUT_LINE == 0 ? "    " : " ") << "{\"" << currencyNames[pair.baseCurrency] << "\", \"" << currencyNames[pair.quoteCurrency] << "\"},";
+        if (i % PAIRS_PER_OUTPUT_LINE == PAIRS_PER_OUTPUT_LINE - 1 || i + 1 == selectedPairs.size())
+            out << std::endl;
+    }
+    out << "};" << std::endl;
+}
+
+static void printUsage(const char* programName) {
+    std::cerr << "Usage: " << programName << " --recording file [--latency-model bench_strategy output] [--algorithm name]" << std::endl
+              << "       [--latency-percentile p50|p99|p99.9|max|mean] [--cores n] [--latency-budget-us us]" << std::endl
+              << "       [--base-latency-us us] [--update-cost-ns ns] [--max-pairs n] [--name array name] [--output file]" << std::endl;
+}
+
+static bool parseArguments(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc)
+            return false;
+        std::string option = argv[i];
+        std::string value = argv[++i];
+        if (option == "--recording")
+            config.recordingFile = value;
+        else if (option == "--latency-model")
+            config.latencyModelFile = value;
+        else if (option == "--algorithm")
+            config.algorithm = value;
+        else if (option == "--latency-percentile")
+            config.latencyPercentile = value;
+        else if (option == "--cores")
+            config.cores = atoi(value.c_str());
+        else if (option == "--latency-budget-us")
+            config.latencyBudgetMicroseconds = atof(value.c_str());
+        else if (option == "--base-latency-us")
+            config.baseLatencyMicroseconds = atof(value.c_str());
+        else if (option == "--update-cost-ns")
+            config.updateCostNanoseconds = atof(value.c_str());
+        else if (option == "--max-pairs")
+            config.maxPairs = strtoul(value.c_str(), NULL, 10);
+        else if (option == "--name")
+            config.name = value;
+        else if (option == "--output")
+            config.outputFile = value;
+        else
+            return false;
+    }
+    return !config.recordingFile.empty() && config.cores > 0 && config.latencyBudgetMicroseconds > 0 && config.baseLatencyMicroseconds >= 0 &&
+           config.updateCostNanoseconds >= 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (!parseArguments(argc, argv)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    LatencyModel latencyModel = {0, DEFAULT_DETECTION_NANOSECONDS_PER_CYCLE};
+    if (!config.latencyModelFile.empty() && !readLatencyModel(config.latencyModelFile, latencyModel))
+        return 1;
+
+    std::vector<RecordedUpdate> updates;
+    std::vector<std::pair<double, double>> prices;
+    if (!readRecording(config.recordingFile, updates, prices))
+        return 1;
+    if (updates.empty()) {
+        std::cerr << "Error: no ticker, quote or book message in " << config.recordingFile << std::endl;
+        return 1;
+    }
+    size_t numberOfUntimestampedUpdates = std::count_if(updates.begin(), updates.end(), [](const RecordedUpdate& update) { return update.timestamp < 0; });
+    if (updates.size() - numberOfUntimestampedUpdates < MIN_TIMESTAMPED_UPDATES || numberOfUntimestampedUpdates > MAX_UNTIMESTAMPED_UPDATE_SHARE * updates.size()) {
+        std::cerr << "Error: " << numberOfUntimestampedUpdates << " of the " << updates.size() << " messages of " << config.recordingFile
+                  << " have no timestamp, record each message after the time it was received at in us and a space" << std::endl;
+        return 1;
+    }
+    enumerateTriangles();
+
+    // Replayed again now that the triangles are known, with the prices each update left
+    for (PairStats& pair : pairs)
+        pair.bidPrice = pair.askPrice = 0;
+    double timestamp = -1;
+    for (size_t i = 0; i < updates.size(); i++) {
+        pairs[updates[i].pairIdx].bidPrice = prices[i].first;
+        pairs[updates[i].pairIdx].askPrice = prices[i].second;
+        // The few records without a timestamp happened when the last one that had one did, the ones before the first
+        // only set the prices
+        if (updates[i].timestamp >= 0)
+            timestamp = updates[i].timestamp;
+        if (timestamp < 0)
+            continue;
+        if (firstTimestamp < 0)
+            firstTimestamp = timestamp;
+        lastTimestamp = timestamp;
+        onPairUpdate(updates[i].pairIdx, timestamp);
+    }
+    for (Triangle& triangle : triangles) {
+        for (int direction = 0; direction < 2; direction++)
+            if (triangle.isProfitable[direction])
+                triangle.lifetimes.push_back(lastTimestamp - triangle.openingTimestamp[direction]);
+        std::sort(triangle.lifetimes.begin(), triangle.lifetimes.end());
+    }
+    double durationInSeconds = std::max(1.0, (lastTimestamp - firstTimestamp) / 1e6);
+
+    printf("%zu updates (%zu without a timestamp) of %zu pairs and %zu currencies over %.1f s, %zu triangles\n", updates.size(), numberOfUntimestampedUpdates,
+           pairs.size(), currencyNames.size(), durationInSeconds, triangles.size());
+    printf("Detection latency model: %.1f ns + %.2f ns per cycle of the updated pair\n\n", latencyModel.intercept, latencyModel.nanosecondsPerCycle);
+    printf("%-14s %10s %12s %10s %14s\n", "pair", "updates", "updates/s", "triangles", "opportunities");
+    for (const PairStats& pair : pairs)
+        printf("%-14s %10zu %12.2f %10zu %14zu\n", pair.symbol.c_str(), pair.updates, pair.updates / durationInSeconds, pair.triangleIds.size(),
+               pair.opportunities);
+
+    PortfolioEvaluation evaluation;
+    std::vector<int> selectedPairs = selectPairs(latencyModel, durationInSeconds, evaluation);
+    if (selectedPairs.empty()) {
+        printf("\nNo triangle can be captured within a budget of %.0f us on %d cores\n", config.latencyBudgetMicroseconds, config.cores);
+        return 1;
+    }
+    printf("\n%zu pairs, %zu triangles, reaction latency %.1f us, core utilisation %.0f%%, %zu captured opportunities (%.1f per hour)\n\n",
+           selectedPairs.size(), evaluation.numberOfTriangles, evaluation.reactionLatencyMicroseconds, 100 * evaluation.coreUtilisation,
+           evaluation.capturedOpportunities, evaluation.capturedOpportunities * 3600.0 / durationInSeconds);
+
+    if (config.outputFile.empty()) {
+        writePortfolio(std::cout, selectedPairs, evaluation, durationInSeconds);
+    } else {
+        std::ofstream outputFile(config.outputFile);
+        if (!outputFile) {
+            perror(config.outputFile.c_str());
+            return 1;
+        }
+        writePortfolio(outputFile, selectedPairs, evaluation, durationInSeconds);
+        printf("Portfolio written to %s\n", config.outputFile.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,299 @@
+// CurrencyGraph.cpp
+
+#include <algorithm>
+#include <cmath>
+#include <immintrin.h>
+#include <iostream>
+#include <limits>
+#include "CurrencyGraph.hpp"
+
+// log2(sizeof(Edge) / sizeof(double)), to turn an edge ID into the index of its log rate in doubles
+#define EDGE_STRIDE_SHIFT 2
+
+using namespace std;
+
+void initializeEdges(CurrencyGraph& graph, const int* sourceCurrencyOfEdge, const int* targetCurrencyOfEdge) {
+    graph.edges.clear();
+    for (int edgeId = 0; edgeId < graph.edgeOffsetOfCurrency[graph.V]; ++edgeId)
+        graph.edges.push_back({-numeric_limits<double>::infinity(), 0.0, 0.0, sourceCurrencyOfEdge[edgeId], targetCurrencyOfEdge[edgeId]});
+    graph.exchangeTimestampOfEdge.assign(graph.edges.size(), system_clock::time_point());
+    graph.rxTimestampOfEdge.assign(graph.edges.size(), system_clock::time_point());
+    graph.cycleEvaluationKernel = getDefaultCycleEvaluationKernel();
+}
+
+void setExchangeRate(CurrencyGraph& graph, int edgeId, double price, double size) {
+    Edge& edge = graph.edges[edgeId];
+    edge.bestPriceSize = size;
+    if (price == edge.bestPrice)
+        return;
+    edge.bestPrice = price;
+    // A missing book (0) and an empty side (inf) both leave the edge out of every cycle, and no cycle sum can be +inf
+    double logRate = log(price * AFTER_FEE_RATE);
+    edge.logRate = std::isfinite(logRate) ? logRate : -numeric_limits<double>::infinity();
+}
+
+std::pair<std::vector<int>, std::chrono::system_clock::time_point> findTriangularArbitrage(const CurrencyGraph& graph) {
+    const Edge* edges = graph.edges.data();
+    const int* edgeOffsetOfCurrency = graph.edgeOffsetOfCurrency;
+    int V = graph.V;
+    vector<double> distances(V);
+    vector<int> predecessors(V, -1);
+    const int startCurrency = 0;
+    distances[startCurrency] = 0;
+
+    for (int i = 0; i < V - 1; ++i) {
+        bool relaxed = false;
+        for (int u = 0; u < V; ++u) {
+            if (distances[u] == numeric_limits<double>::infinity()) continue;
+            for (int edgeId = edgeOffsetOfCurrency[u]; edgeId < edgeOffsetOfCurrency[u + 1]; ++edgeId) {
+                int v = edges[edgeId].targetCurrency;
+                if (distances[u] - edges[edgeId].logRate < distances[v]) {
+                    distances[v] = distances[u] - edges[edgeId].logRate;
+                    predecessors[v] = u;
+                    relaxed = true;
+                }
+            }
+        }
+        if (!relaxed) break;
+    }
+    system_clock::time_point relaxationCompletionTimestamp = std::chrono::high_resolution_clock::now();
+
+    // Cycle detection
+    vector<int> triangularArbitrageCurrencySequence(NUMBER_OF_ORDERS_FOR_TRIANGULAR_ARBITRAGE);
+    vector<bool> seen(V, false);
+    bool stop = false;
+    system_clock::time_point detectionStartTimestamp = std::chrono::high_resolution_clock::now();
+    for (int u = 0; u < V; ++u) {
+        for (int edgeId = edgeOffsetOfCurrency[u]; edgeId < edgeOffsetOfCurrency[u + 1]; ++edgeId) {
+            int v = edges[edgeId].targetCurrency;
+            if (seen[v] || !(distances[u] < numeric_limits<double>::infinity())) continue;
+            if (distances[u] - edges[edgeId].logRate < distances[v]) {
+                vector<int> triangularArbitrageCycle;
+                int x = v;
+                while (true) {
+                    if (x == -1) return std::make_pair(triangularArbitrageCurrencySequence, detectionStartTimestamp);
+                    seen[x] = true;
+                    triangularArbitrageCycle.push_back(x);
+                    x = predecessors[x];
+                    if (x == v || find(triangularArbitrageCycle.begin(), triangularArbitrageCycle.end(), x) != triangularArbitrageCycle.end()) break;
+                }
+                if (x == -1) return std::make_pair(triangularArbitrageCurrencySequence, detectionStartTimestamp);
+                int idx = find(triangularArbitrageCycle.begin(), triangularArbitrageCycle.end(), x) - triangularArbitrageCycle.begin();
+                if (triangularArbitrageCycle.size() - idx == NUMBER_OF_ORDERS_FOR_TRIANGULAR_ARBITRAGE) {
+                    triangularArbitrageCycle.push_back(x);
+                    triangularArbitrageCurrencySequence = vector<int>(triangularArbitrageCycle.begin() + idx, triangularArbitrageCycle.end());
+                    reverse(triangularArbitrageCurrencySequence.begin(), triangularArbitrageCurrencySequence.end());
+                    stop = true;
+                    break;
+                }
+            }
+        }
+        if (stop) break;
+    }
+
+    // return triangularArbitrageCurrencySequence;
+    return std::make_pair(triangularArbitrageCurrencySequence, relaxationCompletionTimestamp);
+}
+
+static inline void appendCycle(const CurrencyGraph& graph, int cycleIdx, double logRate, std::vector<TriangularArbitrageCycle>& cycles) {
+    const Edge* edges = graph.edges.data();
+    int firstEdgeId = graph.cycleFirstEdgeIds[cycleIdx];
+    int secondEdgeId = graph.cycleSecondEdgeIds[cycleIdx];
+    int thirdEdgeId = graph.cycleThirdEdgeIds[cycleIdx];
+    int firstCurrency = edges[firstEdgeId].sourceCurrency;
+    cycles.push_back({{firstCurrency, edges[secondEdgeId].sourceCurrency, edges[thirdEdgeId].sourceCurrency, firstCurrency},
+                      {firstEdgeId, secondEdgeId, thirdEdgeId}, logRate});
+}
+
+// Each kernel evaluates the cycles [begin, end), appends the profitable ones and raises bestLogRate to the highest
+// cycle log rate it saw. The vector kernels leave the tail that does not fill a register to the scalar one.
+static size_t evaluateCyclesScalar(const CurrencyGraph& graph, int begin, int end, std::vector<TriangularArbitrageCycle>& cycles, double minLogRate, double& bestLogRate) {
+    const Edge* edges = graph.edges.data();
+    size_t numberOfCycles = 0;
+    for (int i = begin; i < end; i++) {
+        double logRate = edges[graph.cycleFirstEdgeIds[i]].logRate + edges[graph.cycleSecondEdgeIds[i]].logRate + edges[graph.cycleThirdEdgeIds[i]].logRate;
+        bestLogRate = std::max(bestLogRate, logRate);
+        if (logRate > minLogRate) {
+            appendCycle(graph, i, logRate, cycles);
+            numberOfCycles++;
+        }
+    }
+    return numberOfCycles;
+}
+
+// GCC 12 flags the self-initialised _mm*_undefined_pd() registers inside its own gather and extract intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target("sse4.2")))
+static size_t evaluateCyclesSse42(const CurrencyGraph& graph, int begin, int end, std::vector<TriangularArbitrageCycle>& cycles, double minLogRate, double& bestLogRate) {
+    const Edge* edges = graph.edges.data();
+    const int* firstEdgeIds = graph.cycleFirstEdgeIds;
+    const int* secondEdgeIds = graph.cycleSecondEdgeIds;
+    const int* thirdEdgeIds = graph.cycleThirdEdgeIds;
+    const __m128d threshold = _mm_set1_pd(minLogRate);
+    __m128d best = _mm_set1_pd(bestLogRate);
+    size_t numberOfCycles = 0;
+    int i = begin;
+    for (; i + 2 <= end; i += 2) {
+        // No gathers below AVX2, the lanes are loaded one by one
+        __m128d first = _mm_set_pd(edges[firstEdgeIds[i + 1]].logRate, edges[firstEdgeIds[i]].logRate);
+        __m128d second = _mm_set_pd(edges[secondEdgeIds[i + 1]].logRate, edges[secondEdgeIds[i]].logRate);
+        __m128d third = _mm_set_pd(edges[thirdEdgeIds[i + 1]].logRate, edges[thirdEdgeIds[i]].logRate);
+        __m128d logRates = _mm_add_pd(_mm_add_pd(first, second), third);
+        best = _mm_max_pd(best, logRates);
+        int profitableLanes = _mm_movemask_pd(_mm_cmpgt_pd(logRates, threshold));
+        if (profitableLanes) {
+            double lanes[2];
+            _mm_storeu_pd(lanes, logRates);
+            for (; profitableLanes; profitableLanes &= profitableLanes - 1, numberOfCycles++)
+                appendCycle(graph, i + __builtin_ctz(profitableLanes), lanes[__builtin_ctz(profitableLanes)], cycles);
+        }
+    }
+    bestLogRate = std::max(_mm_cvtsd_f64(best), _mm_cvtsd_f64(_mm_unpackhi_pd(best, best)));
+    return numberOfCycles + evaluateCyclesScalar(graph, i, end, cycles, minLogRate, bestLogRate);
+}
+
+__attribute__((target("avx2")))
+static size_t evaluateCyclesAvx2(const CurrencyGraph& graph, int begin, int end, std::vector<TriangularArbitrageCycle>& cycles, double minLogRate, double& bestLogRate) {
+    // Log rates are gathered straight out of the edges
+    const double* edgeLogRates = &graph.edges.data()->logRate;
+    const int* firstEdgeIds = graph.cycleFirstEdgeIds;
+    const int* secondEdgeIds = graph.cycleSecondEdgeIds;
+    const int* thirdEdgeIds = graph.cycleThirdEdgeIds;
+    const __m256d threshold = _mm256_set1_pd(minLogRate);
+    __m256d best = _mm256_set1_pd(bestLogRate);
+    size_t numberOfCycles = 0;
+    int i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m256d first = _mm256_i32gather_pd(edgeLogRates, _mm_slli_epi32(_mm_loadu_si128((const __m128i*)(firstEdgeIds + i)), EDGE_STRIDE_SHIFT), 8);
+        __m256d second = _mm256_i32gather_pd(edgeLogRates, _mm_slli_epi32(_mm_loadu_si128((const __m128i*)(secondEdgeIds + i)), EDGE_STRIDE_SHIFT), 8);
+        __m256d third = _mm256_i32gather_pd(edgeLogRates, _mm_slli_epi32(_mm_loadu_si128((const __m128i*)(thirdEdgeIds + i)), EDGE_STRIDE_SHIFT), 8);
+        __m256d logRates = _mm256_add_pd(_mm256_add_pd(first, second), third);
+        best = _mm256_max_pd(best, logRates);
+        int profitableLanes = _mm256_movemask_pd(_mm256_cmp_pd(logRates, threshold, _CMP_GT_OQ));
+        if (profitableLanes) {
+            double lanes[4];
+            _mm256_storeu_pd(lanes, logRates);
+            for (; profitableLanes; profitableLanes &= profitableLanes - 1, numberOfCycles++)
+                appendCycle(graph, i + __builtin_ctz(profitableLanes), lanes[__builtin_ctz(profitableLanes)], cycles);
+        }
+    }
+    __m128d best2 = _mm_max_pd(_mm256_castpd256_pd128(best), _mm256_extractf128_pd(best, 1));
+    bestLogRate = std::max(_mm_cvtsd_f64(best2), _mm_cvtsd_f64(_mm_unpackhi_pd(best2, best2)));
+    return numberOfCycles + evaluateCyclesScalar(graph, i, end, cycles, minLogRate, bestLogRate);
+}
+
+__attribute__((target("avx512f")))
+static size_t evaluateCyclesAvx512(const CurrencyGraph& graph, int begin, int end, std::vector<TriangularArbitrageCycle>& cycles, double minLogRate, double& bestLogRate) {
+    // Log rates are gathered straight out of the edges
+    const double* edgeLogRates = &graph.edges.data()->logRate;
+    const int* firstEdgeIds = graph.cycleFirstEdgeIds;
+    const int* secondEdgeIds = graph.cycleSecondEdgeIds;
+    const int* thirdEdgeIds = graph.cycleThirdEdgeIds;
+    const __m512d threshold = _mm512_set1_pd(minLogRate);
+    __m512d best = _mm512_set1_pd(bestLogRate);
+    size_t numberOfCycles = 0;
+    int i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m512d first = _mm512_i32gather_pd(_mm256_slli_epi32(_mm256_loadu_si256((const __m256i*)(firstEdgeIds + i)), EDGE_STRIDE_SHIFT), edgeLogRates, 8);
+        __m512d second = _mm512_i32gather_pd(_mm256_slli_epi32(_mm256_loadu_si256((const __m256i*)(secondEdgeIds + i)), EDGE_STRIDE_SHIFT), edgeLogRates, 8);
+        __m512d third = _mm512_i32gather_pd(_mm256_slli_epi32(_mm256_loadu_si256((const __m256i*)(thirdEdgeIds + i)), EDGE_STRIDE_SHIFT), edgeLogRates, 8);
+        __m512d logRates = _mm512_add_pd(_mm512_add_pd(first, second), third);
+        best = _mm512_max_pd(best, logRates);
+        unsigned profitableLanes = _mm512_cmp_pd_mask(logRates, threshold, _CMP_GT_OQ);
+        if (profitableLanes) {
+            double lanes[8];
+            _mm512_storeu_pd(lanes, logRates);
+            for (; profitableLanes; profitableLanes &= profitableLanes - 1, numberOfCycles++)
+                appendCycle(graph, i + __builtin_ctz(profitableLanes), lanes[__builtin_ctz(profitableLanes)], cycles);
+        }
+    }
+    bestLogRate = _mm512_reduce_max_pd(best);
+    return numberOfCycles + evaluateCyclesScalar(graph, i, end, cycles, minLogRate, bestLogRate);
+}
+
+#pragma GCC diagnostic pop
+
+size_t findTriangularArbitrages(const CurrencyGraph& graph, int currencyPairIdx, std::vector<TriangularArbitrageCycle>& cycles, double minLogRate) {
+    std::pair<int, int> cycleRange(graph.cycleOffsetOfPair[currencyPairIdx], graph.cycleOffsetOfPair[currencyPairIdx + 1]);
+    size_t firstCycleIdx = cycles.size();
+    double bestLogRate = -numeric_limits<double>::infinity();
+    size_t numberOfCycles;
+    switch (graph.cycleEvaluationKernel) {
+        case CycleEvaluationKernel::Avx512:
+            numberOfCycles = evaluateCyclesAvx512(graph, cycleRange.first, cycleRange.second, cycles, minLogRate, bestLogRate);
+            break;
+        case CycleEvaluationKernel::Avx2:
+            numberOfCycles = evaluateCyclesAvx2(graph, cycleRange.first, cycleRange.second, cycles, minLogRate, bestLogRate);
+            break;
+        case CycleEvaluationKernel::Sse42:
+            numberOfCycles = evaluateCyclesSse42(graph, cycleRange.first, cycleRange.second, cycles, minLogRate, bestLogRate);
+            break;
+        default:
+            numberOfCycles = evaluateCyclesScalar(graph, cycleRange.first, cycleRange.second, cycles, minLogRate, bestLogRate);
+            break;
+    }
+
+    // The winner is the cycle whose log rate is the maximum
+    for (size_t i = firstCycleIdx + 1; numberOfCycles > 1 && i < cycles.size(); i++) {
+        if (cycles[i].logRate == bestLogRate) {
+            std::swap(cycles[firstCycleIdx], cycles[i]);
+            break;
+        }
+    }
+    return numberOfCycles;
+}
+
+bool isCycleEvaluationKernelSupported(CycleEvaluationKernel kernel) {
+    switch (kernel) {
+        case CycleEvaluationKernel::Avx512:
+            return __builtin_cpu_supports("avx512f");
+        case CycleEvaluationKernel::Avx2:
+            return __builtin_cpu_supports("avx2");
+        case CycleEvaluationKernel::Sse42:
+            return __builtin_cpu_supports("sse4.2");
+        default:
+            return true;
+    }
+}
+
+CycleEvaluationKernel getDefaultCycleEvaluationKernel() {
+    for (CycleEvaluationKernel kernel : {CycleEvaluationKernel::Avx512, CycleEvaluationKernel::Avx2, CycleEvaluationKernel::Sse42})
+        if (isCycleEvaluationKernelSupported(kernel))
+            return kernel;
+    return CycleEvaluationKernel::Scalar;
+}
+
+const char* getCycleEvaluationKernelName(CycleEvaluationKernel kernel) {
+    switch (kernel) {
+        case CycleEvaluationKernel::Avx512:
+            return "avx512";
+        case CycleEvaluationKernel::Avx2:
+            return "avx2";
+        case CycleEvaluationKernel::Sse42:
+            return "sse4.2";
+        default:
+            return "scalar";
+    }
+}
+
+void printEdgeWeights(const CurrencyGraph& graph) {
+    cout << "Edge Weights:";
+    for (const Edge& edge : graph.edges)
+        cout << edge.sourceCurrency << " -> " << edge.targetCurrency << " : " << -edge.logRate << endl;
+    cout << endl;
+}
+
+void printExchangeRatesMatrix(const CurrencyGraph& graph) {
+    cout << "Exchange Rates Matrix:" << endl;
+    for (size_t u = 0; u < graph.V; ++u) {
+        for (size_t v = 0; v < graph.V; ++v) {
+            int edgeId = graph.edgeIdOfPair[u * graph.V + v];
+            cout << (edgeId < 0 ? 0.0 : graph.edges[edgeId].bestPrice) << " ";
+        }
+        cout << endl;
+    }
+    cout << endl;
+}
@@ -0,0 +1,138 @@
+// CurrencyGraph.hpp
+#ifndef CURRENCY_GRAPH_HPP
+#define CURRENCY_GRAPH_HPP
+
+#include <chrono>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "../SPSCQueue/SPSCQueue.hpp"
+#include "Portfolios.hpp"
+
+#define NUMBER_OF_ORDERS_FOR_TRIANGULAR_ARBITRAGE 3
+#define AFTER_FEE_RATE 0.99925
+// A cycle is profitable when the sum of the log rates of its legs, after fees, is above this
+#define CYCLE_LOG_RATE_THRESHOLD 0.0
+
+using namespace std::chrono;
+
+// Everything the strategy reads about the exchange of one currency into another, two edges per cache line
+struct alignas(32) Edge {
+    double logRate; // log(bestPrice * AFTER_FEE_RATE), -inf while the edge has no usable rate
+    double bestPrice;
+    double bestPriceSize;
+    int sourceCurrency;
+    int targetCurrency;
+};
+static_assert(sizeof(Edge) == 32, "the cycle evaluation kernels gather log rates with a 32 byte stride");
+
+// Starts the edge array on a cache line boundary
+template <typename T>
+struct CacheLineAlignedAllocator {
+    typedef T value_type;
+
+    CacheLineAlignedAllocator() {}
+    template <typename U>
+    CacheLineAlignedAllocator(const CacheLineAlignedAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(CACHELINE_SIZE)));
+    }
+
+    void deallocate(T* p, size_t) {
+        ::operator delete(p, std::align_val_t(CACHELINE_SIZE));
+    }
+
+    bool operator==(const CacheLineAlignedAllocator&) const { return true; }
+    bool operator!=(const CacheLineAlignedAllocator&) const { return false; }
+};
+
+// Currencies of a cycle in trading order, with the first currency repeated at the end
+struct TriangularArbitrageCycle {
+    int currencySequence[NUMBER_OF_ORDERS_FOR_TRIANGULAR_ARBITRAGE + 1];
+    int edgeIds[NUMBER_OF_ORDERS_FOR_TRIANGULAR_ARBITRAGE]; // Edge of each leg, to look up its pair and order side
+    double logRate; // Sum of the log exchange rates after fees of the legs
+};
+
+enum class CycleEvaluationKernel {
+    Scalar,
+    Sse42,
+    Avx2,  // 4 cycles per iteration with gathers
+    Avx512 // 8 cycles per iteration with gathers
+};
+
+// Compressed sparse row graph over the compile-time tables of a portfolio (see Portfolios.hpp), only the edges are
+// owned and updated at runtime
+struct CurrencyGraph {
+    size_t V;
+    size_t numberOfPairs;
+    const char* const* currencies;
+    std::vector<Edge, CacheLineAlignedAllocator<Edge>> edges;
+    // When the exchange sent the best price of each edge and when it was received, kept apart from the edges so that the
+    // cycle evaluation kernels gather from the same cache lines
+    std::vector<system_clock::time_point> exchangeTimestampOfEdge;
+    std::vector<system_clock::time_point> rxTimestampOfEdge;
+    const int* edgeOffsetOfCurrency;
+    const int* edgeIdOfPair;
+    const int* sellEdgeIdOfPair;
+    const int* buyEdgeIdOfPair;
+
+    // Triangles as the edge IDs of their three legs, the cycles of pair p are cycleOffsetOfPair[p] up to
+    // cycleOffsetOfPair[p + 1]
+    const int* cycleFirstEdgeIds;
+    const int* cycleSecondEdgeIds;
+    const int* cycleThirdEdgeIds;
+    const int* cycleOffsetOfPair;
+
+    CycleEvaluationKernel cycleEvaluationKernel;
+};
+
+// Allocates the edges of a graph whose tables are set
+void initializeEdges(CurrencyGraph& graph, const int* sourceCurrencyOfEdge, const int* targetCurrencyOfEdge);
+
+template <size_t NUMBER_OF_PAIRS, size_t NUMBER_OF_CURRENCIES, size_t NUMBER_OF_CYCLES>
+void createCurrencyGraph(const PortfolioTables<NUMBER_OF_PAIRS, NUMBER_OF_CURRENCIES, NUMBER_OF_CYCLES>& portfolio, CurrencyGraph& graph) {
+    graph.V = NUMBER_OF_CURRENCIES;
+    graph.numberOfPairs = NUMBER_OF_PAIRS;
+    graph.currencies = portfolio.currencies.data();
+    graph.edgeOffsetOfCurrency = portfolio.edgeOffsetOfCurrency.data();
+    graph.edgeIdOfPair = portfolio.edgeIdOfPair.data();
+    graph.sellEdgeIdOfPair = portfolio.sellEdgeIdOfPair.data();
+    graph.buyEdgeIdOfPair = portfolio.buyEdgeIdOfPair.data();
+    graph.cycleFirstEdgeIds = portfolio.cycleFirstEdgeIds.data();
+    graph.cycleSecondEdgeIds = portfolio.cycleSecondEdgeIds.data();
+    graph.cycleThirdEdgeIds = portfolio.cycleThirdEdgeIds.data();
+    graph.cycleOffsetOfPair = portfolio.cycleOffsetOfPair.data();
+    initializeEdges(graph, portfolio.sourceCurrencyOfEdge.data(), portfolio.targetCurrencyOfEdge.data());
+}
+
+// Stores the best price to exchange along the edge at, and the size available at it. The price is 0 when there is
+// none.
+void setExchangeRate(CurrencyGraph& graph, int edgeId, double price, double size);
+
+inline void setEdgeTimestamps(CurrencyGraph& graph, int edgeId, system_clock::time_point exchangeTimestamp, system_clock::time_point rxTimestamp) {
+    graph.exchangeTimestampOfEdge[edgeId] = exchangeTimestamp;
+    graph.rxTimestampOfEdge[edgeId] = rxTimestamp;
+}
+
+// Only valid for currencies that are paired
+inline const Edge& getEdge(const CurrencyGraph& graph, int sourceCurrencyIndex, int targetCurrencyIndex) {
+    return graph.edges[graph.edgeIdOfPair[sourceCurrencyIndex * graph.V + targetCurrencyIndex]];
+}
+
+// Bellman-Ford from currency 0 over the whole graph, returns the first negative 3-cycle it finds
+std::pair<std::vector<int>, system_clock::time_point> findTriangularArbitrage(const CurrencyGraph& graph);
+// Evaluates both directions of every triangle the pair is part of and appends the profitable ones to cycles, the most
+// profitable first. Returns how many were found. A negative minimum log rate also appends the triangles that fall short
+// of profitability by less than that.
+size_t findTriangularArbitrages(const CurrencyGraph& graph, int currencyPairIdx, std::vector<TriangularArbitrageCycle>& cycles,
+                                double minLogRate = CYCLE_LOG_RATE_THRESHOLD);
+// The widest kernel the CPU supports
+CycleEvaluationKernel getDefaultCycleEvaluationKernel();
+bool isCycleEvaluationKernelSupported(CycleEvaluationKernel kernel);
+const char* getCycleEvaluationKernelName(CycleEvaluationKernel kernel);
+void printEdgeWeights(const CurrencyGraph& graph);
+void printExchangeRatesMatrix(const CurrencyGraph& graph);
+
+#endif // CURRENCY_GRAPH_HPP
@@ -0,0 +1,88 @@
+// InFlightCycleRegistry.cpp
+
+#include <algorithm>
+#include <iostream>
+#include "InFlightCycleRegistry.hpp"
+
+uint64_t getCycleKey(const int* edgeIds, int numberOfLegs) {
+    int firstLegIdx = std::min_element(edgeIds, edgeIds + numberOfLegs) - edgeIds;
+    // Edge IDs are offset by one so that no cycle has the key 0 of the unused slots
+    uint64_t cycleKey = 0;
+    for (int i = 0; i < numberOfLegs; i++)
+        cycleKey = (cycleKey << CYCLE_KEY_EDGE_ID_BITS) | (uint64_t)(edgeIds[(firstLegIdx + i) % numberOfLegs] + 1);
+    return cycleKey;
+}
+
+static inline size_t getFirstSlotIdx(uint64_t cycleKey) {
+    return (cycleKey * 0x9E3779B97F4A7C15ULL) >> 32 & (IN_FLIGHT_CYCLE_REGISTRY_SIZE - 1);
+}
+
+static inline bool isSlotCompleted(const InFlightCycleSlot& slot) {
+    for (int exchangeIdx = 0; exchangeIdx < MAX_NUMBER_OF_TRADED_EXCHANGES; exchangeIdx++)
+        if ((slot.exchangeMask >> exchangeIdx & 1) &&
+            slot.completedCycleIdOfExchange[exchangeIdx].load(std::memory_order_acquire) != slot.cycleId)
+            return false;
+    return true;
+}
+
+static inline bool isSlotInFlight(const InFlightCycleSlot& slot, steady_clock::time_point now) {
+    return slot.cycleKey != 0 && !isSlotCompleted(slot) && now - slot.submissionTimestamp < milliseconds(IN_FLIGHT_CYCLE_TIMEOUT_IN_MILLISECONDS);
+}
+
+bool isCycleInFlight(InFlightCycleRegistry& registry, uint64_t cycleKey) {
+    steady_clock::time_point now = steady_clock::now();
+    size_t firstSlotIdx = getFirstSlotIdx(cycleKey);
+    for (size_t probe = 0; probe < IN_FLIGHT_CYCLE_MAX_PROBES; probe++) {
+        const InFlightCycleSlot& slot = registry.slots[(firstSlotIdx + probe) & (IN_FLIGHT_CYCLE_REGISTRY_SIZE - 1)];
+        if (slot.cycleKey == cycleKey && isSlotInFlight(slot, now)) {
+            registry.stats.suppressed++;
+            if (registry.stats.suppressed % IN_FLIGHT_CYCLE_STATS_INTERVAL == 0)
+                printInFlightCycleStats(registry);
+            return true;
+        }
+    }
+    return false;
+}
+
+int registerInFlightCycle(InFlightCycleRegistry& registry, uint64_t cycleKey, uint64_t cycleId, unsigned exchangeMask) {
+    steady_clock::time_point now = steady_clock::now();
+    size_t firstSlotIdx = getFirstSlotIdx(cycleKey);
+    int freeSlotIdx = -1;
+    for (size_t probe = 0; probe < IN_FLIGHT_CYCLE_MAX_PROBES; probe++) {
+        int slotIdx = (firstSlotIdx + probe) & (IN_FLIGHT_CYCLE_REGISTRY_SIZE - 1);
+        const InFlightCycleSlot& slot = registry.slots[slotIdx];
+        // The previous slot of the same cycle comes first, so that a cycle is never in two slots at once
+        if (slot.cycleKey == cycleKey) {
+            freeSlotIdx = slotIdx;
+            break;
+        }
+        if (freeSlotIdx < 0 && !isSlotInFlight(slot, now))
+            freeSlotIdx = slotIdx;
+    }
+    if (freeSlotIdx < 0) {
+        registry.stats.full++;
+        return -1;
+    }
+
+    InFlightCycleSlot& slot = registry.slots[freeSlotIdx];
+    if (slot.cycleKey != 0 && !isSlotCompleted(slot))
+        registry.stats.timedOut++;
+    slot.cycleKey = cycleKey;
+    slot.cycleId = cycleId;
+    slot.submissionTimestamp = now;
+    slot.exchangeMask = exchangeMask;
+    registry.stats.registered++;
+    if (registry.stats.registered % IN_FLIGHT_CYCLE_STATS_INTERVAL == 0)
+        printInFlightCycleStats(registry);
+    return freeSlotIdx;
+}
+
+void completeInFlightCycle(InFlightCycleRegistry& registry, int slotIdx, uint64_t cycleId, int exchangeIdx) {
+    if (slotIdx >= 0)
+        registry.slots[slotIdx].completedCycleIdOfExchange[exchangeIdx].store(cycleId, std::memory_order_release);
+}
+
+void printInFlightCycleStats(const InFlightCycleRegistry& registry) {
+    std::cout << "IN-FLIGHT CYCLES: " << registry.stats.registered << " sent, " << registry.stats.suppressed << " duplicates suppressed, "
+              << registry.stats.timedOut << " timed out, " << registry.stats.full << " sent untracked" << std::endl;
+}
@@ -0,0 +1,57 @@
+// InFlightCycleRegistry.hpp
+#ifndef IN_FLIGHT_CYCLE_REGISTRY_HPP
+#define IN_FLIGHT_CYCLE_REGISTRY_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "../SPSCQueue/SPSCQueue.hpp"
+#include "../Exchanges/ExchangePolicies.hpp"
+
+// Power of two
+#define IN_FLIGHT_CYCLE_REGISTRY_SIZE 256
+// Slots a cycle can land in from its hash, so that looking it up never walks the whole registry
+#define IN_FLIGHT_CYCLE_MAX_PROBES 8
+// After this the Strategy stops waiting for the Order Manager to report the cycle, in case a response was lost
+#define IN_FLIGHT_CYCLE_TIMEOUT_IN_MILLISECONDS 1000
+#define IN_FLIGHT_CYCLE_STATS_INTERVAL 1000
+// Bits of each edge ID in the key of a cycle
+#define CYCLE_KEY_EDGE_ID_BITS 12
+
+using namespace std::chrono;
+
+// Only the Strategy writes the key, cycle ID, submission time and exchanges of a slot. The Order Manager of each
+// exchange only stores the ID of the cycle it has completed, so a slot is in flight while the ID of any of the
+// exchanges the cycle trades on differs from the ID of the cycle.
+struct alignas(CACHELINE_SIZE) InFlightCycleSlot {
+    uint64_t cycleKey;          // 0 when the slot was never used
+    uint64_t cycleId;
+    steady_clock::time_point submissionTimestamp;
+    unsigned exchangeMask;      // Bit e is set when a leg of the cycle is traded on exchange e
+    std::atomic<uint64_t> completedCycleIdOfExchange[MAX_NUMBER_OF_TRADED_EXCHANGES];
+};
+
+struct InFlightCycleStats {
+    size_t registered;
+    size_t suppressed;  // Opportunities not sent because the same cycle, in the same direction, was still in flight
+    size_t timedOut;    // Cycles whose slot was reused without the Order Manager reporting them
+    size_t full;        // Opportunities sent untracked because every slot of their probe window was in flight
+};
+
+struct InFlightCycleRegistry {
+    InFlightCycleSlot slots[IN_FLIGHT_CYCLE_REGISTRY_SIZE];
+    InFlightCycleStats stats;   // Strategy side
+};
+
+// The edge IDs of the legs, rotated to start from the smallest, so that a cycle has the same key whichever of its pairs
+// was updated. The edges being directed, the two directions of a cycle have different keys.
+uint64_t getCycleKey(const int* edgeIds, int numberOfLegs);
+bool isCycleInFlight(InFlightCycleRegistry& registry, uint64_t cycleKey);
+// Returns the slot of the cycle, to be handed to the Order Managers with its orders, or -1 when it is not tracked
+int registerInFlightCycle(InFlightCycleRegistry& registry, uint64_t cycleKey, uint64_t cycleId, unsigned exchangeMask);
+// Called by the Order Manager of an exchange once it has answered every order of the cycle sent to it
+void completeInFlightCycle(InFlightCycleRegistry& registry, int slotIdx, uint64_t cycleId, int exchangeIdx);
+void printInFlightCycleStats(const InFlightCycleRegistry& registry);
+
+#endif // IN_FLIGHT_CYCLE_REGISTRY_HPP
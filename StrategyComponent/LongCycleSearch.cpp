@@ -0,0 +1,218 @@
+// LongCycleSearch.cpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include "LongCycleSearch.hpp"
+#include "../Utils/Utils.hpp"
+
+using namespace std;
+
+void createCurrencyAdjacency(const CurrencyGraph& graph, CurrencyAdjacency& adjacency) {
+    adjacency.V = graph.V;
+    adjacency.adjacencyOffsetOfCurrency.assign(graph.edgeOffsetOfCurrency, graph.edgeOffsetOfCurrency + graph.V + 1);
+    adjacency.adjacentEdgeIds.clear();
+    adjacency.adjacentCurrencies.clear();
+    for (size_t edgeId = 0; edgeId < graph.edges.size(); edgeId++) {
+        adjacency.adjacentEdgeIds.push_back(edgeId);
+        adjacency.adjacentCurrencies.push_back(graph.edges[edgeId].targetCurrency);
+    }
+    adjacency.edgeIdOfPair = graph.edgeIdOfPair;
+    adjacency.sellEdgeIdOfPair = graph.sellEdgeIdOfPair;
+    adjacency.buyEdgeIdOfPair = graph.buyEdgeIdOfPair;
+}
+
+struct LongCycleSearchState {
+    const CurrencyAdjacency& adjacency;
+    const double* logRates;
+    int cycleLength;
+    int startCurrency;
+    double maxLogRate;
+    uint64_t visitedCurrencies; // MAX_NUMBER_OF_CURRENCIES is 64
+    int edgeIds[MAX_LONG_CYCLE_LENGTH];
+    int bestEdgeIds[MAX_LONG_CYCLE_LENGTH];
+    double bestLogRate;
+};
+
+// Extends the path ending at currency u, which has legs legs with the given log rate so far
+static void extendPath(LongCycleSearchState& state, int u, int legs, double logRate) {
+    int remainingLegs = state.cycleLength - legs;
+    if (logRate + remainingLegs * state.maxLogRate <= std::max(state.bestLogRate, CYCLE_LOG_RATE_THRESHOLD))
+        return;
+
+    const CurrencyAdjacency& adjacency = state.adjacency;
+    if (remainingLegs == 1) {
+        // The last leg can only go back to the start currency
+        int edgeId = adjacency.edgeIdOfPair[u * adjacency.V + state.startCurrency];
+        if (edgeId < 0)
+            return;
+        double cycleLogRate = logRate + state.logRates[edgeId];
+        if (cycleLogRate > std::max(state.bestLogRate, CYCLE_LOG_RATE_THRESHOLD)) {
+            state.edgeIds[legs] = edgeId;
+            std::copy(state.edgeIds, state.edgeIds + state.cycleLength, state.bestEdgeIds);
+            state.bestLogRate = cycleLogRate;
+        }
+        return;
+    }
+
+    for (int i = adjacency.adjacencyOffsetOfCurrency[u]; i < adjacency.adjacencyOffsetOfCurrency[u + 1]; i++) {
+        int v = adjacency.adjacentCurrencies[i];
+        if (state.visitedCurrencies & (1ULL << v))
+            continue;
+        int edgeId = adjacency.adjacentEdgeIds[i];
+        state.edgeIds[legs] = edgeId;
+        state.visitedCurrencies |= 1ULL << v;
+        extendPath(state, v, legs + 1, logRate + state.logRates[edgeId]);
+        state.visitedCurrencies &= ~(1ULL << v);
+    }
+}
+
+bool findLongCycle(const CurrencyAdjacency& adjacency, const double* logRates, int currencyPairIdx, int cycleLength, int* edgeIds, double& logRate) {
+    LongCycleSearchState state = {adjacency, logRates, cycleLength, 0, -numeric_limits<double>::infinity(), 0, {}, {}, -numeric_limits<double>::infinity()};
+    for (size_t edgeId = 0; edgeId < adjacency.adjacentEdgeIds.size(); edgeId++)
+        state.maxLogRate = std::max(state.maxLogRate, logRates[edgeId]);
+
+    // The cycles that sell the base currency of the pair start with its sell edge, the others with its buy edge
+    for (int firstEdgeId : {adjacency.sellEdgeIdOfPair[currencyPairIdx], adjacency.buyEdgeIdOfPair[currencyPairIdx]}) {
+        if (!std::isfinite(logRates[firstEdgeId]))
+            continue;
+        int u = 0;
+        int v = 0;
+        for (; u < adjacency.V; u++) {
+            int i = std::find(adjacency.adjacentEdgeIds.begin() + adjacency.adjacencyOffsetOfCurrency[u],
+                              adjacency.adjacentEdgeIds.begin() + adjacency.adjacencyOffsetOfCurrency[u + 1], firstEdgeId) - adjacency.adjacentEdgeIds.begin();
+            if (i < adjacency.adjacencyOffsetOfCurrency[u + 1]) {
+                v = adjacency.adjacentCurrencies[i];
+                break;
+            }
+        }
+        state.startCurrency = u;
+        state.visitedCurrencies = (1ULL << u) | (1ULL << v);
+        state.edgeIds[0] = firstEdgeId;
+        extendPath(state, v, 1, logRates[firstEdgeId]);
+    }
+
+    if (state.bestLogRate <= CYCLE_LOG_RATE_THRESHOLD)
+        return false;
+    std::copy(state.bestEdgeIds, state.bestEdgeIds + cycleLength, edgeIds);
+    logRate = state.bestLogRate;
+    return true;
+}
+
+static void runLongCycleSearchWorker(const LongCycleSearchPool& pool, LongCycleSearchWorker& worker, int cpuCore) {
+    setThreadAffinity(pthread_self(), cpuCore);
+    LongCycleSearchJob job;
+    while (true) {
+        while (!worker.jobQueue->pop(job));
+        // Shortest first, so that a 4-leg cycle is not held back by the 5-leg search
+        for (int cycleLength = MIN_LONG_CYCLE_LENGTH; cycleLength <= pool.maxCycleLength; cycleLength++) {
+            LongCycleSearchResult result;
+            result.currencyPairIdx = job.currencyPairIdx;
+            result.cycleLength = cycleLength;
+            result.found = findLongCycle(pool.adjacency, job.logRates, job.currencyPairIdx, cycleLength, result.edgeIds, result.logRate);
+            result.submissionTimestamp = job.submissionTimestamp;
+            result.completionTimestamp = steady_clock::now();
+            result.marketUpdateExchangeTimestamp = job.marketUpdateExchangeTimestamp;
+            result.orderBookFinalChangeTimestamp = job.orderBookFinalChangeTimestamp;
+            result.updateSocketRxTimeStamp = job.updateSocketRxTimeStamp;
+            while (!worker.resultQueue->push(result));
+        }
+    }
+}
+
+bool startLongCycleSearchPool(LongCycleSearchPool& pool, const CurrencyGraph& graph, const LongCycleSearchConfig& config) {
+    if (config.workerCores.empty())
+        return false;
+    if (graph.edges.size() > LONG_CYCLE_SEARCH_MAX_NUMBER_OF_EDGES || graph.V > 64) {
+        std::cerr << "Error: the portfolio is too large for the long cycle search" << std::endl;
+        return false;
+    }
+
+    createCurrencyAdjacency(graph, pool.adjacency);
+    pool.numberOfEdges = graph.edges.size();
+    pool.maxCycleLength = std::min(std::max(config.maxCycleLength, MIN_LONG_CYCLE_LENGTH), MAX_LONG_CYCLE_LENGTH);
+    pool.latencyBudget = microseconds(config.latencyBudgetInMicroseconds);
+    pool.nextWorkerIdx = 0;
+    pool.droppedJobs = 0;
+    for (int cycleLength = MIN_LONG_CYCLE_LENGTH; cycleLength <= MAX_LONG_CYCLE_LENGTH; cycleLength++) {
+        pool.stats[cycleLength] = LongCycleLengthStats();
+        pool.stats[cycleLength].latencies.reserve(LONG_CYCLE_SEARCH_STATS_INTERVAL);
+    }
+
+    for (int cpuCore : config.workerCores) {
+        pool.workers.emplace_back(new LongCycleSearchWorker());
+        LongCycleSearchWorker& worker = *pool.workers.back();
+        worker.jobQueue.reset(new SPSCQueue<LongCycleSearchJob>(LONG_CYCLE_SEARCH_QUEUE_SIZE));
+        worker.resultQueue.reset(new SPSCQueue<LongCycleSearchResult>(LONG_CYCLE_SEARCH_QUEUE_SIZE * (MAX_LONG_CYCLE_LENGTH - MIN_LONG_CYCLE_LENGTH + 1)));
+        worker.thread = std::thread(runLongCycleSearchWorker, std::cref(pool), std::ref(worker), cpuCore);
+        // The workers run for the lifetime of the process, like the other threads of the pipeline
+        worker.thread.detach();
+    }
+    std::cout << "Searching " << MIN_LONG_CYCLE_LENGTH << " to " << pool.maxCycleLength << "-leg cycles on " << pool.workers.size()
+              << " worker cores within " << config.latencyBudgetInMicroseconds << " us" << std::endl;
+    return true;
+}
+
+bool submitLongCycleSearch(LongCycleSearchPool& pool, const CurrencyGraph& graph, int currencyPairIdx, system_clock::time_point marketUpdateExchangeTimestamp,
+                           system_clock::time_point orderBookFinalChangeTimestamp, system_clock::time_point updateSocketRxTimeStamp) {
+    // Filled in place, a job is a few KiB
+    static LongCycleSearchJob job;
+    job.currencyPairIdx = currencyPairIdx;
+    job.submissionTimestamp = steady_clock::now();
+    job.marketUpdateExchangeTimestamp = marketUpdateExchangeTimestamp;
+    job.orderBookFinalChangeTimestamp = orderBookFinalChangeTimestamp;
+    job.updateSocketRxTimeStamp = updateSocketRxTimeStamp;
+    for (size_t edgeId = 0; edgeId < pool.numberOfEdges; edgeId++)
+        job.logRates[edgeId] = graph.edges[edgeId].logRate;
+
+    LongCycleSearchWorker& worker = *pool.workers[pool.nextWorkerIdx];
+    pool.nextWorkerIdx = (pool.nextWorkerIdx + 1) % pool.workers.size();
+    if (!worker.jobQueue->push(job)) {
+        pool.droppedJobs++;
+        return false;
+    }
+    return true;
+}
+
+bool pollLongCycleSearchResult(LongCycleSearchPool& pool, LongCycleSearchResult& result) {
+    for (std::unique_ptr<LongCycleSearchWorker>& worker : pool.workers)
+        if (worker->resultQueue->pop(result))
+            return true;
+    return false;
+}
+
+bool isWithinLatencyBudget(const LongCycleSearchPool& pool, const LongCycleSearchResult& result) {
+    return steady_clock::now() - result.submissionTimestamp <= pool.latencyBudget;
+}
+
+void recordLongCycleSearchResult(LongCycleSearchPool& pool, const LongCycleSearchResult& result, bool late, bool sent) {
+    LongCycleLengthStats& stats = pool.stats[result.cycleLength];
+    stats.searches++;
+    stats.latencies.push_back(duration<double, std::micro>(result.completionTimestamp - result.submissionTimestamp).count());
+    if (result.found) {
+        stats.hits++;
+        if (late)
+            stats.late++;
+        else if (sent)
+            stats.sent++;
+        else
+            stats.stale++;
+    }
+    if (stats.searches % LONG_CYCLE_SEARCH_STATS_INTERVAL == 0)
+        printLongCycleSearchStats(pool, result.cycleLength);
+}
+
+void printLongCycleSearchStats(LongCycleSearchPool& pool, int cycleLength) {
+    LongCycleLengthStats& stats = pool.stats[cycleLength];
+    if (stats.latencies.empty())
+        return;
+    std::sort(stats.latencies.begin(), stats.latencies.end());
+    std::cout << "LONG CYCLE SEARCH " << cycleLength << " LEGS: " << stats.searches << " searches, hit rate "
+              << 100.0 * stats.hits / stats.searches << "%, " << stats.sent << " sent, " << stats.late << " late, " << stats.stale
+              << " stale, " << pool.droppedJobs << " jobs dropped, latency p50 " << stats.latencies[stats.latencies.size() / 2] << " us p99 "
+              << stats.latencies[std::min(stats.latencies.size() - 1, stats.latencies.size() * 99 / 100)] << " us" << std::endl;
+    // Percentiles cover the searches since the previous print
+    stats.latencies.clear();
+}
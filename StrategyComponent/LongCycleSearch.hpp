@@ -0,0 +1,110 @@
+// LongCycleSearch.hpp
+#ifndef LONG_CYCLE_SEARCH_HPP
+#define LONG_CYCLE_SEARCH_HPP
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../SPSCQueue/SPSCQueue.hpp"
+#include "CurrencyGraph.hpp"
+
+#define MIN_LONG_CYCLE_LENGTH 4
+#define MAX_LONG_CYCLE_LENGTH 5
+// Room for the edges of the largest portfolio in a search job
+#define LONG_CYCLE_SEARCH_MAX_NUMBER_OF_EDGES 256
+#define LONG_CYCLE_SEARCH_QUEUE_SIZE 64
+#define DEFAULT_LONG_CYCLE_SEARCH_LATENCY_BUDGET_IN_MICROSECONDS 100
+// Results of each cycle length between two prints of the statistics
+#define LONG_CYCLE_SEARCH_STATS_INTERVAL 10000
+
+using namespace std::chrono;
+
+struct LongCycleSearchConfig {
+    std::vector<int> workerCores; // No worker, and no search, when empty
+    int maxCycleLength;
+    int latencyBudgetInMicroseconds; // From the update of the pair to the result reaching the Strategy
+};
+
+// The log rates of every edge right after the update of the pair, the workers never read the edges the Strategy writes
+struct LongCycleSearchJob {
+    int currencyPairIdx;
+    steady_clock::time_point submissionTimestamp;
+    system_clock::time_point marketUpdateExchangeTimestamp;
+    system_clock::time_point orderBookFinalChangeTimestamp;
+    system_clock::time_point updateSocketRxTimeStamp;
+    double logRates[LONG_CYCLE_SEARCH_MAX_NUMBER_OF_EDGES];
+};
+
+// One per job and cycle length, the lengths of a job are searched and sent back from the shortest up
+struct LongCycleSearchResult {
+    int currencyPairIdx;
+    int cycleLength;
+    bool found;
+    int edgeIds[MAX_LONG_CYCLE_LENGTH]; // Legs of the most profitable cycle of that length through the pair
+    double logRate;
+    steady_clock::time_point submissionTimestamp;
+    steady_clock::time_point completionTimestamp;
+    system_clock::time_point marketUpdateExchangeTimestamp;
+    system_clock::time_point orderBookFinalChangeTimestamp;
+    system_clock::time_point updateSocketRxTimeStamp;
+};
+
+// Adjacency of every currency, the edges leaving u are adjacentEdgeIds[adjacencyOffsetOfCurrency[u]] up to
+// adjacentEdgeIds[adjacencyOffsetOfCurrency[u + 1]] and lead to the matching adjacentCurrencies
+struct CurrencyAdjacency {
+    int V;
+    std::vector<int> adjacencyOffsetOfCurrency;
+    std::vector<int> adjacentEdgeIds;
+    std::vector<int> adjacentCurrencies;
+    const int* edgeIdOfPair;
+    const int* sellEdgeIdOfPair;
+    const int* buyEdgeIdOfPair;
+};
+
+struct LongCycleSearchWorker {
+    std::unique_ptr<SPSCQueue<LongCycleSearchJob>> jobQueue;
+    std::unique_ptr<SPSCQueue<LongCycleSearchResult>> resultQueue;
+    std::thread thread;
+};
+
+struct LongCycleLengthStats {
+    size_t searches;
+    size_t hits;        // Searches that found a profitable cycle
+    size_t late;        // Hits that reached the Strategy after the latency budget
+    size_t stale;       // Hits that the live rates or volumes no longer supported
+    size_t sent;
+    std::vector<double> latencies; // Submission to completion of the search, in microseconds
+};
+
+struct LongCycleSearchPool {
+    CurrencyAdjacency adjacency;
+    size_t numberOfEdges;
+    int maxCycleLength;
+    steady_clock::duration latencyBudget;
+    std::vector<std::unique_ptr<LongCycleSearchWorker>> workers;
+    size_t nextWorkerIdx;
+    size_t droppedJobs; // Jobs not submitted because the queue of the worker was full
+    LongCycleLengthStats stats[MAX_LONG_CYCLE_LENGTH + 1];
+};
+
+void createCurrencyAdjacency(const CurrencyGraph& graph, CurrencyAdjacency& adjacency);
+// Depth-first search for the most profitable simple cycle of exactly cycleLength legs that trades the pair in either
+// direction. Branches are cut as soon as the log rates so far plus the best log rate of the graph for each remaining
+// leg cannot exceed the threshold. Returns false when there is no profitable cycle of that length.
+bool findLongCycle(const CurrencyAdjacency& adjacency, const double* logRates, int currencyPairIdx, int cycleLength, int* edgeIds, double& logRate);
+
+// Starts one worker per core of the config, pinned to it. Returns false when the config has no worker core.
+bool startLongCycleSearchPool(LongCycleSearchPool& pool, const CurrencyGraph& graph, const LongCycleSearchConfig& config);
+// Hands the current rates to the next worker, returns false and counts the job as dropped when its queue is full
+bool submitLongCycleSearch(LongCycleSearchPool& pool, const CurrencyGraph& graph, int currencyPairIdx, system_clock::time_point marketUpdateExchangeTimestamp,
+                           system_clock::time_point orderBookFinalChangeTimestamp, system_clock::time_point updateSocketRxTimeStamp);
+bool pollLongCycleSearchResult(LongCycleSearchPool& pool, LongCycleSearchResult& result);
+bool isWithinLatencyBudget(const LongCycleSearchPool& pool, const LongCycleSearchResult& result);
+// Accounts for a result once the Strategy has decided what to do with it, and prints the statistics of its cycle
+// length every LONG_CYCLE_SEARCH_STATS_INTERVAL results
+void recordLongCycleSearchResult(LongCycleSearchPool& pool, const LongCycleSearchResult& result, bool late, bool sent);
+void printLongCycleSearchStats(LongCycleSearchPool& pool, int cycleLength);
+
+#endif // LONG_CYCLE_SEARCH_HPP
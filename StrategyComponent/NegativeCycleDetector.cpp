@@ -0,0 +1,258 @@
+// NegativeCycleDetector.cpp
+
+#include <algorithm>
+#include "NegativeCycleDetector.hpp"
+#include "../Utils/Utils.hpp"
+
+static inline void enqueueCurrency(NegativeCycleDetector& detector, int currency) {
+    if (detector.isQueued[currency])
+        return;
+    int tail = detector.queueHead + detector.queueSize;
+    detector.queue[tail < detector.V ? tail : tail - detector.V] = currency;
+    detector.queueSize++;
+    detector.isQueued[currency] = 1;
+}
+
+static void clearQueue(NegativeCycleDetector& detector) {
+    for (; detector.queueSize > 0; detector.queueSize--) {
+        detector.isQueued[detector.queue[detector.queueHead]] = 0;
+        detector.queueHead = detector.queueHead + 1 == detector.V ? 0 : detector.queueHead + 1;
+    }
+}
+
+// Returns a currency on a cycle of the predecessor edges set in the current search, -1 when there is none. Every
+// currency is walked through once, each walk stamping what it visits with its own stamp.
+static int findPredecessorCycle(NegativeCycleDetector& detector) {
+    const Edge* edges = detector.graph->edges.data();
+    uint64_t firstWalkStamp = detector.walkStamp + 1;
+    for (int currency = 0; currency < detector.V; currency++) {
+        if (detector.walkStamps[currency] >= firstWalkStamp)
+            continue;
+        uint64_t walkStamp = ++detector.walkStamp;
+        int x = currency;
+        while (detector.predecessorSearchIds[x] == detector.searchId && detector.walkStamps[x] < firstWalkStamp) {
+            detector.walkStamps[x] = walkStamp;
+            x = edges[detector.predecessorEdgeIds[x]].sourceCurrency;
+        }
+        if (detector.walkStamps[x] == walkStamp)
+            return x;
+    }
+    return -1;
+}
+
+// A cycle of predecessor edges is negative as long as the weights did not change during the search, which the sum
+// of its log rates confirms before it is reported
+static bool extractCycle(NegativeCycleDetector& detector, int currencyOnCycle, NegativeCycle& cycle) {
+    const Edge* edges = detector.graph->edges.data();
+    cycle.edgeIds.clear();
+    cycle.logRate = 0;
+    int currency = currencyOnCycle;
+    do {
+        int edgeId = detector.predecessorEdgeIds[currency];
+        cycle.edgeIds.push_back(edgeId);
+        cycle.logRate += edges[edgeId].logRate;
+        currency = edges[edgeId].sourceCurrency;
+    } while (currency != currencyOnCycle);
+    std::reverse(cycle.edgeIds.begin(), cycle.edgeIds.end());
+    return cycle.logRate > CYCLE_LOG_RATE_THRESHOLD;
+}
+
+// Relaxes the outgoing edges of the queued currencies until no potential decreases or the predecessor edges close a
+// cycle, which is looked for after every V relaxations
+static bool runSearch(NegativeCycleDetector& detector, NegativeCycle& cycle) {
+    const Edge* edges = detector.graph->edges.data();
+    const int* edgeOffsetOfCurrency = detector.graph->edgeOffsetOfCurrency;
+    double* potentials = detector.potentials.data();
+    int relaxationsSinceCheck = 0;
+    while (detector.queueSize > 0) {
+        int u = detector.queue[detector.queueHead];
+        detector.queueHead = detector.queueHead + 1 == detector.V ? 0 : detector.queueHead + 1;
+        detector.queueSize--;
+        detector.isQueued[u] = 0;
+
+        for (int edgeId = edgeOffsetOfCurrency[u]; edgeId < edgeOffsetOfCurrency[u + 1]; edgeId++) {
+            int v = edges[edgeId].targetCurrency;
+            // -inf log rates of the edges without a book give +inf, which never relaxes
+            double candidatePotential = potentials[u] - edges[edgeId].logRate;
+            if (!(candidatePotential < potentials[v] - NEGATIVE_CYCLE_RELAXATION_EPSILON))
+                continue;
+            potentials[v] = candidatePotential;
+            detector.predecessorEdgeIds[v] = edgeId;
+            detector.predecessorSearchIds[v] = detector.searchId;
+            detector.stats.relaxations++;
+            enqueueCurrency(detector, v);
+
+            if (++relaxationsSinceCheck < detector.V)
+                continue;
+            relaxationsSinceCheck = 0;
+            int currencyOnCycle = findPredecessorCycle(detector);
+            if (currencyOnCycle < 0)
+                continue;
+            if (extractCycle(detector, currencyOnCycle, cycle)) {
+                detector.lastCycle = cycle;
+                clearQueue(detector);
+                detector.arePotentialsValid = false;
+                detector.stats.cycles++;
+                return true;
+            }
+            // Not negative after all, the search goes on without that edge
+            detector.predecessorSearchIds[currencyOnCycle] = 0;
+        }
+    }
+    return false;
+}
+
+// One Jacobi round of the full pass over the currencies [begin, end): each potential is lowered to the best of its
+// incoming edges on the potentials of the previous round, so that the ranges never write the same currency
+static bool relaxIncomingEdges(NegativeCycleDetector& detector, int begin, int end) {
+    const Edge* edges = detector.graph->edges.data();
+    const double* potentials = detector.potentials.data();
+    bool changed = false;
+    for (int v = begin; v < end; v++) {
+        double bestPotential = potentials[v];
+        int bestEdgeId = -1;
+        for (int i = detector.incomingOffsetOfCurrency[v]; i < detector.incomingOffsetOfCurrency[v + 1]; i++) {
+            int edgeId = detector.incomingEdgeIds[i];
+            double candidatePotential = potentials[edges[edgeId].sourceCurrency] - edges[edgeId].logRate;
+            if (candidatePotential < bestPotential - NEGATIVE_CYCLE_RELAXATION_EPSILON) {
+                bestPotential = candidatePotential;
+                bestEdgeId = edgeId;
+            }
+        }
+        detector.nextPotentials[v] = bestPotential;
+        if (bestEdgeId >= 0) {
+            detector.predecessorEdgeIds[v] = bestEdgeId;
+            detector.predecessorSearchIds[v] = detector.searchId;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// An arbitrage usually outlives a few updates, its cycle is checked on the current log rates before anything else
+static bool isLastCycleNegative(NegativeCycleDetector& detector) {
+    const Edge* edges = detector.graph->edges.data();
+    double logRate = 0;
+    for (int edgeId : detector.lastCycle.edgeIds)
+        logRate += edges[edgeId].logRate;
+    detector.lastCycle.logRate = logRate;
+    return !detector.lastCycle.edgeIds.empty() && logRate > CYCLE_LOG_RATE_THRESHOLD;
+}
+
+static inline int getRangeBegin(const NegativeCycleDetector& detector, int rangeIdx) {
+    return (int)((int64_t)detector.V * rangeIdx / detector.numberOfRanges);
+}
+
+static void runNegativeCycleDetectorWorker(NegativeCycleDetector& detector, int rangeIdx, int cpuCore) {
+    setThreadAffinity(pthread_self(), cpuCore);
+    NegativeCycleDetectorRound& round = *detector.round;
+    uint64_t lastRoundNumber = 0;
+    while (!round.stop.load(std::memory_order_relaxed)) {
+        uint64_t roundNumber = round.roundNumber.load(std::memory_order_acquire);
+        if (roundNumber == lastRoundNumber) {
+            std::this_thread::yield();
+            continue;
+        }
+        lastRoundNumber = roundNumber;
+        round.changedOfWorker[rangeIdx - 1] = relaxIncomingEdges(detector, getRangeBegin(detector, rangeIdx), getRangeBegin(detector, rangeIdx + 1));
+        round.numberOfDoneWorkers.fetch_add(1, std::memory_order_release);
+    }
+}
+
+// The calling thread takes the first range and waits for the workers at the end of the round
+static bool runFullPassRound(NegativeCycleDetector& detector) {
+    NegativeCycleDetectorRound& round = *detector.round;
+    round.numberOfDoneWorkers.store(0, std::memory_order_relaxed);
+    round.roundNumber.fetch_add(1, std::memory_order_release);
+    bool changed = relaxIncomingEdges(detector, 0, getRangeBegin(detector, 1));
+    while (round.numberOfDoneWorkers.load(std::memory_order_acquire) < (int)detector.workers.size());
+    for (char workerChanged : round.changedOfWorker)
+        changed |= workerChanged;
+    std::swap(detector.potentials, detector.nextPotentials);
+    return changed;
+}
+
+void createNegativeCycleDetector(NegativeCycleDetector& detector, const CurrencyGraph& graph, const std::vector<int>& workerCores) {
+    int V = graph.V;
+    int numberOfEdges = graph.edges.size();
+    detector.graph = &graph;
+    detector.V = V;
+    detector.potentials.assign(V, 0.0);
+    detector.nextPotentials.assign(V, 0.0);
+    detector.predecessorEdgeIds.assign(V, -1);
+    detector.predecessorSearchIds.assign(V, 0);
+    detector.searchId = 0;
+    detector.queue.assign(V, 0);
+    detector.isQueued.assign(V, 0);
+    detector.queueHead = 0;
+    detector.queueSize = 0;
+    detector.walkStamps.assign(V, 0);
+    detector.walkStamp = 0;
+    detector.arePotentialsValid = false;
+    detector.lastCycle.edgeIds.clear();
+    detector.lastCycle.edgeIds.reserve(V);
+    detector.stats = {};
+
+    detector.incomingOffsetOfCurrency.assign(V + 1, 0);
+    for (int edgeId = 0; edgeId < numberOfEdges; edgeId++)
+        detector.incomingOffsetOfCurrency[graph.edges[edgeId].targetCurrency + 1]++;
+    for (int v = 0; v < V; v++)
+        detector.incomingOffsetOfCurrency[v + 1] += detector.incomingOffsetOfCurrency[v];
+    detector.incomingEdgeIds.assign(numberOfEdges, -1);
+    std::vector<int> nextIncomingEdgeIdx(detector.incomingOffsetOfCurrency.begin(), detector.incomingOffsetOfCurrency.end() - 1);
+    for (int edgeId = 0; edgeId < numberOfEdges; edgeId++)
+        detector.incomingEdgeIds[nextIncomingEdgeIdx[graph.edges[edgeId].targetCurrency]++] = edgeId;
+
+    detector.round.reset(new NegativeCycleDetectorRound());
+    detector.round->changedOfWorker.assign(workerCores.size(), 0);
+    detector.numberOfRanges = workerCores.size() + 1;
+    for (size_t workerIdx = 0; workerIdx < workerCores.size(); workerIdx++)
+        detector.workers.emplace_back(runNegativeCycleDetectorWorker, std::ref(detector), (int)workerIdx + 1, workerCores[workerIdx]);
+}
+
+void stopNegativeCycleDetector(NegativeCycleDetector& detector) {
+    detector.round->stop.store(true);
+    for (std::thread& worker : detector.workers)
+        worker.join();
+    detector.workers.clear();
+}
+
+bool detectNegativeCycle(NegativeCycleDetector& detector, const int* updatedEdgeIds, int numberOfUpdatedEdges, NegativeCycle& cycle) {
+    if (!detector.arePotentialsValid) {
+        if (isLastCycleNegative(detector)) {
+            cycle = detector.lastCycle;
+            detector.stats.repeatedCycles++;
+            return true;
+        }
+        return detectNegativeCycleFromScratch(detector, cycle);
+    }
+
+    // Every other edge still satisfies the potentials, so a new negative cycle goes through an edge that no longer does
+    const Edge* edges = detector.graph->edges.data();
+    detector.stats.incrementalDetections++;
+    detector.searchId++;
+    for (int i = 0; i < numberOfUpdatedEdges; i++) {
+        const Edge& edge = edges[updatedEdgeIds[i]];
+        if (detector.potentials[edge.sourceCurrency] - edge.logRate < detector.potentials[edge.targetCurrency] - NEGATIVE_CYCLE_RELAXATION_EPSILON)
+            enqueueCurrency(detector, edge.sourceCurrency);
+    }
+    return runSearch(detector, cycle);
+}
+
+bool detectNegativeCycleFromScratch(NegativeCycleDetector& detector, NegativeCycle& cycle) {
+    detector.stats.fullPasses++;
+    detector.searchId++;
+    // The potentials from a virtual currency with a free edge to every other, restarted from 0 rather than from what a
+    // cycle left them at so that they do not drift away from the log rates
+    std::fill(detector.potentials.begin(), detector.potentials.end(), 0.0);
+    detector.arePotentialsValid = true;
+    for (int roundIdx = 0; roundIdx < NEGATIVE_CYCLE_DETECTOR_MAX_FULL_PASS_ROUNDS; roundIdx++) {
+        if (!runFullPassRound(detector))
+            return false;
+    }
+
+    // Long shortest paths, or a cycle, which the search finds on its own
+    for (int currency = 0; currency < detector.V; currency++)
+        enqueueCurrency(detector, currency);
+    return runSearch(detector, cycle);
+}
@@ -0,0 +1,83 @@
+// NegativeCycleDetector.hpp
+#ifndef NEGATIVE_CYCLE_DETECTOR_HPP
+#define NEGATIVE_CYCLE_DETECTOR_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "CurrencyGraph.hpp"
+
+// A potential only decreases by more than this, so that rounding cannot relax a cycle of zero weight forever
+#define NEGATIVE_CYCLE_RELAXATION_EPSILON 1e-12
+// Jacobi rounds of the full pass before the rest of its work is left to the label-correcting search
+#define NEGATIVE_CYCLE_DETECTOR_MAX_FULL_PASS_ROUNDS 8
+
+// Finds a negative cycle of the weights -logRate, i.e. a profitable cycle of any length, without a pass over the whole
+// graph per update. The detector keeps a potential per currency that no edge can lower, which exists as long as there
+// is no negative cycle. An update can only break that for the edges it changed, so the label-correcting search (SPFA)
+// restarts from their source currencies alone and either settles after a few relaxations or runs into a cycle. Once a
+// cycle is found the potentials are no longer valid and the next detection recomputes them over the whole graph, in
+// Jacobi rounds split across the worker cores, unless the cycle found last is still there.
+struct NegativeCycle {
+    std::vector<int> edgeIds; // Legs in trading order
+    double logRate;
+};
+
+// Barrier and shared state of the full pass, the workers spin on the round number
+struct NegativeCycleDetectorRound {
+    std::atomic<uint64_t> roundNumber{0};
+    std::atomic<int> numberOfDoneWorkers{0};
+    std::atomic<bool> stop{false};
+    std::vector<char> changedOfWorker; // Whether a potential of the range of a worker decreased in the round
+};
+
+struct NegativeCycleDetectorStats {
+    size_t incrementalDetections;
+    size_t fullPasses;
+    size_t cycles;
+    size_t repeatedCycles; // Detections answered by the previous cycle, still negative
+    size_t relaxations;
+};
+
+struct NegativeCycleDetector {
+    const CurrencyGraph* graph;
+    int V;
+    std::vector<double> potentials;
+    std::vector<double> nextPotentials;
+    // Edge that last lowered the potential of each currency, only followed when it was set in the current search
+    std::vector<int> predecessorEdgeIds;
+    std::vector<uint64_t> predecessorSearchIds;
+    uint64_t searchId;
+    // Incoming edges of every currency, for the full pass to pull each potential from its own range only
+    std::vector<int> incomingOffsetOfCurrency;
+    std::vector<int> incomingEdgeIds;
+    // FIFO of the currencies whose outgoing edges are to be relaxed, each at most once in it
+    std::vector<int> queue;
+    std::vector<char> isQueued;
+    int queueHead;
+    int queueSize;
+    std::vector<uint64_t> walkStamps;
+    uint64_t walkStamp;
+    bool arePotentialsValid;
+    // While it stays negative there is no point recomputing the potentials
+    NegativeCycle lastCycle;
+
+    std::unique_ptr<NegativeCycleDetectorRound> round;
+    std::vector<std::thread> workers;
+    int numberOfRanges;
+    NegativeCycleDetectorStats stats;
+};
+
+// Starts one worker per core of the list, pinned to it, the full pass is split between them and the calling thread. The
+// workers hold on to the detector, which must stay where it is until it is stopped.
+void createNegativeCycleDetector(NegativeCycleDetector& detector, const CurrencyGraph& graph, const std::vector<int>& workerCores);
+void stopNegativeCycleDetector(NegativeCycleDetector& detector);
+// Checks the graph for a negative cycle after the log rates of the given edges changed. Returns false when there is none.
+bool detectNegativeCycle(NegativeCycleDetector& detector, const int* updatedEdgeIds, int numberOfUpdatedEdges, NegativeCycle& cycle);
+// Recomputes every potential, as after a cycle was found
+bool detectNegativeCycleFromScratch(NegativeCycleDetector& detector, NegativeCycle& cycle);
+
+#endif // NEGATIVE_CYCLE_DETECTOR_HPP
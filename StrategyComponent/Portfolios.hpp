@@ -0,0 +1,335 @@
+// Portfolios.hpp
+#ifndef PORTFOLIOS_HPP
+#define PORTFOLIOS_HPP
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "../Exchanges/ExchangePolicies.hpp"
+
+#define MAX_NUMBER_OF_CURRENCIES 64
+#define MAX_CURRENCY_PAIR_SYMBOL_LENGTH 15
+
+// Currency pairs traded on each exchange, in the order of their market data connections. Everything the Book Builder
+// and the Strategy need to know about a portfolio is derived from these lists at compile time by
+// makePortfolioTables() below, so that no symbol is hashed or compared once the system runs.
+struct CurrencyPair {
+    const char* baseCurrency;   // As the exchange names it, the tables use the canonical name of its policy
+    const char* quoteCurrency;
+    int exchangeIdx = 0;        // Index of the exchange the pair is traded on in the policy list of the portfolio
+};
+
+static constexpr CurrencyPair bitmexCurrencyPairs[] = {
+    {"XBT", "USDT"}, {"XBT", "ETH"}, {"ETH", "USDT"},
+};
+
+// The portfolios keep the names of the optimised portfolios they come from, 122 and 92 now list 115 and 85 pairs
+static constexpr CurrencyPair krakenPortfolio122CurrencyPairs[] = {
+    {"KSM", "EUR"}, {"KSM", "BTC"}, {"KSM", "DOT"}, {"KSM", "GBP"}, {"KSM", "ETH"}, {"KSM", "USD"},
+    {"GBP", "USD"}, {"BTC", "CAD"}, {"BTC", "EUR"}, {"BTC", "AUD"}, {"BTC", "JPY"}, {"BTC", "GBP"},
+    {"BTC", "CHF"}, {"BTC", "USDT"}, {"BTC", "USD"}, {"BTC", "USDC"}, {"LTC", "EUR"}, {"LTC", "BTC"},
+    {"LTC", "AUD"}, {"LTC", "JPY"}, {"LTC", "GBP"}, {"LTC", "ETH"}, {"LTC", "USDT"}, {"LTC", "USD"},
+    {"SOL", "EUR"}, {"SOL", "BTC"}, {"SOL", "GBP"}, {"SOL", "ETH"}, {"SOL", "USDT"}, {"SOL", "USD"},
+    {"DOT", "EUR"}, {"DOT", "BTC"}, {"DOT", "JPY"}, {"DOT", "GBP"}, {"DOT", "ETH"}, {"DOT", "USDT"},
+    {"DOT", "USD"}, {"ETH", "CAD"}, {"ETH", "EUR"}, {"ETH", "BTC"}, {"ETH", "AUD"}, {"ETH", "JPY"},
+    {"ETH", "GBP"}, {"ETH", "CHF"}, {"ETH", "USDT"}, {"ETH", "USD"}, {"ETH", "USDC"}, {"LINK", "EUR"},
+    {"LINK", "BTC"}, {"LINK", "AUD"}, {"LINK", "JPY"}, {"LINK", "GBP"}, {"LINK", "ETH"}, {"LINK", "USDT"},
+    {"LINK", "USD"}, {"USDC", "CAD"}, {"USDC", "EUR"}, {"USDC", "AUD"}, {"USDC", "GBP"}, {"USDC", "CHF"},
+    {"USDC", "USDT"}, {"USDC", "USD"}, {"ADA", "EUR"}, {"ADA", "BTC"}, {"ADA", "AUD"}, {"ADA", "GBP"},
+    {"ADA", "ETH"}, {"ADA", "USDT"}, {"ADA", "USD"}, {"ATOM", "EUR"}, {"ATOM", "BTC"}, {"ATOM", "GBP"},
+    {"ATOM", "ETH"}, {"ATOM", "USDT"}, {"ATOM", "USD"}, {"USDT", "EUR"}, {"USDT", "AUD"}, {"USDT", "JPY"},
+    {"USDT", "GBP"}, {"USDT", "CHF"}, {"USDT", "USD"}, {"USDT", "CAD"}, {"AUD", "JPY"}, {"AUD", "USD"},
+    {"XRP", "CAD"}, {"XRP", "EUR"}, {"XRP", "BTC"}, {"XRP", "AUD"}, {"XRP", "GBP"}, {"XRP", "ETH"},
+    {"XRP", "USDT"}, {"XRP", "USD"}, {"EUR", "CAD"}, {"EUR", "AUD"}, {"EUR", "JPY"}, {"EUR", "GBP"},
+    {"EUR", "CHF"}, {"EUR", "USD"}, {"BCH", "EUR"}, {"BCH", "BTC"}, {"BCH", "AUD"}, {"BCH", "JPY"},
+    {"BCH", "GBP"}, {"BCH", "ETH"}, {"BCH", "USDT"}, {"BCH", "USD"}, {"USD", "CHF"}, {"USD", "JPY"},
+    {"USD", "CAD"}, {"ALGO", "EUR"}, {"ALGO", "BTC"}, {"ALGO", "GBP"}, {"ALGO", "ETH"}, {"ALGO", "USDT"},
+    {"ALGO", "USD"},
+};
+
+static constexpr CurrencyPair krakenPortfolio92CurrencyPairs[] = {
+    {"BCH", "USD"}, {"BCH", "BTC"}, {"BCH", "EUR"}, {"BCH", "AUD"}, {"BCH", "GBP"}, {"BCH", "ETH"},
+    {"BCH", "USDT"}, {"BCH", "JPY"}, {"BTC", "USD"}, {"BTC", "EUR"}, {"BTC", "USDC"}, {"BTC", "AUD"},
+    {"BTC", "GBP"}, {"BTC", "CAD"}, {"BTC", "USDT"}, {"BTC", "JPY"}, {"USD", "CAD"}, {"USD", "JPY"},
+    {"XRP", "USD"}, {"XRP", "BTC"}, {"XRP", "EUR"}, {"XRP", "AUD"}, {"XRP", "GBP"}, {"XRP", "ETH"},
+    {"XRP", "CAD"}, {"XRP", "USDT"}, {"EUR", "USD"}, {"EUR", "AUD"}, {"EUR", "GBP"}, {"EUR", "CAD"},
+    {"EUR", "JPY"}, {"LTC", "USD"}, {"LTC", "EUR"}, {"LTC", "BTC"}, {"LTC", "AUD"}, {"LTC", "GBP"},
+    {"LTC", "ETH"}, {"LTC", "USDT"}, {"LTC", "JPY"}, {"ETH", "USD"}, {"ETH", "EUR"}, {"ETH", "BTC"},
+    {"ETH", "USDC"}, {"ETH", "AUD"}, {"ETH", "GBP"}, {"ETH", "CAD"}, {"ETH", "USDT"}, {"ETH", "JPY"},
+    {"LINK", "USD"}, {"LINK", "BTC"}, {"LINK", "EUR"}, {"LINK", "AUD"}, {"LINK", "GBP"}, {"LINK", "ETH"},
+    {"LINK", "USDT"}, {"LINK", "JPY"}, {"ADA", "USD"}, {"ADA", "BTC"}, {"ADA", "EUR"}, {"ADA", "AUD"},
+    {"ADA", "GBP"}, {"ADA", "ETH"}, {"ADA", "USDT"}, {"USDC", "USD"}, {"USDC", "EUR"}, {"USDC", "AUD"},
+    {"USDC", "GBP"}, {"USDC", "CAD"}, {"USDC", "USDT"}, {"GBP", "USD"}, {"DOT", "USD"}, {"DOT", "BTC"},
+    {"DOT", "EUR"}, {"DOT", "GBP"}, {"DOT", "ETH"}, {"DOT", "USDT"}, {"DOT", "JPY"}, {"USDT", "USD"},
+    {"USDT", "EUR"}, {"USDT", "AUD"}, {"USDT", "GBP"}, {"USDT", "CAD"}, {"USDT", "JPY"}, {"AUD", "USD"},
+    {"AUD", "JPY"},
+};
+
+static constexpr CurrencyPair krakenPortfolio50CurrencyPairs[] = {
+    {"BCH", "JPY"}, {"BCH", "ETH"}, {"BCH", "GBP"}, {"BCH", "AUD"}, {"BCH", "BTC"}, {"BCH", "USDT"},
+    {"BCH", "EUR"}, {"BCH", "USD"}, {"USDT", "JPY"}, {"USDT", "GBP"}, {"USDT", "AUD"}, {"USDT", "EUR"},
+    {"USDT", "USD"}, {"BTC", "JPY"}, {"BTC", "GBP"}, {"BTC", "AUD"}, {"BTC", "USDT"}, {"BTC", "EUR"},
+    {"BTC", "USD"}, {"EUR", "GBP"}, {"EUR", "JPY"}, {"EUR", "AUD"}, {"EUR", "USD"}, {"ETH", "JPY"},
+    {"ETH", "EUR"}, {"ETH", "AUD"}, {"ETH", "BTC"}, {"ETH", "USDT"}, {"ETH", "GBP"}, {"ETH", "USD"},
+    {"USD", "JPY"}, {"LINK", "JPY"}, {"LINK", "ETH"}, {"LINK", "EUR"}, {"LINK", "AUD"}, {"LINK", "BTC"},
+    {"LINK", "USDT"}, {"LINK", "GBP"}, {"LINK", "USD"}, {"LTC", "JPY"}, {"LTC", "ETH"}, {"LTC", "GBP"},
+    {"LTC", "AUD"}, {"LTC", "BTC"}, {"LTC", "USDT"}, {"LTC", "EUR"}, {"LTC", "USD"}, {"GBP", "USD"},
+    {"AUD", "JPY"}, {"AUD", "USD"},
+};
+
+static constexpr CurrencyPair krakenPortfolio3CurrencyPairs[] = {
+    {"USDT", "USD"}, {"SOL", "USDT"}, {"SOL", "USD"},
+};
+
+// Kraken (0) and BitMEX (1) in one graph, whose cycles through BTC and ETH cross from one exchange to the other. A pair
+// is traded on a single exchange, the pairs of an exchange follow each other.
+static constexpr CurrencyPair krakenAndBitmexCurrencyPairs[] = {
+    {"USDT", "USD", 0}, {"SOL", "USDT", 0}, {"SOL", "USD", 0}, {"BTC", "USD", 0}, {"ETH", "USD", 0},
+    {"XBT", "USDT", 1}, {"XBT", "ETH", 1}, {"ETH", "USDT", 1},
+};
+
+// Exchanging the base currency of a pair into its quote currency sells the base currency on the book of the pair,
+// the other way round buys it
+enum class OrderSide {
+    Buy,
+    Sell
+};
+
+// Compile-time tables of a portfolio. Currencies are numbered in the order they first appear in the pair list. The
+// two edges of a pair exchange its base currency into its quote currency (sell edge) and back (buy edge), and are
+// numbered by source currency. The cycles of a pair are the two directions of every triangle it is part of, starting
+// with its base currency.
+template <size_t NUMBER_OF_PAIRS, size_t NUMBER_OF_CURRENCIES, size_t NUMBER_OF_CYCLES>
+struct PortfolioTables {
+    static constexpr size_t numberOfPairs = NUMBER_OF_PAIRS;
+    static constexpr size_t numberOfCurrencies = NUMBER_OF_CURRENCIES;
+    static constexpr size_t numberOfEdges = 2 * NUMBER_OF_PAIRS;
+    static constexpr size_t numberOfCycles = NUMBER_OF_CYCLES;
+
+    std::array<const char*, NUMBER_OF_CURRENCIES> currencies;
+    // Null-terminated exchange symbols, e.g. "SOL/USD" on Kraken and "XBTUSDT" on BitMEX
+    std::array<std::array<char, MAX_CURRENCY_PAIR_SYMBOL_LENGTH + 1>, NUMBER_OF_PAIRS> currencyPairSymbols;
+    std::array<int, NUMBER_OF_PAIRS> baseCurrencyIndexOfPair;
+    std::array<int, NUMBER_OF_PAIRS> quoteCurrencyIndexOfPair;
+    std::array<int, NUMBER_OF_PAIRS> sellEdgeIdOfPair;
+    std::array<int, NUMBER_OF_PAIRS> buyEdgeIdOfPair;
+
+    // The pairs of exchange e are pairOffsetOfExchange[e] up to pairOffsetOfExchange[e + 1], each exchange running a
+    // Book Builder and an Order Manager of its own over them
+    size_t numberOfExchanges;
+    std::array<int, NUMBER_OF_PAIRS> exchangeIdxOfPair;
+    std::array<int, MAX_NUMBER_OF_TRADED_EXCHANGES + 1> pairOffsetOfExchange;
+
+    // Edge ID of the exchange from u to v at u * NUMBER_OF_CURRENCIES + v, -1 when u and v are not paired
+    std::array<int, NUMBER_OF_CURRENCIES * NUMBER_OF_CURRENCIES> edgeIdOfPair;
+    // The edges leaving currency u are edgeOffsetOfCurrency[u] up to edgeOffsetOfCurrency[u + 1]
+    std::array<int, NUMBER_OF_CURRENCIES + 1> edgeOffsetOfCurrency;
+    std::array<int, 2 * NUMBER_OF_PAIRS> sourceCurrencyOfEdge;
+    std::array<int, 2 * NUMBER_OF_PAIRS> targetCurrencyOfEdge;
+    std::array<int, 2 * NUMBER_OF_PAIRS> currencyPairIdxOfEdge;
+    std::array<OrderSide, 2 * NUMBER_OF_PAIRS> orderSideOfEdge;
+
+    // The cycles of pair p are cycleOffsetOfPair[p] up to cycleOffsetOfPair[p + 1], as the edge IDs of their legs
+    std::array<int, NUMBER_OF_CYCLES> cycleFirstEdgeIds;
+    std::array<int, NUMBER_OF_CYCLES> cycleSecondEdgeIds;
+    std::array<int, NUMBER_OF_CYCLES> cycleThirdEdgeIds;
+    std::array<int, NUMBER_OF_PAIRS + 1> cycleOffsetOfPair;
+};
+
+// The policy of the exchange of a pair is only known by its index while the tables are built
+template <typename ExchangePolicies, size_t I = 0>
+constexpr char getSymbolSeparator(int exchangeIdx) {
+    if constexpr (I + 1 < std::tuple_size<ExchangePolicies>::value)
+        if (exchangeIdx != (int)I)
+            return getSymbolSeparator<ExchangePolicies, I + 1>(exchangeIdx);
+    return std::tuple_element_t<I, ExchangePolicies>::symbolSeparator;
+}
+
+template <typename ExchangePolicies, size_t I = 0>
+constexpr const char* getCanonicalCurrency(int exchangeIdx, const char* currency) {
+    if constexpr (I + 1 < std::tuple_size<ExchangePolicies>::value)
+        if (exchangeIdx != (int)I)
+            return getCanonicalCurrency<ExchangePolicies, I + 1>(exchangeIdx, currency);
+    return std::tuple_element_t<I, ExchangePolicies>::getCanonicalCurrency(currency);
+}
+
+// Currencies and pairs by index, the intermediate step of the tables above whose sizes are not known yet
+template <size_t NUMBER_OF_PAIRS>
+struct IndexedCurrencyPairs {
+    size_t numberOfCurrencies;
+    const char* currencies[MAX_NUMBER_OF_CURRENCIES];
+    int baseCurrencyIndexOfPair[NUMBER_OF_PAIRS];
+    int quoteCurrencyIndexOfPair[NUMBER_OF_PAIRS];
+    // Pair index of u and v at u * MAX_NUMBER_OF_CURRENCIES + v and v * MAX_NUMBER_OF_CURRENCIES + u, -1 when unpaired
+    int pairIdxOfCurrencies[MAX_NUMBER_OF_CURRENCIES * MAX_NUMBER_OF_CURRENCIES];
+};
+
+template <size_t NUMBER_OF_PAIRS>
+constexpr int indexCurrency(IndexedCurrencyPairs<NUMBER_OF_PAIRS>& indexedCurrencyPairs, const char* currency) {
+    for (size_t i = 0; i < indexedCurrencyPairs.numberOfCurrencies; i++)
+        if (areSymbolsEqual(indexedCurrencyPairs.currencies[i], currency))
+            return i;
+    if (indexedCurrencyPairs.numberOfCurrencies == MAX_NUMBER_OF_CURRENCIES)
+        throw "too many currencies in the portfolio, raise MAX_NUMBER_OF_CURRENCIES";
+    indexedCurrencyPairs.currencies[indexedCurrencyPairs.numberOfCurrencies] = currency;
+    return indexedCurrencyPairs.numberOfCurrencies++;
+}
+
+// Currencies are told apart by their canonical names, so that the same currency on two exchanges is one vertex
+template <typename ExchangePolicies, size_t NUMBER_OF_PAIRS>
+constexpr IndexedCurrencyPairs<NUMBER_OF_PAIRS> indexCurrencyPairs(const CurrencyPair (&currencyPairs)[NUMBER_OF_PAIRS]) {
+    IndexedCurrencyPairs<NUMBER_OF_PAIRS> indexedCurrencyPairs{};
+    for (int& pairIdx : indexedCurrencyPairs.pairIdxOfCurrencies)
+        pairIdx = -1;
+    for (size_t p = 0; p < NUMBER_OF_PAIRS; p++) {
+        int exchangeIdx = currencyPairs[p].exchangeIdx;
+        if (exchangeIdx < 0 || exchangeIdx >= (int)std::tuple_size<ExchangePolicies>::value)
+            throw "a currency pair is traded on an exchange the portfolio does not list";
+        if (p > 0 && exchangeIdx < currencyPairs[p - 1].exchangeIdx)
+            throw "the currency pairs of an exchange do not follow each other";
+        int u = indexCurrency(indexedCurrencyPairs, getCanonicalCurrency<ExchangePolicies>(exchangeIdx, currencyPairs[p].baseCurrency));
+        int v = indexCurrency(indexedCurrencyPairs, getCanonicalCurrency<ExchangePolicies>(exchangeIdx, currencyPairs[p].quoteCurrency));
+        if (u == v || indexedCurrencyPairs.pairIdxOfCurrencies[u * MAX_NUMBER_OF_CURRENCIES + v] >= 0)
+            throw "a currency pair is listed twice, on one exchange or two, or pairs a currency with itself";
+        indexedCurrencyPairs.baseCurrencyIndexOfPair[p] = u;
+        indexedCurrencyPairs.quoteCurrencyIndexOfPair[p] = v;
+        indexedCurrencyPairs.pairIdxOfCurrencies[u * MAX_NUMBER_OF_CURRENCIES + v] = p;
+        indexedCurrencyPairs.pairIdxOfCurrencies[v * MAX_NUMBER_OF_CURRENCIES + u] = p;
+    }
+    return indexedCurrencyPairs;
+}
+
+template <typename ExchangePolicies, size_t NUMBER_OF_PAIRS>
+constexpr size_t countCurrencies(const CurrencyPair (&currencyPairs)[NUMBER_OF_PAIRS]) {
+    return indexCurrencyPairs<ExchangePolicies>(currencyPairs).numberOfCurrencies;
+}
+
+template <typename ExchangePolicies, size_t NUMBER_OF_PAIRS>
+constexpr size_t countCycles(const CurrencyPair (&currencyPairs)[NUMBER_OF_PAIRS]) {
+    IndexedCurrencyPairs<NUMBER_OF_PAIRS> indexedCurrencyPairs = indexCurrencyPairs<ExchangePolicies>(currencyPairs);
+    size_t numberOfCycles = 0;
+    for (size_t p = 0; p < NUMBER_OF_PAIRS; p++)
+        for (size_t w = 0; w < indexedCurrencyPairs.numberOfCurrencies; w++)
+            if (indexedCurrencyPairs.pairIdxOfCurrencies[indexedCurrencyPairs.baseCurrencyIndexOfPair[p] * MAX_NUMBER_OF_CURRENCIES + w] >= 0 &&
+                indexedCurrencyPairs.pairIdxOfCurrencies[indexedCurrencyPairs.quoteCurrencyIndexOfPair[p] * MAX_NUMBER_OF_CURRENCIES + w] >= 0)
+                numberOfCycles += 2;
+    return numberOfCycles;
+}
+
+// ExchangePolicies lists the exchanges the pairs are traded on, whose policies give the symbols of their pairs
+template <typename ExchangePolicies, size_t NUMBER_OF_CURRENCIES, size_t NUMBER_OF_CYCLES, size_t NUMBER_OF_PAIRS>
+constexpr PortfolioTables<NUMBER_OF_PAIRS, NUMBER_OF_CURRENCIES, NUMBER_OF_CYCLES> makePortfolioTables(const CurrencyPair (&currencyPairs)[NUMBER_OF_PAIRS]) {
+    static_assert(std::tuple_size<ExchangePolicies>::value <= MAX_NUMBER_OF_TRADED_EXCHANGES, "too many exchanges in the portfolio");
+    IndexedCurrencyPairs<NUMBER_OF_PAIRS> indexedCurrencyPairs = indexCurrencyPairs<ExchangePolicies>(currencyPairs);
+    PortfolioTables<NUMBER_OF_PAIRS, NUMBER_OF_CURRENCIES, NUMBER_OF_CYCLES> tables{};
+    const size_t V = NUMBER_OF_CURRENCIES;
+    for (size_t u = 0; u < V; u++)
+        tables.currencies[u] = indexedCurrencyPairs.currencies[u];
+
+    tables.numberOfExchanges = std::tuple_size<ExchangePolicies>::value;
+    for (size_t p = 0; p < NUMBER_OF_PAIRS; p++) {
+        tables.exchangeIdxOfPair[p] = currencyPairs[p].exchangeIdx;
+        tables.pairOffsetOfExchange[currencyPairs[p].exchangeIdx + 1]++;
+    }
+    for (size_t e = 0; e < tables.numberOfExchanges; e++)
+        tables.pairOffsetOfExchange[e + 1] += tables.pairOffsetOfExchange[e];
+
+    for (size_t p = 0; p < NUMBER_OF_PAIRS; p++) {
+        char separator = getSymbolSeparator<ExchangePolicies>(currencyPairs[p].exchangeIdx);
+        size_t length = 0;
+        for (const char* c = currencyPairs[p].baseCurrency; *c; c++)
+            tables.currencyPairSymbols[p][length++] = *c;
+        if (separator)
+            tables.currencyPairSymbols[p][length++] = separator;
+        for (const char* c = currencyPairs[p].quoteCurrency; *c; c++)
+            tables.currencyPairSymbols[p][length++] = *c;
+        if (length > MAX_CURRENCY_PAIR_SYMBOL_LENGTH)
+            throw "currency pair symbol longer than MAX_CURRENCY_PAIR_SYMBOL_LENGTH";
+        tables.baseCurrencyIndexOfPair[p] = indexedCurrencyPairs.baseCurrencyIndexOfPair[p];
+        tables.quoteCurrencyIndexOfPair[p] = indexedCurrencyPairs.quoteCurrencyIndexOfPair[p];
+    }
+
+    // Edge IDs follow the source currency so that the edges leaving a currency are next to each other
+    for (size_t p = 0; p < NUMBER_OF_PAIRS; p++) {
+        tables.edgeOffsetOfCurrency[tables.baseCurrencyIndexOfPair[p] + 1]++;
+        tables.edgeOffsetOfCurrency[tables.quoteCurrencyIndexOfPair[p] + 1]++;
+    }
+    for (size_t u = 0; u < V; u++)
+        tables.edgeOffsetOfCurrency[u + 1] += tables.edgeOffsetOfCurrency[u];
+    for (int& edgeId : tables.edgeIdOfPair)
+        edgeId = -1;
+    std::array<int, NUMBER_OF_CURRENCIES> nextEdgeIdOfCurrency{};
+    for (size_t u = 0; u < V; u++)
+        nextEdgeIdOfCurrency[u] = tables.edgeOffsetOfCurrency[u];
+    for (size_t p = 0; p < NUMBER_OF_PAIRS; p++) {
+        int u = tables.baseCurrencyIndexOfPair[p];
+        int v = tables.quoteCurrencyIndexOfPair[p];
+        int sellEdgeId = tables.sellEdgeIdOfPair[p] = tables.edgeIdOfPair[u * V + v] = nextEdgeIdOfCurrency[u]++;
+        int buyEdgeId = tables.buyEdgeIdOfPair[p] = tables.edgeIdOfPair[v * V + u] = nextEdgeIdOfCurrency[v]++;
+        tables.sourceCurrencyOfEdge[sellEdgeId] = tables.targetCurrencyOfEdge[buyEdgeId] = u;
+        tables.targetCurrencyOfEdge[sellEdgeId] = tables.sourceCurrencyOfEdge[buyEdgeId] = v;
+        tables.currencyPairIdxOfEdge[sellEdgeId] = tables.currencyPairIdxOfEdge[buyEdgeId] = p;
+        tables.orderSideOfEdge[sellEdgeId] = OrderSide::Sell;
+        tables.orderSideOfEdge[buyEdgeId] = OrderSide::Buy;
+    }
+
+    size_t numberOfCycles = 0;
+    for (size_t p = 0; p < NUMBER_OF_PAIRS; p++) {
+        int u = tables.baseCurrencyIndexOfPair[p];
+        int v = tables.quoteCurrencyIndexOfPair[p];
+        tables.cycleOffsetOfPair[p] = numberOfCycles;
+        for (size_t w = 0; w < V; w++) {
+            if (tables.edgeIdOfPair[u * V + w] < 0 || tables.edgeIdOfPair[v * V + w] < 0) continue;
+            // u -> v -> w -> u and u -> w -> v -> u
+            tables.cycleFirstEdgeIds[numberOfCycles] = tables.edgeIdOfPair[u * V + v];
+            tables.cycleSecondEdgeIds[numberOfCycles] = tables.edgeIdOfPair[v * V + w];
+            tables.cycleThirdEdgeIds[numberOfCycles++] = tables.edgeIdOfPair[w * V + u];
+            tables.cycleFirstEdgeIds[numberOfCycles] = tables.edgeIdOfPair[u * V + w];
+            tables.cycleSecondEdgeIds[numberOfCycles] = tables.edgeIdOfPair[w * V + v];
+            tables.cycleThirdEdgeIds[numberOfCycles++] = tables.edgeIdOfPair[v * V + u];
+        }
+    }
+    tables.cycleOffsetOfPair[NUMBER_OF_PAIRS] = numberOfCycles;
+    return tables;
+}
+
+// The policies after the pair list are the exchanges the pairs are traded on, in the order of their indices
+#define PORTFOLIO_TABLES(currencyPairs, ...) \
+    makePortfolioTables<std::tuple<__VA_ARGS__>, countCurrencies<std::tuple<__VA_ARGS__>>(currencyPairs), \
+                        countCycles<std::tuple<__VA_ARGS__>>(currencyPairs)>(currencyPairs)
+
+static constexpr auto bitmexPortfolio = PORTFOLIO_TABLES(bitmexCurrencyPairs, BitmexExchangePolicy);
+static constexpr auto krakenPortfolio122 = PORTFOLIO_TABLES(krakenPortfolio122CurrencyPairs, KrakenExchangePolicy);
+static constexpr auto krakenPortfolio92 = PORTFOLIO_TABLES(krakenPortfolio92CurrencyPairs, KrakenExchangePolicy);
+static constexpr auto krakenPortfolio50 = PORTFOLIO_TABLES(krakenPortfolio50CurrencyPairs, KrakenExchangePolicy);
+static constexpr auto krakenPortfolio3 = PORTFOLIO_TABLES(krakenPortfolio3CurrencyPairs, KrakenExchangePolicy);
+static constexpr auto krakenAndBitmexPortfolio = PORTFOLIO_TABLES(krakenAndBitmexCurrencyPairs, KrakenExchangePolicy, BitmexExchangePolicy);
+
+// The portfolio the system is built for, whose exchanges are the traded exchanges in the same order
+#if defined(USE_KRAKEN_AND_BITMEX_EXCHANGES) || defined(USE_KRAKEN_AND_BITMEX_MOCK_EXCHANGES)
+    static constexpr const auto& tradedPortfolio = krakenAndBitmexPortfolio;
+#elif defined(USE_BITMEX_EXCHANGE) || defined(USE_BITMEX_MOCK_EXCHANGE) || defined(USE_BITMEX_TESTNET_EXCHANGE)
+    static constexpr const auto& tradedPortfolio = bitmexPortfolio;
+#elif defined(USE_KRAKEN_EXCHANGE) || defined(USE_KRAKEN_MOCK_EXCHANGE)
+  #if defined(USE_PORTFOLIO_122)
+    static constexpr const auto& tradedPortfolio = krakenPortfolio122;
+  #elif defined(USE_PORTFOLIO_92)
+    static constexpr const auto& tradedPortfolio = krakenPortfolio92;
+  #elif defined(USE_PORTFOLIO_50)
+    static constexpr const auto& tradedPortfolio = krakenPortfolio50;
+  #elif defined(USE_PORTFOLIO_3)
+    static constexpr const auto& tradedPortfolio = krakenPortfolio3;
+  #endif
+#endif
+
+template <typename Tables>
+std::vector<std::string> getCurrencyPairSymbols(const Tables& tables) {
+    std::vector<std::string> currencyPairSymbols;
+    for (const auto& currencyPairSymbol : tables.currencyPairSymbols)
+        currencyPairSymbols.emplace_back(currencyPairSymbol.data());
+    return currencyPairSymbols;
+}
+
+#endif // PORTFOLIOS_HPP
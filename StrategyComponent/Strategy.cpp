@@ -1,224 +1,389 @@
 #include "Strategy.hpp"
 
 #define CPU_CORE_INDEX_FOR_STRATEGY_THREAD 3
-#define NUMBER_OF_ORDERS_FOR_TRIANGULAR_ARBITRAGE 3
-#define AFTER_FEE_RATE 0.99925
 #define ORDER_SIZE_RATIO_THRESHOLD 1
 
-struct ExchangeRatePriceAndSize {
-    double bestPrice;
-    double bestPriceSize;
-};
-
 struct MinOrderSizeInfo {
     double minOrderSizeInBaseCurrency;
     double minOrderSizeInQuoteCurrency;
 };
 
-#if defined(USE_BITMEX_EXCHANGE) || defined(USE_BITMEX_MOCK_EXCHANGE) || defined(USE_BITMEX_TESTNET_EXCHANGE)
-    #define ORDER_TYPE "Market"
-    #define BUY_ORDER "Buy"
-    #define SELL_ORDER "Sell"
-    const std::unordered_map<string, vector<string>> currencyPairsDict = {
-        {"XBT", {"USDT", "ETH"}},
-        {"ETH", {"USDT"}},
-    };
-#elif defined(USE_KRAKEN_EXCHANGE) || defined(USE_KRAKEN_MOCK_EXCHANGE)
-    #define ORDER_TYPE "market"
-    #define BUY_ORDER "buy"
-    #define SELL_ORDER "sell"
-    #if defined(USE_PORTFOLIO_122)
-        static const std::unordered_map<string, vector<string>> currencyPairsDict = {
-            {"KSM", {"EUR", "BTC", "DOT", "GBP", "ETH", "USD"}},
-            {"GBP", {"USD"}},
-            {"BTC", {"CAD", "EUR", "AUD", "JPY", "GBP", "CHF", "USDT", "USD", "USDC"}},
-            {"LTC", {"EUR", "BTC", "AUD", "JPY", "GBP", "ETH", "USDT", "USD"}},
-            {"SOL", {"EUR", "BTC", "GBP", "ETH", "USDT", "USD"}},
-            {"DOT", {"EUR", "BTC", "JPY", "GBP", "ETH", "USDT", "USD"}},
-            {"ETH", {"CAD", "EUR", "BTC", "AUD", "JPY", "GBP", "CHF", "USDT", "USD", "USDC"}},
-            {"LINK", {"EUR", "BTC", "AUD", "JPY", "GBP", "ETH", "USDT", "USD"}},
-            {"USDC", {"CAD", "EUR", "AUD", "GBP", "CHF", "USDT", "USD"}},
-            {"ADA", {"EUR", "BTC", "AUD", "GBP", "ETH", "USDT", "USD"}},
-            {"ATOM", {"EUR", "BTC", "GBP", "ETH", "USDT", "USD"}},
-            {"USDT", {"EUR", "AUD", "JPY", "GBP", "CHF", "USD", "CAD"}},
-            {"AUD", {"JPY", "USD"}},
-            {"XRP", {"CAD", "EUR", "BTC", "AUD", "GBP", "ETH", "USDT", "USD"}},
-            {"EUR", {"CAD", "AUD", "JPY", "GBP", "CHF", "USD"}},
-            {"BCH", {"EUR", "BTC", "AUD", "JPY", "GBP", "ETH", "USDT", "USD"}},
-            {"USD", {"CHF", "JPY", "CAD"}},
-            {"ALGO", {"EUR", "BTC", "GBP", "ETH", "USDT", "USD"}}
-        };
-    #elif defined(USE_PORTFOLIO_92)
-        const std::unordered_map<string, vector<string>> currencyPairsDict  = {
-            {"BCH", {"USD", "BTC", "EUR", "AUD", "GBP", "ETH", "USDT", "JPY"}},
-            {"BTC", {"USD", "EUR", "USDC", "AUD", "GBP", "CAD", "USDT", "JPY"}},
-            {"USD", {"CAD", "JPY"}},
-            {"XRP", {"USD", "BTC", "EUR", "AUD", "GBP", "ETH", "CAD", "USDT"}},
-            {"EUR", {"USD", "AUD", "GBP", "CAD", "JPY"}},
-            {"LTC", {"USD", "EUR", "BTC", "AUD", "GBP", "ETH", "USDT", "JPY"}},
-            {"ETH", {"USD", "EUR", "BTC", "USDC", "AUD", "GBP", "CAD", "USDT", "JPY"}},
-            {"LINK", {"USD", "BTC", "EUR", "AUD", "GBP", "ETH", "USDT", "JPY"}},
-            {"ADA", {"USD", "BTC", "EUR", "AUD", "GBP", "ETH", "USDT"}},
-            {"USDC", {"USD", "EUR", "AUD", "GBP", "CAD", "USDT"}},
-            {"GBP", {"USD"}},
-            {"DOT", {"USD", "BTC", "EUR", "GBP", "ETH", "USDT", "JPY"}},
-            {"USDT", {"USD", "EUR", "AUD", "GBP", "CAD", "JPY"}},
-            {"AUD", {"USD", "JPY"}}
-        };
-    #elif defined(USE_PORTFOLIO_50)
-        const std::unordered_map<string, vector<string>> currencyPairsDict = {
-            {"BCH", {"JPY", "ETH", "GBP", "AUD", "BTC", "USDT", "EUR", "USD"}},
-            {"USDT", {"JPY", "GBP", "AUD", "EUR", "USD"}},
-            {"BTC", {"JPY", "GBP", "AUD", "USDT", "EUR", "USD"}},
-            {"EUR", {"GBP", "JPY", "AUD", "USD"}},
-            {"ETH", {"JPY", "EUR", "AUD", "BTC", "USDT", "GBP", "USD"}},
-            {"USD", {"JPY"}},
-            {"LINK", {"JPY", "ETH", "EUR", "AUD", "BTC", "USDT", "GBP", "USD"}},
-            {"LTC", {"JPY", "ETH", "GBP", "AUD", "BTC", "USDT", "EUR", "USD"}},
-            {"GBP", {"USD"}},
-            {"AUD", {"JPY", "USD"}}
-        };
-    #elif defined(USE_PORTFOLIO_3)
-        const std::unordered_map<string, vector<string>> currencyPairsDict = {
-            {"USDT", {"USD"}},
-            {"SOL", {"USDT", "USD"}},
-        };
-    #endif
-#endif
-
 
 static std::ofstream strategyComponentDataFile;
 
-static size_t V;
-static std::vector<std::vector<std::pair<int, double>>> g;
-static std::vector<std::vector<ExchangeRatePriceAndSize>> exchangeRatesMatrix;
-static std::vector<std::string> currencies;    
-static std::unordered_map<string, int> currencySymbolToIndex;
-
-void createCurrencyGraph() {
-    g.resize(V);
-    for (int u = 0; u < V; ++u) {
-        for (int v = 0; v < V; ++v) {
-            if (exchangeRatesMatrix[u][v].bestPrice != 0) {
-                g[u].emplace_back(v, 0);
-            }
+static CurrencyGraph currencyGraph;
+// Indexed by currency pair, so that sizing the first leg does not hash its symbol
+static std::array<MinOrderSizeInfo, tradedPortfolio.numberOfPairs> minOrderSizes{};
+static std::array<int, tradedPortfolio.numberOfPairs> lotDecimalsOfPair;
+static LongCycleSearchPool longCycleSearchPool;
+// Shared by the legs of a cycle and unique over the run, to match the orders of the Order Manager to their opportunity.
+// 0 is what the slots of the in-flight registry start completed with.
+static uint64_t nextCycleId = 1;
+
+static StrategyConfig strategyConfig;
+// The queues to the Order Manager of each traded exchange, by exchange index
+static SPSCQueue<StrategyComponentToOrderManagerQueueEntry>* strategyToOrderManagerQueues[MAX_NUMBER_OF_TRADED_EXCHANGES];
+static SPSCQueue<int>* strategyToOrderManagerPrestagingQueues[MAX_NUMBER_OF_TRADED_EXCHANGES];
+
+// Why a profitable cycle was not sent
+enum class OpportunitySkipReason {
+    StaleLeg,           // One of the legs is priced on a book older than the maximum leg age
+    OverBudget,         // The update behind the cycle was received longer ago than the tick-to-decision budget
+    InFlight,           // The orders of the same cycle are still in flight
+    InsufficientVolume, // A leg needs more than the size at the best price, or less than a lot
+    Unprofitable,       // The cycle is no longer profitable on the live books
+    Count
+};
+static size_t opportunitySkips[(size_t)OpportunitySkipReason::Count];
+static size_t totalOpportunitySkips = 0;
+
+static void countOpportunitySkip(OpportunitySkipReason reason) {
+    opportunitySkips[(size_t)reason]++;
+    if (++totalOpportunitySkips % OPPORTUNITY_SKIP_STATS_INTERVAL != 0)
+        return;
+    std::cout << "OPPORTUNITIES SKIPPED: "
+              << opportunitySkips[(size_t)OpportunitySkipReason::StaleLeg] << " stale leg, "
+              << opportunitySkips[(size_t)OpportunitySkipReason::OverBudget] << " over budget, "
+              << opportunitySkips[(size_t)OpportunitySkipReason::InFlight] << " in flight, "
+              << opportunitySkips[(size_t)OpportunitySkipReason::InsufficientVolume] << " insufficient volume, "
+              << opportunitySkips[(size_t)OpportunitySkipReason::Unprofitable] << " unprofitable" << std::endl;
+}
+
+// A pair updated in the current batch, with the timestamps of its latest book
+struct TouchedCurrencyPair {
+    int currencyPairIdx;
+    system_clock::time_point marketUpdateExchangeTimestamp;
+    system_clock::time_point orderBookFinalChangeTimestamp;
+    system_clock::time_point updateSocketRxTimeStamp;
+};
+static std::vector<TouchedCurrencyPair> touchedCurrencyPairs;
+// Index of each pair in touchedCurrencyPairs, -1 when it was not updated in the current batch
+static std::array<int, tradedPortfolio.numberOfPairs> touchedCurrencyPairSlots;
+static std::array<bool, tradedPortfolio.numberOfPairs> isCurrencyPairSearched{};
+
+// A profitable triangle of the batch, with the pair it was found through
+struct ArbitrageCandidate {
+    TriangularArbitrageCycle triangularArbitrageCycle;
+    int touchedCurrencyPairSlot;
+};
+static std::vector<ArbitrageCandidate> arbitrageCandidates;
+
+// Triangles between this and the profitability threshold are close enough for the Order Manager to prestage their
+// orders, CYCLE_LOG_RATE_THRESHOLD when prestaging is off
+static double prestageMinLogRate = CYCLE_LOG_RATE_THRESHOLD;
+// When each edge was last handed to the Order Manager, which keeps its staged request until it expires
+static std::array<steady_clock::time_point, tradedPortfolio.numberOfEdges> prestagingRequestTimestamps{};
+
+static size_t updateBatchSizeHistogram[UPDATE_BATCH_HISTOGRAM_BUCKETS];
+// Microseconds from the Book Builder changing a book to the Strategy taking it off the queue
+static size_t queueWaitHistogram[QUEUE_WAIT_HISTOGRAM_BUCKETS];
+static size_t numberOfUpdateBatches = 0;
+
+// Bucket i holds the values in [2^(i-1), 2^i), bucket 0 the zeros
+static int getHistogramBucketIdx(uint64_t value, int numberOfBuckets) {
+    int bucketIdx = value == 0 ? 0 : 64 - __builtin_clzll(value);
+    return std::min(bucketIdx, numberOfBuckets - 1);
+}
+
+static void printHistogram(const char* name, const char* unit, const size_t* histogram, int numberOfBuckets) {
+    std::cout << name << ":";
+    for (int i = 0; i < numberOfBuckets - 1; i++)
+        std::cout << " <" << (1ULL << i) << unit << " " << histogram[i] << ",";
+    std::cout << " >=" << (1ULL << (numberOfBuckets - 2)) << unit << " " << histogram[numberOfBuckets - 1] << std::endl;
+}
+
+static void recordUpdateBatch(int batchSize) {
+    updateBatchSizeHistogram[getHistogramBucketIdx(batchSize, UPDATE_BATCH_HISTOGRAM_BUCKETS)]++;
+    if (++numberOfUpdateBatches % UPDATE_BATCH_STATS_INTERVAL != 0)
+        return;
+    printHistogram("UPDATE BATCH SIZES", "", updateBatchSizeHistogram, UPDATE_BATCH_HISTOGRAM_BUCKETS);
+    printHistogram("QUEUE WAIT", "us", queueWaitHistogram, QUEUE_WAIT_HISTOGRAM_BUCKETS);
+}
+
+static_assert(tradedPortfolio.numberOfEdges <= LONG_CYCLE_SEARCH_MAX_NUMBER_OF_EDGES, "A long cycle search job cannot hold the rates of the portfolio");
+static_assert(tradedPortfolio.numberOfEdges < (1 << CYCLE_KEY_EDGE_ID_BITS) && MAX_LONG_CYCLE_LENGTH * CYCLE_KEY_EDGE_ID_BITS <= 64, "The key of a cycle cannot hold its edge IDs");
+static_assert(MAX_LONG_CYCLE_LENGTH <= MAX_ARBITRAGE_BATCH_SIZE, "A batch of the Order Manager cannot hold the legs of the longest cycle");
+static_assert(tradedPortfolio.numberOfExchanges == numberOfTradedExchanges, "The traded portfolio does not list the pairs of each traded exchange");
+
+// Sizes the legs of the cycle on the current best prices and pushes them to the Order Managers of their exchanges, as
+// one batch per exchange. Returns false, without pushing anything, and counts the reason when the cycle is skipped.
+static bool sendArbitrageOrders(const int* edgeIds, int numberOfLegs, system_clock::time_point marketUpdateExchangeTimestamp, system_clock::time_point orderBookFinalChangeTimestamp,
+                                system_clock::time_point updateSocketRxTimeStamp, InFlightCycleRegistry& inFlightCycleRegistry) {
+    system_clock::time_point now = high_resolution_clock::now();
+    if (strategyConfig.tickToDecisionBudgetInMicroseconds > 0 && now - updateSocketRxTimeStamp > microseconds(strategyConfig.tickToDecisionBudgetInMicroseconds)) {
+      countOpportunitySkip(OpportunitySkipReason::OverBudget);
+      return false;
+    }
+    if (strategyConfig.maxLegAgeInMicroseconds > 0) {
+      for (int i = 0; i < numberOfLegs; ++i) {
+        if (now - currencyGraph.rxTimestampOfEdge[edgeIds[i]] > microseconds(strategyConfig.maxLegAgeInMicroseconds)) {
+          countOpportunitySkip(OpportunitySkipReason::StaleLeg);
+          return false;
         }
+      }
     }
-}
 
-void createExchangeRatesMatrix() {
-    for (const auto& [key, vals] : currencyPairsDict) {
-        currencies.push_back(key);
-        currencies.insert(currencies.end(), vals.begin(), vals.end());
+    // An opportunity that persists over several updates would otherwise be sent again on each of them
+    uint64_t cycleKey = getCycleKey(edgeIds, numberOfLegs);
+    if (isCycleInFlight(inFlightCycleRegistry, cycleKey)) {
+      countOpportunitySkip(OpportunitySkipReason::InFlight);
+      return false;
     }
-    sort(currencies.begin(), currencies.end());
-    currencies.erase(unique(currencies.begin(), currencies.end()), currencies.end());
 
-    cout << "CURRENCIES: " << endl;
-    for (size_t i = 0; i < currencies.size(); ++i) {
-        currencySymbolToIndex[currencies[i]] = i;
-        cout << currencies[i] << endl;
+    bool cancelOrders = false;
+    double arbitrageProfit = 1;
+    double convertedSize;
+    StrategyComponentToOrderManagerQueueEntry orderManagerQueueEntries[MAX_NUMBER_OF_TRADED_EXCHANGES];
+    unsigned exchangeMask = 0;
+    for (size_t exchangeIdx = 0; exchangeIdx < numberOfTradedExchanges; ++exchangeIdx)
+        orderManagerQueueEntries[exchangeIdx].numberOfOrders = 0;
+    for (int i = 0; i < numberOfLegs; ++i) {
+        int edgeId = edgeIds[i];
+        int legCurrencyPairIdx = tradedPortfolio.currencyPairIdxOfEdge[edgeId];
+        int legExchangeIdx = tradedPortfolio.exchangeIdxOfPair[legCurrencyPairIdx];
+        const Edge& edge = currencyGraph.edges[edgeId];
+
+        double orderSize;
+        double orderSizeRatio;
+        if (tradedPortfolio.orderSideOfEdge[edgeId] == OrderSide::Sell) {
+          if (i == 0) 
+              orderSize = minOrderSizes[legCurrencyPairIdx].minOrderSizeInBaseCurrency;
+          else 
+              orderSize = convertedSize;
+          convertedSize = orderSize /*in base*/ * edge.bestPrice; /*in quote*/ 
+        } else {
+          if (i == 0) 
+              orderSize = minOrderSizes[legCurrencyPairIdx].minOrderSizeInBaseCurrency;
+          else 
+              orderSize = convertedSize /*in quote*/ * edge.bestPrice /*in base*/; /*reciprocal*/
+          convertedSize = orderSize; // in base
+        }
+      
+        orderSizeRatio = orderSize / edge.bestPriceSize;  
+        if (orderSizeRatio > ORDER_SIZE_RATIO_THRESHOLD) {
+          cancelOrders = true;
+        }
+
+        StrategyComponentToOrderManagerQueueEntry& orderManagerQueueEntry = orderManagerQueueEntries[legExchangeIdx];
+        ArbitrageOrder& order = orderManagerQueueEntry.orders[orderManagerQueueEntry.numberOfOrders++];
+        exchangeMask |= 1u << legExchangeIdx;
+        order.currencyPairIdx = legCurrencyPairIdx;
+        order.side = tradedPortfolio.orderSideOfEdge[edgeId];
+        order.orderType = OrderType::Market;
+        order.lotDecimals = lotDecimalsOfPair[legCurrencyPairIdx];
+        order.legIdx = i;
+        order.volumeInLots = volumeToLots(orderSize, order.lotDecimals);
+        if (order.volumeInLots == 0)
+          cancelOrders = true;
+
+        arbitrageProfit *= edge.bestPrice;
+
+        std::cout << "NEW ORDER CREATED: " << tradedPortfolio.currencyPairSymbols[legCurrencyPairIdx].data() << (order.side == OrderSide::Sell ? " sell " : " buy ")
+                  << order.volumeInLots / powersOfTen[order.lotDecimals] << std::endl; 
+    }
+
+    if (cancelOrders) {
+      countOpportunitySkip(OpportunitySkipReason::InsufficientVolume);
+      return false;
+    }
+    if (arbitrageProfit < 1.000) {
+      countOpportunitySkip(OpportunitySkipReason::Unprofitable);
+      return false;
+    }
+
+    // The Order Manager of each exchange reports its part of the cycle completed on its own
+    uint64_t cycleId = nextCycleId++;
+    int inFlightSlotIdx = registerInFlightCycle(inFlightCycleRegistry, cycleKey, cycleId, exchangeMask);
+    for (size_t exchangeIdx = 0; exchangeIdx < numberOfTradedExchanges; ++exchangeIdx) {
+        StrategyComponentToOrderManagerQueueEntry& orderManagerQueueEntry = orderManagerQueueEntries[exchangeIdx];
+        if (orderManagerQueueEntry.numberOfOrders == 0)
+            continue;
+        orderManagerQueueEntry.cycleId = cycleId;
+        orderManagerQueueEntry.inFlightSlotIdx = inFlightSlotIdx;
+        orderManagerQueueEntry.marketUpdateExchangeTimestamp = timePointToNanoseconds(marketUpdateExchangeTimestamp);
+        orderManagerQueueEntry.orderBookFinalChangeTimestamp = timePointToNanoseconds(orderBookFinalChangeTimestamp);
+        orderManagerQueueEntry.updateSocketRxTimeStamp = timePointToNanoseconds(updateSocketRxTimeStamp);
+        orderManagerQueueEntry.strategyOrderPushTimestamp = timePointToNanoseconds(high_resolution_clock::now());
+        while (!strategyToOrderManagerQueues[exchangeIdx]->push(orderManagerQueueEntry));
+    }
+
+    cout << "Expected percentage profit for the detected " << numberOfLegs << "-leg arbitrage: " << (arbitrageProfit - 1) * 100 << "%" << endl;
+    return true;
+}
+
+// Writes the best prices of the book into the graph and adds its pair to the ones searched at the end of the batch
+template <typename ExchangePolicy>
+static void applyOrderBook(OrderBook<ExchangePolicy>& orderBook) {
+    auto bestBuy = orderBook.getBestBuyLimitPriceAndSize();
+    auto bestSell = orderBook.getBestSellLimitPriceAndSize();  
+    double bestBuyPrice = bestBuy.first;
+    double bestBuyPriceSize = bestBuy.second;
+    double bestSellPriceReciprocal = 1.0 / bestSell.first;
+    double bestSellPriceSize = bestSell.second;
+
+    int currencyPairIdx = orderBook.getCurrencyPairIdx();
+    int sellEdgeId = tradedPortfolio.sellEdgeIdOfPair[currencyPairIdx];
+    int buyEdgeId = tradedPortfolio.buyEdgeIdOfPair[currencyPairIdx];
+
+    if (!orderBook.isValid()) {
+      // The pair stays out of every cycle until the Book Builder has applied the snapshot of its resubscription
+      setExchangeRate(currencyGraph, sellEdgeId, 0.0, 0.0);
+      setExchangeRate(currencyGraph, buyEdgeId, 0.0, 0.0);
+      return;
     }
+
+    system_clock::time_point marketUpdateExchangeTimestamp = time_point<high_resolution_clock>(microseconds(orderBook.getMarketUpdateExchangeTimestamp()));
+    system_clock::time_point orderBookFinalChangeTimestamp = orderBook.getFinalUpdateTimestamp();
+    system_clock::time_point updateSocketRxTimeStamp = orderBook.getUpdateSocketRxTimestamp();
+
+    setExchangeRate(currencyGraph, sellEdgeId, bestBuyPrice, bestBuyPriceSize);
+    setExchangeRate(currencyGraph, buyEdgeId, bestSellPriceReciprocal, bestSellPriceSize);
+    setEdgeTimestamps(currencyGraph, sellEdgeId, marketUpdateExchangeTimestamp, updateSocketRxTimeStamp);
+    setEdgeTimestamps(currencyGraph, buyEdgeId, marketUpdateExchangeTimestamp, updateSocketRxTimeStamp);
+#ifdef VERBOSE_STRATEGY      
+    //   printExchangeRatesMatrix(currencyGraph);
+    printEdgeWeights(currencyGraph);
+#endif
     
-    int n = currencies.size();
-    exchangeRatesMatrix = std::vector<std::vector<ExchangeRatePriceAndSize>>(n, std::vector<ExchangeRatePriceAndSize>(n, {0.0, 0.0}));
+    if (orderBook.getMarketUpdateExchangeTimestamp() == 0) 
+      return;
+
+    TouchedCurrencyPair touchedCurrencyPair = {currencyPairIdx, marketUpdateExchangeTimestamp, orderBookFinalChangeTimestamp, updateSocketRxTimeStamp};
+    if (touchedCurrencyPairSlots[currencyPairIdx] < 0) {
+      touchedCurrencyPairSlots[currencyPairIdx] = touchedCurrencyPairs.size();
+      touchedCurrencyPairs.push_back(touchedCurrencyPair);
+    } else {
+      touchedCurrencyPairs[touchedCurrencyPairSlots[currencyPairIdx]] = touchedCurrencyPair;
+    }
+}
 
-    for (const auto& [p1, p2s] : currencyPairsDict) {
-        for (const auto& p2 : p2s) {
-            exchangeRatesMatrix[currencySymbolToIndex[p1]][currencySymbolToIndex[p2]].bestPrice = 1;
-            exchangeRatesMatrix[currencySymbolToIndex[p2]][currencySymbolToIndex[p1]].bestPrice = 1;
-        }
+// A triangle through several pairs of the batch is only evaluated with the first of them that is searched
+static bool isSearchedInBatch(const TriangularArbitrageCycle& triangularArbitrageCycle) {
+    for (int edgeId : triangularArbitrageCycle.edgeIds) {
+      if (isCurrencyPairSearched[tradedPortfolio.currencyPairIdxOfEdge[edgeId]])
+        return true;
     }
+    return false;
 }
 
-std::pair<std::vector<int>, std::chrono::system_clock::time_point> findTriangularArbitrage() {
-    int V = exchangeRatesMatrix.size();
-    vector<double> distances(V);
-    vector<int> predecessors(V, -1);
-    const int startCurrency = 0;
-    distances[startCurrency] = 0;
-
-    for (int i = 0; i < V - 1; ++i) { 
-        bool relaxed = false;
-        for (int u = 0; u < V; ++u) {
-            if (distances[u] == numeric_limits<double>::infinity()) continue;
-            for (const auto& [v, weight] : g[u]) 
-                if (distances[u] + weight < distances[v]) {
-                    distances[v] = distances[u] + weight;
-                    predecessors[v] = u;
-                    relaxed = true;
-                }
-        }
-        if (!relaxed) break;
-    }       
-    system_clock::time_point relaxationCompletionTimestamp = std::chrono::high_resolution_clock::now();
-
-    // Cycle detection
-    vector<int> triangularArbitrageCurrencySequence(NUMBER_OF_ORDERS_FOR_TRIANGULAR_ARBITRAGE);
-    vector<bool> seen(V, false);
-    bool stop = false;
-    system_clock::time_point detectionStartTimestamp = std::chrono::high_resolution_clock::now();
-    for (int u = 0; u < V; ++u) { 
-        for (const auto& [v, weight] : g[u]) {
-            if (seen[v] || !(distances[u] < numeric_limits<double>::infinity())) continue;
-            if (distances[u] + weight < distances[v]) {
-                vector<int> triangularArbitrageCycle;
-                int x = v;
-                while (true) {
-                    if (x == -1) return std::make_pair(triangularArbitrageCurrencySequence, detectionStartTimestamp);
-                    seen[x] = true;
-                    triangularArbitrageCycle.push_back(x);
-                    x = predecessors[x];
-                    if (x == v || find(triangularArbitrageCycle.begin(), triangularArbitrageCycle.end(), x) != triangularArbitrageCycle.end()) break;
-                }
-                if (x == -1) return std::make_pair(triangularArbitrageCurrencySequence, detectionStartTimestamp);
-                int idx = find(triangularArbitrageCycle.begin(), triangularArbitrageCycle.end(), x) - triangularArbitrageCycle.begin();
-                if (triangularArbitrageCycle.size() - idx == NUMBER_OF_ORDERS_FOR_TRIANGULAR_ARBITRAGE) {
-                    triangularArbitrageCycle.push_back(x);
-                    triangularArbitrageCurrencySequence = vector<int>(triangularArbitrageCycle.begin() + idx, triangularArbitrageCycle.end()); 
-                    reverse(triangularArbitrageCurrencySequence.begin(), triangularArbitrageCurrencySequence.end());
-                    stop = true;
-                    break;
-                }
-            }
-        }
-        if (stop) break;
+// Asks the Order Managers of its legs to prepare the orders of a triangle that may turn profitable with the next
+// updates. The queues are never waited on, a request that does not fit is dropped.
+static void requestOrderPrestaging(const TriangularArbitrageCycle& triangularArbitrageCycle) {
+    steady_clock::time_point now = steady_clock::now();
+    for (int edgeId : triangularArbitrageCycle.edgeIds) {
+      if (now - prestagingRequestTimestamps[edgeId] < milliseconds(PRESTAGING_REQUEST_INTERVAL_IN_MILLISECONDS))
+        continue;
+      int exchangeIdx = tradedPortfolio.exchangeIdxOfPair[tradedPortfolio.currencyPairIdxOfEdge[edgeId]];
+      if (!strategyToOrderManagerPrestagingQueues[exchangeIdx]->push(edgeId))
+        return;
+      prestagingRequestTimestamps[edgeId] = now;
     }
+}
+
+// Searches the cycles through a pair updated in the batch, on the rates of every book of the batch, and adds its
+// profitable triangles to the candidates of the batch. The orders of the nearly profitable ones are prestaged.
+static void searchCurrencyPair(int touchedCurrencyPairSlot, bool isLongCycleSearchEnabled, std::vector<TriangularArbitrageCycle>& triangularArbitrageCycles) {
+    const TouchedCurrencyPair& touchedCurrencyPair = touchedCurrencyPairs[touchedCurrencyPairSlot];
+    int currencyPairIdx = touchedCurrencyPair.currencyPairIdx;
+
+    // The workers search the longer cycles through the pair while the triangles are evaluated here
+    if (isLongCycleSearchEnabled)
+      submitLongCycleSearch(longCycleSearchPool, currencyGraph, currencyPairIdx, touchedCurrencyPair.marketUpdateExchangeTimestamp,
+                            touchedCurrencyPair.orderBookFinalChangeTimestamp, touchedCurrencyPair.updateSocketRxTimeStamp);
+
+    // Only the triangles through the updated pair can have changed since the previous update
+    triangularArbitrageCycles.clear();
+    size_t numberOfTriangularArbitrages = findTriangularArbitrages(currencyGraph, currencyPairIdx, triangularArbitrageCycles, prestageMinLogRate);
+
+    if (numberOfTriangularArbitrages == 0)
+      return;
     
-    // return triangularArbitrageCurrencySequence;
-    return std::make_pair(triangularArbitrageCurrencySequence, relaxationCompletionTimestamp);
+#ifdef VERBOSE_STRATEGY
+    std::cout << numberOfTriangularArbitrages << " profitable or nearly profitable triangles through " << tradedPortfolio.currencyPairSymbols[currencyPairIdx].data() << std::endl;
+#endif
+    for (const TriangularArbitrageCycle& triangularArbitrageCycle : triangularArbitrageCycles) {
+      if (isSearchedInBatch(triangularArbitrageCycle))
+        continue;
+      if (triangularArbitrageCycle.logRate > CYCLE_LOG_RATE_THRESHOLD)
+        arbitrageCandidates.push_back({triangularArbitrageCycle, touchedCurrencyPairSlot});
+      else
+        requestOrderPrestaging(triangularArbitrageCycle);
+    }
 }
 
-void printEdgeWeights() {
-    cout << "Edge Weights:";
-    for (int u = 0; u < V; ++u) 
-        for (const auto& [v, weight] : g[u]) 
-            cout << u << " -> " << v << " : " << weight << endl;
-    cout << endl;
+// Tries the candidates of the batch from the most profitable down, until the maximum number of cycles per batch is
+// sent. The candidates that need the best level of a book that a cycle sent before them takes are left out, as only
+// the first one would find the volume it was sized on.
+static void sendBestArbitrages(InFlightCycleRegistry& inFlightCycleRegistry) {
+    std::sort(arbitrageCandidates.begin(), arbitrageCandidates.end(), [](const ArbitrageCandidate& a, const ArbitrageCandidate& b) {
+      return a.triangularArbitrageCycle.logRate > b.triangularArbitrageCycle.logRate;
+    });
+
+    int takenEdgeIds[MAX_CONCURRENT_ARBITRAGE_BATCHES * NUMBER_OF_ORDERS_FOR_TRIANGULAR_ARBITRAGE];
+    int numberOfTakenEdges = 0;
+    int numberOfSentArbitrages = 0;
+    for (const ArbitrageCandidate& arbitrageCandidate : arbitrageCandidates) {
+      if (numberOfSentArbitrages == strategyConfig.maxArbitragesPerBatch)
+        break;
+      const TriangularArbitrageCycle& triangularArbitrageCycle = arbitrageCandidate.triangularArbitrageCycle;
+      if (std::any_of(triangularArbitrageCycle.edgeIds, triangularArbitrageCycle.edgeIds + NUMBER_OF_ORDERS_FOR_TRIANGULAR_ARBITRAGE, [&](int edgeId) {
+            return std::find(takenEdgeIds, takenEdgeIds + numberOfTakenEdges, edgeId) != takenEdgeIds + numberOfTakenEdges;
+          }))
+        continue;
+
+      const TouchedCurrencyPair& touchedCurrencyPair = touchedCurrencyPairs[arbitrageCandidate.touchedCurrencyPairSlot];
+      if (!sendArbitrageOrders(triangularArbitrageCycle.edgeIds, NUMBER_OF_ORDERS_FOR_TRIANGULAR_ARBITRAGE, touchedCurrencyPair.marketUpdateExchangeTimestamp,
+                               touchedCurrencyPair.orderBookFinalChangeTimestamp, touchedCurrencyPair.updateSocketRxTimeStamp, inFlightCycleRegistry))
+        continue;
+
+#ifdef VERBOSE_STRATEGY
+      std::cout << "TRIANGULAR ARBITRAGE OPPORTUNITY FOUND" << std::endl;  
+      cout << "Currency conversions for triangular arbitrage opportunity: ";
+      for (int currency : triangularArbitrageCycle.currencySequence) {
+          cout << currency << " ";
+      }
+      cout << endl;
+#endif
+      for (int edgeId : triangularArbitrageCycle.edgeIds)
+        takenEdgeIds[numberOfTakenEdges++] = edgeId;
+      numberOfSentArbitrages++;
+    }
+    arbitrageCandidates.clear();
 }
 
-void printExchangeRatesMatrix() {
-    cout << "Exchange Rates Matrix:" << endl;
-    for (const auto& row : exchangeRatesMatrix) {
-        for (ExchangeRatePriceAndSize exchangeRatePriceAndSize : row) {
-            cout << exchangeRatePriceAndSize.bestPrice << " ";
-        }
-        cout << endl;
+// Sends the cycles the workers found while they are still within the latency budget and still profitable on the live books
+static void processLongCycleSearchResults(InFlightCycleRegistry& inFlightCycleRegistry) {
+    LongCycleSearchResult result;
+    while (pollLongCycleSearchResult(longCycleSearchPool, result)) {
+      bool late = false;
+      bool sent = false;
+      if (result.found) {
+        late = !isWithinLatencyBudget(longCycleSearchPool, result);
+        if (!late)
+          sent = sendArbitrageOrders(result.edgeIds, result.cycleLength, result.marketUpdateExchangeTimestamp, result.orderBookFinalChangeTimestamp,
+                                     result.updateSocketRxTimeStamp, inFlightCycleRegistry);
+      }
+      recordLongCycleSearchResult(longCycleSearchPool, result, late, sent);
     }
-    cout << endl;
 }
 
-void changeEdgeWeight(int baseCurrencyGraphIndex, int quoteCurrencyGraphIndex, double new_weight) {
-    for (auto& edge : g[baseCurrencyGraphIndex]) {
-        if (edge.first == quoteCurrencyGraphIndex) {
-            edge.second = new_weight;
-            return;
-        }
+// Applies the books waiting on the queue of one exchange, at most maxNumberOfBooks of them, and returns how many
+template <typename ExchangePolicy>
+static int applyWaitingOrderBooks(SPSCQueue<OrderBook<ExchangePolicy>>& bookBuilderToStrategyQueue, int maxNumberOfBooks) {
+    OrderBook<ExchangePolicy> orderBook;
+    int numberOfBooks = 0;
+    while (numberOfBooks < maxNumberOfBooks && bookBuilderToStrategyQueue.pop(orderBook)) {
+      system_clock::time_point newOrderBookDetectionTimestamp = high_resolution_clock::now();
+      int64_t queueWaitInMicroseconds = duration_cast<microseconds>(newOrderBookDetectionTimestamp - orderBook.getFinalUpdateTimestamp()).count();
+      queueWaitHistogram[getHistogramBucketIdx(std::max<int64_t>(queueWaitInMicroseconds, 0), QUEUE_WAIT_HISTOGRAM_BUCKETS)]++;
+      applyOrderBook(orderBook);
+      numberOfBooks++;
     }
-    g[baseCurrencyGraphIndex].emplace_back(quoteCurrencyGraphIndex, new_weight); 
+    return numberOfBooks;
 }
 
-void strategy(SPSCQueue<OrderBook>& builderToStrategyQueue, SPSCQueue<StrategyComponentToOrderManagerQueueEntry>& strategyToOrderManagerQueue) {
+void strategy(AllTradedExchangeQueues& tradedExchangeQueues, InFlightCycleRegistry& inFlightCycleRegistry, const StrategyConfig& config,
+              const LongCycleSearchConfig& longCycleSearchConfig) {
     int numCores = std::thread::hardware_concurrency();
     
     if (numCores == 0) {
@@ -229,161 +394,77 @@ void strategy(SPSCQueue<OrderBook>& builderToStrategyQueue, SPSCQueue<StrategyCo
         return;
     }
 
+    strategyConfig = config;
+    forEachTradedExchange([&](auto exchangePolicy) {
+        using ExchangePolicy = decltype(exchangePolicy);
+        TradedExchangeQueues<ExchangePolicy>* queues = std::get<TradedExchangeQueues<ExchangePolicy>*>(tradedExchangeQueues);
+        strategyToOrderManagerQueues[getTradedExchangeIdx<ExchangePolicy>()] = &queues->strategyToOrderManagerQueue;
+        strategyToOrderManagerPrestagingQueues[getTradedExchangeIdx<ExchangePolicy>()] = &queues->strategyToOrderManagerPrestagingQueue;
+    });
+    if (strategyConfig.prestageMarginInBasisPoints > 0)
+        prestageMinLogRate = CYCLE_LOG_RATE_THRESHOLD + log1p(-strategyConfig.prestageMarginInBasisPoints / 10000.0);
     int cpuCoreNumberForStrategyThread = CPU_CORE_INDEX_FOR_STRATEGY_THREAD;
     setThreadAffinity(pthread_self(), cpuCoreNumberForStrategyThread);
 
     ifstream minOrderSizesJsonFile("min-order-sizes.json");
     nlohmann::json minOrderSizesJson;
     minOrderSizesJsonFile >> minOrderSizesJson;
-    unordered_map<string, MinOrderSizeInfo> minOrderSizes;
-    for (auto& [currencyPair, minOrderSizeInfo] : minOrderSizesJson.items()) {
-        minOrderSizes[currencyPair] = {
-            minOrderSizeInfo["ordermin"].get<double>(),
-            minOrderSizeInfo["costmin"].get<double>()
+    for (size_t currencyPairIdx = 0; currencyPairIdx < tradedPortfolio.numberOfPairs; currencyPairIdx++) {
+        const char* currencyPairSymbol = tradedPortfolio.currencyPairSymbols[currencyPairIdx].data();
+        int lotDecimals = DEFAULT_LOT_DECIMALS;
+        if (minOrderSizesJson.contains(currencyPairSymbol))
+            lotDecimals = minOrderSizesJson[currencyPairSymbol].value("lot_decimals", DEFAULT_LOT_DECIMALS);
+        if (lotDecimals < 0 || lotDecimals > MAX_LOT_DECIMALS) {
+            std::cerr << "Error: " << lotDecimals << " lot decimals for " << currencyPairSymbol << " are not supported" << std::endl;
+            return;
+        }
+        lotDecimalsOfPair[currencyPairIdx] = lotDecimals;
+        if (!minOrderSizesJson.contains(currencyPairSymbol)) {
+            std::cerr << "Warning: no minimum order size for " << currencyPairSymbol << " in min-order-sizes.json" << std::endl;
+            continue;
+        }
+        minOrderSizes[currencyPairIdx] = {
+            minOrderSizesJson[currencyPairSymbol]["ordermin"].get<double>(),
+            minOrderSizesJson[currencyPairSymbol]["costmin"].get<double>()
         };
     }
 
-    createExchangeRatesMatrix();
-    V = exchangeRatesMatrix.size();
-    createCurrencyGraph();
-    
+    createCurrencyGraph(tradedPortfolio, currencyGraph);
+    cout << "CURRENCIES: " << endl;
+    for (const char* currency : tradedPortfolio.currencies)
+        cout << currency << endl;
+    cout << "Cycle evaluation kernel: " << getCycleEvaluationKernelName(currencyGraph.cycleEvaluationKernel) << endl;
+    bool isLongCycleSearchEnabled = startLongCycleSearchPool(longCycleSearchPool, currencyGraph, longCycleSearchConfig);
+
+    std::vector<TriangularArbitrageCycle> triangularArbitrageCycles;
+    touchedCurrencyPairs.reserve(tradedPortfolio.numberOfPairs);
+    touchedCurrencyPairSlots.fill(-1);
     while (true) {
-      OrderBook orderBook;
-      while (!builderToStrategyQueue.pop(orderBook));
-      system_clock::time_point newOrderBookDetectionTimestamp = high_resolution_clock::now();
-      auto bestBuy = orderBook.getBestBuyLimitPriceAndSize();
-      auto bestSell = orderBook.getBestSellLimitPriceAndSize();  
-      double bestBuyPrice = bestBuy.first;
-      double bestBuyPriceSize = bestBuy.second;
-      double bestSellPriceReciprocal = 1.0 / bestSell.first;
-      double bestSellPriceSize = bestSell.second;
-
-      std::string currencyPair = orderBook.getCurrencyPairSymbol();
-#if defined(USE_KRAKEN_EXCHANGE) || defined(USE_KRAKEN_MOCK_EXCHANGE)
-      std::size_t baseCurrencyEndPos = currencyPair.find('/');
-      int quoteCurrencyGraphIndex = currencySymbolToIndex[currencyPair.substr(baseCurrencyEndPos + 1, currencyPair.size())];
-#elif defined(USE_BITMEX_EXCHANGE) || defined(USE_BITMEX_MOCK_EXCHANGE) || defined(USE_BITMEX_TESTNET_EXCHANGE)
-      std::size_t baseCurrencyEndPos = 3;
-      int quoteCurrencyGraphIndex = currencySymbolToIndex[currencyPair.substr(baseCurrencyEndPos, currencyPair.size())];
-#endif
-      int baseCurrencyGraphIndex = currencySymbolToIndex[currencyPair.substr(0, baseCurrencyEndPos)];
-
-      if (bestBuyPrice != exchangeRatesMatrix[baseCurrencyGraphIndex][quoteCurrencyGraphIndex].bestPrice) {
-        exchangeRatesMatrix[baseCurrencyGraphIndex][quoteCurrencyGraphIndex].bestPrice = bestBuyPrice;
-        changeEdgeWeight(baseCurrencyGraphIndex, quoteCurrencyGraphIndex, -log(bestBuyPrice));
+      // Every book already waiting is applied before searching, so that a burst is searched once on its latest rates
+      // rather than book by book on rates that the rest of the queue has already overwritten. The queues of the
+      // exchanges are taken in turn, each up to what is left of the batch.
+      int batchSize = 0;
+      while (true) {
+        std::apply([&](auto*... queues) {
+          ((batchSize += applyWaitingOrderBooks(queues->bookBuilderToStrategyQueue, strategyConfig.maxUpdateBatchSize - batchSize)), ...);
+        }, tradedExchangeQueues);
+        if (batchSize > 0)
+          break;
+        if (isLongCycleSearchEnabled)
+          processLongCycleSearchResults(inFlightCycleRegistry);
       }
+      recordUpdateBatch(batchSize);
 
-      if (bestSellPriceReciprocal != exchangeRatesMatrix[baseCurrencyGraphIndex][quoteCurrencyGraphIndex].bestPrice) {
-        exchangeRatesMatrix[quoteCurrencyGraphIndex][baseCurrencyGraphIndex].bestPrice = bestSellPriceReciprocal;
-        changeEdgeWeight(quoteCurrencyGraphIndex, baseCurrencyGraphIndex, -log(bestSellPriceReciprocal));
+      for (size_t touchedCurrencyPairSlot = 0; touchedCurrencyPairSlot < touchedCurrencyPairs.size(); touchedCurrencyPairSlot++) {
+        searchCurrencyPair(touchedCurrencyPairSlot, isLongCycleSearchEnabled, triangularArbitrageCycles);
+        isCurrencyPairSearched[touchedCurrencyPairs[touchedCurrencyPairSlot].currencyPairIdx] = true;
       }
-
-      exchangeRatesMatrix[baseCurrencyGraphIndex][quoteCurrencyGraphIndex].bestPriceSize = bestBuyPriceSize;
-      exchangeRatesMatrix[quoteCurrencyGraphIndex][baseCurrencyGraphIndex].bestPriceSize = bestSellPriceSize;
-#ifdef VERBOSE_STRATEGY      
-    //   printExchangeRatesMatrix();
-      printEdgeWeights();
-#endif
-      std::chrono::system_clock::time_point findArbitrageStartTimestamp = high_resolution_clock::now();
-      std::pair<std::vector<int>, std::chrono::system_clock::time_point> findTriangularArbitrageResult = findTriangularArbitrage();
-      std::vector<int> triangularArbitrageCurrencySequence = findTriangularArbitrageResult.first;
-      std::chrono::system_clock::time_point relaxationCompletionTimestamp = findTriangularArbitrageResult.second;
-      std::chrono::system_clock::time_point arbitrageDetectionCompletionTimestamp = high_resolution_clock::now();
-            
-      if (triangularArbitrageCurrencySequence.empty())
-        continue;   
-
-      if (triangularArbitrageCurrencySequence.size() > 1 && triangularArbitrageCurrencySequence[0] == triangularArbitrageCurrencySequence[1]) { //happens for ADA/ADA
-        continue;
-      }          
-      
-      system_clock::time_point marketUpdateExchangeTimestamp = time_point<high_resolution_clock>(microseconds(orderBook.getMarketUpdateExchangeTimestamp()));
-      system_clock::time_point orderBookFinalChangeTimestamp = orderBook.getFinalUpdateTimestamp();
-      system_clock::time_point updateSocketRxTimeStamp = orderBook.getUpdateSocketRxTimestamp();
-      
-      std::string marketUpdateExchangeTimepoint = std::to_string(duration_cast<microseconds>(marketUpdateExchangeTimestamp.time_since_epoch()).count());  
-      if (marketUpdateExchangeTimepoint == "0") 
-        continue;
-      
-      bool cancelOrders = false;
-      double arbitrageProfit = 1;
-      double convertedSize;
-      StrategyComponentToOrderManagerQueueEntry orderManagerQueueEntries[NUMBER_OF_ORDERS_FOR_TRIANGULAR_ARBITRAGE];
-      for (size_t i = 0; i < triangularArbitrageCurrencySequence.size() - 1; ++i) {
-          int sourceCurrencyIndex = triangularArbitrageCurrencySequence[i];
-          int targetCurrencyIndex = triangularArbitrageCurrencySequence[i + 1];
-          std::string sourceCurrencySymbol = currencies[sourceCurrencyIndex];
-          std::string targetCurrencySymbol = currencies[targetCurrencyIndex];
-
-          std::string orderSide;
-          std::string orderBookSymbol;
-          double orderSize;
-          double orderSizeRatio;
-          auto it = currencyPairsDict.find(sourceCurrencySymbol);
-          if (it != currencyPairsDict.end() && std::find(it->second.begin(), it->second.end(), targetCurrencySymbol) != it->second.end()) {
-            orderSide = SELL_ORDER;
-#if defined(USE_KRAKEN_EXCHANGE) || defined(USE_KRAKEN_MOCK_EXCHANGE)           
-            orderBookSymbol = sourceCurrencySymbol + "/" + targetCurrencySymbol;
-#elif defined(USE_BITMEX_EXCHANGE) || defined(USE_BITMEX_MOCK_EXCHANGE) || defined(USE_BITMEX_TESTNET_EXCHANGE)
-            orderBookSymbol = sourceCurrencySymbol + targetCurrencySymbol;
-#endif  
-            if (i == 0) 
-                orderSize = minOrderSizes.find(orderBookSymbol)->second.minOrderSizeInBaseCurrency;
-            else 
-                orderSize = convertedSize;
-            convertedSize = orderSize /*in base*/ * exchangeRatesMatrix[sourceCurrencyIndex][targetCurrencyIndex].bestPrice; /*in quote*/ 
-          } else {
-            orderSide = BUY_ORDER;
-#if defined(USE_KRAKEN_EXCHANGE) || defined(USE_KRAKEN_MOCK_EXCHANGE)           
-            orderBookSymbol = targetCurrencySymbol + "/" + sourceCurrencySymbol;
-#elif defined(USE_BITMEX_EXCHANGE) || defined(USE_BITMEX_MOCK_EXCHANGE) || defined(USE_BITMEX_TESTNET_EXCHANGE)
-            orderBookSymbol = targetCurrencySymbol + sourceCurrencySymbol;
-#endif  
-            if (i == 0) 
-                orderSize = minOrderSizes.find(orderBookSymbol)->second.minOrderSizeInBaseCurrency;
-            else 
-                orderSize = convertedSize /*in quote*/ * exchangeRatesMatrix[sourceCurrencyIndex][targetCurrencyIndex].bestPrice /*in base*/; /*reciprocal*/
-            convertedSize = orderSize; // in base
-          }
-          
-          orderSizeRatio = orderSize / exchangeRatesMatrix[sourceCurrencyIndex][targetCurrencyIndex].bestPriceSize;  
-          if (orderSizeRatio > ORDER_SIZE_RATIO_THRESHOLD) {
-            cancelOrders = true;
-          }
-
-#if defined(USE_BITMEX_EXCHANGE) || defined(USE_BITMEX_MOCK_EXCHANGE) || defined(USE_BITMEX_TESTNET_EXCHANGE)
-          orderManagerQueueEntries[i].order = std::string("symbol=") + orderBookSymbol + "&side=" + orderSide + "&orderQty=" + std::to_string(orderSize) + "&ordType=" + ORDER_TYPE;
-#elif defined(USE_KRAKEN_EXCHANGE) || defined(USE_KRAKEN_MOCK_EXCHANGE)          
-          orderManagerQueueEntries[i].order = std::string("pair=") + orderBookSymbol + "&type=" + orderSide + "&volume=" + std::to_string(orderSize) + "&ordertype=" + ORDER_TYPE;
-#endif          
-          orderManagerQueueEntries[i].marketUpdateExchangeTimestamp = marketUpdateExchangeTimestamp;
-          orderManagerQueueEntries[i].orderBookFinalChangeTimestamp = orderBookFinalChangeTimestamp;
-          orderManagerQueueEntries[i].updateSocketRxTimeStamp = updateSocketRxTimeStamp;
-
-          arbitrageProfit *= exchangeRatesMatrix[sourceCurrencyIndex][targetCurrencyIndex].bestPrice;
-
-          std::cout << "NEW ORDER CREATED: " << orderManagerQueueEntries[i].order << std::endl; 
-      }
-
-      std::chrono::system_clock::time_point ordersCreationTimestamp = high_resolution_clock::now();
-
-      if (cancelOrders || arbitrageProfit < 1.000) 
-        continue;
-
-      for (int i = 0; i < NUMBER_OF_ORDERS_FOR_TRIANGULAR_ARBITRAGE; ++i) {
-        orderManagerQueueEntries[i].strategyOrderPushTimestamp = high_resolution_clock::now();
-        while (!strategyToOrderManagerQueue.push(orderManagerQueueEntries[i]));
-      }    
-      
-      cout << "Expected percentage profit for the detected triangular arbitrage: " << (arbitrageProfit - 1) * 100 << "%" << endl;
- 
- #ifdef VERBOSE_STRATEGY
-      std::cout << "TRIANGULAR ARBITRAGE OPPORTUNITY FOUND" << std::endl;  
-      cout << "Currency conversions for triangular arbitrage opportunity: ";
-      for (int currency : triangularArbitrageCurrencySequence) {
-          cout << currency << " ";
+      if (!arbitrageCandidates.empty())
+        sendBestArbitrages(inFlightCycleRegistry);
+      for (const TouchedCurrencyPair& touchedCurrencyPair : touchedCurrencyPairs) {
+        touchedCurrencyPairSlots[touchedCurrencyPair.currencyPairIdx] = -1;
+        isCurrencyPairSearched[touchedCurrencyPair.currencyPairIdx] = false;
       }
-      cout << endl;
-#endif
+      touchedCurrencyPairs.clear();
     }
 }
@@ -2,6 +2,7 @@
 #ifndef STRATEGY_HPP
 #define STRATEGY_HPP
 
+#include <array>
 #include <chrono> 
 #include <iostream>
 #include <vector>
@@ -18,11 +19,57 @@
 #include "../OrderBook/OrderBook.hpp"
 #include "../SPSCQueue/SPSCQueue.hpp"
 #include "../Utils/Utils.hpp"
+#include "CurrencyGraph.hpp"
+#include "InFlightCycleRegistry.hpp"
+#include "LongCycleSearch.hpp"
+#include "../OrderManager/OrderTemplates.hpp"
+#include "../OrderManager/OrderPrestaging.hpp"
 #include "Strategy.hpp"
 
 using namespace std::chrono;
 using namespace std;
 
-void strategy(SPSCQueue<OrderBook>& builderToStrategyQueue, SPSCQueue<StrategyComponentToOrderManagerQueueEntry>& strategyToOrderManagerQueue);
+#define OPPORTUNITY_SKIP_STATS_INTERVAL 1000
+#define DEFAULT_MAX_UPDATE_BATCH_SIZE 32
+#define DEFAULT_MAX_ARBITRAGES_PER_BATCH 1
+#define MAX_PRESTAGE_MARGIN_IN_BASIS_POINTS 1000
+#define UPDATE_BATCH_STATS_INTERVAL 1000
+// Power-of-two buckets, the last one also counts everything above it
+#define UPDATE_BATCH_HISTOGRAM_BUCKETS 8
+#define QUEUE_WAIT_HISTOGRAM_BUCKETS 12
+
+// Limits on the age of the market data behind an opportunity, 0 disables a limit
+struct StrategyConfig {
+    int maxLegAgeInMicroseconds;            // Since the book of each leg was last received
+    int tickToDecisionBudgetInMicroseconds; // From the reception of the update that revealed the cycle to its orders being sent
+    int maxUpdateBatchSize;                 // Books applied before the cycles through them are searched, 1 searches after each
+    int maxArbitragesPerBatch;              // Cycles sent from one batch of books, also the batches the Order Manager has in flight
+    int prestageMarginInBasisPoints;        // Triangles short of profitable by less than this have their orders prestaged, 0 disables prestaging
+};
+
+// The queues between the Strategy and the pipeline of one traded exchange
+template <typename ExchangePolicy>
+struct TradedExchangeQueues {
+    SPSCQueue<OrderBook<ExchangePolicy>> bookBuilderToStrategyQueue;
+    SPSCQueue<StrategyComponentToOrderManagerQueueEntry> strategyToOrderManagerQueue;
+    SPSCQueue<int> strategyToOrderManagerPrestagingQueue;
+
+    TradedExchangeQueues(size_t queueSize) : bookBuilderToStrategyQueue(queueSize), strategyToOrderManagerQueue(queueSize), strategyToOrderManagerPrestagingQueue(queueSize) {}
+};
+
+template <typename ExchangePolicies>
+struct TradedExchangeQueuesOf;
+
+template <typename... ExchangePolicies>
+struct TradedExchangeQueuesOf<std::tuple<ExchangePolicies...>> {
+    using type = std::tuple<TradedExchangeQueues<ExchangePolicies>*...>;
+};
+
+// The queues of every traded exchange, in the order of TradedExchanges. The Strategy takes the books of all of them
+// into one graph and sends the legs of a cycle to the Order Managers of the exchanges they are traded on.
+using AllTradedExchangeQueues = TradedExchangeQueuesOf<TradedExchanges>::type;
+
+void strategy(AllTradedExchangeQueues& tradedExchangeQueues, InFlightCycleRegistry& inFlightCycleRegistry, const StrategyConfig& config,
+              const LongCycleSearchConfig& longCycleSearchConfig);
 
 #endif // STRATEGY_HPP
@@ -1,6 +1,7 @@
 // Utils.cpp
 
 #include "Utils.hpp"
+#include <arpa/inet.h>
 
 std::chrono::system_clock::time_point convertTimestampToTimePoint(const std::string& timestamp) {
     std::istringstream ss(timestamp);
@@ -42,6 +43,14 @@ long long timePointToMicroseconds(const std::chrono::system_clock::time_point& t
     return std::chrono::duration_cast<std::chrono::microseconds>(tp.time_since_epoch()).count();
 }
 
+int64_t timePointToNanoseconds(const std::chrono::system_clock::time_point& tp) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count();
+}
+
+std::chrono::system_clock::time_point nanosecondsToTimePoint(int64_t nanosecondsSinceEpoch) {
+    return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(nanosecondsSinceEpoch)));
+}
+
 double getTimeDifference(const std::chrono::system_clock::time_point& time1, const std::chrono::system_clock::time_point& time2) {
     long long time1_us = timePointToMicroseconds(time1);
     long long time2_us = timePointToMicroseconds(time2);
@@ -52,7 +61,7 @@ double getTimeDifference(const std::chrono::system_clock::time_point& time1, con
     auto timePoint2 = std::chrono::time_point<std::chrono::system_clock>(std::chrono::milliseconds(time2_us));
     // Convert the duration to milliseconds
     return std::chrono::duration_cast<std::chrono::milliseconds>(timePoint2 - timePoint1).count();
-#elif defined(USE_KRAKEN_MOCK_EXCHANGE) || defined (USE_BITMEX_MOCK_EXCHANGE)
+#else
     auto timePoint1 = std::chrono::time_point<std::chrono::system_clock>(std::chrono::microseconds(time1_us));
     auto timePoint2 = std::chrono::time_point<std::chrono::system_clock>(std::chrono::microseconds(time2_us));
     // Convert the duration to milliseconds
@@ -72,6 +81,26 @@ std::string getCurrentTimestamp() {
     return ss.str();
 }
 
+// Parses "host:port[/path]", SNI is only sent for host names as IP literals are not allowed in it
+bool parseExchangeEndpoint(const std::string& endpoint, ExchangeEndpoint& exchangeEndpoint) {
+    size_t colonPos = endpoint.find(':');
+    if (colonPos == std::string::npos || colonPos == 0)
+        return false;
+
+    size_t slashPos = endpoint.find('/', colonPos);
+    std::string port = endpoint.substr(colonPos + 1, slashPos == std::string::npos ? std::string::npos : slashPos - colonPos - 1);
+    if (port.empty() || port.size() > 5 || port.find_first_not_of("0123456789") != std::string::npos || std::stoi(port) > 65535)
+        return false;
+
+    exchangeEndpoint.address = endpoint.substr(0, colonPos);
+    exchangeEndpoint.port = std::stoi(port);
+    exchangeEndpoint.path = slashPos == std::string::npos ? "/" : endpoint.substr(slashPos);
+
+    struct in_addr addr;
+    exchangeEndpoint.serverName = inet_pton(AF_INET, exchangeEndpoint.address.c_str(), &addr) == 1 ? "" : exchangeEndpoint.address;
+    return true;
+}
+
 // Function to set CPU affinity of a thread
 void setThreadAffinity(pthread_t thread, int cpuCore) {
   if (cpuCore < 0) {
@@ -88,3 +117,33 @@ void setThreadAffinity(pthread_t thread, int cpuCore) {
   };
 }
 
+// Parses a comma-separated list of core indices, -1 leaving a thread unpinned (or, for the SQPOLL cores, sharing the
+// SQPOLL thread of the first gateway shard)
+bool parseCoreList(const char* list, std::vector<int>& cores) {
+    std::stringstream ss(list);
+    std::string core;
+    cores.clear();
+    while (std::getline(ss, core, ',')) {
+        char* end;
+        long value = strtol(core.c_str(), &end, 10);
+        if (core.empty() || *end != '\0' || value < -1)
+            return false;
+        cores.push_back(value);
+    }
+    return !cores.empty();
+}
+
+// Recorded market data holds one websocket message per line, preceded by the local time it was received at, in us
+// since the epoch, and a space, as the exchanges do not timestamp every message (Kraken tickers and book snapshots
+// have none). Lines without it are taken as the bare message, with a receive time of -1.
+const char* skipRecordedReceiveTimestamp(const char* line, long long& receiveTimestamp) {
+    char* end;
+    receiveTimestamp = -1;
+    if (*line < '0' || *line > '9')
+        return line;
+    long long timestamp = strtoll(line, &end, 10);
+    if (*end != ' ')
+        return line;
+    receiveTimestamp = timestamp;
+    return end + 1;
+}
@@ -16,6 +16,8 @@
 #include <openssl/buffer.h>
 #include <vector>
 #include <stdexcept>
+#include <cstdint>
+#include <type_traits>
 
 #define WEBSOCKET_CLIENT_RX_BUFFER_SIZE 16378
 
@@ -25,25 +27,98 @@ struct BookBuilderGatewayToComponentQueueEntry {
     char decryptedReadBuffer[WEBSOCKET_CLIENT_RX_BUFFER_SIZE];	
     int decryptedReadBufferSize = sizeof(decryptedReadBuffer);
     int decryptedBytesRead;
+    int connectionIdx;
+    // Set by the gateway when the connection died so the component drops the book until the resubscription snapshot lands
+    bool connectionReset = false;
     system_clock::time_point marketUpdatePollTimestamp;
     system_clock::time_point marketUpdateReadCompletionTimestamp;
     system_clock::time_point marketUpdateSocketRxTimestamp;
     system_clock::time_point marketUpdateDecryptionCompletionTimestamp;
 };
 
+// Cores of a Book Builder Gateway shard, a negative SQPOLL core attaches the shard to the SQPOLL thread of the first one
+struct BookBuilderGatewayShardPlacement {
+    int gatewayCpuCore;
+    int sqPollCpuCore;
+};
+
+// Connections are dealt round-robin across the Book Builder Gateway shards
+inline int getGatewayShardIdx(int connectionIdx, int numberOfShards) {
+    return connectionIdx % numberOfShards;
+}
+
+// What a market data connection subscribes to: the full depth book or only the best bid and ask of the pair
+enum class FeedMode {
+    Depth,
+    TopOfBook
+};
+
+// Orders of the longest cycle the Strategy can send in one batch
+#define MAX_ARBITRAGE_BATCH_SIZE 5
+// Batches the Order Manager can have in flight at once, each on connections of its own
+#define MAX_CONCURRENT_ARBITRAGE_BATCHES 4
+#define MAX_ORDER_MANAGER_CONNECTIONS (MAX_ARBITRAGE_BATCH_SIZE * MAX_CONCURRENT_ARBITRAGE_BATCHES)
+
+// Defined with the portfolios
+enum class OrderSide;
+
+enum class OrderType : uint8_t {
+    Market
+};
+
+// One leg of an arbitrage, the Order Manager turns it into the request body of the pair and side
+struct ArbitrageOrder {
+    int64_t volumeInLots;   // Fixed point volume with lotDecimals decimals
+    int currencyPairIdx;    // Index of the pair in the traded portfolio
+    OrderSide side;
+    OrderType orderType;
+    uint8_t lotDecimals;
+    uint8_t legIdx;
+};
+
+// All the legs of one cycle, trivially copyable so that pushing it does not allocate and the Order Manager pops a
+// single entry per opportunity. The timestamps are in nanoseconds since the epoch.
 struct StrategyComponentToOrderManagerQueueEntry {
-    std::string order;
-    system_clock::time_point strategyOrderPushTimestamp;
-    system_clock::time_point marketUpdateExchangeTimestamp;
-    system_clock::time_point orderBookFinalChangeTimestamp;
-    system_clock::time_point updateSocketRxTimeStamp;
+    uint64_t cycleId;
+    int inFlightSlotIdx;    // Slot of the cycle in the in-flight registry, -1 when it is not tracked
+    int numberOfOrders;
+    ArbitrageOrder orders[MAX_ARBITRAGE_BATCH_SIZE];
+    int64_t strategyOrderPushTimestamp;
+    int64_t marketUpdateExchangeTimestamp;
+    int64_t orderBookFinalChangeTimestamp;
+    int64_t updateSocketRxTimeStamp;
+};
+static_assert(std::is_trivially_copyable<StrategyComponentToOrderManagerQueueEntry>::value, "the Strategy pushes its orders to the Order Manager by copy");
+
+// Where a component connects to, selectable at runtime so that the system can run against a local mock exchange
+struct ExchangeEndpoint {
+    std::string address;    // Host name or IPv4 address to connect to
+    int port;
+    std::string path;       // Websocket path, unused by the REST API
+    std::string serverName; // TLS SNI, none is sent when empty
 };
 
+template <typename ExchangePolicy>
+inline ExchangeEndpoint getDefaultMarketDataEndpoint() {
+    return {ExchangePolicy::marketDataAddress, ExchangePolicy::marketDataPort, ExchangePolicy::marketDataPath, ExchangePolicy::marketDataServerName};
+}
+
+template <typename ExchangePolicy>
+inline ExchangeEndpoint getDefaultOrderEntryEndpoint() {
+    return {ExchangePolicy::orderEntryAddress, ExchangePolicy::orderEntryPort, "", ExchangePolicy::orderEntryServerName};
+}
+
+bool parseExchangeEndpoint(const std::string& endpoint, ExchangeEndpoint& exchangeEndpoint);
+
 std::chrono::system_clock::time_point convertTimestampToTimePoint(const std::string& timestamp);
 double getTimeDifference(const std::chrono::system_clock::time_point& time1, const std::chrono::system_clock::time_point& time2);
 std::string getCurrentTimestamp();
 void removeIncorrectNullCharacters(char* buffer, size_t size);
 long long timePointToMicroseconds(const std::chrono::system_clock::time_point& tp);
+int64_t timePointToNanoseconds(const std::chrono::system_clock::time_point& tp);
+std::chrono::system_clock::time_point nanosecondsToTimePoint(int64_t nanosecondsSinceEpoch);
 void setThreadAffinity(pthread_t thread, int cpuCore);
+bool parseCoreList(const char* list, std::vector<int>& cores);
+const char* skipRecordedReceiveTimestamp(const char* line, long long& receiveTimestamp);
 
 #endif // UTILS_H
\ No newline at end of file
@@ -4,6 +4,7 @@ USE_PORTFOLIO=""
 USE_EXCHANGE=""
 VERBOSE_BOOK_BUILDER="OFF"
 VERBOSE_STRATEGY="OFF"
+USE_PERMESSAGE_DEFLATE="OFF"
 
 # Parse command-line arguments
 while [[ $# -gt 0 ]]
@@ -29,6 +30,10 @@ do
         VERBOSE_STRATEGY="ON"
         shift # past argument
         ;;
+        --permessage-deflate)
+        USE_PERMESSAGE_DEFLATE="ON"
+        shift # past argument
+        ;;
         *)    # unknown option
         echo "Unknown option: $key"
         exit 1
@@ -37,13 +42,14 @@ do
 done
 
 # Check if portfolio and exchange options are set
-if [[ -z "$USE_PORTFOLIO" ]]; then
-    echo "Error: An option must be specified for portfolio using -p or --portfolio."
+if [[ -z "$USE_EXCHANGE" ]]; then
+    echo "Error: An option must be specified for exchange using -e or --exchange."
     exit 1
 fi
 
-if [[ -z "$USE_EXCHANGE" ]]; then
-    echo "Error: An option must be specified for exchange using -e or --exchange."
+# The multi-venue builds trade a portfolio of their own
+if [[ -z "$USE_PORTFOLIO" && "$USE_EXCHANGE" != "USE_KRAKEN_AND_BITMEX_EXCHANGES" && "$USE_EXCHANGE" != "USE_KRAKEN_AND_BITMEX_MOCK_EXCHANGES" ]]; then
+    echo "Error: An option must be specified for portfolio using -p or --portfolio."
     exit 1
 fi
 
@@ -57,7 +63,7 @@ mkdir build
 cd build || exit
 
 # Run cmake
-cmake -D"$USE_PORTFOLIO"=ON -D"$USE_EXCHANGE"=ON -DVERBOSE_BOOK_BUILDER="$VERBOSE_BOOK_BUILDER" -DVERBOSE_STRATEGY="$VERBOSE_STRATEGY" ..
+cmake ${USE_PORTFOLIO:+-D"$USE_PORTFOLIO"=ON} -D"$USE_EXCHANGE"=ON -DVERBOSE_BOOK_BUILDER="$VERBOSE_BOOK_BUILDER" -DVERBOSE_STRATEGY="$VERBOSE_STRATEGY" -DUSE_PERMESSAGE_DEFLATE="$USE_PERMESSAGE_DEFLATE" ..
 
 # Run make
 make
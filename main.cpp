@@ -1,4 +1,6 @@
 #include <atomic>
+#include <memory>
+#include <strings.h>
 #include <iostream>
 #include <thread>
 #include <vector>
@@ -8,92 +10,303 @@
 #include "BookBuilder/BookBuilderComponent.cpp"
 #include "BookBuilder/BookBuilderGateway.cpp"
 #include "Utils/Utils.hpp"
+#include "StrategyComponent/Portfolios.hpp"
 #include "StrategyComponent/Strategy.hpp"
 #include "OrderManager/OrderManager.hpp"
 
-#if defined(USE_BITMEX_EXCHANGE) || defined(USE_BITMEX_MOCK_EXCHANGE) || defined(USE_BITMEX_TESTNET_EXCHANGE)
-static const std::vector<std::string> currencyPairs = {"XBTUSDT", "XBTETH", "ETHUSDT"};
-#elif defined(USE_KRAKEN_EXCHANGE) || defined(USE_KRAKEN_MOCK_EXCHANGE)
-  #if defined(USE_PORTFOLIO_122)
-    static const std::vector<std::string> currencyPairs = {
-      "KSM/EUR", "KSM/BTC", "KSM/DOT", "KSM/GBP", "KSM/ETH", "KSM/USD", "GBP/USD", "BTC/CAD", "BTC/EUR",
-      "BTC/AUD", "BTC/JPY", "BTC/GBP", "BTC/CHF", "BTC/USDT", "BTC/USD", "BTC/USDC", "LTC/EUR", "LTC/BTC",
-      "LTC/AUD", "LTC/JPY", "LTC/GBP", "LTC/ETH", "LTC/USDT", "LTC/USD", "SOL/EUR", "SOL/BTC", "SOL/GBP",
-      "SOL/ETH", "SOL/USDT", "SOL/USD", "DOT/EUR", "DOT/BTC", "DOT/JPY", "DOT/GBP", "DOT/ETH", "DOT/USDT",
-      "DOT/USD", "ETH/CAD", "ETH/EUR", "ETH/BTC", "ETH/AUD", "ETH/JPY", "ETH/GBP", "ETH/CHF", "ETH/USDT",
-      "ETH/USD", "ETH/USDC", "LINK/EUR", "LINK/BTC", "LINK/AUD", "LINK/JPY", "LINK/GBP", "LINK/ETH",
-      "LINK/USDT", "LINK/USD", "USDC/CAD", "USDC/EUR", "USDC/AUD", "USDC/GBP", "USDC/CHF", "USDC/USDT",
-      "USDC/USD", "ADA/EUR", "ADA/BTC", "ADA/AUD", "ADA/GBP", "ADA/ETH", "ADA/USDT", "ADA/USD", "ATOM/EUR",
-      "ATOM/BTC", "ATOM/GBP", "ATOM/ETH", "ATOM/USDT", "ATOM/USD", "USDT/EUR", "USDT/AUD", "USDT/JPY",
-      "USDT/GBP", "USDT/CHF", "USDT/USD", "USDT/CAD", "AUD/JPY", "AUD/USD", "XRP/CAD", "XRP/EUR", "XRP/BTC",
-      "XRP/AUD", "XRP/GBP", "XRP/ETH", "XRP/USDT", "XRP/USD", "EUR/CAD", "EUR/AUD", "EUR/JPY", "EUR/GBP",
-      "EUR/CHF", "EUR/USD", "BCH/EUR", "BCH/BTC", "BCH/AUD", "BCH/JPY", "BCH/GBP", "BCH/ETH", "BCH/USDT",
-      "BCH/USD", "USD/CHF", "USD/JPY", "USD/CAD", "ALGO/EUR", "ALGO/BTC", "ALGO/GBP", "ALGO/ETH", "ALGO/USDT",
-      "ALGO/USD"
-    };
-  #elif defined(USE_PORTFOLIO_92)
-    static const std::vector<std::string> currencyPairs = {
-      "BCH/USD", "BCH/BTC", "BCH/EUR", "BCH/AUD", "BCH/GBP", "BCH/ETH", "BCH/USDT", "BCH/JPY", "BTC/USD",
-      "BTC/EUR", "BTC/USDC", "BTC/AUD", "BTC/GBP", "BTC/CAD", "BTC/USDT", "BTC/JPY", "USD/CAD", "USD/JPY",
-      "XRP/USD", "XRP/BTC", "XRP/EUR", "XRP/AUD", "XRP/GBP", "XRP/ETH", "XRP/CAD", "XRP/USDT", "EUR/USD",
-      "EUR/AUD", "EUR/GBP", "EUR/CAD", "EUR/JPY", "LTC/USD", "LTC/EUR", "LTC/BTC", "LTC/AUD", "LTC/GBP",
-      "LTC/ETH", "LTC/USDT", "LTC/JPY", "ETH/USD", "ETH/EUR", "ETH/BTC", "ETH/USDC", "ETH/AUD", "ETH/GBP",
-      "ETH/CAD", "ETH/USDT", "ETH/JPY", "LINK/USD", "LINK/BTC", "LINK/EUR", "LINK/AUD", "LINK/GBP", "LINK/ETH",
-      "LINK/USDT", "LINK/JPY", "ADA/USD", "ADA/BTC", "ADA/EUR", "ADA/AUD", "ADA/GBP", "ADA/ETH", "ADA/USDT",
-      "USDC/USD", "USDC/EUR", "USDC/AUD", "USDC/GBP", "USDC/CAD", "USDC/USDT", "GBP/USD", "DOT/USD", "DOT/BTC",
-      "DOT/EUR", "DOT/GBP", "DOT/ETH", "DOT/USDT", "DOT/JPY", "USDT/USD", "USDT/EUR", "USDT/AUD", "USDT/GBP",
-      "USDT/CAD", "USDT/JPY", "AUD/USD", "AUD/JPY"
-    };
-  #elif defined(USE_PORTFOLIO_50)
-    static const std::vector<std::string> currencyPairs = {
-      "BCH/JPY", "BCH/ETH", "BCH/GBP", "BCH/AUD", "BCH/BTC", "BCH/USDT", "BCH/EUR", "BCH/USD", "USDT/JPY",
-      "USDT/GBP", "USDT/AUD", "USDT/EUR", "USDT/USD", "BTC/JPY", "BTC/GBP", "BTC/AUD", "BTC/USDT", "BTC/EUR",
-      "BTC/USD", "EUR/GBP", "EUR/JPY", "EUR/AUD", "EUR/USD", "ETH/JPY", "ETH/EUR", "ETH/AUD", "ETH/BTC",
-      "ETH/USDT", "ETH/GBP", "ETH/USD", "USD/JPY", "LINK/JPY", "LINK/ETH", "LINK/EUR", "LINK/AUD", "LINK/BTC",
-      "LINK/USDT", "LINK/GBP", "LINK/USD", "LTC/JPY", "LTC/ETH", "LTC/GBP", "LTC/AUD", "LTC/BTC", "LTC/USDT",
-      "LTC/EUR", "LTC/USD", "GBP/USD", "AUD/JPY", "AUD/USD"
-    };
-  #elif defined(USE_PORTFOLIO_3)
-    static const std::vector<std::string> currencyPairs = {"USDT/USD", "SOL/USDT", "SOL/USD"};
-  #endif
-#endif
+// One market data connection per pair, in the order of the portfolio, the pairs of each traded exchange following each other
+static const std::vector<std::string> currencyPairs = getCurrencyPairSymbols(tradedPortfolio);
+// Written by the Strategy when it sends a cycle and by the Order Manager when the exchange has answered its orders
+static InFlightCycleRegistry inFlightCycleRegistry;
 
-int main(int argc, char *argv[]) {
-    const size_t queueSize = 10000;
+static void printUsage(const char* programName) {
+    std::cerr << "Usage: " << programName << " [--exchange name] [--market-data-endpoint host:port[/path]] [--order-entry-endpoint host:port]" << std::endl
+              << "       [--gateway-shards n] [--gateway-cores c0,c1,...] [--sqpoll-cores c0,c1,...]" << std::endl
+              << "       [--gateway-network-backend b] [--order-manager-network-backend b]" << std::endl
+              << "       [--top-of-book all|pair0,pair1,...] [--trades all|pair0,pair1,...]" << std::endl
+              << "       [--long-cycle-cores c0,c1,...] [--max-cycle-length 4|5] [--long-cycle-budget-us n]" << std::endl
+              << "       [--max-leg-age-us n] [--tick-to-decision-budget-us n] [--max-update-batch n]" << std::endl
+              << "       [--max-arbitrages-per-batch 1-" << MAX_CONCURRENT_ARBITRAGE_BATCHES << "] [--prestage-margin-bps 1-" << MAX_PRESTAGE_MARGIN_IN_BASIS_POINTS << "]" << std::endl
+              << "       [--kraken-nonce-window n]" << std::endl
+              << "       with b one of io_uring_sqpoll, io_uring, epoll, busy_poll" << std::endl
+              << "       the options of the first two lines apply to the traded exchange named by the last --exchange, the first one by default" << std::endl;
+}
 
-    SPSCQueue<BookBuilderGatewayToComponentQueueEntry> bookBuilderGatewayToComponentQueue(queueSize);
-    SPSCQueue<OrderBook> builderToStrategyQueue(queueSize);
-    SPSCQueue<StrategyComponentToOrderManagerQueueEntry> strategyToOrderManagerQueue(queueSize);
+// Where and how the pipeline of one traded exchange runs
+struct TradedExchangeConfig {
+    ExchangeEndpoint marketDataEndpoint;
+    ExchangeEndpoint orderEntryEndpoint;
+    int numberOfGatewayShards;
+    std::vector<int> gatewayCores, sqPollCores;
+    NetworkBackendType gatewayNetworkBackendType;
+    NetworkBackendType orderManagerNetworkBackendType;
+};
 
-    int pipefd[2];
-    if (pipe(pipefd) == -1) {
-        perror("pipe");
-        return 1;
+// Number of pairs of the portfolio traded on an exchange, each of them having a market data connection of its own
+static size_t getNumberOfCurrencyPairsOfExchange(int exchangeIdx) {
+    return tradedPortfolio.pairOffsetOfExchange[exchangeIdx + 1] - tradedPortfolio.pairOffsetOfExchange[exchangeIdx];
+}
+
+// The pipeline of one traded exchange: its gateway shards, its Book Builder Component and its Order Manager
+template <typename ExchangePolicy>
+static void startTradedExchangePipeline(const TradedExchangeConfig& config, TradedExchangeQueues<ExchangePolicy>& tradedExchangeQueues, const std::vector<FeedMode>& feedModes,
+                                        const std::vector<bool>& tradeFeeds, int bookBuilderPipeEnd, int orderManagerPipeEnd, int maxNumberOfOrdersInBatch, int numberOfConcurrentBatches, size_t queueSize,
+                                        std::vector<std::unique_ptr<SPSCQueue<BookBuilderGatewayToComponentQueueEntry>>>& bookBuilderGatewayToComponentQueues,
+                                        std::vector<std::unique_ptr<SPSCQueue<int>>>& bookBuilderComponentToGatewayResyncQueues, std::vector<std::thread>& threads) {
+    constexpr int exchangeIdx = getTradedExchangeIdx<ExchangePolicy>();
+    // The connections of the exchange are indexed from 0 in its pipeline
+    size_t firstCurrencyPairIdx = tradedPortfolio.pairOffsetOfExchange[exchangeIdx];
+    size_t lastCurrencyPairIdx = firstCurrencyPairIdx + getNumberOfCurrencyPairsOfExchange(exchangeIdx);
+    std::vector<std::string> exchangeCurrencyPairs(currencyPairs.begin() + firstCurrencyPairIdx, currencyPairs.begin() + lastCurrencyPairIdx);
+    std::vector<FeedMode> exchangeFeedModes(feedModes.begin() + firstCurrencyPairIdx, feedModes.begin() + lastCurrencyPairIdx);
+    std::vector<bool> exchangeTradeFeeds(tradeFeeds.begin() + firstCurrencyPairIdx, tradeFeeds.begin() + lastCurrencyPairIdx);
+
+    std::vector<BookBuilderGatewayShardPlacement> gatewayShardPlacements = getDefaultGatewayShardPlacements(config.numberOfGatewayShards, exchangeIdx);
+    for (int shardIdx = 0; shardIdx < config.numberOfGatewayShards; shardIdx++) {
+        if (shardIdx < (int)config.gatewayCores.size())
+            gatewayShardPlacements[shardIdx].gatewayCpuCore = config.gatewayCores[shardIdx];
+        if (shardIdx < (int)config.sqPollCores.size())
+            gatewayShardPlacements[shardIdx].sqPollCpuCore = config.sqPollCores[shardIdx];
     }
 
-    int bookBuilderPipeEnd = pipefd[0];
-    int orderManagerPipeEnd = pipefd[1];
+    // One pair of queues per gateway shard
+    std::vector<SPSCQueue<BookBuilderGatewayToComponentQueueEntry>*> bookBuilderGatewayToComponentQueuePtrs;
+    std::vector<SPSCQueue<int>*> bookBuilderComponentToGatewayResyncQueuePtrs;
+    for (int shardIdx = 0; shardIdx < config.numberOfGatewayShards; shardIdx++) {
+        bookBuilderGatewayToComponentQueues.emplace_back(new SPSCQueue<BookBuilderGatewayToComponentQueueEntry>(queueSize));
+        bookBuilderComponentToGatewayResyncQueues.emplace_back(new SPSCQueue<int>(queueSize));
+        bookBuilderGatewayToComponentQueuePtrs.push_back(bookBuilderGatewayToComponentQueues.back().get());
+        bookBuilderComponentToGatewayResyncQueuePtrs.push_back(bookBuilderComponentToGatewayResyncQueues.back().get());
+    }
+
+    for (int shardIdx = 0; shardIdx < config.numberOfGatewayShards; shardIdx++) {
+        SPSCQueue<BookBuilderGatewayToComponentQueueEntry>& bookBuilderGatewayToComponentQueue = *bookBuilderGatewayToComponentQueuePtrs[shardIdx];
+        SPSCQueue<int>& bookBuilderComponentToGatewayResyncQueue = *bookBuilderComponentToGatewayResyncQueuePtrs[shardIdx];
+        BookBuilderGatewayShardPlacement placement = gatewayShardPlacements[shardIdx];
+        threads.emplace_back([shardIdx, config, placement, &bookBuilderGatewayToComponentQueue, &bookBuilderComponentToGatewayResyncQueue, orderManagerPipeEnd, exchangeCurrencyPairs, exchangeFeedModes, exchangeTradeFeeds] {
+            bookBuilderGateway<ExchangePolicy>(shardIdx, config.numberOfGatewayShards, placement, config.gatewayNetworkBackendType, bookBuilderGatewayToComponentQueue, bookBuilderComponentToGatewayResyncQueue,
+                                               exchangeCurrencyPairs, exchangeFeedModes, exchangeTradeFeeds, config.marketDataEndpoint, orderManagerPipeEnd);
+        });
+    }
 
-    auto strategyThread = std::thread([&builderToStrategyQueue, &strategyToOrderManagerQueue] {
-        strategy(builderToStrategyQueue, strategyToOrderManagerQueue);
+    threads.emplace_back([bookBuilderGatewayToComponentQueuePtrs, &tradedExchangeQueues, bookBuilderComponentToGatewayResyncQueuePtrs, exchangeCurrencyPairs, exchangeFeedModes, exchangeTradeFeeds] {
+        bookBuilderComponent<ExchangePolicy>(bookBuilderGatewayToComponentQueuePtrs, tradedExchangeQueues.bookBuilderToStrategyQueue, bookBuilderComponentToGatewayResyncQueuePtrs, exchangeCurrencyPairs, exchangeFeedModes, exchangeTradeFeeds);
     });
 
-    auto bookBuilderGatewayThread = std::thread([&bookBuilderGatewayToComponentQueue, orderManagerPipeEnd, currencyPairs = currencyPairs] {
-        bookBuilderGateway(bookBuilderGatewayToComponentQueue, currencyPairs, orderManagerPipeEnd);
+    threads.emplace_back([&tradedExchangeQueues, config, bookBuilderPipeEnd, maxNumberOfOrdersInBatch, numberOfConcurrentBatches] {
+        orderManager<ExchangePolicy>(tradedExchangeQueues.strategyToOrderManagerQueue, tradedExchangeQueues.strategyToOrderManagerPrestagingQueue, config.orderEntryEndpoint, config.orderManagerNetworkBackendType,
+                                     bookBuilderPipeEnd, maxNumberOfOrdersInBatch, numberOfConcurrentBatches, inFlightCycleRegistry);
+    });
+}
+
+// Parses a comma-separated list of currency pairs of the portfolio, or "all", into the indices of the pairs
+static bool parseCurrencyPairList(const char* list, std::vector<size_t>& currencyPairIndices) {
+    currencyPairIndices.clear();
+    if (strcmp(list, "all") == 0) {
+        for (size_t i = 0; i < currencyPairs.size(); i++)
+            currencyPairIndices.push_back(i);
+        return true;
+    }
+    std::stringstream ss(list);
+    std::string currencyPair;
+    while (std::getline(ss, currencyPair, ',')) {
+        auto it = std::find(currencyPairs.begin(), currencyPairs.end(), currencyPair);
+        if (it == currencyPairs.end()) {
+            std::cerr << currencyPair << " is not part of the portfolio" << std::endl;
+            return false;
+        }
+        currencyPairIndices.push_back(it - currencyPairs.begin());
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    const size_t queueSize = 10000;
+
+    TradedExchangeConfig tradedExchangeConfigs[MAX_NUMBER_OF_TRADED_EXCHANGES];
+    const char* tradedExchangeNames[MAX_NUMBER_OF_TRADED_EXCHANGES];
+    bool isKrakenTraded = false;
+    forEachTradedExchange([&](auto exchangePolicy) {
+        using ExchangePolicy = decltype(exchangePolicy);
+        int exchangeIdx = getTradedExchangeIdx<ExchangePolicy>();
+        tradedExchangeConfigs[exchangeIdx] = {getDefaultMarketDataEndpoint<ExchangePolicy>(), getDefaultOrderEntryEndpoint<ExchangePolicy>(), 1, {}, {},
+                                              getDefaultNetworkBackendType(), getDefaultNetworkBackendType()};
+        tradedExchangeNames[exchangeIdx] = ExchangePolicy::name;
+        isKrakenTraded = isKrakenTraded || ExchangePolicy::api == ExchangeApi::Kraken;
     });
+    int selectedExchangeIdx = 0;
+    std::vector<FeedMode> feedModes(currencyPairs.size(), FeedMode::Depth);
+    std::vector<bool> tradeFeeds(currencyPairs.size(), false);
+    std::vector<size_t> currencyPairIndices;
+    // No limit on the age of the market data unless given
+    StrategyConfig strategyConfig = {0, 0, DEFAULT_MAX_UPDATE_BATCH_SIZE, DEFAULT_MAX_ARBITRAGES_PER_BATCH, 0};
+    // The 4- and 5-leg cycle search only runs when it is given worker cores
+    LongCycleSearchConfig longCycleSearchConfig = {{}, MAX_LONG_CYCLE_LENGTH, DEFAULT_LONG_CYCLE_SEARCH_LATENCY_BUDGET_IN_MICROSECONDS};
+    // Kraken orders are only prestaged when the API key is declared to have a nonce window
+    long long krakenNonceWindow = 0;
+    for (int i = 1; i < argc; i++) {
+        TradedExchangeConfig& selectedExchangeConfig = tradedExchangeConfigs[selectedExchangeIdx];
+        if (strcmp(argv[i], "--exchange") == 0 && i + 1 < argc) {
+            i++;
+            selectedExchangeIdx = -1;
+            for (int exchangeIdx = 0; exchangeIdx < (int)numberOfTradedExchanges; exchangeIdx++)
+                if (strcasecmp(argv[i], tradedExchangeNames[exchangeIdx]) == 0)
+                    selectedExchangeIdx = exchangeIdx;
+            if (selectedExchangeIdx < 0) {
+                std::cerr << argv[i] << " is not a traded exchange" << std::endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--market-data-endpoint") == 0 && i + 1 < argc) {
+            if (!parseExchangeEndpoint(argv[++i], selectedExchangeConfig.marketDataEndpoint)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--order-entry-endpoint") == 0 && i + 1 < argc) {
+            if (!parseExchangeEndpoint(argv[++i], selectedExchangeConfig.orderEntryEndpoint)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--gateway-shards") == 0 && i + 1 < argc) {
+            selectedExchangeConfig.numberOfGatewayShards = atoi(argv[++i]);
+            if (selectedExchangeConfig.numberOfGatewayShards < 1 || selectedExchangeConfig.numberOfGatewayShards > (int)getNumberOfCurrencyPairsOfExchange(selectedExchangeIdx)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--gateway-cores") == 0 && i + 1 < argc) {
+            if (!parseCoreList(argv[++i], selectedExchangeConfig.gatewayCores)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--sqpoll-cores") == 0 && i + 1 < argc) {
+            if (!parseCoreList(argv[++i], selectedExchangeConfig.sqPollCores)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--top-of-book") == 0 && i + 1 < argc) {
+            if (!parseCurrencyPairList(argv[++i], currencyPairIndices)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            for (size_t currencyPairIdx : currencyPairIndices)
+                feedModes[currencyPairIdx] = FeedMode::TopOfBook;
+        } else if (strcmp(argv[i], "--trades") == 0 && i + 1 < argc) {
+            if (!parseCurrencyPairList(argv[++i], currencyPairIndices)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            for (size_t currencyPairIdx : currencyPairIndices)
+                tradeFeeds[currencyPairIdx] = true;
+        } else if (strcmp(argv[i], "--gateway-network-backend") == 0 && i + 1 < argc) {
+            if (!parseNetworkBackendType(argv[++i], selectedExchangeConfig.gatewayNetworkBackendType)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--order-manager-network-backend") == 0 && i + 1 < argc) {
+            if (!parseNetworkBackendType(argv[++i], selectedExchangeConfig.orderManagerNetworkBackendType)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--max-leg-age-us") == 0 && i + 1 < argc) {
+            strategyConfig.maxLegAgeInMicroseconds = atoi(argv[++i]);
+            if (strategyConfig.maxLegAgeInMicroseconds <= 0) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--tick-to-decision-budget-us") == 0 && i + 1 < argc) {
+            strategyConfig.tickToDecisionBudgetInMicroseconds = atoi(argv[++i]);
+            if (strategyConfig.tickToDecisionBudgetInMicroseconds <= 0) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--max-update-batch") == 0 && i + 1 < argc) {
+            strategyConfig.maxUpdateBatchSize = atoi(argv[++i]);
+            if (strategyConfig.maxUpdateBatchSize <= 0) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--max-arbitrages-per-batch") == 0 && i + 1 < argc) {
+            strategyConfig.maxArbitragesPerBatch = atoi(argv[++i]);
+            if (strategyConfig.maxArbitragesPerBatch <= 0 || strategyConfig.maxArbitragesPerBatch > MAX_CONCURRENT_ARBITRAGE_BATCHES) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--prestage-margin-bps") == 0 && i + 1 < argc) {
+            strategyConfig.prestageMarginInBasisPoints = atoi(argv[++i]);
+            if (strategyConfig.prestageMarginInBasisPoints <= 0 || strategyConfig.prestageMarginInBasisPoints > MAX_PRESTAGE_MARGIN_IN_BASIS_POINTS) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--kraken-nonce-window") == 0 && i + 1 < argc) {
+            krakenNonceWindow = atoll(argv[++i]);
+            if (krakenNonceWindow <= 0) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--long-cycle-cores") == 0 && i + 1 < argc) {
+            if (!parseCoreList(argv[++i], longCycleSearchConfig.workerCores)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--max-cycle-length") == 0 && i + 1 < argc) {
+            longCycleSearchConfig.maxCycleLength = atoi(argv[++i]);
+            if (longCycleSearchConfig.maxCycleLength < MIN_LONG_CYCLE_LENGTH || longCycleSearchConfig.maxCycleLength > MAX_LONG_CYCLE_LENGTH) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--long-cycle-budget-us") == 0 && i + 1 < argc) {
+            longCycleSearchConfig.latencyBudgetInMicroseconds = atoi(argv[++i]);
+            if (longCycleSearchConfig.latencyBudgetInMicroseconds <= 0) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    // A staged Kraken request carries the nonce it was staged with, which is older than the ones sent since
+    if (isKrakenTraded && strategyConfig.prestageMarginInBasisPoints > 0 && krakenNonceWindow < MIN_KRAKEN_NONCE_WINDOW_FOR_PRESTAGING) {
+        std::cerr << "Error: prestaging Kraken orders needs --kraken-nonce-window, the nonce window of the API key, of at least "
+                  << MIN_KRAKEN_NONCE_WINDOW_FOR_PRESTAGING << " nonces" << std::endl;
+        return 1;
+    }
+
+    // One Order Manager connection per leg of the longest cycle
+    int maxNumberOfOrdersInBatch = longCycleSearchConfig.workerCores.empty() ? NUMBER_OF_ORDERS_FOR_TRIANGULAR_ARBITRAGE : longCycleSearchConfig.maxCycleLength;
+
+    // The Strategy reads the books of every traded exchange and sends the legs of a cycle to the Order Managers of their exchanges
+    // One pipe per traded exchange, from its first gateway shard to its Order Manager
+    int pipefds[MAX_NUMBER_OF_TRADED_EXCHANGES][2];
+    for (size_t exchangeIdx = 0; exchangeIdx < numberOfTradedExchanges; exchangeIdx++) {
+        if (pipe(pipefds[exchangeIdx]) == -1) {
+            perror("pipe");
+            return 1;
+        }
+    }
 
-    auto bookBuilderComponentThread = std::thread([&bookBuilderGatewayToComponentQueue, &builderToStrategyQueue, currencyPairs = currencyPairs] {
-        bookBuilderComponent(bookBuilderGatewayToComponentQueue, builderToStrategyQueue, currencyPairs);
+    auto tradedExchangeQueueOwners = std::apply([queueSize](auto... exchangePolicies) {
+        return std::make_tuple(std::make_unique<TradedExchangeQueues<decltype(exchangePolicies)>>(queueSize)...);
+    }, TradedExchanges{});
+    AllTradedExchangeQueues tradedExchangeQueues = std::apply([](auto&... owners) { return AllTradedExchangeQueues(owners.get()...); }, tradedExchangeQueueOwners);
+    std::vector<std::unique_ptr<SPSCQueue<BookBuilderGatewayToComponentQueueEntry>>> bookBuilderGatewayToComponentQueues;
+    std::vector<std::unique_ptr<SPSCQueue<int>>> bookBuilderComponentToGatewayResyncQueues;
+    std::vector<std::thread> tradedExchangeThreads;
+    forEachTradedExchange([&](auto exchangePolicy) {
+        using ExchangePolicy = decltype(exchangePolicy);
+        constexpr int exchangeIdx = getTradedExchangeIdx<ExchangePolicy>();
+        startTradedExchangePipeline<ExchangePolicy>(tradedExchangeConfigs[exchangeIdx], *std::get<TradedExchangeQueues<ExchangePolicy>*>(tradedExchangeQueues),
+                                                    feedModes, tradeFeeds, pipefds[exchangeIdx][0], pipefds[exchangeIdx][1], maxNumberOfOrdersInBatch, strategyConfig.maxArbitragesPerBatch, queueSize,
+                                                    bookBuilderGatewayToComponentQueues, bookBuilderComponentToGatewayResyncQueues, tradedExchangeThreads);
     });
 
-    auto orderManagerThread = std::thread([&strategyToOrderManagerQueue, bookBuilderPipeEnd] {
-        orderManager(strategyToOrderManagerQueue, bookBuilderPipeEnd);
+    auto strategyThread = std::thread([&tradedExchangeQueues, strategyConfig, longCycleSearchConfig] {
+        strategy(tradedExchangeQueues, inFlightCycleRegistry, strategyConfig, longCycleSearchConfig);
     });
 
-    bookBuilderGatewayThread.join();
-    bookBuilderComponentThread.join();
+    for (std::thread& tradedExchangeThread : tradedExchangeThreads)
+        tradedExchangeThread.join();
     strategyThread.join();
-    orderManagerThread.join();
 
     return 0;
 }